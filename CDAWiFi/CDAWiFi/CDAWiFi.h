@@ -13,8 +13,20 @@
 #import <CDAWiFi/CDAWiFiChannel.h>
 #import <CDAWiFi/CDAWiFiClient.h>
 #import <CDAWiFi/CDAWiFiInterface.h>
+#import <CDAWiFi/CDAWiFiInterfaceState.h>
 #import <CDAWiFi/CDAWiFiNetwork.h>
 #import <CDAWiFi/CDAWiFiNetworkProfile.h>
+#import <CDAWiFi/CDAWiFiScanCacheChanges.h>
+#import <CDAWiFi/CDAWiFiMergedScanResult.h>
+#import <CDAWiFi/CDAWiFiScanSnapshot.h>
+#import <CDAWiFi/CDAWiFiRSSIHistory.h>
+#import <CDAWiFi/CDAWiFiRoamingEngine.h>
+#import <CDAWiFi/CDAWiFiLinkSampler.h>
+#import <CDAWiFi/CDAWiFiChannelSurvey.h>
+#import <CDAWiFi/CDAWiFiAutoChannelEngine.h>
+#import <CDAWiFi/CDAWiFiScanQuery.h>
+#import <CDAWiFi/CDAWiFiProfileStore.h>
+#import <CDAWiFi/CDAWiFiAutoJoinEngine.h>
 
 
 
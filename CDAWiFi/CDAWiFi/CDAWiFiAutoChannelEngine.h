@@ -0,0 +1,211 @@
+//
+//  CDAWiFiAutoChannelEngine.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiInterface, CDAWiFiChannel, CDAWiFiChannelSurvey;
+
+/*!
+ * @constant CDAWiFiAutoChannelEngineDefaultMinimumImprovement
+ *
+ * @abstract The default share by which the best channel must beat the current one before the engine switches.
+ */
+#define CDAWiFiAutoChannelEngineDefaultMinimumImprovement 0.25
+
+/*!
+ * @constant CDAWiFiAutoChannelEngineDefaultInterval
+ *
+ * @abstract The default interval (seconds) between the evaluations of a running engine.
+ */
+#define CDAWiFiAutoChannelEngineDefaultInterval 60
+
+/*!
+ * @typedef CDAWiFiAutoChannelScore
+ *
+ * @abstract The evaluation of a channel.
+ *
+ * @discussion
+ * BSSes heard above the clear channel assessment threshold (-82 dBm) share the air time of the channel,
+ * weaker ones raise its noise floor. The score estimates the clear bandwidth left to the access point:
+ * the width of the channel, times the idle share of its busiest 20 MHz channel, divided among the contending BSSes,
+ * scaled down by the interference over the noise floor.
+ */
+typedef struct CDAWiFiAutoChannelScore {
+    int channelNumber;
+    CDAWiFiChannelWidth channelWidth;
+    CDAWiFiChannelBand channelBand;
+    float contention;       /* Overlapping BSSes above the threshold, partial overlaps count partially */
+    float interference;     /* dBm, noise floor plus the weaker overlapping BSSes */
+    float utilization;      /* Average utilization of the busiest 20 MHz channel of the span, 0 if never surveyed */
+    float score;            /* MHz */
+} CDAWiFiAutoChannelScore;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Picks the best channel and width for an access point, and moves a HostAP interface to it.
+ *
+ * @discussion
+ * Every evaluation scores all the supported channels at every supported width in one batch, from the cached
+ * scan results (the channel, width and RSSI of every BSS) and a fresh channel survey (the utilization and
+ * the noise of every channel). The candidates, the BSSes and the survey are flat arrays of floats, scored by
+ * branchless loops the compiler vectorizes, so an evaluation stays cheap with hundreds of BSSes in range.
+ *
+ * Scan before the first evaluation, the engine does not scan by itself: an access point cannot leave its channel.
+ * Thread safe.
+ */
+@interface CDAWiFiAutoChannelEngine : OFObject
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes an engine for an interface. The engine does nothing until it evaluates or is started.
+ */
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interface the engine moves.
+ */
+@property (readonly) CDAWiFiInterface *interface;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The survey of the channels of the interface, updated by every evaluation.
+ */
+@property (readonly) CDAWiFiChannelSurvey *survey;
+
+/*! @functiongroup Configuring the Engine */
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The widest channel considered, 80 MHz by default.
+ */
+@property CDAWiFiChannelWidth maximumChannelWidth;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The share by which the best channel must beat the current one before a running engine switches, 0.25 by default.
+ */
+@property double minimumImprovement;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Invoked on a global queue after every automatic channel change, with the new channel or the error.
+ */
+@property (copy) void (^channelHandler)(CDAWiFiChannel *channel, CDAError *error);
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Invoked on a global queue when a running engine finds a channel that beats the one of a running access point
+ * by the minimum improvement.
+ *
+ * @discussion
+ * The engine does not move a running access point, which must announce the switch in its beacons.
+ * Pass the channel to the process that builds them, for example to the chan_switch command of hostapd.
+ */
+@property (copy) void (^recommendationHandler)(CDAWiFiChannel *channel);
+
+/*! @functiongroup Evaluating Channels */
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Updates the survey and scores every channel.
+ */
+- (BOOL)evaluateAndReturnError:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @param scores
+ * A C array of maximumCount elements which upon return contains the scores of the last evaluation, best first.
+ *
+ * @result
+ * The number of scores copied.
+ *
+ * @abstract
+ * Copies the scores of the last evaluation.
+ */
+- (size_t)getScores:(CDAWiFiAutoChannelScore *)scores maximumCount:(size_t)maximumCount;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the best channel of the last evaluation, or nil.
+ */
+- (CDAWiFiChannel *)bestChannel;
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * The channel of the interface, or nil if an error occurs.
+ *
+ * @abstract
+ * Evaluates the channels and moves the interface to the best one, whatever the improvement.
+ *
+ * @discussion
+ * Meant for the start of an access point, before it beacons. Fails with a CDAWiFiNotSupportedError error
+ * if the access point already runs, and with a CDAWiFiInvalidParameterError error if a station interface is associated.
+ */
+- (CDAWiFiChannel *)selectChannelAndReturnError:(out CDAError **)error;
+
+/*! @functiongroup Running the Engine */
+
+/*!
+ * @method
+ *
+ * @param interval
+ * The interval (seconds) between evaluations.
+ *
+ * @abstract
+ * Evaluates the channels periodically when the interface is in HostAP mode. If the best channel beats the current one
+ * by the minimum improvement, moves the interface to it before the access point starts, and passes it to
+ * recommendationHandler once the access point runs. Changes the interval if the engine is running.
+ */
+- (void)startWithInterval:(of_time_interval_t)interval;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Stops the periodic evaluations.
+ */
+- (void)stop;
+
+@end
@@ -0,0 +1,590 @@
+//
+//  CDAWiFiAutoChannelEngine.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiAutoChannelEngine.h"
+#import "CDAWiFiChannelSurvey.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiChannel+Private.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiInterface.h"
+#import "CDAWiFiInterface+Private.h"
+#import "CDAWiFiUtilities.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Clear channel assessment threshold (dBm) of an OFDM receiver for a 20 MHz signal. */
+#define CDAWiFiAutoChannelClearChannelAssessmentThreshold -82
+
+/* Noise floor (dBm) of the channels the survey has no measurement for. */
+#define CDAWiFiAutoChannelDefaultNoise -95
+
+static inline float CDAWiFiAutoChannelWidthMHz(CDAWiFiChannelWidth width)
+{
+    return (float)(20 << (width - CDAWiFiChannelWidth20MHz));
+}
+
+static inline float CDAWiFiAutoChannelPower(float dBm)
+{
+    return powf(10.0f, dBm / 10.0f);
+}
+
+/*
+ * The loops below run over every candidate for each BSS or surveyed channel. They take flat arrays and
+ * select with masks instead of branching, so the compiler vectorizes them.
+ */
+
+/* Adds a BSS spanning bssLow to bssHigh (MHz), contending (1) or interfering with the received power (mW) (0). */
+static void CDAWiFiAutoChannelAddBSS(size_t count, const float *restrict low, const float *restrict high,
+                                     float *restrict contention, float *restrict interference,
+                                     float bssLow, float bssHigh, float contending, float power)
+{
+    float bssWidth = bssHigh - bssLow;
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        float overlap = fmaxf(0.0f, fminf(high[index], bssHigh) - fmaxf(low[index], bssLow));
+        
+        /* A BSS nested in the channel, or the channel nested in the BSS, fully contends. */
+        contention[index] += contending * overlap / fminf(high[index] - low[index], bssWidth);
+        interference[index] += (1.0f - contending) * power * overlap / bssWidth;
+    }
+}
+
+/* Adds the survey of the 20 MHz channel centered on frequency (MHz) to the candidates it is part of. */
+static void CDAWiFiAutoChannelAddSurvey(size_t count, const float *restrict low, const float *restrict high,
+                                        float *restrict utilization, float *restrict noise,
+                                        float frequency, float channelUtilization, float channelNoise)
+{
+    for (size_t index = 0; index < count; index++) {
+        
+        /* 20 MHz channels of a span are centered 10 MHz past each multiple of 20 MHz from its low edge. */
+        float offset = frequency - low[index];
+        float inside = (float)((offset > 0.0f) & (frequency < high[index]) &
+                               (offset - 20.0f * floorf(offset / 20.0f) == 10.0f));
+        
+        utilization[index] = fmaxf(utilization[index], inside * channelUtilization);
+        noise[index] = fmaxf(noise[index], inside * channelNoise);
+    }
+}
+
+static void CDAWiFiAutoChannelScoreCandidates(size_t count, const float *restrict low, const float *restrict high,
+                                              const float *restrict contention, const float *restrict utilization,
+                                              float *restrict noise, float *restrict interference, float *restrict score)
+{
+    float defaultNoise = CDAWiFiAutoChannelPower(CDAWiFiAutoChannelDefaultNoise);
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        noise[index] = (noise[index] > 0.0f) ? noise[index] : defaultNoise;
+        
+        float floor = noise[index] + interference[index];
+        
+        score[index] = (high[index] - low[index]) * (1.0f - utilization[index]) / (1.0f + contention[index]) * noise[index] / floor;
+        interference[index] = floor;
+    }
+}
+
+static int CDAWiFiAutoChannelCompareScores(const void *first, const void *second)
+{
+    const CDAWiFiAutoChannelScore *a = first, *b = second;
+    
+    /* Best first, ties by band, channel number and width for a stable choice. */
+    if (a->score != b->score) {
+        return (a->score < b->score) - (a->score > b->score);
+    }
+    
+    if (a->channelBand != b->channelBand) {
+        return (a->channelBand > b->channelBand) - (a->channelBand < b->channelBand);
+    }
+    
+    if (a->channelNumber != b->channelNumber) {
+        return (a->channelNumber > b->channelNumber) - (a->channelNumber < b->channelNumber);
+    }
+    
+    return (a->channelWidth > b->channelWidth) - (a->channelWidth < b->channelWidth);
+}
+
+@implementation CDAWiFiAutoChannelEngine
+{
+    dispatch_queue_t _queue;
+    dispatch_source_t _timer;
+    
+    /* Candidates, loaded once on the queue: one channel and span (MHz) per index. Every array is a slice of _low. */
+    OFArray *_channels;
+    float *_low;
+    float *_high;
+    
+    /* Per candidate results of the evaluation, only used on the queue. */
+    float *_contention;
+    float *_interference;
+    float *_utilization;
+    float *_noise;
+    float *_score;
+    
+    /* Results of the last evaluation, best first, guarded by the mutex. */
+    OFMutex *_mutex;
+    OFDataArray *_scores;
+    CDAWiFiChannel *_bestChannel;
+}
+
+@synthesize interface = _interface, survey = _survey;
+@synthesize maximumChannelWidth = _maximumChannelWidth, minimumImprovement = _minimumImprovement;
+@synthesize channelHandler = _channelHandler, recommendationHandler = _recommendationHandler;
+
+#pragma mark - Initialization
+
+- (instancetype)init
+{
+    return [self initWithInterface:nil];
+}
+
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface
+{
+    self = [super init];
+    
+    if (self) {
+        
+        if (interface == nil) {
+            return nil;
+        }
+        
+        _interface = interface;
+        _survey = [[CDAWiFiChannelSurvey alloc] initWithInterface:interface];
+        _maximumChannelWidth = CDAWiFiChannelWidth80MHz;
+        _minimumImprovement = CDAWiFiAutoChannelEngineDefaultMinimumImprovement;
+        _queue = dispatch_queue_create("CDAWiFiAutoChannelEngine", DISPATCH_QUEUE_SERIAL);
+        _mutex = [OFMutex mutex];
+        _scores = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiAutoChannelScore)];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_timer != NULL) {
+        
+        dispatch_source_cancel(_timer);
+        
+        CDAWiFiDispatchRelease(_timer);
+    }
+    
+    if (_queue != NULL) {
+        CDAWiFiDispatchRelease(_queue);
+    }
+    
+    free(_low);
+}
+
+#pragma mark - Candidates
+
+/*
+ * Runs on the queue. Keeps the supported channels whose whole span is made of supported 20 MHz channels,
+ * the interface reports its widths per band whatever the channel.
+ */
+- (BOOL)loadCandidatesAndReturnError:(out CDAError **)error
+{
+    if (_channels != nil) {
+        return YES;
+    }
+    
+    OFSet *supportedChannels = _interface.supportedWLANChannels;
+    
+    if (supportedChannels == nil) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiUnspecifiedFailureError);
+        }
+        
+        return NO;
+    }
+    
+    OFMutableSet *frequencies = [OFMutableSet set];
+    
+    for (CDAWiFiChannel *channel in supportedChannels) {
+        
+        uint32_t frequency = CDAWiFiFrequencyForChannelNumber(channel.channelNumber, channel.channelBand);
+        
+        if (frequency != 0) {
+            [frequencies addObject:[OFNumber numberWithUInt32:frequency]];
+        }
+    }
+    
+    size_t capacity = supportedChannels.count;
+    OFMutableArray *channels = [OFMutableArray arrayWithCapacity:capacity];
+    
+    float *arrays = malloc(7 * OF_MAX(capacity, 1) * sizeof(float));
+    
+    if (arrays == NULL) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiNoMemoryError);
+        }
+        
+        return NO;
+    }
+    
+    _low = arrays;
+    _high = _low + capacity;
+    _contention = _high + capacity;
+    _interference = _contention + capacity;
+    _utilization = _interference + capacity;
+    _noise = _utilization + capacity;
+    _score = _noise + capacity;
+    
+    for (CDAWiFiChannel *channel in supportedChannels) {
+        
+        uint32_t center = CDAWiFiCenterFrequencyForChannel(channel.channelNumber, channel.channelWidth, channel.channelBand);
+        
+        if (center == 0) {
+            continue;
+        }
+        
+        uint32_t width = (uint32_t)CDAWiFiAutoChannelWidthMHz(channel.channelWidth);
+        BOOL supported = YES;
+        
+        for (uint32_t frequency = center - width / 2 + 10; supported && frequency < center + width / 2; frequency += 20) {
+            supported = [frequencies containsObject:[OFNumber numberWithUInt32:frequency]];
+        }
+        
+        if (!supported) {
+            continue;
+        }
+        
+        _low[channels.count] = center - width / 2.0f;
+        _high[channels.count] = center + width / 2.0f;
+        
+        [channels addObject:channel];
+    }
+    
+    [channels makeImmutable];
+    
+    _channels = channels;
+    
+    return YES;
+}
+
+#pragma mark - Evaluating Channels
+
+/* Runs on the queue. */
+- (BOOL)evaluateWithError:(out CDAError **)error
+{
+    if (![self loadCandidatesAndReturnError:error]) {
+        return NO;
+    }
+    
+    /* Drivers without survey support are scored from the scan results alone. */
+    [_survey updateAndReturnError:NULL];
+    
+    OFSet *networks = _interface.cachedScanResults;
+    
+    if (networks == nil) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiUnspecifiedFailureError);
+        }
+        
+        return NO;
+    }
+    
+    size_t count = _channels.count;
+    
+    memset(_contention, 0, count * sizeof(float));
+    memset(_interference, 0, count * sizeof(float));
+    memset(_utilization, 0, count * sizeof(float));
+    memset(_noise, 0, count * sizeof(float));
+    
+    for (CDAWiFiNetwork *network in networks) {
+        
+        CDAWiFiChannel *channel = network.wlanChannel;
+        uint32_t center = CDAWiFiCenterFrequencyForChannel(channel.channelNumber, channel.channelWidth, channel.channelBand);
+        
+        if (center == 0) {
+            continue;
+        }
+        
+        float width = CDAWiFiAutoChannelWidthMHz(channel.channelWidth);
+        float contending = (network.rssiValue >= CDAWiFiAutoChannelClearChannelAssessmentThreshold);
+        
+        CDAWiFiAutoChannelAddBSS(count, _low, _high, _contention, _interference,
+                                 center - width / 2, center + width / 2, contending, CDAWiFiAutoChannelPower(network.rssiValue));
+    }
+    
+    size_t surveyCount = _survey.channelCount;
+    CDAWiFiChannelSurveyEntry *entries = malloc(OF_MAX(surveyCount, 1) * sizeof(CDAWiFiChannelSurveyEntry));
+    
+    if (entries == NULL) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiNoMemoryError);
+        }
+        
+        return NO;
+    }
+    
+    surveyCount = [_survey getChannels:entries maximumCount:surveyCount];
+    
+    for (size_t index = 0; index < surveyCount; index++) {
+        
+        float noise = (entries[index].averageNoise != 0) ? CDAWiFiAutoChannelPower(entries[index].averageNoise) : 0;
+        
+        CDAWiFiAutoChannelAddSurvey(count, _low, _high, _utilization, _noise,
+                                    entries[index].frequency, entries[index].averageUtilization, noise);
+    }
+    
+    free(entries);
+    
+    CDAWiFiAutoChannelScoreCandidates(count, _low, _high, _contention, _utilization, _noise, _interference, _score);
+    
+    OFDataArray *scores = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiAutoChannelScore)];
+    CDAWiFiChannelWidth maximumChannelWidth = self.maximumChannelWidth;
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        CDAWiFiChannel *channel = [_channels objectAtIndex:index];
+        CDAWiFiAutoChannelScore score;
+        
+        if (channel.channelWidth > maximumChannelWidth) {
+            continue;
+        }
+        
+        score.channelNumber = channel.channelNumber;
+        score.channelWidth = channel.channelWidth;
+        score.channelBand = channel.channelBand;
+        score.contention = _contention[index];
+        score.interference = 10.0f * log10f(_interference[index]);
+        score.utilization = _utilization[index];
+        score.score = _score[index];
+        
+        [scores addItem:&score];
+    }
+    
+    qsort(scores.items, scores.count, sizeof(CDAWiFiAutoChannelScore), CDAWiFiAutoChannelCompareScores);
+    
+    CDAWiFiChannel *bestChannel = nil;
+    
+    if (scores.count > 0) {
+        
+        const CDAWiFiAutoChannelScore *best = scores.firstItem;
+        
+        bestChannel = [CDAWiFiChannel channelWithChannelNumber:best->channelNumber
+                                                  channelWidth:best->channelWidth
+                                                   channelBand:best->channelBand];
+    }
+    
+    [_mutex lock];
+    
+    _scores = scores;
+    _bestChannel = bestChannel;
+    
+    [_mutex unlock];
+    
+    return YES;
+}
+
+- (BOOL)evaluateAndReturnError:(out CDAError **)error
+{
+    __block BOOL success;
+    __block CDAError *evaluationError = nil;
+    
+    dispatch_sync(_queue, ^{
+        
+        success = [self evaluateWithError:&evaluationError];
+    });
+    
+    if (!success && error != NULL) {
+        *error = evaluationError;
+    }
+    
+    return success;
+}
+
+- (size_t)getScores:(CDAWiFiAutoChannelScore *)scores maximumCount:(size_t)maximumCount
+{
+    [_mutex lock];
+    
+    size_t count = OF_MIN(_scores.count, maximumCount);
+    
+    if (count > 0) {
+        memcpy(scores, _scores.items, count * sizeof(CDAWiFiAutoChannelScore));
+    }
+    
+    [_mutex unlock];
+    
+    return count;
+}
+
+- (CDAWiFiChannel *)bestChannel
+{
+    [_mutex lock];
+    
+    CDAWiFiChannel *channel = _bestChannel;
+    
+    [_mutex unlock];
+    
+    return channel;
+}
+
+/* Returns the score of the last evaluation for a channel, or -1 if it was not scored. */
+- (float)scoreForChannel:(CDAWiFiChannel *)channel
+{
+    float result = -1.0f;
+    
+    [_mutex lock];
+    
+    const CDAWiFiAutoChannelScore *scores = _scores.items;
+    
+    for (size_t index = 0; index < _scores.count; index++) {
+        
+        if (scores[index].channelNumber == channel.channelNumber && scores[index].channelWidth == channel.channelWidth &&
+            scores[index].channelBand == channel.channelBand) {
+            
+            result = scores[index].score;
+            
+            break;
+        }
+    }
+    
+    [_mutex unlock];
+    
+    return result;
+}
+
+- (CDAWiFiChannel *)selectChannelAndReturnError:(out CDAError **)error
+{
+    __block CDAWiFiChannel *channel = nil;
+    __block CDAError *selectionError = nil;
+    
+    dispatch_sync(_queue, ^{
+        
+        if (![self evaluateWithError:&selectionError]) {
+            return;
+        }
+        
+        CDAWiFiChannel *bestChannel = self.bestChannel;
+        
+        if (bestChannel == nil) {
+            
+            selectionError = CDAWiFiErrorWithCode(CDAWiFiUnspecifiedFailureError);
+            
+            return;
+        }
+        
+        if (bestChannel != _interface.wlanChannel && ![_interface setWLANChannel:bestChannel error:&selectionError]) {
+            return;
+        }
+        
+        channel = bestChannel;
+    });
+    
+    if (channel == nil && error != NULL) {
+        *error = selectionError;
+    }
+    
+    return channel;
+}
+
+#pragma mark - Running the Engine
+
+- (void)startWithInterval:(of_time_interval_t)interval
+{
+    if (!(interval > 0)) {
+        return;
+    }
+    
+    uint64_t nanoseconds = (uint64_t)(interval * NSEC_PER_SEC);
+    
+    dispatch_sync(_queue, ^{
+        
+        if (_timer == NULL) {
+            
+            __weak CDAWiFiAutoChannelEngine *weakSelf = self;
+            
+            _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+            
+            dispatch_source_set_event_handler(_timer, ^{
+                
+                [weakSelf evaluateAndSwitch];
+            });
+            
+            dispatch_resume(_timer);
+        }
+        
+        dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, nanoseconds), nanoseconds, nanoseconds / 10);
+    });
+}
+
+- (void)stop
+{
+    dispatch_sync(_queue, ^{
+        
+        if (_timer == NULL) {
+            return;
+        }
+        
+        dispatch_source_cancel(_timer);
+        
+        CDAWiFiDispatchRelease(_timer);
+        
+        _timer = NULL;
+    });
+}
+
+/*
+ * Runs on the queue. Only access points move, and only for a clear gain, every change disrupts the clients.
+ * A running access point is not moved, the best channel is only recommended.
+ */
+- (void)evaluateAndSwitch
+{
+    if (_interface.interfaceMode != CDAWiFiInterfaceModeHostAP || ![self evaluateWithError:NULL]) {
+        return;
+    }
+    
+    CDAWiFiChannel *bestChannel = self.bestChannel;
+    CDAWiFiChannel *currentChannel = _interface.wlanChannel;
+    
+    if (bestChannel == nil || bestChannel == currentChannel) {
+        return;
+    }
+    
+    float currentScore = (currentChannel != nil) ? [self scoreForChannel:currentChannel] : -1.0f;
+    
+    if (currentScore >= 0 && [self scoreForChannel:bestChannel] < currentScore * (1.0 + self.minimumImprovement)) {
+        return;
+    }
+    
+    if (_interface.beaconing) {
+        
+        void (^recommendationHandler)(CDAWiFiChannel *) = self.recommendationHandler;
+        
+        if (recommendationHandler != nil) {
+            
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                
+                recommendationHandler(bestChannel);
+            });
+        }
+        
+        return;
+    }
+    
+    CDAError *error = nil;
+    CDAWiFiChannel *channel = [_interface setWLANChannel:bestChannel error:&error] ? bestChannel : nil;
+    void (^channelHandler)(CDAWiFiChannel *, CDAError *) = self.channelHandler;
+    
+    if (channelHandler != nil) {
+        
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            
+            channelHandler(channel, error);
+        });
+    }
+}
+
+@end
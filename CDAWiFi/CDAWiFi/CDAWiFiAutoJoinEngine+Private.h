@@ -0,0 +1,43 @@
+//
+//  CDAWiFiAutoJoinEngine+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiAutoJoinEngine.h>
+
+@class CDAWiFiScanCacheChanges, CDAWiFiSSID;
+
+@interface CDAWiFiAutoJoinEngine (Private)
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Joins the best known network in the scan cache of the interface if a network added or changed may match a profile.
+ * Returns immediately.
+ */
+- (void)scanCacheDidChange:(CDAWiFiScanCacheChanges *)changes;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Rebuilds the Bloom filter if the profile store changed since it was built. Returns NO if out of memory.
+ *
+ * @discussion
+ * Only called on the queue of the engine while it runs.
+ */
+- (BOOL)updateFilter;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns NO if no profile has the SSID, YES if one may have it. The filter must have been built.
+ */
+- (BOOL)filterMayContainSSID:(CDAWiFiSSID *)ssid;
+
+@end
@@ -0,0 +1,125 @@
+//
+//  CDAWiFiAutoJoinEngine.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiInterface, CDAWiFiNetwork, CDAWiFiNetworkProfile, CDAWiFiProfileStore;
+
+/*!
+ * @constant CDAWiFiAutoJoinEngineDefaultMinimumRSSI
+ *
+ * @abstract The default RSSI (dBm) below which an auto-join engine ignores a BSS.
+ */
+#define CDAWiFiAutoJoinEngineDefaultMinimumRSSI -80
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Joins a known network whenever a station mode interface is not associated and one shows up in the scan cache.
+ *
+ * @discussion
+ * The engine is told about every change of the scan cache of the interface, including the updates that follow the
+ * scan events of the client. A Bloom filter over the SSIDs of the profiles of a profile store rejects the BSSes of
+ * unknown SSIDs with a few bit tests, so the cost of a scan grows with the number of BSSes, not with the number of profiles.
+ * When a BSS added or changed passes the filter, every BSS of the scan cache is matched against the profiles,
+ * only the SSIDs passing the filter being looked up in the store. The scan cache is matched the same way
+ * when the interface disconnects, if the client has an event engine.
+ *
+ * The matching BSSes are ranked by the security of their profile, strongest first, then by RSSI,
+ * 5 GHz BSSes getting a bonus of 5 dB, and the engine associates to the best ones in turn until one succeeds.
+ * Only open and WPA Personal profiles are joined, since associateToNetwork:password:error: does not support the others,
+ * and a WPA Personal profile only when the password handler returns its passphrase.
+ *
+ * Thread safe.
+ */
+@interface CDAWiFiAutoJoinEngine : OFObject
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes an auto-join engine for an interface. The engine does nothing until it is started.
+ */
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface profileStore:(CDAWiFiProfileStore *)profileStore;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interface the engine associates.
+ */
+@property (readonly) CDAWiFiInterface *interface;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The known networks. Updates of the store apply to the next scan cache change.
+ */
+@property (readonly) CDAWiFiProfileStore *profileStore;
+
+/*! @functiongroup Configuring Auto-Join */
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The RSSI (dBm) below which a BSS is not joined.
+ */
+@property int minimumRSSI;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Returns the passphrase of a WPA Personal profile about to be joined.
+ *
+ * @discussion
+ * Invoked on the queue of the engine. If the handler is nil or returns nil, the profile is skipped; the key set
+ * with -[CDAWiFiInterface setPairwiseMasterKey:error:] is never used by the engine.
+ */
+@property (copy) OFString *(^passwordHandler)(CDAWiFiNetworkProfile *profile);
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Invoked on a global queue after every automatic join, with the BSS joined or the error of the last attempt.
+ */
+@property (copy) void (^joinHandler)(CDAWiFiNetwork *network, CDAError *error);
+
+/*! @functiongroup Running the Engine */
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Starts watching the scan cache of the interface, and looks for a known network in the current scan results.
+ * Does nothing if the engine is running.
+ */
+- (BOOL)startAndReturnError:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Stops the engine. Does not disassociate the interface.
+ */
+- (void)stop;
+
+@end
@@ -0,0 +1,473 @@
+//
+//  CDAWiFiAutoJoinEngine.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiAutoJoinEngine.h"
+#import "CDAWiFiAutoJoinEngine+Private.h"
+#import "CDAWiFiInterface.h"
+#import "CDAWiFiInterface+Private.h"
+#import "CDAWiFiInterfaceState.h"
+#import "CDAWiFiClient.h"
+#import "CDAWiFiClient+Private.h"
+#import "CDAWiFiEventEngine.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiNetworkProfile.h"
+#import "CDAWiFiProfileStore.h"
+#import "CDAWiFiProfileStore+Private.h"
+#import "CDAWiFiSSID.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiScanCacheChanges.h"
+#import "CDAWiFiScanQuery.h"
+#import "CDAWiFiUtilities.h"
+#include <stdlib.h>
+
+/* Score bonus (dB) of 5 GHz BSSes, which are usually less congested. */
+#define CDAWiFiAutoJoinEngine5GHzBonus 5
+
+/* Score of a security rank, above any RSSI difference. */
+#define CDAWiFiAutoJoinEngineSecurityWeight 1000
+
+/* Seconds a BSS that refused an association is skipped. */
+#define CDAWiFiAutoJoinEngineFailurePenalty 60
+
+/* Candidates tried per join. */
+#define CDAWiFiAutoJoinEngineMaximumAttempts 3
+
+/* Bloom filter sizing: bits per profile before rounding up to a power of two, and bits tested per SSID. */
+#define CDAWiFiAutoJoinEngineFilterBitsPerProfile 10
+#define CDAWiFiAutoJoinEngineFilterHashCount 7
+#define CDAWiFiAutoJoinEngineFilterMinimumBitCount 1024
+
+/* Ranks the securities associateToNetwork:password:error: supports, strongest highest. -1 for the others. */
+static inline int CDAWiFiAutoJoinEngineSecurityRank(CDAWiFiSecurity security)
+{
+    switch (security) {
+        
+        case CDAWiFiSecurityNone:
+            return 0;
+        
+        case CDAWiFiSecurityWPAPersonal:
+            return 1;
+        
+        case CDAWiFiSecurityWPAPersonalMixed:
+            return 2;
+        
+        case CDAWiFiSecurityWPA2Personal:
+        case CDAWiFiSecurityPersonal:
+            return 3;
+        
+        default:
+            return -1;
+    }
+}
+
+static inline int CDAWiFiAutoJoinEngineScore(CDAWiFiSecurity security, int rssi, CDAWiFiChannel *channel)
+{
+    return CDAWiFiAutoJoinEngineSecurityRank(security) * CDAWiFiAutoJoinEngineSecurityWeight + rssi +
+           ((channel.channelBand == CDAWiFiChannelBand5GHz) ? CDAWiFiAutoJoinEngine5GHzBonus : 0);
+}
+
+/* Derives the probes of the Bloom filter from one 64 bit FNV-1a hash of an SSID, by double hashing. */
+static inline void CDAWiFiAutoJoinEngineFilterHash(const uint8_t *ssid, size_t length, uint32_t *hash, uint32_t *step)
+{
+    uint64_t value = 14695981039346656037ull;
+    
+    for (size_t index = 0; index < length; index++) {
+        value = (value ^ ssid[index]) * 1099511628211ull;
+    }
+    
+    *hash = (uint32_t)value;
+    *step = (uint32_t)(value >> 32) | 1;
+}
+
+/* A network the engine may join, with the profile it matched. */
+@interface CDAWiFiAutoJoinCandidate : OFObject
+{
+@public
+    CDAWiFiNetwork *_network;
+    CDAWiFiNetworkProfile *_profile;
+    int _score;
+}
+
+@end
+
+@implementation CDAWiFiAutoJoinCandidate
+
+@end
+
+@implementation CDAWiFiAutoJoinEngine
+{
+    /* Every ivar below is only used on the queue. */
+    dispatch_queue_t _queue;
+    BOOL _running;
+    
+    uint64_t *_filter;                  /* Bloom filter of the SSIDs of the profiles */
+    uint32_t _filterMask;               /* Number of bits of the filter minus one */
+    uint64_t _filterGeneration;         /* Generation of the profile store the filter was built from */
+    
+    OFMutableDictionary *_failures;     /* OFNumber monotonic time of the last refused association by BSSID */
+    
+    id _linkObserver;                   /* Disconnection observer of the event engine of the client, if it has one */
+}
+
+@synthesize interface = _interface, profileStore = _profileStore, minimumRSSI = _minimumRSSI;
+@synthesize passwordHandler = _passwordHandler, joinHandler = _joinHandler;
+
+#pragma mark - Initialization
+
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface profileStore:(CDAWiFiProfileStore *)profileStore
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _interface = interface;
+        _profileStore = profileStore;
+        _minimumRSSI = CDAWiFiAutoJoinEngineDefaultMinimumRSSI;
+        _queue = dispatch_queue_create("CDAWiFiAutoJoinEngine", DISPATCH_QUEUE_SERIAL);
+        _failures = [OFMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_linkObserver != nil) {
+        [_interface.client.eventEngine removeLinkObserver:_linkObserver];
+    }
+    
+    /* Pending blocks retain the engine, so the queue is idle here. */
+    free(_filter);
+    
+    if (_queue != NULL) {
+        CDAWiFiDispatchRelease(_queue);
+    }
+}
+
+#pragma mark - Running the Engine
+
+- (BOOL)startAndReturnError:(out CDAError **)error
+{
+    __block BOOL success = YES;
+    
+    dispatch_sync(_queue, ^{
+        
+        if (_running) {
+            return;
+        }
+        
+        if (![self updateFilter]) {
+            
+            success = NO;
+            
+            return;
+        }
+        
+        /* Without an event engine, the engine only joins when the scan cache changes. */
+        CDAWiFiEventEngine *eventEngine = _interface.client.eventEngine;
+        
+        if (eventEngine != nil && [eventEngine startAndReturnError:NULL]) {
+            
+            __weak CDAWiFiAutoJoinEngine *weakSelf = self;
+            dispatch_queue_t queue = _queue;
+            
+            _linkObserver = [eventEngine addLinkObserverForInterfaceIndex:_interface.interfaceIndex handler:^(CDAWiFiEventType type, int rssi) {
+                
+                if (type != CDAWiFiEventTypeLinkDidChange) {
+                    return;
+                }
+                
+                dispatch_async(queue, ^{
+                    
+                    [weakSelf linkDidGoDown];
+                });
+            }];
+        }
+        
+        _running = YES;
+        _interface.autoJoinEngine = self;
+        
+        [self joinNetworks:_interface.cachedScanResults];
+    });
+    
+    if (!success && error != NULL) {
+        *error = CDAWiFiErrorWithCode(CDAWiFiNoMemoryError);
+    }
+    
+    return success;
+}
+
+- (void)stop
+{
+    dispatch_sync(_queue, ^{
+        
+        if (!_running) {
+            return;
+        }
+        
+        _running = NO;
+        
+        if (_linkObserver != nil) {
+            
+            [_interface.client.eventEngine removeLinkObserver:_linkObserver];
+            
+            _linkObserver = nil;
+        }
+        
+        if (_interface.autoJoinEngine == self) {
+            _interface.autoJoinEngine = nil;
+        }
+        
+        [_failures removeAllObjects];
+    });
+}
+
+#pragma mark - Matching Networks
+
+- (void)scanCacheDidChange:(CDAWiFiScanCacheChanges *)changes
+{
+    dispatch_async(_queue, ^{
+        
+        if (!_running) {
+            return;
+        }
+        
+        /* Keeps the previous filter if out of memory, it only misses the profiles added since. */
+        [self updateFilter];
+        
+        /* The changes only tell whether a known network may have shown up. The candidates are ranked over the whole
+           scan cache, so a BSS that changed is never joined over a better one that did not. */
+        if ([self networksMayMatchProfile:changes.addedNetworks] || [self networksMayMatchProfile:changes.changedNetworks]) {
+            [self joinCachedNetworks];
+        }
+    });
+}
+
+/* Returns YES if the filter passes the SSID of one of the networks. */
+- (BOOL)networksMayMatchProfile:(OFSet *)networks
+{
+    for (CDAWiFiNetwork *network in networks) {
+        
+        CDAWiFiSSID *ssid = network.internedSSID;
+        
+        if (ssid != nil && ssid.length != 0 && [self filterMayContainSSID:ssid]) {
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
+/* The interface disconnected or lost its association, a known network in range is joined without waiting for a scan. */
+- (void)linkDidGoDown
+{
+    if (!_running) {
+        return;
+    }
+    
+    [self updateFilter];
+    [self joinCachedNetworks];
+}
+
+- (BOOL)updateFilter
+{
+    if (_filter != NULL && _profileStore.generation == _filterGeneration) {
+        return YES;
+    }
+    
+    uint32_t bitCount = CDAWiFiAutoJoinEngineFilterMinimumBitCount;
+    
+    while (bitCount < _profileStore.count * CDAWiFiAutoJoinEngineFilterBitsPerProfile && bitCount < UINT32_MAX / 4) {
+        bitCount *= 2;
+    }
+    
+    uint64_t *filter = calloc(bitCount / 64, sizeof(uint64_t));
+    uint32_t mask = bitCount - 1;
+    
+    if (filter == NULL) {
+        return NO;
+    }
+    
+    /* Profiles added between the count and the enumeration only make the filter fuller, never wrong. */
+    uint64_t generation = [_profileStore enumerateSSIDsUsingBlock:^(const uint8_t *ssid, size_t length) {
+        
+        uint32_t hash, step;
+        
+        CDAWiFiAutoJoinEngineFilterHash(ssid, length, &hash, &step);
+        
+        for (int probe = 0; probe < CDAWiFiAutoJoinEngineFilterHashCount; probe++, hash += step) {
+            filter[(hash & mask) / 64] |= (uint64_t)1 << (hash & 63);
+        }
+    }];
+    
+    free(_filter);
+    
+    _filter = filter;
+    _filterMask = mask;
+    _filterGeneration = generation;
+    
+    return YES;
+}
+
+- (BOOL)filterMayContainSSID:(CDAWiFiSSID *)ssid
+{
+    uint32_t hash, step;
+    
+    CDAWiFiAutoJoinEngineFilterHash(ssid.bytes, ssid.length, &hash, &step);
+    
+    for (int probe = 0; probe < CDAWiFiAutoJoinEngineFilterHashCount; probe++, hash += step) {
+        
+        if ((_filter[(hash & _filterMask) / 64] & ((uint64_t)1 << (hash & 63))) == 0) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+/* Ranks the networks matching a profile, best first. */
+- (OFArray *)candidatesWithNetworks:(id <OFFastEnumeration>)networks
+{
+    of_time_interval_t now = CDAWiFiMonotonicTime();
+    OFMutableArray *candidates = [OFMutableArray array];
+    
+    for (CDAWiFiNetwork *network in networks) {
+        
+        CDAWiFiSSID *ssid = network.internedSSID;
+        
+        if (ssid == nil || ssid.length == 0 || network.ibss || network.rssiValue < _minimumRSSI || ![self filterMayContainSSID:ssid]) {
+            continue;
+        }
+        
+        OFNumber *failure = _failures[[OFNumber numberWithUInt64:network.bssidValue]];
+        
+        if (failure != nil && now - failure.doubleValue < CDAWiFiAutoJoinEngineFailurePenalty) {
+            continue;
+        }
+        
+        for (CDAWiFiNetworkProfile *profile in [_profileStore profilesForNetwork:network]) {
+            
+            if (CDAWiFiAutoJoinEngineSecurityRank(profile.security) < 0) {
+                continue;
+            }
+            
+            CDAWiFiAutoJoinCandidate *candidate = [[CDAWiFiAutoJoinCandidate alloc] init];
+            
+            candidate->_network = network;
+            candidate->_profile = profile;
+            candidate->_score = CDAWiFiAutoJoinEngineScore(profile.security, network.rssiValue, network.wlanChannel);
+            
+            size_t index = candidates.count;
+            
+            while (index > 0 && ((CDAWiFiAutoJoinCandidate *)candidates[index - 1])->_score < candidate->_score) {
+                index--;
+            }
+            
+            [candidates insertObject:candidate atIndex:index];
+        }
+    }
+    
+    return candidates;
+}
+
+#pragma mark - Joining
+
+/* Associates to the best known network in the scan cache of the interface, as of its last update. */
+- (void)joinCachedNetworks
+{
+    CDAWiFiScanQuery *query = [CDAWiFiScanQuery query];
+    
+    query.minimumRSSI = _minimumRSSI;
+    
+    [self joinNetworks:[_interface cachedScanResultsMatchingQuery:query]];
+}
+
+/* Associates to the best candidate among networks, unless the interface is associated. */
+- (void)joinNetworks:(id <OFFastEnumeration>)networks
+{
+    OFArray *candidates = [self candidatesWithNetworks:networks];
+    
+    if (candidates.count == 0) {
+        return;
+    }
+    
+    [_interface updateStateAndReturnError:NULL];
+    
+    if (_interface.state.associated) {
+        return;
+    }
+    
+    of_time_interval_t now = CDAWiFiMonotonicTime();
+    OFString *(^passwordHandler)(CDAWiFiNetworkProfile *) = self.passwordHandler;
+    OFMutableSet *attempted = [OFMutableSet set];
+    CDAWiFiNetwork *joinedNetwork = nil;
+    CDAError *joinError = nil;
+    int attempts = 0;
+    
+    for (CDAWiFiAutoJoinCandidate *candidate in candidates) {
+        
+        if (attempts == CDAWiFiAutoJoinEngineMaximumAttempts) {
+            break;
+        }
+        
+        OFNumber *bssid = [OFNumber numberWithUInt64:candidate->_network.bssidValue];
+        
+        /* A BSS matching several profiles is tried once, with its best one. */
+        if ([attempted containsObject:bssid]) {
+            continue;
+        }
+        
+        OFString *password = nil;
+        
+        if (candidate->_profile.security != CDAWiFiSecurityNone) {
+            
+            if (passwordHandler != nil) {
+                password = passwordHandler(candidate->_profile);
+            }
+            
+            /* The key stored on the interface may belong to another SSID, so a secured profile without
+               a passphrase is not joined. The BSS may still be tried with another of its profiles. */
+            if (password == nil) {
+                continue;
+            }
+        }
+        
+        [attempted addObject:bssid];
+        
+        attempts++;
+        
+        if ([_interface associateToNetwork:candidate->_network password:password error:&joinError]) {
+            
+            [_failures removeObjectForKey:bssid];
+            
+            joinedNetwork = candidate->_network;
+            joinError = nil;
+            
+            break;
+        }
+        
+        _failures[bssid] = [OFNumber numberWithDouble:now];
+    }
+    
+    if (attempts == 0) {
+        return;
+    }
+    
+    void (^joinHandler)(CDAWiFiNetwork *, CDAError *) = self.joinHandler;
+    
+    if (joinHandler != nil) {
+        
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            
+            joinHandler(joinedNetwork, joinError);
+        });
+    }
+}
+
+@end
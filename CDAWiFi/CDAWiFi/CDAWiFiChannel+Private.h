@@ -0,0 +1,38 @@
+//
+//  CDAWiFiChannel+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/2/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiChannel.h>
+
+@interface CDAWiFiChannel (Private)
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the interned CDAWiFiChannel object with the specified properties.
+ *
+ * @discussion
+ * Channels are immutable and shared process wide, equal channels are the same object.
+ * Returns nil if a property is out of range.
+ */
++ (instancetype)channelWithChannelNumber:(int)channelNumber
+                            channelWidth:(CDAWiFiChannelWidth)channelWidth
+                             channelBand:(CDAWiFiChannelBand)channelBand;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns a CDAWiFiChannel object for a center frequency (MHz) and an nl80211 channel width.
+ *
+ * @discussion
+ * Returns nil if the frequency is not a Wi-Fi channel.
+ */
++ (instancetype)channelWithFrequency:(uint32_t)frequency nl80211ChannelWidth:(uint32_t)width;
+
+@end
@@ -17,6 +17,9 @@
  *
  * @discussion
  * The CDAWiFiChannel class is used by both CWInterface and CWNetwork as a representation of an IEEE 802.11 Wi-Fi channel.
+ *
+ * Channel objects are interned: every channel with the same number, width and band is the same instance,
+ * so comparing and hashing channels is constant time.
  */
 @interface CDAWiFiChannel : OFObject <OFCopying, OFSerialization>
 
@@ -7,36 +7,125 @@
 //
 
 #import "CDAWiFiChannel.h"
+#import "CDAWiFiChannel+Private.h"
+#import "CDAWiFiUtilities.h"
+#include <stdatomic.h>
+
+/* Channel number (8 bits), width (3 bits) and band (2 bits) packed into a key. Every key is a slot of the interned table. */
+#define CDAWiFiChannelKeyCount 8192
+
+static inline uint32_t CDAWiFiChannelKeyMake(int channelNumber, CDAWiFiChannelWidth channelWidth, CDAWiFiChannelBand channelBand)
+{
+    return ((uint32_t)channelNumber << 5) | ((uint32_t)channelWidth << 2) | (uint32_t)channelBand;
+}
+
+/* Interned channels by key. Entries are published once and live for the lifetime of the process. */
+static void *_Atomic CDAWiFiChannelTable[CDAWiFiChannelKeyCount];
 
 @implementation CDAWiFiChannel
+{
+    uint32_t _key;
+}
 
-#pragma mark - Equality
+#pragma mark - Initialization
 
--(BOOL)isEqualToChannel:(CDAWiFiChannel *)channel
+- (instancetype)init
+{
+    OF_INVALID_INIT_METHOD
+}
+
+- (instancetype)initWithChannelNumber:(int)channelNumber
+                         channelWidth:(CDAWiFiChannelWidth)channelWidth
+                          channelBand:(CDAWiFiChannelBand)channelBand
 {
-    if (!channel) {
-        return NO;
+    self = [super init];
+    
+    if (self) {
+        
+        _channelNumber = channelNumber;
+        _channelWidth = channelWidth;
+        _channelBand = channelBand;
+        _key = CDAWiFiChannelKeyMake(channelNumber, channelWidth, channelBand);
     }
     
-    return (self.channelNumber == channel.channelNumber &&
-            self.channelWidth == channel.channelWidth &&
-            self.channelBand == channel.channelBand);
+    return self;
 }
 
-- (bool)isEqual:(id)other
++ (instancetype)channelWithChannelNumber:(int)channelNumber
+                            channelWidth:(CDAWiFiChannelWidth)channelWidth
+                             channelBand:(CDAWiFiChannelBand)channelBand
 {
-    if (other == self) {
-        return YES;
-    } else if (![super isEqual:other]) {
-        return NO;
-    } else {
-        return [self isEqualToChannel:other];
+    if (channelNumber < 0 || channelNumber > UINT8_MAX ||
+        (uint32_t)channelWidth > CDAWiFiChannelWidth160MHz ||
+        (uint32_t)channelBand > CDAWiFiChannelBand5GHz) {
+        
+        return nil;
+    }
+    
+    uint32_t key = CDAWiFiChannelKeyMake(channelNumber, channelWidth, channelBand);
+    void *channel = atomic_load_explicit(&CDAWiFiChannelTable[key], memory_order_acquire);
+    
+    if (channel != NULL) {
+        return (__bridge CDAWiFiChannel *)channel;
     }
+    
+    /* Concurrent callers may race to create the channel, the first one to publish it wins. */
+    CDAWiFiChannel *candidate = [[CDAWiFiChannel alloc] initWithChannelNumber:channelNumber
+                                                                 channelWidth:channelWidth
+                                                                  channelBand:channelBand];
+    
+    void *expected = NULL;
+    
+    if (atomic_compare_exchange_strong_explicit(&CDAWiFiChannelTable[key], &expected, (__bridge void *)candidate,
+                                                memory_order_acq_rel, memory_order_acquire)) {
+        
+        /* The table owns a reference that is never released. */
+        (void)(__bridge_retained void *)candidate;
+        
+        return candidate;
+    }
+    
+    return (__bridge CDAWiFiChannel *)expected;
+}
+
++ (instancetype)channelWithFrequency:(uint32_t)frequency nl80211ChannelWidth:(uint32_t)width
+{
+    int channelNumber = CDAWiFiChannelNumberForFrequency(frequency);
+    
+    if (channelNumber == 0) {
+        return nil;
+    }
+    
+    return [self channelWithChannelNumber:channelNumber
+                             channelWidth:CDAWiFiChannelWidthForNL80211ChannelWidth(width)
+                              channelBand:CDAWiFiChannelBandForFrequency(frequency)];
+}
+
+#pragma mark - Copying
+
+- (id)copy
+{
+    /* Immutable and interned. */
+    return self;
+}
+
+#pragma mark - Equality
+
+/* Channels are interned, so equal channels are the same object. */
+
+-(BOOL)isEqualToChannel:(CDAWiFiChannel *)channel
+{
+    return (channel == self);
+}
+
+- (bool)isEqual:(id)other
+{
+    return (other == self);
 }
 
 - (uint32_t)hash
 {
-    return (_channelNumber ^ _channelWidth ^ _channelBand);
+    return _key;
 }
 
 @end
@@ -0,0 +1,146 @@
+//
+//  CDAWiFiChannelSurvey.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiInterface;
+
+/*!
+ * @constant CDAWiFiChannelSurveyDefaultSmoothingFactor
+ *
+ * @abstract The default weight of the newest survey in the rolling averages.
+ */
+#define CDAWiFiChannelSurveyDefaultSmoothingFactor 0.25
+
+/*!
+ * @typedef CDAWiFiChannelSurveyEntry
+ *
+ * @abstract The survey of a channel.
+ *
+ * @discussion
+ * Times are cumulative counters of the driver, in milliseconds. The utilization is the share of the active time
+ * the channel was sensed busy, from 0 to 1, over the interval since the previous survey that reported activity
+ * (over the whole counters for the first one).
+ */
+typedef struct CDAWiFiChannelSurveyEntry {
+    uint32_t frequency;             /* MHz */
+    int channelNumber;
+    CDAWiFiChannelBand channelBand;
+    BOOL inUse;                     /* The interface operates on the channel */
+    
+    int noise;                      /* dBm, 0 if unknown */
+    uint64_t activeTime;
+    uint64_t busyTime;
+    uint64_t receiveTime;
+    uint64_t transmitTime;
+    double utilization;
+    
+    double averageNoise;            /* dBm, 0 if unknown */
+    double averageUtilization;
+    unsigned sampleCount;           /* Intervals folded into the average utilization, 0 if the utilization is unknown */
+} CDAWiFiChannelSurveyEntry;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Surveys the noise and utilization of every supported channel of an interface, and keeps rolling averages.
+ *
+ * @discussion
+ * Every update is a single NL80211_CMD_GET_SURVEY dump, covering all the channels the driver has statistics for.
+ * Channels outside -[CDAWiFiInterface supportedWLANChannels] are left out. Each update folds the noise and the
+ * utilization of the interval since the previous update into exponentially weighted moving averages.
+ *
+ * Drivers only gather statistics for other channels while they visit them, usually during scans.
+ * Channels whose active time did not advance keep their averages. Thread safe.
+ */
+@interface CDAWiFiChannelSurvey : OFObject
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes a survey of the channels of an interface. Nothing is fetched until the first update.
+ */
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interface surveyed.
+ */
+@property (readonly) CDAWiFiInterface *interface;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The weight of the newest survey in the rolling averages, from 0 to 1.
+ */
+@property double smoothingFactor;
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Fetches the survey of every channel and folds it into the averages.
+ */
+- (BOOL)updateAndReturnError:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the number of channels surveyed so far.
+ */
+- (size_t)channelCount;
+
+/*!
+ * @method
+ *
+ * @param entries
+ * A C array of maximumCount elements which upon return contains the channels, by ascending frequency.
+ *
+ * @result
+ * The number of channels copied.
+ *
+ * @abstract
+ * Copies the survey table.
+ */
+- (size_t)getChannels:(CDAWiFiChannelSurveyEntry *)entries maximumCount:(size_t)maximumCount;
+
+/*!
+ * @method
+ *
+ * @result
+ * NO if the channel was never surveyed.
+ *
+ * @abstract
+ * Copies the survey of the channel with the specified center frequency (MHz).
+ */
+- (BOOL)getChannel:(CDAWiFiChannelSurveyEntry *)entry withFrequency:(uint32_t)frequency;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Forgets every channel and average.
+ */
+- (void)reset;
+
+@end
@@ -0,0 +1,290 @@
+//
+//  CDAWiFiChannelSurvey.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiChannelSurvey.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiInterface.h"
+#import "CDAWiFiInterface+Private.h"
+#include <string.h>
+
+/* Channel numbers tracked per band by the supported channel bitmap. */
+#define CDAWiFiChannelSurveyChannelNumberCount 256
+
+/* Returns the index of the entry with frequency, or the index to insert it at with found set to NO. */
+static size_t CDAWiFiChannelSurveySearch(const CDAWiFiChannelSurveyEntry *entries, size_t count, uint32_t frequency, BOOL *found)
+{
+    size_t low = 0, high = count;
+    
+    while (low < high) {
+        
+        size_t middle = low + (high - low) / 2;
+        
+        if (entries[middle].frequency < frequency) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    
+    *found = (low < count && entries[low].frequency == frequency);
+    
+    return low;
+}
+
+static double CDAWiFiChannelSurveyUtilization(uint64_t busyTime, uint64_t activeTime)
+{
+    return (busyTime >= activeTime) ? 1.0 : (double)busyTime / activeTime;
+}
+
+/* Folds a fresh survey of the channel into its entry. A new entry has no counters and no sample. */
+static void CDAWiFiChannelSurveyEntryFold(CDAWiFiChannelSurveyEntry *entry, const CDAWiFiChannelSurveyEntry *survey, double alpha)
+{
+    uint64_t activeTime = survey->activeTime, busyTime = survey->busyTime;
+    
+    /* Counters going backwards were reset by the driver, they count from zero again. */
+    if (activeTime >= entry->activeTime && busyTime >= entry->busyTime) {
+        
+        activeTime -= entry->activeTime;
+        busyTime -= entry->busyTime;
+    }
+    
+    /* Drivers without time counters still refresh the noise on every dump. */
+    BOOL advanced = (activeTime > 0 || survey->activeTime == 0);
+    
+    if (activeTime > 0) {
+        
+        entry->utilization = CDAWiFiChannelSurveyUtilization(busyTime, activeTime);
+        
+        if (entry->sampleCount == 0) {
+            entry->averageUtilization = entry->utilization;
+        } else {
+            entry->averageUtilization += alpha * (entry->utilization - entry->averageUtilization);
+        }
+        
+        entry->sampleCount++;
+    }
+    
+    if (advanced && survey->noise != 0) {
+        
+        if (entry->averageNoise == 0) {
+            entry->averageNoise = survey->noise;
+        } else {
+            entry->averageNoise += alpha * (survey->noise - entry->averageNoise);
+        }
+    }
+    
+    entry->frequency = survey->frequency;
+    entry->channelNumber = survey->channelNumber;
+    entry->channelBand = survey->channelBand;
+    entry->inUse = survey->inUse;
+    entry->noise = survey->noise;
+    entry->activeTime = survey->activeTime;
+    entry->busyTime = survey->busyTime;
+    entry->receiveTime = survey->receiveTime;
+    entry->transmitTime = survey->transmitTime;
+}
+
+@implementation CDAWiFiChannelSurvey
+{
+    OFMutex *_mutex;
+    
+    /* Entries by ascending frequency, guarded by the mutex. */
+    OFDataArray *_channels;
+    
+    /* One bit per channel number and band, valid once the supported channels were loaded. */
+    uint32_t _supportedChannels[CDAWiFiChannelBand5GHz + 1][CDAWiFiChannelSurveyChannelNumberCount / 32];
+    BOOL _supportedChannelsLoaded;
+}
+
+@synthesize interface = _interface, smoothingFactor = _smoothingFactor;
+
+#pragma mark - Initialization
+
+- (instancetype)init
+{
+    return [self initWithInterface:nil];
+}
+
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface
+{
+    self = [super init];
+    
+    if (self) {
+        
+        if (interface == nil) {
+            return nil;
+        }
+        
+        _interface = interface;
+        _smoothingFactor = CDAWiFiChannelSurveyDefaultSmoothingFactor;
+        _mutex = [OFMutex mutex];
+        _channels = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiChannelSurveyEntry)];
+    }
+    
+    return self;
+}
+
+#pragma mark - Supported Channels
+
+/* Runs with the mutex locked. Channels of every width share the number of their primary 20 MHz channel. */
+- (void)loadSupportedChannels:(OFSet *)channels
+{
+    if (_supportedChannelsLoaded || channels.count == 0) {
+        return;
+    }
+    
+    memset(_supportedChannels, 0, sizeof(_supportedChannels));
+    
+    for (CDAWiFiChannel *channel in channels) {
+        
+        int channelNumber = channel.channelNumber;
+        
+        if (channelNumber <= 0 || channelNumber >= CDAWiFiChannelSurveyChannelNumberCount) {
+            continue;
+        }
+        
+        _supportedChannels[channel.channelBand][channelNumber / 32] |= (uint32_t)1 << (channelNumber % 32);
+    }
+    
+    _supportedChannelsLoaded = YES;
+}
+
+- (BOOL)isSupportedChannelNumber:(int)channelNumber band:(CDAWiFiChannelBand)band
+{
+    /* Until the supported channels are known, every channel reported by the driver is kept. */
+    if (!_supportedChannelsLoaded) {
+        return YES;
+    }
+    
+    if (band == CDAWiFiChannelBandUnknown || channelNumber <= 0 || channelNumber >= CDAWiFiChannelSurveyChannelNumberCount) {
+        return NO;
+    }
+    
+    return (_supportedChannels[band][channelNumber / 32] >> (channelNumber % 32)) & 1;
+}
+
+#pragma mark - Updating
+
+- (BOOL)updateAndReturnError:(out CDAError **)error
+{
+    OFDataArray *surveys = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiChannelSurveyEntry)];
+    
+    [_mutex lock];
+    
+    BOOL supportedChannelsLoaded = _supportedChannelsLoaded;
+    
+    [_mutex unlock];
+    
+    /*
+     * The exchanges run without the lock, readers keep the previous table meanwhile. The supported channels
+     * are a wiphy dump, only fetched until the driver reports some.
+     */
+    OFSet *supportedChannels = supportedChannelsLoaded ? nil : _interface.supportedWLANChannels;
+    
+    if (![_interface getChannelSurveyEntries:surveys error:error]) {
+        return NO;
+    }
+    
+    [_mutex lock];
+    
+    [self loadSupportedChannels:supportedChannels];
+    
+    double alpha = OF_MIN(OF_MAX(_smoothingFactor, 0.0), 1.0);
+    const CDAWiFiChannelSurveyEntry *surveyItems = surveys.items;
+    size_t surveyCount = surveys.count;
+    
+    /* Channels missing from the dump are no longer in use. */
+    CDAWiFiChannelSurveyEntry *entries = _channels.items;
+    
+    for (size_t index = 0; index < _channels.count; index++) {
+        entries[index].inUse = NO;
+    }
+    
+    for (size_t surveyIndex = 0; surveyIndex < surveyCount; surveyIndex++) {
+        
+        const CDAWiFiChannelSurveyEntry *survey = &surveyItems[surveyIndex];
+        BOOL found;
+        
+        if (![self isSupportedChannelNumber:survey->channelNumber band:survey->channelBand]) {
+            continue;
+        }
+        
+        size_t index = CDAWiFiChannelSurveySearch(_channels.items, _channels.count, survey->frequency, &found);
+        
+        if (!found) {
+            
+            CDAWiFiChannelSurveyEntry entry;
+            
+            memset(&entry, 0, sizeof(entry));
+            
+            [_channels insertItem:&entry atIndex:index];
+        }
+        
+        CDAWiFiChannelSurveyEntryFold([_channels itemAtIndex:index], survey, alpha);
+    }
+    
+    [_mutex unlock];
+    
+    return YES;
+}
+
+- (void)reset
+{
+    [_mutex lock];
+    
+    [_channels removeAllItems];
+    
+    [_mutex unlock];
+}
+
+#pragma mark - Reading
+
+- (size_t)channelCount
+{
+    [_mutex lock];
+    
+    size_t count = _channels.count;
+    
+    [_mutex unlock];
+    
+    return count;
+}
+
+- (size_t)getChannels:(CDAWiFiChannelSurveyEntry *)entries maximumCount:(size_t)maximumCount
+{
+    [_mutex lock];
+    
+    size_t count = OF_MIN(_channels.count, maximumCount);
+    
+    if (count > 0) {
+        memcpy(entries, _channels.items, count * sizeof(CDAWiFiChannelSurveyEntry));
+    }
+    
+    [_mutex unlock];
+    
+    return count;
+}
+
+- (BOOL)getChannel:(CDAWiFiChannelSurveyEntry *)entry withFrequency:(uint32_t)frequency
+{
+    BOOL found;
+    
+    [_mutex lock];
+    
+    size_t index = CDAWiFiChannelSurveySearch(_channels.items, _channels.count, frequency, &found);
+    
+    if (found) {
+        memcpy(entry, [_channels itemAtIndex:index], sizeof(CDAWiFiChannelSurveyEntry));
+    }
+    
+    [_mutex unlock];
+    
+    return found;
+}
+
+@end
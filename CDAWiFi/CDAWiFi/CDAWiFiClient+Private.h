@@ -0,0 +1,34 @@
+//
+//  CDAWiFiClient+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/8/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiClient.h>
+
+@class CDAWiFiEventEngine, CDAWiFiPairwiseMasterKeyCache;
+
+@interface CDAWiFiClient (Private)
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The engine receiving the Wi-Fi events of every interface.
+ *
+ * @discussion
+ * Interfaces use it to wait for scan completion, whatever the event types the delegate monitors.
+ */
+@property (readonly) CDAWiFiEventEngine *eventEngine;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The pairwise master keys derived from the passphrases passed to -[CDAWiFiInterface associateToNetwork:password:error:].
+ */
+@property (readonly) CDAWiFiPairwiseMasterKeyCache *pairwiseMasterKeyCache;
+
+@end
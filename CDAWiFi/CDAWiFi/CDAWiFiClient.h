@@ -11,7 +11,7 @@
 #import <CDAWiFi/CDAWiFiTypes.h>
 #include <dispatch/dispatch.h>
 
-@class CDAWiFiInterface;
+@class CDAWiFiInterface, CDAWiFiScanCacheChanges, CDAWiFiRSSIHistory;
 
 /*!
  * @protocol
@@ -177,6 +177,25 @@
  */
 - (void)scanCacheUpdatedForWiFiInterfaceWithName:(OFString *)interfaceName;
 
+/*!
+ * @method
+ *
+ * @param interfaceName
+ * The name of the Wi-Fi interface.
+ *
+ * @param changes
+ * The networks added, changed and removed by the update.
+ *
+ * @abstract
+ * Invoked when an update of the Wi-Fi interface scan cache changed its contents.
+ *
+ * @discussion
+ * Delivers the same changes as -[CDAWiFiInterface scanCacheChangesSinceGeneration:error:] with the previous generation,
+ * so clients that implement this method never need to fetch or diff the whole scan cache.
+ * Updates that leave the scan cache unchanged are not delivered.
+ */
+- (void)scanCacheDidChangeForWiFiInterfaceWithName:(OFString *)interfaceName changes:(CDAWiFiScanCacheChanges *)changes;
+
 @end
 
 /*!
@@ -211,6 +230,20 @@
  */
 @property(nonatomic, weak) id<CDAWiFiEventDelegate> delegate;
 
+/*! @functiongroup Recording Signal History */
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The store signal samples are recorded to, or nil to record nothing.
+ *
+ * @discussion
+ * Every network a scan cache update heard again is recorded, and so is the BSS of an interface whenever its link quality changes,
+ * provided link quality events are monitored.
+ */
+@property CDAWiFiRSSIHistory *rssiHistory;
+
 /*! @functiongroup Getting a Wi-Fi Client */
 
 /*!
@@ -284,6 +317,98 @@
  */
 - (OFArray *)interfaces;
 
+/*! @functiongroup Scanning on Several Interfaces */
+
+/*!
+ * @method
+ *
+ * @param interfaces
+ * The CDAWiFiInterface objects to scan on. Pass nil to scan on every available interface.
+ *
+ * @param ssid
+ * Probe request SSID.
+ * Pass an SSID to perform a directed scan for hidden Wi-Fi networks.
+ * This parameter is optional.
+ *
+ * @param queue
+ * The dispatch queue the completion handler is invoked on.
+ *
+ * @param completionHandler
+ * Invoked once every scan is over, with an NSSet of CDAWiFiMergedScanResult objects,
+ * and the CDAError of every interface whose scan failed, keyed by interface name.
+ * The set is nil if no scan succeeded. The errors are nil if the available interfaces could not be listed.
+ *
+ * @abstract
+ * Scans for Wi-Fi networks on several interfaces in parallel, and merges the results.
+ *
+ * @discussion
+ * Every scan is triggered at once, so the whole operation lasts as long as the slowest interface.
+ * Results are merged by BSSID as each interface completes, recording which interfaces saw each BSS and at what RSSI.
+ */
+- (void)scanForNetworksOnInterfaces:(OFArray *)interfaces
+                               ssid:(OFDataArray *)ssid
+                              queue:(dispatch_queue_t)queue
+                  completionHandler:(void (^)(OFSet *results, OFDictionary *errors))completionHandler;
+
+/*!
+ * @method
+ *
+ * @param interfaces
+ * The CDAWiFiInterface objects to scan on. Pass nil to scan on every available interface.
+ *
+ * @param ssid
+ * Probe request SSID.
+ * Pass an SSID to perform a directed scan for hidden Wi-Fi networks.
+ * This parameter is optional.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * An NSSet of CDAWiFiMergedScanResult objects, or nil if no scan succeeded.
+ *
+ * @abstract
+ * Scans for Wi-Fi networks on several interfaces in parallel, and merges the results.
+ *
+ * @discussion
+ * This method will block for the duration of the slowest scan.
+ * Interfaces whose scan failed are left out of the results.
+ */
+- (OFSet *)scanForNetworksOnInterfaces:(OFArray *)interfaces ssid:(OFDataArray *)ssid error:(out CDAError **)error;
+
+/*! @functiongroup Deriving Keys */
+
+/*!
+ * @method
+ *
+ * @param ssids
+ * An OFArray of OFDataArray objects, the SSIDs of the networks.
+ *
+ * @param passphrases
+ * An OFArray of OFString objects, the passphrase of the network with the SSID at the same index.
+ * A passphrase is 8 to 63 printable ASCII characters, or the PSK as 64 hexadecimal digits.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * An OFArray of OFDataArray objects, the pairwise master keys in the order of the SSIDs. Returns nil if an error occurs.
+ *
+ * @abstract
+ * Derives the WPA Personal pairwise master keys (PMK) of many networks at once, for example when provisioning profiles.
+ *
+ * @discussion
+ * The keys are derived in parallel on every core, and several at once on each core. Each key can be passed to
+ * -[CDAWiFiInterface setPairwiseMasterKey:error:]. Derived keys are also cached, so a later association with
+ * -[CDAWiFiInterface associateToNetwork:password:error:] and the same passphrase does not derive them again.
+ *
+ * Fails with a CDAWiFiInvalidParameterError error if the arrays differ in length, or if any SSID or passphrase is invalid.
+ * This method blocks until every key is derived.
+ */
+- (OFArray *)pairwiseMasterKeysForSSIDs:(OFArray *)ssids passphrases:(OFArray *)passphrases error:(out CDAError **)error;
+
 /*! @functiongroup Register for Wi-Fi Events */
 
 /*!
@@ -301,6 +426,12 @@
  *
  * @abstract
  * Register for specific Wi-Fi event notifications.
+ *
+ * @discussion
+ * Events of every type are received by a single background thread, and handed in order to a serial queue
+ * which invokes the delegate methods.
+ * If the kernel drops events because they were not read fast enough, -[CDAWiFiEventDelegate clientConnectionInterrupted]
+ * is invoked and cached interface state is refreshed on next access.
  */
 - (BOOL)startMonitoringEventWithType:(CDAWiFiEventType)type error:(out CDAError **)error;
 
@@ -337,4 +468,38 @@
  */
 - (BOOL)stopMonitoringAllEventsAndReturnError:(out CDAError **)error;
 
+/*! @functiongroup Maintaining Interface State */
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Keeps the state of every interface current from events, so interface getters never poll the kernel.
+ *
+ * @discussion
+ * The event queue fetches a new CDAWiFiInterfaceState whenever an event may have changed the state of an interface,
+ * whether the event type is monitored or not, and swaps it in atomically before the delegate is told.
+ * Getters then read the current state with a single atomic load, without a lock or a system call,
+ * and -[CDAWiFiInterface stateRefreshInterval] is ignored.
+ *
+ * Link quality only changes the state when it crosses the connection quality monitor threshold,
+ * use CDAWiFiLinkSampler to follow the signal closely.
+ */
+- (BOOL)startMaintainingInterfaceStateAndReturnError:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Stops keeping interface states current from events. Getters refresh expired states again.
+ */
+- (void)stopMaintainingInterfaceState;
+
 @end
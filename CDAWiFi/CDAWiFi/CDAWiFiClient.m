@@ -7,8 +7,55 @@
 //
 
 #import "CDAWiFiClient.h"
+#import "CDAWiFiClient+Private.h"
+#import "CDAWiFiEventEngine.h"
+#import "CDAWiFiPairwiseMasterKeyCache.h"
+#import "CDAWiFiInterface.h"
+#import "CDAWiFiInterface+Private.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiMergedScanResult.h"
+#import "CDAWiFiMergedScanResult+Private.h"
+#import "CDAWiFiNetlink.h"
+#import "CDAWiFiRSSIHistory.h"
+#import "CDAWiFiUtilities.h"
+
+@interface CDAWiFiClient ()
+
+- (void)handleEventWithType:(CDAWiFiEventType)type interfaceIndex:(uint32_t)interfaceIndex;
+
+@end
 
 @implementation CDAWiFiClient
+{
+    CDAWiFiNetlinkSocket *_socket;
+    
+    OFMutex *_interfacesMutex;
+    
+    /* CDAWiFiInterface objects by interface name, reused across calls so their state snapshots are shared. */
+    OFMutableDictionary *_interfaces;
+    
+    /* Whether interface states are kept current from events. Protected by the interfaces mutex. */
+    BOOL _maintainsInterfaceState;
+    
+    /* Whether link quality events are monitored, so new interfaces get a threshold. Protected by the interfaces mutex. */
+    BOOL _monitorsConnectionQuality;
+    
+    /*
+     * State updates queued on the event queue and not started yet, an OFNumber BOOL telling whether the mode or power
+     * of the interface changed by OFNumber interface index (0 for every interface). Protected by the interfaces mutex.
+     */
+    OFMutableDictionary *_pendingStateUpdates;
+    
+    CDAWiFiEventEngine *_eventEngine;
+    
+    /* Serial queue the events are handled on, so the kernel round trips they cost never hold up the event thread. */
+    dispatch_queue_t _eventQueue;
+    
+    CDAWiFiPairwiseMasterKeyCache *_pairwiseMasterKeyCache;
+}
+
+@synthesize eventEngine = _eventEngine, pairwiseMasterKeyCache = _pairwiseMasterKeyCache;
 
 + (instancetype)sharedWiFiClient
 {
@@ -25,4 +72,692 @@
     return sharedStore;
 }
 
+#pragma mark - Initialization
+
+- (instancetype)init
+{
+    self = [super init];
+    
+    if (self) {
+        
+        CDAError *error;
+        
+        _socket = [[CDAWiFiNetlinkSocket alloc] initAndReturnError:&error];
+        
+        if (_socket == nil) {
+            
+            CDALog(@"Could not connect to nl80211: %@", error);
+            
+            return nil;
+        }
+        
+        _interfacesMutex = [OFMutex mutex];
+        _interfaces = [OFMutableDictionary dictionary];
+        _pendingStateUpdates = [OFMutableDictionary dictionary];
+        _pairwiseMasterKeyCache = [[CDAWiFiPairwiseMasterKeyCache alloc] init];
+        
+        _eventQueue = dispatch_queue_create("CDAWiFiClient.events", DISPATCH_QUEUE_SERIAL);
+        
+        __weak CDAWiFiClient *weakSelf = self;
+        dispatch_queue_t eventQueue = _eventQueue;
+        
+        /* Both run on the same serial queue, states are still updated before the delegate is told. */
+        _eventEngine = [[CDAWiFiEventEngine alloc] initWithHandler:^(CDAWiFiEventType type, uint32_t interfaceIndex) {
+            
+            dispatch_async(eventQueue, ^{
+                [weakSelf handleEventWithType:type interfaceIndex:interfaceIndex];
+            });
+            
+        } stateHandler:^(CDAWiFiEventType type, uint32_t interfaceIndex) {
+            
+            [weakSelf scheduleStateUpdateForEventWithType:type interfaceIndex:interfaceIndex];
+        }];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    [_eventEngine stop];
+    
+    if (_eventQueue != NULL) {
+        CDAWiFiDispatchRelease(_eventQueue);
+    }
+}
+
+#pragma mark - Interfaces
+
+/* Fetches every nl80211 network interface with a single dump and updates the interface cache. Returns interfaces in kernel order. */
+- (OFArray *)loadInterfacesAndReturnError:(out CDAError **)error
+{
+    CDAWiFiNetlinkMessage request;
+    OFMutableArray *interfaces = [OFMutableArray array];
+    OFMutableDictionary *cachedInterfaces = _interfaces;
+    CDAWiFiNetlinkSocket *socket = _socket;
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, NLM_F_DUMP, NL80211_CMD_GET_INTERFACE);
+    
+    [_interfacesMutex lock];
+    
+    BOOL success = [_socket performRequests:&request count:1 handler:^(size_t requestIndex, const struct nlmsghdr *message) {
+        
+        const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+        
+        CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+        
+        /* Skip wireless devices without a network interface (e.g. P2P devices). */
+        if (attributes[NL80211_ATTR_IFNAME] == NULL || attributes[NL80211_ATTR_IFINDEX] == NULL) {
+            return;
+        }
+        
+        OFString *name = [OFString stringWithUTF8String:CDAWiFiNetlinkAttributeData(attributes[NL80211_ATTR_IFNAME])];
+        uint32_t interfaceIndex = CDAWiFiNetlinkAttributeU32(attributes[NL80211_ATTR_IFINDEX]);
+        uint32_t wiphyIndex = attributes[NL80211_ATTR_WIPHY] != NULL ? CDAWiFiNetlinkAttributeU32(attributes[NL80211_ATTR_WIPHY]) : 0;
+        
+        CDAWiFiInterface *interface = cachedInterfaces[name];
+        
+        if (interface == nil || interface.interfaceIndex != interfaceIndex || interface.wiphyIndex != wiphyIndex) {
+            
+            interface = [[CDAWiFiInterface alloc] initWithInterfaceName:name
+                                                         interfaceIndex:interfaceIndex
+                                                             wiphyIndex:wiphyIndex
+                                                                 socket:socket];
+            interface.client = self;
+            interface.stateMaintained = _maintainsInterfaceState;
+            
+            cachedInterfaces[name] = interface;
+        }
+        
+        [interfaces addObject:interface];
+        
+    } results:NULL error:error];
+    
+    if (success) {
+        
+        /* Forget interfaces that went away. */
+        for (OFString *name in [cachedInterfaces allKeys]) {
+            
+            BOOL found = NO;
+            
+            for (CDAWiFiInterface *interface in interfaces) {
+                
+                if ([interface.interfaceName isEqual:name]) {
+                    found = YES;
+                    break;
+                }
+            }
+            
+            if (!found) {
+                [cachedInterfaces removeObjectForKey:name];
+            }
+        }
+    }
+    
+    [_interfacesMutex unlock];
+    
+    if (!success) {
+        return nil;
+    }
+    
+    [interfaces makeImmutable];
+    
+    return interfaces;
+}
+
+- (CDAWiFiInterface *)interface
+{
+    return [[self interfaces] firstObject];
+}
+
++ (NSArray *)interfaceNames
+{
+    OFArray *interfaces = [[self sharedWiFiClient] interfaces];
+    
+    if (interfaces == nil) {
+        return nil;
+    }
+    
+    OFMutableArray *interfaceNames = [OFMutableArray arrayWithCapacity:interfaces.count];
+    
+    for (CDAWiFiInterface *interface in interfaces) {
+        [interfaceNames addObject:interface.interfaceName];
+    }
+    
+    [interfaceNames makeImmutable];
+    
+    return interfaceNames;
+}
+
+- (CDAWiFiInterface *)interfaceWithName:(NSString *)interfaceName
+{
+    OFArray *interfaces = [self interfaces];
+    
+    if (interfaceName == nil) {
+        return [interfaces firstObject];
+    }
+    
+    for (CDAWiFiInterface *interface in interfaces) {
+        
+        if ([interface.interfaceName isEqual:interfaceName]) {
+            return interface;
+        }
+    }
+    
+    return nil;
+}
+
+- (OFArray *)interfaces
+{
+    return [self loadInterfacesAndReturnError:NULL];
+}
+
+#pragma mark - Scanning
+
+- (void)scanForNetworksOnInterfaces:(OFArray *)interfaces
+                               ssid:(OFDataArray *)ssid
+                              queue:(dispatch_queue_t)queue
+                  completionHandler:(void (^)(OFSet *results, OFDictionary *errors))completionHandler
+{
+    if (interfaces == nil) {
+        
+        interfaces = [self loadInterfacesAndReturnError:NULL];
+        
+        if (interfaces == nil) {
+            
+            CDAWiFiDispatchRetain(queue);
+            
+            dispatch_async(queue, ^{
+                
+                completionHandler(nil, nil);
+                
+                CDAWiFiDispatchRelease(queue);
+            });
+            
+            return;
+        }
+    }
+    
+    /* Results are merged on a serial queue as each interface completes, the slowest scan sets the pace. */
+    dispatch_queue_t mergeQueue = dispatch_queue_create("CDAWiFiClient.scan", DISPATCH_QUEUE_SERIAL);
+    dispatch_group_t group = dispatch_group_create();
+    OFMutableDictionary *results = [OFMutableDictionary dictionary];
+    OFMutableDictionary *errors = [OFMutableDictionary dictionary];
+    __block size_t succeededCount = 0;
+    
+    for (CDAWiFiInterface *interface in interfaces) {
+        
+        OFString *interfaceName = interface.interfaceName;
+        
+        dispatch_group_enter(group);
+        
+        [interface scanForNetworksWithSSID:ssid queue:mergeQueue resultHandler:nil completionHandler:^(OFSet *networks, CDAError *scanError) {
+            
+            if (networks == nil) {
+                
+                errors[interfaceName] = scanError;
+                
+            } else {
+                
+                succeededCount++;
+                
+                for (CDAWiFiNetwork *network in networks) {
+                    
+                    OFNumber *key = [OFNumber numberWithUInt64:network.bssidValue];
+                    CDAWiFiMergedScanResult *result = results[key];
+                    
+                    if (result == nil) {
+                        results[key] = [[CDAWiFiMergedScanResult alloc] initWithNetwork:network interfaceName:interfaceName];
+                    } else {
+                        [result addNetwork:network interfaceName:interfaceName];
+                    }
+                }
+            }
+            
+            dispatch_group_leave(group);
+        }];
+    }
+    
+    CDAWiFiDispatchRetain(queue);
+    
+    dispatch_group_notify(group, mergeQueue, ^{
+        
+        OFSet *mergedResults = nil;
+        
+        if (succeededCount > 0 || interfaces.count == 0) {
+            mergedResults = [OFSet setWithArray:[results allObjects]];
+        }
+        
+        [errors makeImmutable];
+        
+        dispatch_async(queue, ^{
+            
+            completionHandler(mergedResults, errors);
+            
+            CDAWiFiDispatchRelease(queue);
+        });
+    });
+    
+    CDAWiFiDispatchRelease(group);
+    CDAWiFiDispatchRelease(mergeQueue);
+}
+
+- (OFSet *)scanForNetworksOnInterfaces:(OFArray *)interfaces ssid:(OFDataArray *)ssid error:(out CDAError **)error
+{
+    if (interfaces == nil) {
+        
+        interfaces = [self loadInterfacesAndReturnError:error];
+        
+        if (interfaces == nil) {
+            return nil;
+        }
+    }
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block OFSet *results;
+    __block CDAError *scanError;
+    
+    [self scanForNetworksOnInterfaces:interfaces
+                                 ssid:ssid
+                                queue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+                    completionHandler:^(OFSet *mergedResults, OFDictionary *errors) {
+                        
+                        results = mergedResults;
+                        scanError = [[errors allObjects] firstObject];
+                        
+                        dispatch_semaphore_signal(semaphore);
+                    }];
+    
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    
+    CDAWiFiDispatchRelease(semaphore);
+    
+    if (results == nil && error != NULL) {
+        *error = (scanError != nil) ? scanError : CDAWiFiErrorWithCode(CDAWiFiUnknownError);
+    }
+    
+    return results;
+}
+
+#pragma mark - Keys
+
+- (OFArray *)pairwiseMasterKeysForSSIDs:(OFArray *)ssids passphrases:(OFArray *)passphrases error:(out CDAError **)error
+{
+    return [_pairwiseMasterKeyCache pairwiseMasterKeysForSSIDs:ssids passphrases:passphrases error:error];
+}
+
+#pragma mark - Events
+
+/* Connection quality monitor thresholds, so link quality events are sent without polling. */
+#define CDAWiFiClientCQMRSSIThreshold -70
+#define CDAWiFiClientCQMRSSIHysteresis 4
+
+- (BOOL)startMonitoringEventWithType:(CDAWiFiEventType)type error:(out CDAError **)error
+{
+    if (type == CDAWiFiEventTypeNone || type == CDAWiFiEventTypeUnknown) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    if (![_eventEngine startAndReturnError:error]) {
+        return NO;
+    }
+    
+    if (type == CDAWiFiEventTypeLinkQualityDidChange) {
+        
+        [_interfacesMutex lock];
+        
+        _monitorsConnectionQuality = YES;
+        
+        [_interfacesMutex unlock];
+        
+        [self enableConnectionQualityMonitorForInterfaces:[self loadInterfacesAndReturnError:NULL]];
+    }
+    
+    [_eventEngine enableEventType:type];
+    
+    return YES;
+}
+
+- (BOOL)stopMonitoringEventWithType:(CDAWiFiEventType)type error:(out CDAError **)error
+{
+    if (type == CDAWiFiEventTypeNone || type == CDAWiFiEventTypeUnknown) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    [_eventEngine disableEventType:type];
+    
+    if (type == CDAWiFiEventTypeLinkQualityDidChange) {
+        
+        [_interfacesMutex lock];
+        
+        _monitorsConnectionQuality = NO;
+        
+        [_interfacesMutex unlock];
+    }
+    
+    return YES;
+}
+
+- (BOOL)stopMonitoringAllEventsAndReturnError:(out CDAError **)error
+{
+    [_eventEngine disableAllEventTypes];
+    
+    [_interfacesMutex lock];
+    
+    _monitorsConnectionQuality = NO;
+    
+    [_interfacesMutex unlock];
+    
+    return YES;
+}
+
+#pragma mark - Interface State
+
+- (BOOL)startMaintainingInterfaceStateAndReturnError:(out CDAError **)error
+{
+    if (![_eventEngine startAndReturnError:error]) {
+        return NO;
+    }
+    
+    [_interfacesMutex lock];
+    
+    _maintainsInterfaceState = YES;
+    
+    OFArray *interfaces = [_interfaces allObjects];
+    
+    for (CDAWiFiInterface *interface in interfaces) {
+        interface.stateMaintained = YES;
+    }
+    
+    [_interfacesMutex unlock];
+    
+    /* Events only report changes, start from a current state. */
+    for (CDAWiFiInterface *interface in interfaces) {
+        [interface updateStateAndReturnError:NULL];
+    }
+    
+    return YES;
+}
+
+- (void)stopMaintainingInterfaceState
+{
+    [_interfacesMutex lock];
+    
+    _maintainsInterfaceState = NO;
+    
+    for (CDAWiFiInterface *interface in [_interfaces allObjects]) {
+        interface.stateMaintained = NO;
+    }
+    
+    [_interfacesMutex unlock];
+}
+
+/*
+ * Asks interfaces to report RSSI threshold crossings, in batches. Drivers without CQM support still send events on roam
+ * and disconnect. Interfaces with a roaming engine keep the engine's threshold.
+ */
+- (void)enableConnectionQualityMonitorForInterfaces:(OFArray *)interfaces
+{
+    CDAWiFiNetlinkMessage requests[CDAWiFiNetlinkMaximumBatchCount];
+    int results[CDAWiFiNetlinkMaximumBatchCount];
+    size_t count = 0;
+    
+    for (CDAWiFiInterface *interface in interfaces) {
+        
+        if (interface.roamingEngine != nil) {
+            continue;
+        }
+        
+        /* Failures are expected for interfaces that are not connected, or whose driver lacks CQM. */
+        if (count == CDAWiFiNetlinkMaximumBatchCount) {
+            
+            [_socket performRequests:requests count:count handler:NULL results:results error:NULL];
+            
+            count = 0;
+        }
+        
+        CDAWiFiNetlinkMessage *request = &requests[count++];
+        
+        CDAWiFiNetlinkMessageInit(request, _socket.nl80211FamilyID, 0, NL80211_CMD_SET_CQM);
+        CDAWiFiNetlinkMessagePutU32(request, NL80211_ATTR_IFINDEX, interface.interfaceIndex);
+        
+        size_t nested = CDAWiFiNetlinkMessageBeginNested(request, NL80211_ATTR_CQM);
+        
+        CDAWiFiNetlinkMessagePutU32(request, NL80211_ATTR_CQM_RSSI_THOLD, (uint32_t)CDAWiFiClientCQMRSSIThreshold);
+        CDAWiFiNetlinkMessagePutU32(request, NL80211_ATTR_CQM_RSSI_HYST, CDAWiFiClientCQMRSSIHysteresis);
+        
+        CDAWiFiNetlinkMessageEndNested(request, nested);
+    }
+    
+    if (count == 0) {
+        return;
+    }
+    
+    [_socket performRequests:requests count:count handler:NULL results:results error:NULL];
+}
+
+/*
+ * Invoked on the event thread. A single netlink message is delivered as several events, a connection for example
+ * changes the SSID, the BSSID and the link, and the RTM_NEWLINK that follows changes the link again.
+ * Events concerning an interface whose update is queued but not started yet join that update instead of queuing another,
+ * it still runs before the delegate is told about any of them.
+ */
+- (void)scheduleStateUpdateForEventWithType:(CDAWiFiEventType)type interfaceIndex:(uint32_t)interfaceIndex
+{
+    /* Lost events may have concerned any interface. */
+    if (type == CDAWiFiEventTypeNone) {
+        interfaceIndex = 0;
+    }
+    
+    OFNumber *key = [OFNumber numberWithUInt32:interfaceIndex];
+    BOOL modeOrPowerChanged = (type == CDAWiFiEventTypeModeDidChange || type == CDAWiFiEventTypePowerDidChange);
+    
+    [_interfacesMutex lock];
+    
+    OFNumber *pendingUpdate = _pendingStateUpdates[key];
+    
+    _pendingStateUpdates[key] = [OFNumber numberWithBool:(pendingUpdate.boolValue || modeOrPowerChanged)];
+    
+    [_interfacesMutex unlock];
+    
+    if (pendingUpdate != nil) {
+        return;
+    }
+    
+    __weak CDAWiFiClient *weakSelf = self;
+    
+    dispatch_async(_eventQueue, ^{
+        [weakSelf updateStateForInterfaceIndex:interfaceIndex];
+    });
+}
+
+/* Invoked on the event queue, before the delegate is told. An interface index of 0 updates every interface. */
+- (void)updateStateForInterfaceIndex:(uint32_t)interfaceIndex
+{
+    OFNumber *key = [OFNumber numberWithUInt32:interfaceIndex];
+    
+    /* Events from now on queue another update, this one may read the state before they happened. */
+    [_interfacesMutex lock];
+    
+    BOOL modeOrPowerChanged = [_pendingStateUpdates[key] boolValue];
+    BOOL monitorsConnectionQuality = _monitorsConnectionQuality;
+    
+    [_pendingStateUpdates removeObjectForKey:key];
+    
+    [_interfacesMutex unlock];
+    
+    /*
+     * Interfaces created (a first RTM_NEWLINK, or NL80211_CMD_NEW_INTERFACE), brought up or whose mode changed
+     * after link quality monitoring started may have no threshold yet.
+     */
+    if (monitorsConnectionQuality && interfaceIndex != 0 && modeOrPowerChanged) {
+        
+        OFMutableArray *changedInterfaces = [OFMutableArray array];
+        
+        for (CDAWiFiInterface *interface in [self loadInterfacesAndReturnError:NULL]) {
+            
+            if (interface.interfaceIndex == interfaceIndex) {
+                [changedInterfaces addObject:interface];
+            }
+        }
+        
+        [self enableConnectionQualityMonitorForInterfaces:changedInterfaces];
+    }
+    
+    [_interfacesMutex lock];
+    
+    OFArray *interfaces = [_interfaces allObjects];
+    
+    [_interfacesMutex unlock];
+    
+    for (CDAWiFiInterface *interface in interfaces) {
+        
+        if (interfaceIndex != 0 && interface.interfaceIndex != interfaceIndex) {
+            continue;
+        }
+        
+        if (!interface.stateMaintained || ![interface updateStateAndReturnError:NULL]) {
+            [interface invalidateState];
+        }
+    }
+}
+
+/* Invoked on the event queue. */
+- (void)handleEventWithType:(CDAWiFiEventType)type interfaceIndex:(uint32_t)interfaceIndex
+{
+    id<CDAWiFiEventDelegate> delegate = self.delegate;
+    
+    /* Interface states were already updated by the state handler. */
+    if (type == CDAWiFiEventTypeNone) {
+        
+        if ([delegate respondsToSelector:@selector(clientConnectionInterrupted)]) {
+            [delegate clientConnectionInterrupted];
+        }
+        
+        return;
+    }
+    
+    /* Interfaces come and go with mode changes, so the list is reloaded before looking them up. */
+    OFArray *interfaces = (type == CDAWiFiEventTypeModeDidChange) ? [self loadInterfacesAndReturnError:NULL] : nil;
+    
+    if (interfaces == nil) {
+        
+        [_interfacesMutex lock];
+        
+        interfaces = [_interfaces allObjects];
+        
+        [_interfacesMutex unlock];
+    }
+    
+    for (CDAWiFiInterface *interface in interfaces) {
+        
+        if (interfaceIndex != 0 && interface.interfaceIndex != interfaceIndex) {
+            continue;
+        }
+        
+        OFString *interfaceName = interface.interfaceName;
+        
+        switch (type) {
+            
+            case CDAWiFiEventTypePowerDidChange:
+                
+                if ([delegate respondsToSelector:@selector(powerStateDidChangeForWiFiInterfaceWithName:)]) {
+                    [delegate powerStateDidChangeForWiFiInterfaceWithName:interfaceName];
+                }
+                
+                break;
+            
+            case CDAWiFiEventTypeSSIDDidChange:
+                
+                if ([delegate respondsToSelector:@selector(ssidDidChangeForWiFiInterfaceWithName:)]) {
+                    [delegate ssidDidChangeForWiFiInterfaceWithName:interfaceName];
+                }
+                
+                break;
+            
+            case CDAWiFiEventTypeBSSIDDidChange:
+                
+                if ([delegate respondsToSelector:@selector(bssidDidChangeForWiFiInterfaceWithName:)]) {
+                    [delegate bssidDidChangeForWiFiInterfaceWithName:interfaceName];
+                }
+                
+                break;
+            
+            case CDAWiFiEventTypeCountryCodeDidChange:
+                
+                if ([delegate respondsToSelector:@selector(countryCodeDidChangeForWiFiInterfaceWithName:)]) {
+                    [delegate countryCodeDidChangeForWiFiInterfaceWithName:interfaceName];
+                }
+                
+                break;
+            
+            case CDAWiFiEventTypeLinkDidChange:
+                
+                if ([delegate respondsToSelector:@selector(linkDidChangeForWiFiInterfaceWithName:)]) {
+                    [delegate linkDidChangeForWiFiInterfaceWithName:interfaceName];
+                }
+                
+                break;
+            
+            case CDAWiFiEventTypeLinkQualityDidChange:
+                
+                if ((self.rssiHistory != nil ||
+                     [delegate respondsToSelector:@selector(linkQualityDidChangeForWiFiInterfaceWithName:rssi:transmitRate:)]) &&
+                    (interface.stateMaintained || [interface updateStateAndReturnError:NULL])) {
+                    
+                    CDAWiFiRSSISample sample = {
+                        .timestamp = [[OFDate date] timeIntervalSince1970],
+                        .rssiValue = interface.rssiValue,
+                        .noiseMeasurement = interface.noiseMeasurement
+                    };
+                    
+                    [self.rssiHistory addSample:sample forBSSID:interface.bssidValue];
+                    
+                    if ([delegate respondsToSelector:@selector(linkQualityDidChangeForWiFiInterfaceWithName:rssi:transmitRate:)]) {
+                        
+                        [delegate linkQualityDidChangeForWiFiInterfaceWithName:interfaceName
+                                                                          rssi:interface.rssiValue
+                                                                  transmitRate:interface.transmitRate];
+                    }
+                }
+                
+                break;
+            
+            case CDAWiFiEventTypeModeDidChange:
+                
+                if ([delegate respondsToSelector:@selector(modeDidChangeForWiFiInterfaceWithName:)]) {
+                    [delegate modeDidChangeForWiFiInterfaceWithName:interfaceName];
+                }
+                
+                break;
+            
+            case CDAWiFiEventTypeScanCacheUpdated:
+                
+                /* Also delivers the incremental changes to the delegate. The dump of a scan in flight will do both. */
+                if (!interface.scanning) {
+                    [interface updateScanCacheAndReturnError:NULL];
+                }
+                
+                if ([delegate respondsToSelector:@selector(scanCacheUpdatedForWiFiInterfaceWithName:)]) {
+                    [delegate scanCacheUpdatedForWiFiInterfaceWithName:interfaceName];
+                }
+                
+                break;
+            
+            default:
+                break;
+        }
+    }
+}
+
 @end
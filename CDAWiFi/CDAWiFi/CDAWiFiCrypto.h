@@ -0,0 +1,217 @@
+//
+//  CDAWiFiCrypto.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/10/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+
+/* SHA-1 and the key derivations of WPA Personal. Not part of the public API. */
+
+/*!
+ * @constant CDAWiFiSHA1DigestLength
+ *
+ * @abstract The length of a SHA-1 digest.
+ */
+#define CDAWiFiSHA1DigestLength 20
+
+/*!
+ * @constant CDAWiFiPairwiseMasterKeyLength
+ *
+ * @abstract The length of a WPA pairwise master key (PMK).
+ */
+#define CDAWiFiPairwiseMasterKeyLength 32
+
+/*!
+ * @constant CDAWiFiPairwiseMasterKeyIdentifierLength
+ *
+ * @abstract The length of a PMK identifier (PMKID).
+ */
+#define CDAWiFiPairwiseMasterKeyIdentifierLength 16
+
+/*!
+ * @constant CDAWiFiPairwiseMasterKeyIterations
+ *
+ * @abstract The PBKDF2 iteration count of WPA passphrases (IEEE 802.11-2012, M.4).
+ */
+#define CDAWiFiPairwiseMasterKeyIterations 4096
+
+/*!
+ * @typedef CDAWiFiSHA1Implementation
+ *
+ * @abstract Implementations of the SHA-1 compression function.
+ *
+ * @constant CDAWiFiSHA1ImplementationScalar
+ * Portable C.
+ *
+ * @constant CDAWiFiSHA1ImplementationSHANI
+ * x86 SHA extensions.
+ *
+ * @constant CDAWiFiSHA1ImplementationARMv8
+ * ARMv8 cryptography extensions. Only built if the compiler targets them, for example with -march=armv8-a+crypto.
+ */
+typedef enum
+{
+    CDAWiFiSHA1ImplementationScalar     = 0,
+    CDAWiFiSHA1ImplementationSHANI      = 1,
+    CDAWiFiSHA1ImplementationARMv8      = 2,
+} CDAWiFiSHA1Implementation;
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the fastest implementation supported by the CPU.
+ */
+extern CDAWiFiSHA1Implementation CDAWiFiSHA1ImplementationBest(void);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Computes the SHA-1 digest of a buffer.
+ */
+extern void CDAWiFiSHA1(const void *bytes, size_t length, uint8_t digest[CDAWiFiSHA1DigestLength]);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Computes the HMAC-SHA1 (RFC 2104) of a message.
+ */
+extern void CDAWiFiHMACSHA1(const void *key,
+                            size_t keyLength,
+                            const void *message,
+                            size_t messageLength,
+                            uint8_t digest[CDAWiFiSHA1DigestLength]);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Derives a key with PBKDF2-HMAC-SHA1 (RFC 2898), using the fastest implementation supported by the CPU.
+ */
+extern void CDAWiFiPBKDF2SHA1(const void *password,
+                              size_t passwordLength,
+                              const void *salt,
+                              size_t saltLength,
+                              uint32_t iterations,
+                              uint8_t *key,
+                              size_t keyLength);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Derives a key with PBKDF2-HMAC-SHA1 (RFC 2898), using a specific implementation.
+ *
+ * @discussion
+ * Falls back to the scalar implementation if the requested one is not supported by the CPU.
+ */
+extern void CDAWiFiPBKDF2SHA1WithImplementation(const void *password,
+                                                size_t passwordLength,
+                                                const void *salt,
+                                                size_t saltLength,
+                                                uint32_t iterations,
+                                                uint8_t *key,
+                                                size_t keyLength,
+                                                CDAWiFiSHA1Implementation implementation);
+
+/*!
+ * @function
+ *
+ * @param passphrase
+ * A passphrase of 8 to 63 printable ASCII characters, or the PSK as 64 hexadecimal digits.
+ *
+ * @param ssid
+ * The SSID octets, 1 to 32 of them.
+ *
+ * @param key
+ * Upon return, the pairwise master key.
+ *
+ * @result
+ * NO if the passphrase or the SSID is invalid.
+ *
+ * @abstract
+ * Derives the pairwise master key of a WPA Personal network (IEEE 802.11-2012, M.4).
+ */
+extern BOOL CDAWiFiPairwiseMasterKeyDerive(const char *passphrase,
+                                           size_t passphraseLength,
+                                           const uint8_t *ssid,
+                                           size_t ssidLength,
+                                           uint8_t key[CDAWiFiPairwiseMasterKeyLength]);
+
+/*!
+ * @function
+ *
+ * @param key
+ * The pairwise master key.
+ *
+ * @param authenticatorAddress
+ * The BSSID of the access point.
+ *
+ * @param supplicantAddress
+ * The hardware address of the station.
+ *
+ * @param identifier
+ * Upon return, the PMKID.
+ *
+ * @abstract
+ * Computes the identifier of a PMK security association (IEEE 802.11-2012, 11.6.1.3),
+ * HMAC-SHA1-128(PMK, "PMK Name" || AA || SPA).
+ */
+extern void CDAWiFiPairwiseMasterKeyIdentifierDerive(const uint8_t key[CDAWiFiPairwiseMasterKeyLength],
+                                                     const uint8_t authenticatorAddress[6],
+                                                     const uint8_t supplicantAddress[6],
+                                                     uint8_t identifier[CDAWiFiPairwiseMasterKeyIdentifierLength]);
+
+/*!
+ * @typedef CDAWiFiPairwiseMasterKeyDerivation
+ *
+ * @abstract One key of a batch derivation.
+ *
+ * @field passphrase
+ * A passphrase of 8 to 63 printable ASCII characters, or the PSK as 64 hexadecimal digits.
+ *
+ * @field ssid
+ * The SSID octets, 1 to 32 of them.
+ *
+ * @field key
+ * Upon return, the pairwise master key.
+ *
+ * @field valid
+ * Upon return, NO if the passphrase or the SSID is invalid.
+ */
+typedef struct
+{
+    const char *passphrase;
+    size_t passphraseLength;
+    const uint8_t *ssid;
+    size_t ssidLength;
+    uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+    BOOL valid;
+    
+} CDAWiFiPairwiseMasterKeyDerivation;
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Derives many pairwise master keys at once. Blocks until all of them are derived.
+ *
+ * @discussion
+ * Each key is two independent PBKDF2 blocks. The blocks are iterated in groups spread over every core with libdispatch,
+ * and within a group in the lanes of one core: eight AVX2 or SSE2 lanes on x86 (or two interleaved SHA-NI chains without AVX2),
+ * two interleaved chains of the ARMv8 SHA-1 instructions, or four NEON lanes.
+ */
+extern void CDAWiFiPairwiseMasterKeyDeriveBatch(CDAWiFiPairwiseMasterKeyDerivation *derivations, size_t count);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Overwrites key material with zeros. Unlike memset(), it is not optimized away.
+ */
+extern void CDAWiFiSecureZero(void *bytes, size_t length);
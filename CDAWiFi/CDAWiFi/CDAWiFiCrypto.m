@@ -0,0 +1,1168 @@
+//
+//  CDAWiFiCrypto.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/10/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiCrypto.h"
+#include <stdlib.h>
+#include <string.h>
+#include <dispatch/dispatch.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CDAWiFiCryptoSHANI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2)) && defined(__linux__)
+#define CDAWiFiCryptoARMv8 1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/*
+ * Blocks are passed to the compression functions as 16 big endian words, already loaded.
+ * PBKDF2 builds most of its blocks directly as words, so they are never serialized to bytes.
+ */
+typedef void (*CDAWiFiSHA1CompressFunction)(uint32_t state[5], const uint32_t words[16]);
+
+static const uint32_t CDAWiFiSHA1InitialState[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+#define CDAWiFiSHA1K0 0x5A827999
+#define CDAWiFiSHA1K1 0x6ED9EBA1
+#define CDAWiFiSHA1K2 0x8F1BBCDC
+#define CDAWiFiSHA1K3 0xCA62C1D6
+
+static inline uint32_t CDAWiFiSHA1Rotate(uint32_t value, int count)
+{
+    return (value << count) | (value >> (32 - count));
+}
+
+static inline uint32_t CDAWiFiSHA1LoadWord(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+static inline void CDAWiFiSHA1StoreWord(uint8_t *bytes, uint32_t word)
+{
+    bytes[0] = (uint8_t)(word >> 24);
+    bytes[1] = (uint8_t)(word >> 16);
+    bytes[2] = (uint8_t)(word >> 8);
+    bytes[3] = (uint8_t)word;
+}
+
+#pragma mark - Scalar
+
+static void CDAWiFiSHA1CompressScalar(uint32_t state[5], const uint32_t words[16])
+{
+    uint32_t w[16];
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    
+    memcpy(w, words, sizeof(w));
+    
+    for (int round = 0; round < 80; round++) {
+        
+        uint32_t f, k;
+        
+        if (round >= 16) {
+            w[round & 15] = CDAWiFiSHA1Rotate(w[(round + 13) & 15] ^ w[(round + 8) & 15] ^ w[(round + 2) & 15] ^ w[round & 15], 1);
+        }
+        
+        if (round < 20) {
+            f = (b & c) | (~b & d);
+            k = CDAWiFiSHA1K0;
+        } else if (round < 40) {
+            f = b ^ c ^ d;
+            k = CDAWiFiSHA1K1;
+        } else if (round < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = CDAWiFiSHA1K2;
+        } else {
+            f = b ^ c ^ d;
+            k = CDAWiFiSHA1K3;
+        }
+        
+        uint32_t temp = CDAWiFiSHA1Rotate(a, 5) + f + e + k + w[round & 15];
+        
+        e = d;
+        d = c;
+        c = CDAWiFiSHA1Rotate(b, 30);
+        b = a;
+        a = temp;
+    }
+    
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+#pragma mark - x86 SHA Extensions
+
+#if CDAWiFiCryptoSHANI
+
+/* Four rounds: folds e into the next message words, then runs the rounds with function f. */
+#define CDAWiFiSHA1NIRounds(next, saved, message, f) \
+    next = _mm_sha1nexte_epu32(next, message); \
+    saved = abcd; \
+    abcd = _mm_sha1rnds4_epu32(abcd, next, f)
+
+__attribute__((target("sha,sse4.1")))
+static void CDAWiFiSHA1CompressSHANI(uint32_t state[5], const uint32_t words[16])
+{
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+    __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+    __m128i e1;
+    __m128i abcdSaved = abcd;
+    __m128i e0Saved = e0;
+    
+    /* The instructions expect the first word of a group in the highest lane. */
+    __m128i message0 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(words + 0)), 0x1B);
+    __m128i message1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(words + 4)), 0x1B);
+    __m128i message2 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(words + 8)), 0x1B);
+    __m128i message3 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(words + 12)), 0x1B);
+    
+    /* Rounds 0-3 */
+    e0 = _mm_add_epi32(e0, message0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    
+    /* Rounds 4-15 */
+    CDAWiFiSHA1NIRounds(e1, e0, message1, 0);
+    message0 = _mm_sha1msg1_epu32(message0, message1);
+    
+    CDAWiFiSHA1NIRounds(e0, e1, message2, 0);
+    message1 = _mm_sha1msg1_epu32(message1, message2);
+    message0 = _mm_xor_si128(message0, message2);
+    
+    CDAWiFiSHA1NIRounds(e1, e0, message3, 0);
+    message0 = _mm_sha1msg2_epu32(message0, message3);
+    message2 = _mm_sha1msg1_epu32(message2, message3);
+    message1 = _mm_xor_si128(message1, message3);
+    
+    /* Rounds 16-67, the message schedule runs three groups ahead */
+    CDAWiFiSHA1NIRounds(e0, e1, message0, 0);
+    message1 = _mm_sha1msg2_epu32(message1, message0);
+    message3 = _mm_sha1msg1_epu32(message3, message0);
+    message2 = _mm_xor_si128(message2, message0);
+    
+    CDAWiFiSHA1NIRounds(e1, e0, message1, 1);
+    message2 = _mm_sha1msg2_epu32(message2, message1);
+    message0 = _mm_sha1msg1_epu32(message0, message1);
+    message3 = _mm_xor_si128(message3, message1);
+    
+    CDAWiFiSHA1NIRounds(e0, e1, message2, 1);
+    message3 = _mm_sha1msg2_epu32(message3, message2);
+    message1 = _mm_sha1msg1_epu32(message1, message2);
+    message0 = _mm_xor_si128(message0, message2);
+    
+    CDAWiFiSHA1NIRounds(e1, e0, message3, 1);
+    message0 = _mm_sha1msg2_epu32(message0, message3);
+    message2 = _mm_sha1msg1_epu32(message2, message3);
+    message1 = _mm_xor_si128(message1, message3);
+    
+    CDAWiFiSHA1NIRounds(e0, e1, message0, 1);
+    message1 = _mm_sha1msg2_epu32(message1, message0);
+    message3 = _mm_sha1msg1_epu32(message3, message0);
+    message2 = _mm_xor_si128(message2, message0);
+    
+    CDAWiFiSHA1NIRounds(e1, e0, message1, 1);
+    message2 = _mm_sha1msg2_epu32(message2, message1);
+    message0 = _mm_sha1msg1_epu32(message0, message1);
+    message3 = _mm_xor_si128(message3, message1);
+    
+    CDAWiFiSHA1NIRounds(e0, e1, message2, 2);
+    message3 = _mm_sha1msg2_epu32(message3, message2);
+    message1 = _mm_sha1msg1_epu32(message1, message2);
+    message0 = _mm_xor_si128(message0, message2);
+    
+    CDAWiFiSHA1NIRounds(e1, e0, message3, 2);
+    message0 = _mm_sha1msg2_epu32(message0, message3);
+    message2 = _mm_sha1msg1_epu32(message2, message3);
+    message1 = _mm_xor_si128(message1, message3);
+    
+    CDAWiFiSHA1NIRounds(e0, e1, message0, 2);
+    message1 = _mm_sha1msg2_epu32(message1, message0);
+    message3 = _mm_sha1msg1_epu32(message3, message0);
+    message2 = _mm_xor_si128(message2, message0);
+    
+    CDAWiFiSHA1NIRounds(e1, e0, message1, 2);
+    message2 = _mm_sha1msg2_epu32(message2, message1);
+    message0 = _mm_sha1msg1_epu32(message0, message1);
+    message3 = _mm_xor_si128(message3, message1);
+    
+    CDAWiFiSHA1NIRounds(e0, e1, message2, 2);
+    message3 = _mm_sha1msg2_epu32(message3, message2);
+    message1 = _mm_sha1msg1_epu32(message1, message2);
+    message0 = _mm_xor_si128(message0, message2);
+    
+    CDAWiFiSHA1NIRounds(e1, e0, message3, 3);
+    message0 = _mm_sha1msg2_epu32(message0, message3);
+    message2 = _mm_sha1msg1_epu32(message2, message3);
+    message1 = _mm_xor_si128(message1, message3);
+    
+    CDAWiFiSHA1NIRounds(e0, e1, message0, 3);
+    message1 = _mm_sha1msg2_epu32(message1, message0);
+    message3 = _mm_sha1msg1_epu32(message3, message0);
+    message2 = _mm_xor_si128(message2, message0);
+    
+    /* Rounds 68-79 */
+    CDAWiFiSHA1NIRounds(e1, e0, message1, 3);
+    message2 = _mm_sha1msg2_epu32(message2, message1);
+    message3 = _mm_xor_si128(message3, message1);
+    
+    CDAWiFiSHA1NIRounds(e0, e1, message2, 3);
+    message3 = _mm_sha1msg2_epu32(message3, message2);
+    
+    CDAWiFiSHA1NIRounds(e1, e0, message3, 3);
+    
+    e0 = _mm_sha1nexte_epu32(e0, e0Saved);
+    abcd = _mm_add_epi32(abcd, abcdSaved);
+    
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+static BOOL CDAWiFiSHA1SupportsSHANI(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+        return NO;
+    }
+    
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return NO;
+    }
+    
+    /* CPUID.(EAX=07H, ECX=0):EBX.SHA[bit 29] */
+    return (ebx & (1u << 29)) != 0;
+}
+
+#endif
+
+#pragma mark - ARMv8 Cryptography Extensions
+
+#if CDAWiFiCryptoARMv8
+
+static void CDAWiFiSHA1CompressARMv8(uint32_t state[5], const uint32_t words[16])
+{
+    static const uint32_t constants[4] = { CDAWiFiSHA1K0, CDAWiFiSHA1K1, CDAWiFiSHA1K2, CDAWiFiSHA1K3 };
+    
+    uint32x4_t abcd = vld1q_u32(state);
+    uint32x4_t abcdSaved = abcd;
+    uint32_t e0 = state[4];
+    uint32_t e1 = 0;
+    uint32x4_t message[4];
+    uint32x4_t sum[2];
+    
+    message[0] = vld1q_u32(words + 0);
+    message[1] = vld1q_u32(words + 4);
+    message[2] = vld1q_u32(words + 8);
+    message[3] = vld1q_u32(words + 12);
+    
+    sum[0] = vaddq_u32(message[0], vdupq_n_u32(CDAWiFiSHA1K0));
+    sum[1] = vaddq_u32(message[1], vdupq_n_u32(CDAWiFiSHA1K0));
+    
+    /* Twenty groups of four rounds. The message schedule runs three groups ahead, the round sums two. */
+    for (int group = 0; group < 20; group++) {
+        
+        uint32_t e = (group & 1) ? e1 : e0;
+        uint32_t nextE = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        
+        if (group < 5) {
+            abcd = vsha1cq_u32(abcd, e, sum[group & 1]);
+        } else if (group < 10 || group >= 15) {
+            abcd = vsha1pq_u32(abcd, e, sum[group & 1]);
+        } else {
+            abcd = vsha1mq_u32(abcd, e, sum[group & 1]);
+        }
+        
+        if (group & 1) {
+            e0 = nextE;
+        } else {
+            e1 = nextE;
+        }
+        
+        if (group + 2 < 20) {
+            sum[group & 1] = vaddq_u32(message[(group + 2) & 3], vdupq_n_u32(constants[(group + 2) / 5]));
+        }
+        
+        if (group + 3 >= 4 && group + 3 < 20) {
+            message[(group + 3) & 3] = vsha1su1q_u32(message[(group + 3) & 3], message[(group + 2) & 3]);
+        }
+        
+        if (group + 4 < 20) {
+            message[group & 3] = vsha1su0q_u32(message[group & 3], message[(group + 1) & 3], message[(group + 2) & 3]);
+        }
+    }
+    
+    abcd = vaddq_u32(abcd, abcdSaved);
+    
+    vst1q_u32(state, abcd);
+    state[4] += e0;
+}
+
+static BOOL CDAWiFiSHA1SupportsARMv8(void)
+{
+    return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+}
+
+#endif
+
+#pragma mark - Implementations
+
+CDAWiFiSHA1Implementation CDAWiFiSHA1ImplementationBest(void)
+{
+#if CDAWiFiCryptoSHANI
+    if (CDAWiFiSHA1SupportsSHANI()) {
+        return CDAWiFiSHA1ImplementationSHANI;
+    }
+#endif
+
+#if CDAWiFiCryptoARMv8
+    if (CDAWiFiSHA1SupportsARMv8()) {
+        return CDAWiFiSHA1ImplementationARMv8;
+    }
+#endif
+    
+    return CDAWiFiSHA1ImplementationScalar;
+}
+
+static CDAWiFiSHA1CompressFunction CDAWiFiSHA1CompressFunctionForImplementation(CDAWiFiSHA1Implementation implementation)
+{
+#if CDAWiFiCryptoSHANI
+    if (implementation == CDAWiFiSHA1ImplementationSHANI && CDAWiFiSHA1SupportsSHANI()) {
+        return CDAWiFiSHA1CompressSHANI;
+    }
+#endif
+
+#if CDAWiFiCryptoARMv8
+    if (implementation == CDAWiFiSHA1ImplementationARMv8 && CDAWiFiSHA1SupportsARMv8()) {
+        return CDAWiFiSHA1CompressARMv8;
+    }
+#endif
+    
+    return CDAWiFiSHA1CompressScalar;
+}
+
+static CDAWiFiSHA1Implementation CDAWiFiSHA1ImplementationCached(void)
+{
+    static CDAWiFiSHA1Implementation implementation = -1;
+    
+    if (implementation == (CDAWiFiSHA1Implementation)-1) {
+        implementation = CDAWiFiSHA1ImplementationBest();
+    }
+    
+    return implementation;
+}
+
+#pragma mark - Hashing
+
+/* Hashes length bytes on top of a state that already absorbed prefixLength bytes, a multiple of 64. */
+static void CDAWiFiSHA1Finish(CDAWiFiSHA1CompressFunction compress,
+                              uint32_t state[5],
+                              uint64_t prefixLength,
+                              const uint8_t *bytes,
+                              size_t length)
+{
+    uint32_t words[16];
+    uint8_t block[64];
+    uint64_t bitLength = (prefixLength + length) * 8;
+    
+    for (; length >= 64; bytes += 64, length -= 64) {
+        
+        for (int index = 0; index < 16; index++) {
+            words[index] = CDAWiFiSHA1LoadWord(bytes + 4 * index);
+        }
+        
+        compress(state, words);
+    }
+    
+    memset(block, 0, sizeof(block));
+    memcpy(block, bytes, length);
+    block[length] = 0x80;
+    
+    if (length >= 56) {
+        
+        for (int index = 0; index < 16; index++) {
+            words[index] = CDAWiFiSHA1LoadWord(block + 4 * index);
+        }
+        
+        compress(state, words);
+        
+        memset(block, 0, sizeof(block));
+    }
+    
+    for (int index = 0; index < 14; index++) {
+        words[index] = CDAWiFiSHA1LoadWord(block + 4 * index);
+    }
+    
+    words[14] = (uint32_t)(bitLength >> 32);
+    words[15] = (uint32_t)bitLength;
+    
+    compress(state, words);
+    
+    CDAWiFiSecureZero(block, sizeof(block));
+    CDAWiFiSecureZero(words, sizeof(words));
+}
+
+void CDAWiFiSHA1(const void *bytes, size_t length, uint8_t digest[CDAWiFiSHA1DigestLength])
+{
+    uint32_t state[5];
+    
+    memcpy(state, CDAWiFiSHA1InitialState, sizeof(state));
+    
+    CDAWiFiSHA1Finish(CDAWiFiSHA1CompressFunctionForImplementation(CDAWiFiSHA1ImplementationCached()), state, 0, bytes, length);
+    
+    for (int index = 0; index < 5; index++) {
+        CDAWiFiSHA1StoreWord(digest + 4 * index, state[index]);
+    }
+}
+
+#pragma mark - PBKDF2
+
+/* The HMAC key, absorbed once into the inner and outer states. */
+static void CDAWiFiHMACSHA1Prepare(CDAWiFiSHA1CompressFunction compress,
+                                   const uint8_t *key,
+                                   size_t keyLength,
+                                   uint32_t innerState[5],
+                                   uint32_t outerState[5])
+{
+    uint8_t digest[CDAWiFiSHA1DigestLength];
+    uint8_t block[64];
+    uint32_t innerWords[16];
+    uint32_t outerWords[16];
+    
+    if (keyLength > 64) {
+        
+        uint32_t state[5];
+        
+        memcpy(state, CDAWiFiSHA1InitialState, sizeof(state));
+        
+        CDAWiFiSHA1Finish(compress, state, 0, key, keyLength);
+        
+        for (int index = 0; index < 5; index++) {
+            CDAWiFiSHA1StoreWord(digest + 4 * index, state[index]);
+        }
+        
+        key = digest;
+        keyLength = sizeof(digest);
+    }
+    
+    memset(block, 0, sizeof(block));
+    memcpy(block, key, keyLength);
+    
+    for (int index = 0; index < 16; index++) {
+        
+        uint32_t word = CDAWiFiSHA1LoadWord(block + 4 * index);
+        
+        innerWords[index] = word ^ 0x36363636;
+        outerWords[index] = word ^ 0x5C5C5C5C;
+    }
+    
+    memcpy(innerState, CDAWiFiSHA1InitialState, sizeof(CDAWiFiSHA1InitialState));
+    memcpy(outerState, CDAWiFiSHA1InitialState, sizeof(CDAWiFiSHA1InitialState));
+    
+    compress(innerState, innerWords);
+    compress(outerState, outerWords);
+    
+    CDAWiFiSecureZero(digest, sizeof(digest));
+    CDAWiFiSecureZero(block, sizeof(block));
+    CDAWiFiSecureZero(innerWords, sizeof(innerWords));
+    CDAWiFiSecureZero(outerWords, sizeof(outerWords));
+}
+
+/* U1 = HMAC(password, salt || INT(blockIndex)). The salt block has 4 spare bytes after the salt. */
+static void CDAWiFiPBKDF2SHA1FirstIteration(CDAWiFiSHA1CompressFunction compress,
+                                            const uint32_t innerState[5],
+                                            const uint32_t outerState[5],
+                                            uint8_t *saltBlock,
+                                            size_t saltLength,
+                                            uint32_t blockIndex,
+                                            uint32_t value[5])
+{
+    uint32_t words[16] = { 0 };
+    
+    CDAWiFiSHA1StoreWord(saltBlock + saltLength, blockIndex);
+    
+    memcpy(value, innerState, 5 * sizeof(uint32_t));
+    CDAWiFiSHA1Finish(compress, value, 64, saltBlock, saltLength + 4);
+    
+    memcpy(words, value, 5 * sizeof(uint32_t));
+    words[5] = 0x80000000;
+    words[15] = (64 + CDAWiFiSHA1DigestLength) * 8;
+    
+    memcpy(value, outerState, 5 * sizeof(uint32_t));
+    compress(value, words);
+    
+    CDAWiFiSecureZero(words, sizeof(words));
+}
+
+void CDAWiFiHMACSHA1(const void *key,
+                     size_t keyLength,
+                     const void *message,
+                     size_t messageLength,
+                     uint8_t digest[CDAWiFiSHA1DigestLength])
+{
+    CDAWiFiSHA1CompressFunction compress = CDAWiFiSHA1CompressFunctionForImplementation(CDAWiFiSHA1ImplementationCached());
+    uint32_t innerState[5];
+    uint32_t outerState[5];
+    
+    CDAWiFiHMACSHA1Prepare(compress, key, keyLength, innerState, outerState);
+    
+    CDAWiFiSHA1Finish(compress, innerState, 64, message, messageLength);
+    
+    for (int index = 0; index < 5; index++) {
+        CDAWiFiSHA1StoreWord(digest + 4 * index, innerState[index]);
+    }
+    
+    CDAWiFiSHA1Finish(compress, outerState, 64, digest, CDAWiFiSHA1DigestLength);
+    
+    for (int index = 0; index < 5; index++) {
+        CDAWiFiSHA1StoreWord(digest + 4 * index, outerState[index]);
+    }
+    
+    CDAWiFiSecureZero(innerState, sizeof(innerState));
+    CDAWiFiSecureZero(outerState, sizeof(outerState));
+}
+
+/*
+ * Runs the iterations of one PBKDF2 block. Every HMAC of a 20 byte message is exactly two compressions
+ * of a single padded block, starting from the precomputed key states. Inlined into a copy per implementation,
+ * so the compression function is called directly.
+ */
+static inline __attribute__((always_inline)) void CDAWiFiPBKDF2SHA1Iterate(CDAWiFiSHA1CompressFunction compress,
+                                                                           const uint32_t innerState[5],
+                                                                           const uint32_t outerState[5],
+                                                                           uint32_t iterations,
+                                                                           uint32_t value[5])
+{
+    uint32_t words[16] = { 0 };
+    uint32_t result[5];
+    
+    /* The message (a previous digest) is followed by the padding of a 84 byte message. */
+    words[5] = 0x80000000;
+    words[15] = (64 + CDAWiFiSHA1DigestLength) * 8;
+    
+    memcpy(result, value, sizeof(result));
+    
+    for (uint32_t iteration = 1; iteration < iterations; iteration++) {
+        
+        uint32_t state[5];
+        
+        memcpy(words, value, sizeof(result));
+        memcpy(state, innerState, sizeof(state));
+        compress(state, words);
+        
+        memcpy(words, state, sizeof(state));
+        memcpy(state, outerState, sizeof(state));
+        compress(state, words);
+        
+        for (int index = 0; index < 5; index++) {
+            value[index] = state[index];
+            result[index] ^= state[index];
+        }
+    }
+    
+    memcpy(value, result, sizeof(result));
+    
+    CDAWiFiSecureZero(words, sizeof(words));
+    CDAWiFiSecureZero(result, sizeof(result));
+}
+
+static void CDAWiFiPBKDF2SHA1IterateScalar(const uint32_t innerState[5], const uint32_t outerState[5], uint32_t iterations, uint32_t value[5])
+{
+    CDAWiFiPBKDF2SHA1Iterate(CDAWiFiSHA1CompressScalar, innerState, outerState, iterations, value);
+}
+
+#if CDAWiFiCryptoSHANI
+__attribute__((target("sha,sse4.1")))
+static void CDAWiFiPBKDF2SHA1IterateSHANI(const uint32_t innerState[5], const uint32_t outerState[5], uint32_t iterations, uint32_t value[5])
+{
+    CDAWiFiPBKDF2SHA1Iterate(CDAWiFiSHA1CompressSHANI, innerState, outerState, iterations, value);
+}
+#endif
+
+#if CDAWiFiCryptoARMv8
+static void CDAWiFiPBKDF2SHA1IterateARMv8(const uint32_t innerState[5], const uint32_t outerState[5], uint32_t iterations, uint32_t value[5])
+{
+    CDAWiFiPBKDF2SHA1Iterate(CDAWiFiSHA1CompressARMv8, innerState, outerState, iterations, value);
+}
+#endif
+
+void CDAWiFiPBKDF2SHA1WithImplementation(const void *password,
+                                         size_t passwordLength,
+                                         const void *salt,
+                                         size_t saltLength,
+                                         uint32_t iterations,
+                                         uint8_t *key,
+                                         size_t keyLength,
+                                         CDAWiFiSHA1Implementation implementation)
+{
+    CDAWiFiSHA1CompressFunction compress = CDAWiFiSHA1CompressFunctionForImplementation(implementation);
+    void (*iterate)(const uint32_t *, const uint32_t *, uint32_t, uint32_t *) = CDAWiFiPBKDF2SHA1IterateScalar;
+    uint32_t innerState[5];
+    uint32_t outerState[5];
+
+#if CDAWiFiCryptoSHANI
+    if (compress == CDAWiFiSHA1CompressSHANI) {
+        iterate = CDAWiFiPBKDF2SHA1IterateSHANI;
+    }
+#endif
+
+#if CDAWiFiCryptoARMv8
+    if (compress == CDAWiFiSHA1CompressARMv8) {
+        iterate = CDAWiFiPBKDF2SHA1IterateARMv8;
+    }
+#endif
+    
+    if (iterations == 0) {
+        iterations = 1;
+    }
+    
+    CDAWiFiHMACSHA1Prepare(compress, password, passwordLength, innerState, outerState);
+    
+    uint8_t *saltBlock = malloc(saltLength + 4);
+    
+    if (saltBlock == NULL) {
+        
+        memset(key, 0, keyLength);
+        
+        return;
+    }
+    
+    memcpy(saltBlock, salt, saltLength);
+    
+    for (uint32_t blockIndex = 1; keyLength > 0; blockIndex++) {
+        
+        uint32_t value[5];
+        uint8_t digest[CDAWiFiSHA1DigestLength];
+        
+        CDAWiFiPBKDF2SHA1FirstIteration(compress, innerState, outerState, saltBlock, saltLength, blockIndex, value);
+        
+        iterate(innerState, outerState, iterations, value);
+        
+        for (int index = 0; index < 5; index++) {
+            CDAWiFiSHA1StoreWord(digest + 4 * index, value[index]);
+        }
+        
+        size_t length = (keyLength < sizeof(digest)) ? keyLength : sizeof(digest);
+        
+        memcpy(key, digest, length);
+        
+        key += length;
+        keyLength -= length;
+        
+        CDAWiFiSecureZero(value, sizeof(value));
+        CDAWiFiSecureZero(digest, sizeof(digest));
+    }
+    
+    free(saltBlock);
+    
+    CDAWiFiSecureZero(innerState, sizeof(innerState));
+    CDAWiFiSecureZero(outerState, sizeof(outerState));
+}
+
+void CDAWiFiPBKDF2SHA1(const void *password,
+                       size_t passwordLength,
+                       const void *salt,
+                       size_t saltLength,
+                       uint32_t iterations,
+                       uint8_t *key,
+                       size_t keyLength)
+{
+    CDAWiFiPBKDF2SHA1WithImplementation(password, passwordLength, salt, saltLength, iterations, key, keyLength,
+                                        CDAWiFiSHA1ImplementationCached());
+}
+
+#pragma mark - Batches
+
+/* One PBKDF2 block of a batch: the key states of its password, U1 on input and the block on output. */
+typedef struct
+{
+    uint32_t innerState[5];
+    uint32_t outerState[5];
+    uint32_t value[5];
+    size_t owner;   /* index of the derived key in the batch */
+    
+} CDAWiFiPBKDF2SHA1Job;
+
+/* Runs the iterations of the first jobs, as many as the implementation processes at once. Returns how many. */
+typedef size_t (*CDAWiFiPBKDF2SHA1JobFunction)(CDAWiFiPBKDF2SHA1Job *jobs, size_t count, uint32_t iterations);
+
+/*
+ * Multi-buffer SHA-1: independent messages in the lanes of a vector, one message per lane.
+ * Eight lanes are one AVX2 register, or two SSE2 registers. Four lanes are one NEON register.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define CDAWiFiSHA1LaneCount 8
+#else
+#define CDAWiFiSHA1LaneCount 4
+#endif
+
+typedef uint32_t CDAWiFiSHA1Lanes __attribute__((vector_size(4 * CDAWiFiSHA1LaneCount)));
+
+#define CDAWiFiSHA1LanesRotate(value, count) (((value) << (count)) | ((value) >> (32 - (count))))
+
+static inline __attribute__((always_inline)) void CDAWiFiSHA1CompressLanes(CDAWiFiSHA1Lanes state[5], const CDAWiFiSHA1Lanes words[16])
+{
+    CDAWiFiSHA1Lanes w[16];
+    CDAWiFiSHA1Lanes a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    
+    memcpy(w, words, sizeof(w));
+    
+    for (int round = 0; round < 80; round++) {
+        
+        CDAWiFiSHA1Lanes f;
+        uint32_t k;
+        
+        if (round >= 16) {
+            w[round & 15] = CDAWiFiSHA1LanesRotate(w[(round + 13) & 15] ^ w[(round + 8) & 15] ^ w[(round + 2) & 15] ^ w[round & 15], 1);
+        }
+        
+        if (round < 20) {
+            f = d ^ (b & (c ^ d));
+            k = CDAWiFiSHA1K0;
+        } else if (round < 40) {
+            f = b ^ c ^ d;
+            k = CDAWiFiSHA1K1;
+        } else if (round < 60) {
+            f = (b & c) | (d & (b | c));
+            k = CDAWiFiSHA1K2;
+        } else {
+            f = b ^ c ^ d;
+            k = CDAWiFiSHA1K3;
+        }
+        
+        CDAWiFiSHA1Lanes temp = CDAWiFiSHA1LanesRotate(a, 5) + f + e + k + w[round & 15];
+        
+        e = d;
+        d = c;
+        c = CDAWiFiSHA1LanesRotate(b, 30);
+        b = a;
+        a = temp;
+    }
+    
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+static inline __attribute__((always_inline)) size_t CDAWiFiPBKDF2SHA1IterateLanes(CDAWiFiPBKDF2SHA1Job *jobs, size_t count, uint32_t iterations)
+{
+    CDAWiFiSHA1Lanes innerState[5], outerState[5], value[5], result[5], state[5];
+    CDAWiFiSHA1Lanes words[16] = { { 0 } };
+    
+    if (count > CDAWiFiSHA1LaneCount) {
+        count = CDAWiFiSHA1LaneCount;
+    }
+    
+    /* Spare lanes repeat the last job. */
+    for (int lane = 0; lane < CDAWiFiSHA1LaneCount; lane++) {
+        
+        const CDAWiFiPBKDF2SHA1Job *job = &jobs[((size_t)lane < count) ? (size_t)lane : count - 1];
+        
+        for (int index = 0; index < 5; index++) {
+            innerState[index][lane] = job->innerState[index];
+            outerState[index][lane] = job->outerState[index];
+            value[index][lane] = job->value[index];
+        }
+        
+        words[5][lane] = 0x80000000;
+        words[15][lane] = (64 + CDAWiFiSHA1DigestLength) * 8;
+    }
+    
+    memcpy(result, value, sizeof(result));
+    
+    for (uint32_t iteration = 1; iteration < iterations; iteration++) {
+        
+        memcpy(words, value, sizeof(value));
+        memcpy(state, innerState, sizeof(state));
+        CDAWiFiSHA1CompressLanes(state, words);
+        
+        memcpy(words, state, sizeof(state));
+        memcpy(state, outerState, sizeof(state));
+        CDAWiFiSHA1CompressLanes(state, words);
+        
+        for (int index = 0; index < 5; index++) {
+            value[index] = state[index];
+            result[index] ^= state[index];
+        }
+    }
+    
+    for (size_t lane = 0; lane < count; lane++) {
+        
+        for (int index = 0; index < 5; index++) {
+            jobs[lane].value[index] = result[index][lane];
+        }
+    }
+    
+    CDAWiFiSecureZero(innerState, sizeof(innerState));
+    CDAWiFiSecureZero(outerState, sizeof(outerState));
+    CDAWiFiSecureZero(value, sizeof(value));
+    CDAWiFiSecureZero(result, sizeof(result));
+    CDAWiFiSecureZero(state, sizeof(state));
+    CDAWiFiSecureZero(words, sizeof(words));
+    
+    return count;
+}
+
+/* Runs the iterations of two jobs in the same loop, so out of order cores overlap the two dependency chains. */
+static inline __attribute__((always_inline)) size_t CDAWiFiPBKDF2SHA1IterateInterleaved(CDAWiFiSHA1CompressFunction compress,
+                                                                                        CDAWiFiPBKDF2SHA1Job *jobs,
+                                                                                        size_t count,
+                                                                                        uint32_t iterations)
+{
+    if (count < 2) {
+        
+        CDAWiFiPBKDF2SHA1Iterate(compress, jobs[0].innerState, jobs[0].outerState, iterations, jobs[0].value);
+        
+        return 1;
+    }
+    
+    uint32_t words[2][16] = { { 0 } };
+    uint32_t result[2][5];
+    
+    for (int chain = 0; chain < 2; chain++) {
+        
+        words[chain][5] = 0x80000000;
+        words[chain][15] = (64 + CDAWiFiSHA1DigestLength) * 8;
+        
+        memcpy(result[chain], jobs[chain].value, sizeof(result[chain]));
+    }
+    
+    for (uint32_t iteration = 1; iteration < iterations; iteration++) {
+        
+        uint32_t state[2][5];
+        
+        memcpy(words[0], jobs[0].value, sizeof(result[0]));
+        memcpy(words[1], jobs[1].value, sizeof(result[1]));
+        memcpy(state[0], jobs[0].innerState, sizeof(state[0]));
+        memcpy(state[1], jobs[1].innerState, sizeof(state[1]));
+        compress(state[0], words[0]);
+        compress(state[1], words[1]);
+        
+        memcpy(words[0], state[0], sizeof(state[0]));
+        memcpy(words[1], state[1], sizeof(state[1]));
+        memcpy(state[0], jobs[0].outerState, sizeof(state[0]));
+        memcpy(state[1], jobs[1].outerState, sizeof(state[1]));
+        compress(state[0], words[0]);
+        compress(state[1], words[1]);
+        
+        for (int index = 0; index < 5; index++) {
+            
+            jobs[0].value[index] = state[0][index];
+            jobs[1].value[index] = state[1][index];
+            result[0][index] ^= state[0][index];
+            result[1][index] ^= state[1][index];
+        }
+    }
+    
+    memcpy(jobs[0].value, result[0], sizeof(result[0]));
+    memcpy(jobs[1].value, result[1], sizeof(result[1]));
+    
+    CDAWiFiSecureZero(words, sizeof(words));
+    CDAWiFiSecureZero(result, sizeof(result));
+    
+    return 2;
+}
+
+static size_t CDAWiFiPBKDF2SHA1IterateJobsLanes(CDAWiFiPBKDF2SHA1Job *jobs, size_t count, uint32_t iterations)
+{
+    return CDAWiFiPBKDF2SHA1IterateLanes(jobs, count, iterations);
+}
+
+#if CDAWiFiCryptoSHANI
+__attribute__((target("avx2")))
+static size_t CDAWiFiPBKDF2SHA1IterateJobsAVX2(CDAWiFiPBKDF2SHA1Job *jobs, size_t count, uint32_t iterations)
+{
+    return CDAWiFiPBKDF2SHA1IterateLanes(jobs, count, iterations);
+}
+
+__attribute__((target("sha,sse4.1")))
+static size_t CDAWiFiPBKDF2SHA1IterateJobsSHANI(CDAWiFiPBKDF2SHA1Job *jobs, size_t count, uint32_t iterations)
+{
+    return CDAWiFiPBKDF2SHA1IterateInterleaved(CDAWiFiSHA1CompressSHANI, jobs, count, iterations);
+}
+#endif
+
+#if CDAWiFiCryptoARMv8
+static size_t CDAWiFiPBKDF2SHA1IterateJobsARMv8(CDAWiFiPBKDF2SHA1Job *jobs, size_t count, uint32_t iterations)
+{
+    return CDAWiFiPBKDF2SHA1IterateInterleaved(CDAWiFiSHA1CompressARMv8, jobs, count, iterations);
+}
+#endif
+
+/*
+ * Returns the fastest job function for batches, and the number of jobs it processes at once.
+ * Eight AVX2 lanes outrun two interleaved SHA extension chains, SHA extensions outrun SSE2 and NEON lanes.
+ */
+static CDAWiFiPBKDF2SHA1JobFunction CDAWiFiPBKDF2SHA1JobFunctionBest(size_t *jobCount)
+{
+    CDAWiFiSHA1Implementation implementation = CDAWiFiSHA1ImplementationCached();
+    
+    *jobCount = CDAWiFiSHA1LaneCount;
+
+#if CDAWiFiCryptoSHANI
+    if (__builtin_cpu_supports("avx2")) {
+        return CDAWiFiPBKDF2SHA1IterateJobsAVX2;
+    }
+    
+    if (implementation == CDAWiFiSHA1ImplementationSHANI) {
+        
+        *jobCount = 2;
+        
+        return CDAWiFiPBKDF2SHA1IterateJobsSHANI;
+    }
+#endif
+
+#if CDAWiFiCryptoARMv8
+    if (implementation == CDAWiFiSHA1ImplementationARMv8) {
+        
+        *jobCount = 2;
+        
+        return CDAWiFiPBKDF2SHA1IterateJobsARMv8;
+    }
+#endif
+    
+    (void)implementation;
+    
+    return CDAWiFiPBKDF2SHA1IterateJobsLanes;
+}
+
+typedef struct
+{
+    CDAWiFiPBKDF2SHA1Job *jobs;
+    size_t count;
+    size_t groupSize;
+    uint32_t iterations;
+    CDAWiFiPBKDF2SHA1JobFunction function;
+    
+} CDAWiFiPBKDF2SHA1Batch;
+
+static void CDAWiFiPBKDF2SHA1BatchRunGroup(void *context, size_t group)
+{
+    const CDAWiFiPBKDF2SHA1Batch *batch = context;
+    size_t start = group * batch->groupSize;
+    size_t end = (start + batch->groupSize < batch->count) ? start + batch->groupSize : batch->count;
+    
+    while (start < end) {
+        start += batch->function(batch->jobs + start, end - start, batch->iterations);
+    }
+}
+
+/* Iterates every job. Groups of jobs run on all cores, the jobs of a group in the lanes of one core. */
+static void CDAWiFiPBKDF2SHA1RunJobs(CDAWiFiPBKDF2SHA1Job *jobs, size_t count, uint32_t iterations)
+{
+    CDAWiFiPBKDF2SHA1Batch batch;
+    
+    batch.jobs = jobs;
+    batch.count = count;
+    batch.iterations = iterations;
+    batch.function = CDAWiFiPBKDF2SHA1JobFunctionBest(&batch.groupSize);
+    
+    dispatch_apply_f((count + batch.groupSize - 1) / batch.groupSize,
+                     dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+                     &batch,
+                     CDAWiFiPBKDF2SHA1BatchRunGroup);
+}
+
+#pragma mark - WPA
+
+static inline int CDAWiFiHexadecimalDigit(char character)
+{
+    if (character >= '0' && character <= '9') {
+        return character - '0';
+    }
+    
+    if (character >= 'a' && character <= 'f') {
+        return character - 'a' + 10;
+    }
+    
+    if (character >= 'A' && character <= 'F') {
+        return character - 'A' + 10;
+    }
+    
+    return -1;
+}
+
+/* Validates a passphrase and an SSID. A passphrase given as a hexadecimal PSK is decoded into key, and isKey set. */
+static BOOL CDAWiFiPairwiseMasterKeyCheck(const char *passphrase,
+                                          size_t passphraseLength,
+                                          size_t ssidLength,
+                                          uint8_t key[CDAWiFiPairwiseMasterKeyLength],
+                                          BOOL *isKey)
+{
+    *isKey = NO;
+    
+    if (ssidLength == 0 || ssidLength > 32) {
+        return NO;
+    }
+    
+    /* A 256 bit PSK given in hexadecimal is the PMK itself. */
+    if (passphraseLength == 2 * CDAWiFiPairwiseMasterKeyLength) {
+        
+        for (size_t index = 0; index < CDAWiFiPairwiseMasterKeyLength; index++) {
+            
+            int high = CDAWiFiHexadecimalDigit(passphrase[2 * index]);
+            int low = CDAWiFiHexadecimalDigit(passphrase[2 * index + 1]);
+            
+            if (high < 0 || low < 0) {
+                
+                CDAWiFiSecureZero(key, CDAWiFiPairwiseMasterKeyLength);
+                
+                return NO;
+            }
+            
+            key[index] = (uint8_t)((high << 4) | low);
+        }
+        
+        *isKey = YES;
+        
+        return YES;
+    }
+    
+    if (passphraseLength < 8 || passphraseLength > 63) {
+        return NO;
+    }
+    
+    for (size_t index = 0; index < passphraseLength; index++) {
+        
+        if (passphrase[index] < 32 || passphrase[index] > 126) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+BOOL CDAWiFiPairwiseMasterKeyDerive(const char *passphrase,
+                                    size_t passphraseLength,
+                                    const uint8_t *ssid,
+                                    size_t ssidLength,
+                                    uint8_t key[CDAWiFiPairwiseMasterKeyLength])
+{
+    BOOL isKey;
+    
+    if (!CDAWiFiPairwiseMasterKeyCheck(passphrase, passphraseLength, ssidLength, key, &isKey)) {
+        return NO;
+    }
+    
+    if (!isKey) {
+        CDAWiFiPBKDF2SHA1(passphrase, passphraseLength, ssid, ssidLength, CDAWiFiPairwiseMasterKeyIterations,
+                          key, CDAWiFiPairwiseMasterKeyLength);
+    }
+    
+    return YES;
+}
+
+void CDAWiFiPairwiseMasterKeyIdentifierDerive(const uint8_t key[CDAWiFiPairwiseMasterKeyLength],
+                                              const uint8_t authenticatorAddress[6],
+                                              const uint8_t supplicantAddress[6],
+                                              uint8_t identifier[CDAWiFiPairwiseMasterKeyIdentifierLength])
+{
+    static const char label[] = "PMK Name";
+    uint8_t message[sizeof(label) - 1 + 6 + 6];
+    uint8_t digest[CDAWiFiSHA1DigestLength];
+    
+    memcpy(message, label, sizeof(label) - 1);
+    memcpy(message + sizeof(label) - 1, authenticatorAddress, 6);
+    memcpy(message + sizeof(label) - 1 + 6, supplicantAddress, 6);
+    
+    CDAWiFiHMACSHA1(key, CDAWiFiPairwiseMasterKeyLength, message, sizeof(message), digest);
+    
+    memcpy(identifier, digest, CDAWiFiPairwiseMasterKeyIdentifierLength);
+    
+    CDAWiFiSecureZero(digest, sizeof(digest));
+}
+
+void CDAWiFiPairwiseMasterKeyDeriveBatch(CDAWiFiPairwiseMasterKeyDerivation *derivations, size_t count)
+{
+    CDAWiFiSHA1CompressFunction compress = CDAWiFiSHA1CompressFunctionForImplementation(CDAWiFiSHA1ImplementationCached());
+    
+    /* A PMK is two PBKDF2 blocks, two independent jobs. */
+    CDAWiFiPBKDF2SHA1Job *jobs = calloc(2 * count, sizeof(CDAWiFiPBKDF2SHA1Job));
+    size_t jobCount = 0;
+    
+    if (jobs == NULL) {
+        
+        for (size_t index = 0; index < count; index++) {
+            
+            derivations[index].valid = CDAWiFiPairwiseMasterKeyDerive(derivations[index].passphrase,
+                                                                      derivations[index].passphraseLength,
+                                                                      derivations[index].ssid,
+                                                                      derivations[index].ssidLength,
+                                                                      derivations[index].key);
+        }
+        
+        return;
+    }
+    
+    /* The first iteration of every block, then the remaining ones in parallel. */
+    for (size_t index = 0; index < count; index++) {
+        
+        CDAWiFiPairwiseMasterKeyDerivation *derivation = &derivations[index];
+        uint8_t saltBlock[32 + 4];
+        BOOL isKey;
+        
+        derivation->valid = CDAWiFiPairwiseMasterKeyCheck(derivation->passphrase, derivation->passphraseLength,
+                                                          derivation->ssidLength, derivation->key, &isKey);
+        
+        if (!derivation->valid || isKey) {
+            continue;
+        }
+        
+        memcpy(saltBlock, derivation->ssid, derivation->ssidLength);
+        
+        CDAWiFiHMACSHA1Prepare(compress, (const uint8_t *)derivation->passphrase, derivation->passphraseLength,
+                               jobs[jobCount].innerState, jobs[jobCount].outerState);
+        
+        jobs[jobCount].owner = index;
+        
+        memcpy(&jobs[jobCount + 1], &jobs[jobCount], sizeof(CDAWiFiPBKDF2SHA1Job));
+        
+        for (uint32_t blockIndex = 1; blockIndex <= 2; blockIndex++, jobCount++) {
+            
+            CDAWiFiPBKDF2SHA1FirstIteration(compress, jobs[jobCount].innerState, jobs[jobCount].outerState,
+                                            saltBlock, derivation->ssidLength, blockIndex, jobs[jobCount].value);
+        }
+        
+        CDAWiFiSecureZero(saltBlock, sizeof(saltBlock));
+    }
+    
+    CDAWiFiPBKDF2SHA1RunJobs(jobs, jobCount, CDAWiFiPairwiseMasterKeyIterations);
+    
+    for (size_t index = 0; index < jobCount; index += 2) {
+        
+        uint8_t digest[2 * CDAWiFiSHA1DigestLength];
+        
+        for (int word = 0; word < 10; word++) {
+            CDAWiFiSHA1StoreWord(digest + 4 * word, jobs[index + word / 5].value[word % 5]);
+        }
+        
+        memcpy(derivations[jobs[index].owner].key, digest, CDAWiFiPairwiseMasterKeyLength);
+        
+        CDAWiFiSecureZero(digest, sizeof(digest));
+    }
+    
+    CDAWiFiSecureZero(jobs, 2 * count * sizeof(CDAWiFiPBKDF2SHA1Job));
+    
+    free(jobs);
+}
+
+void CDAWiFiSecureZero(void *bytes, size_t length)
+{
+    volatile uint8_t *cursor = bytes;
+    
+    while (length-- > 0) {
+        *cursor++ = 0;
+    }
+}
@@ -0,0 +1,293 @@
+//
+//  CDAWiFiEventEngine.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/8/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+struct nlmsghdr;
+
+/*!
+ * @typedef CDAWiFiEventEngineHandler
+ *
+ * @abstract Invoked on the event thread for every event of an enabled type.
+ *
+ * @param type
+ * The type of the event. CDAWiFiEventTypeNone if events were lost because the kernel socket buffer overflowed.
+ *
+ * @param interfaceIndex
+ * The kernel index of the interface the event is about, or 0 if the event concerns every interface.
+ */
+typedef void (^CDAWiFiEventEngineHandler)(CDAWiFiEventType type, uint32_t interfaceIndex);
+
+/*!
+ * @typedef CDAWiFiScanObserverHandler
+ *
+ * @abstract Invoked on the event thread when a scan completes.
+ *
+ * @param aborted
+ * YES if the scan was aborted, NO if new scan results are available.
+ */
+typedef void (^CDAWiFiScanObserverHandler)(BOOL aborted);
+
+/*!
+ * @constant CDAWiFiStatusCodeUnspecifiedFailure
+ *
+ * @abstract The IEEE 802.11 status code reported for connections that time out or are torn down before completing.
+ */
+#define CDAWiFiStatusCodeUnspecifiedFailure 1
+
+/*!
+ * @typedef CDAWiFiConnectObserverHandler
+ *
+ * @abstract Invoked on the event thread when a connection attempt completes.
+ *
+ * @param statusCode
+ * The IEEE 802.11 status code of the attempt, 0 if the interface is connected.
+ */
+typedef void (^CDAWiFiConnectObserverHandler)(uint16_t statusCode);
+
+/*!
+ * @typedef CDAWiFiAuthorizationObserverHandler
+ *
+ * @abstract Invoked on the event thread when the port of a connection is authorized, or the connection is lost before.
+ *
+ * @param authorized
+ * YES once the 4-way handshake completed, NO if the connection failed or the interface disconnected.
+ */
+typedef void (^CDAWiFiAuthorizationObserverHandler)(BOOL authorized);
+
+/*!
+ * @typedef CDAWiFiLinkObserverHandler
+ *
+ * @abstract Invoked on the event thread when the link of an interface changes.
+ *
+ * @param type
+ * CDAWiFiEventTypeLinkQualityDidChange when the RSSI crosses the connection quality monitor threshold,
+ * CDAWiFiEventTypeBSSIDDidChange when the interface connects or roams, CDAWiFiEventTypeLinkDidChange when it disconnects.
+ *
+ * @param rssi
+ * For threshold crossings, the RSSI in dBm if the driver reports it, otherwise 0.
+ */
+typedef void (^CDAWiFiLinkObserverHandler)(CDAWiFiEventType type, int rssi);
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Receives the Wi-Fi events of every interface on a single thread.
+ *
+ * @discussion
+ * The nl80211 "mlme", "scan", "regulatory" and "config" multicast groups and the rtnetlink link group
+ * are watched by one epoll set. Messages are demultiplexed into CDAWiFiEventType values as they arrive,
+ * and only the enabled types are delivered. Enabling or disabling a type is a single atomic operation.
+ *
+ * Thread safe.
+ */
+@interface CDAWiFiEventEngine : OFObject
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes an event engine. No resources are allocated until the engine is started.
+ */
+- (instancetype)initWithHandler:(CDAWiFiEventEngineHandler)handler;
+
+/*!
+ * @method
+ *
+ * @param stateHandler
+ * Invoked on the event thread for every event that may change the state of an interface, whether its type is enabled
+ * or not, right before the handler. CDAWiFiEventTypeNone if events were lost. Scan cache updates are not included.
+ *
+ * @abstract
+ * Initializes an event engine that also reports state changes, so interface state can be kept current from events.
+ */
+- (instancetype)initWithHandler:(CDAWiFiEventEngineHandler)handler stateHandler:(CDAWiFiEventEngineHandler)stateHandler;
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Opens the event sockets and starts the event thread. Does nothing if the engine is running.
+ */
+- (BOOL)startAndReturnError:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Stops the event thread and closes the event sockets. Must not be called from the event thread.
+ */
+- (void)stop;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Starts delivering events of the specified type.
+ */
+- (void)enableEventType:(CDAWiFiEventType)type;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Stops delivering events of the specified type.
+ */
+- (void)disableEventType:(CDAWiFiEventType)type;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Stops delivering events of any type.
+ */
+- (void)disableAllEventTypes;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns YES if events of the specified type are delivered.
+ */
+- (BOOL)isEventTypeEnabled:(CDAWiFiEventType)type;
+
+/*!
+ * @method
+ *
+ * @param interfaceIndex
+ * The kernel index of the scanning interface.
+ *
+ * @param handler
+ * Invoked once, when the next scan on the interface completes or is aborted.
+ *
+ * @result
+ * An opaque observer, to pass to -[CDAWiFiEventEngine removeScanObserver:].
+ *
+ * @abstract
+ * Waits for the completion of a scan, whatever the enabled event types.
+ *
+ * @discussion
+ * Add the observer before triggering the scan, so the completion can not be missed.
+ */
+- (id)addScanObserverForInterfaceIndex:(uint32_t)interfaceIndex handler:(CDAWiFiScanObserverHandler)handler;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes a scan observer that has not fired yet. Does nothing if it already fired.
+ */
+- (void)removeScanObserver:(id)observer;
+
+/*!
+ * @method
+ *
+ * @param interfaceIndex
+ * The kernel index of the connecting interface.
+ *
+ * @param handler
+ * Invoked once, when the next connection attempt on the interface completes or the interface disconnects.
+ *
+ * @result
+ * An opaque observer, to pass to -[CDAWiFiEventEngine removeConnectObserver:].
+ *
+ * @abstract
+ * Waits for the completion of a connection attempt, whatever the enabled event types.
+ *
+ * @discussion
+ * Add the observer before requesting the connection, so the completion can not be missed.
+ */
+- (id)addConnectObserverForInterfaceIndex:(uint32_t)interfaceIndex handler:(CDAWiFiConnectObserverHandler)handler;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes a connect observer that has not fired yet. Does nothing if it already fired.
+ */
+- (void)removeConnectObserver:(id)observer;
+
+/*!
+ * @method
+ *
+ * @param interfaceIndex
+ * The kernel index of the connecting interface.
+ *
+ * @param handler
+ * Invoked once, when the driver reports the port authorized, the connection attempt fails or the interface disconnects.
+ *
+ * @result
+ * An opaque observer, to pass to -[CDAWiFiEventEngine removeAuthorizationObserver:].
+ *
+ * @abstract
+ * Waits for the 4-way handshake of a WPA connection offloaded to the driver, whatever the enabled event types.
+ *
+ * @discussion
+ * The driver reports it with NL80211_CMD_PORT_AUTHORIZED, or with the NL80211_ATTR_PORT_AUTHORIZED flag
+ * of the connection event if the handshake completed first. Add the observer before requesting the connection.
+ */
+- (id)addAuthorizationObserverForInterfaceIndex:(uint32_t)interfaceIndex handler:(CDAWiFiAuthorizationObserverHandler)handler;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes an authorization observer that has not fired yet. Does nothing if it already fired.
+ */
+- (void)removeAuthorizationObserver:(id)observer;
+
+/*!
+ * @method
+ *
+ * @param interfaceIndex
+ * The kernel index of the observed interface.
+ *
+ * @param handler
+ * Invoked for every link change of the interface, until the observer is removed.
+ *
+ * @result
+ * An opaque observer, to pass to -[CDAWiFiEventEngine removeLinkObserver:].
+ *
+ * @abstract
+ * Observes the link of an interface, whatever the enabled event types.
+ */
+- (id)addLinkObserverForInterfaceIndex:(uint32_t)interfaceIndex handler:(CDAWiFiLinkObserverHandler)handler;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes a link observer. The handler may still be running on the event thread when this method returns.
+ */
+- (void)removeLinkObserver:(id)observer;
+
+/*!
+ * @method
+ *
+ * @param message
+ * An nl80211 multicast message.
+ *
+ * @abstract
+ * Demultiplexes an nl80211 message on the calling thread, as if the event thread had received it.
+ *
+ * @discussion
+ * Used by the event thread, and to replay recorded event streams. The engine does not need to be running.
+ */
+- (void)dispatchGenericMessage:(const struct nlmsghdr *)message;
+
+@end
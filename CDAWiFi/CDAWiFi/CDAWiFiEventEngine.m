@@ -0,0 +1,700 @@
+//
+//  CDAWiFiEventEngine.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/8/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiEventEngine.h"
+#import "CDAWiFiNetlink.h"
+#import "CDAWiFiUtilities.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <linux/rtnetlink.h>
+
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP 0x10000
+#endif
+
+/* Size of the rtnetlink receive buffer. */
+#define CDAWiFiEventEngineRouteBufferSize (16 * 1024)
+
+/* epoll tags of the watched descriptors. */
+enum {
+    CDAWiFiEventEngineSourceWake,
+    CDAWiFiEventEngineSourceGeneric,
+    CDAWiFiEventEngineSourceRoute
+};
+
+static inline uint32_t CDAWiFiEventTypeMask(CDAWiFiEventType type)
+{
+    return (type > CDAWiFiEventTypeNone && type < 32) ? (1u << type) : 0;
+}
+
+/*
+ * A pending scan or connection completion wait, or a link observation.
+ * The handler is a CDAWiFiScanObserverHandler, a CDAWiFiConnectObserverHandler, a CDAWiFiAuthorizationObserverHandler
+ * or a CDAWiFiLinkObserverHandler.
+ */
+@interface CDAWiFiEventObserver : OFObject
+{
+@public
+    uint32_t _interfaceIndex;
+    id _handler;
+}
+
+@end
+
+@implementation CDAWiFiEventObserver
+
+@end
+
+@implementation CDAWiFiEventEngine
+{
+    CDAWiFiEventEngineHandler _handler;
+    CDAWiFiEventEngineHandler _stateHandler;
+    _Atomic(uint32_t) _enabledEventTypes;
+    
+    /* Protects the lifecycle of the thread and the descriptors. */
+    OFMutex *_mutex;
+    OFThread *_thread;
+    _Atomic(bool) _stopping;
+    CDAWiFiNetlinkSocket *_genericSocket;
+    int _routeFileDescriptor;
+    int _epollFileDescriptor;
+    int _wakeFileDescriptor;
+    
+    OFMutex *_observersMutex;
+    OFMutableArray *_scanObservers;
+    OFMutableArray *_connectObservers;
+    OFMutableArray *_authorizationObservers;
+    OFMutableArray *_linkObservers;
+    
+    /* Last known flags of every network interface. Only used by the event thread. */
+    OFMutableDictionary *_interfaceFlags;
+    uint8_t *_routeBuffer;
+}
+
+#pragma mark - Initialization
+
+- (instancetype)initWithHandler:(CDAWiFiEventEngineHandler)handler
+{
+    return [self initWithHandler:handler stateHandler:nil];
+}
+
+- (instancetype)initWithHandler:(CDAWiFiEventEngineHandler)handler stateHandler:(CDAWiFiEventEngineHandler)stateHandler
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _handler = [handler copy];
+        _stateHandler = [stateHandler copy];
+        _mutex = [OFMutex mutex];
+        _observersMutex = [OFMutex mutex];
+        _scanObservers = [OFMutableArray array];
+        _connectObservers = [OFMutableArray array];
+        _authorizationObservers = [OFMutableArray array];
+        _linkObservers = [OFMutableArray array];
+        _interfaceFlags = [OFMutableDictionary dictionary];
+        _routeFileDescriptor = -1;
+        _epollFileDescriptor = -1;
+        _wakeFileDescriptor = -1;
+        
+        atomic_init(&_enabledEventTypes, 0);
+        atomic_init(&_stopping, false);
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    [self closeFileDescriptors];
+}
+
+- (void)closeFileDescriptors
+{
+    if (_routeFileDescriptor >= 0) {
+        close(_routeFileDescriptor);
+        _routeFileDescriptor = -1;
+    }
+    
+    if (_epollFileDescriptor >= 0) {
+        close(_epollFileDescriptor);
+        _epollFileDescriptor = -1;
+    }
+    
+    if (_wakeFileDescriptor >= 0) {
+        close(_wakeFileDescriptor);
+        _wakeFileDescriptor = -1;
+    }
+    
+    _genericSocket = nil;
+    
+    free(_routeBuffer);
+    _routeBuffer = NULL;
+}
+
+#pragma mark - Lifecycle
+
+- (BOOL)watchFileDescriptor:(int)fileDescriptor source:(uint32_t)source error:(out CDAError **)error
+{
+    struct epoll_event event = { .events = EPOLLIN, .data.u32 = source };
+    
+    if (epoll_ctl(_epollFileDescriptor, EPOLL_CTL_ADD, fileDescriptor, &event) != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errno);
+        }
+        
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (BOOL)openFileDescriptorsAndReturnError:(out CDAError **)error
+{
+    struct sockaddr_nl address;
+    
+    _genericSocket = [[CDAWiFiNetlinkSocket alloc] initAndReturnError:error];
+    
+    if (_genericSocket == nil) {
+        return NO;
+    }
+    
+    /* "mlme" and "scan" are required, "regulatory" and "config" are missing from old kernels. */
+    if (![_genericSocket addMembershipToMulticastGroupWithName:@"mlme" error:error] ||
+        ![_genericSocket addMembershipToMulticastGroupWithName:@"scan" error:error]) {
+        
+        return NO;
+    }
+    
+    [_genericSocket addMembershipToMulticastGroupWithName:@"regulatory" error:NULL];
+    [_genericSocket addMembershipToMulticastGroupWithName:@"config" error:NULL];
+    
+    _routeFileDescriptor = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    _epollFileDescriptor = epoll_create1(EPOLL_CLOEXEC);
+    _wakeFileDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    _routeBuffer = malloc(CDAWiFiEventEngineRouteBufferSize);
+    
+    if (_routeFileDescriptor < 0 || _epollFileDescriptor < 0 || _wakeFileDescriptor < 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errno);
+        }
+        
+        return NO;
+    }
+    
+    if (_routeBuffer == NULL) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiNoMemoryError);
+        }
+        
+        return NO;
+    }
+    
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = RTMGRP_LINK;
+    
+    if (bind(_routeFileDescriptor, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errno);
+        }
+        
+        return NO;
+    }
+    
+    return [self watchFileDescriptor:_wakeFileDescriptor source:CDAWiFiEventEngineSourceWake error:error] &&
+           [self watchFileDescriptor:_genericSocket.fileDescriptor source:CDAWiFiEventEngineSourceGeneric error:error] &&
+           [self watchFileDescriptor:_routeFileDescriptor source:CDAWiFiEventEngineSourceRoute error:error];
+}
+
+- (BOOL)startAndReturnError:(out CDAError **)error
+{
+    [_mutex lock];
+    
+    if (_thread != nil) {
+        
+        [_mutex unlock];
+        
+        return YES;
+    }
+    
+    if (![self openFileDescriptorsAndReturnError:error]) {
+        
+        [self closeFileDescriptors];
+        
+        [_mutex unlock];
+        
+        return NO;
+    }
+    
+    atomic_store(&_stopping, false);
+    
+    _thread = [OFThread threadWithThreadBlock:^id {
+        
+        [self run];
+        
+        return nil;
+    }];
+    
+    [_thread setName:@"CDAWiFi.events"];
+    [_thread start];
+    
+    [_mutex unlock];
+    
+    return YES;
+}
+
+- (void)stop
+{
+    [_mutex lock];
+    
+    if (_thread == nil) {
+        
+        [_mutex unlock];
+        
+        return;
+    }
+    
+    uint64_t wake = 1;
+    
+    atomic_store(&_stopping, true);
+    
+    write(_wakeFileDescriptor, &wake, sizeof(wake));
+    
+    [_thread join];
+    
+    _thread = nil;
+    
+    [self closeFileDescriptors];
+    
+    [_mutex unlock];
+}
+
+#pragma mark - Event Types
+
+- (void)enableEventType:(CDAWiFiEventType)type
+{
+    atomic_fetch_or(&_enabledEventTypes, CDAWiFiEventTypeMask(type));
+}
+
+- (void)disableEventType:(CDAWiFiEventType)type
+{
+    atomic_fetch_and(&_enabledEventTypes, ~CDAWiFiEventTypeMask(type));
+}
+
+- (void)disableAllEventTypes
+{
+    atomic_store(&_enabledEventTypes, 0);
+}
+
+- (BOOL)isEventTypeEnabled:(CDAWiFiEventType)type
+{
+    return (atomic_load_explicit(&_enabledEventTypes, memory_order_relaxed) & CDAWiFiEventTypeMask(type)) != 0;
+}
+
+#pragma mark - Observers
+
+- (id)addObserverToArray:(OFMutableArray *)observers interfaceIndex:(uint32_t)interfaceIndex handler:(id)handler
+{
+    CDAWiFiEventObserver *observer = [[CDAWiFiEventObserver alloc] init];
+    
+    observer->_interfaceIndex = interfaceIndex;
+    observer->_handler = [handler copy];
+    
+    [_observersMutex lock];
+    [observers addObject:observer];
+    [_observersMutex unlock];
+    
+    return observer;
+}
+
+- (void)removeObserver:(id)observer fromArray:(OFMutableArray *)observers
+{
+    [_observersMutex lock];
+    [observers removeObjectIdenticalTo:observer];
+    [_observersMutex unlock];
+}
+
+/* Returns the observers of an interface, so they fire outside of the lock. One-shot observers are removed. */
+- (OFArray *)observersFromArray:(OFMutableArray *)observers interfaceIndex:(uint32_t)interfaceIndex remove:(BOOL)remove
+{
+    OFMutableArray *matches = nil;
+    
+    [_observersMutex lock];
+    
+    for (size_t index = 0; index < observers.count; ) {
+        
+        CDAWiFiEventObserver *observer = observers[index];
+        
+        if (observer->_interfaceIndex != interfaceIndex) {
+            index++;
+            continue;
+        }
+        
+        if (matches == nil) {
+            matches = [OFMutableArray array];
+        }
+        
+        [matches addObject:observer];
+        
+        if (remove) {
+            [observers removeObjectAtIndex:index];
+        } else {
+            index++;
+        }
+    }
+    
+    [_observersMutex unlock];
+    
+    return matches;
+}
+
+- (id)addScanObserverForInterfaceIndex:(uint32_t)interfaceIndex handler:(CDAWiFiScanObserverHandler)handler
+{
+    return [self addObserverToArray:_scanObservers interfaceIndex:interfaceIndex handler:handler];
+}
+
+- (void)removeScanObserver:(id)observer
+{
+    [self removeObserver:observer fromArray:_scanObservers];
+}
+
+- (void)notifyScanObserversForInterfaceIndex:(uint32_t)interfaceIndex aborted:(BOOL)aborted
+{
+    for (CDAWiFiEventObserver *observer in [self observersFromArray:_scanObservers interfaceIndex:interfaceIndex remove:YES]) {
+        ((CDAWiFiScanObserverHandler)observer->_handler)(aborted);
+    }
+}
+
+- (id)addConnectObserverForInterfaceIndex:(uint32_t)interfaceIndex handler:(CDAWiFiConnectObserverHandler)handler
+{
+    return [self addObserverToArray:_connectObservers interfaceIndex:interfaceIndex handler:handler];
+}
+
+- (void)removeConnectObserver:(id)observer
+{
+    [self removeObserver:observer fromArray:_connectObservers];
+}
+
+- (void)notifyConnectObserversForInterfaceIndex:(uint32_t)interfaceIndex statusCode:(uint16_t)statusCode
+{
+    for (CDAWiFiEventObserver *observer in [self observersFromArray:_connectObservers interfaceIndex:interfaceIndex remove:YES]) {
+        ((CDAWiFiConnectObserverHandler)observer->_handler)(statusCode);
+    }
+}
+
+- (id)addAuthorizationObserverForInterfaceIndex:(uint32_t)interfaceIndex handler:(CDAWiFiAuthorizationObserverHandler)handler
+{
+    return [self addObserverToArray:_authorizationObservers interfaceIndex:interfaceIndex handler:handler];
+}
+
+- (void)removeAuthorizationObserver:(id)observer
+{
+    [self removeObserver:observer fromArray:_authorizationObservers];
+}
+
+- (void)notifyAuthorizationObserversForInterfaceIndex:(uint32_t)interfaceIndex authorized:(BOOL)authorized
+{
+    for (CDAWiFiEventObserver *observer in [self observersFromArray:_authorizationObservers interfaceIndex:interfaceIndex remove:YES]) {
+        ((CDAWiFiAuthorizationObserverHandler)observer->_handler)(authorized);
+    }
+}
+
+- (id)addLinkObserverForInterfaceIndex:(uint32_t)interfaceIndex handler:(CDAWiFiLinkObserverHandler)handler
+{
+    return [self addObserverToArray:_linkObservers interfaceIndex:interfaceIndex handler:handler];
+}
+
+- (void)removeLinkObserver:(id)observer
+{
+    [self removeObserver:observer fromArray:_linkObservers];
+}
+
+- (void)notifyLinkObserversForInterfaceIndex:(uint32_t)interfaceIndex type:(CDAWiFiEventType)type rssi:(int)rssi
+{
+    for (CDAWiFiEventObserver *observer in [self observersFromArray:_linkObservers interfaceIndex:interfaceIndex remove:NO]) {
+        ((CDAWiFiLinkObserverHandler)observer->_handler)(type, rssi);
+    }
+}
+
+#pragma mark - Event Thread
+
+- (void)deliverEventWithType:(CDAWiFiEventType)type interfaceIndex:(uint32_t)interfaceIndex
+{
+    /* The state is current by the time the handler runs. */
+    if (_stateHandler != nil && type != CDAWiFiEventTypeScanCacheUpdated) {
+        _stateHandler(type, interfaceIndex);
+    }
+    
+    if ([self isEventTypeEnabled:type]) {
+        _handler(type, interfaceIndex);
+    }
+}
+
+- (void)deliverLostEvents
+{
+    if (_stateHandler != nil) {
+        _stateHandler(CDAWiFiEventTypeNone, 0);
+    }
+    
+    _handler(CDAWiFiEventTypeNone, 0);
+}
+
+- (void)run
+{
+    struct epoll_event events[4];
+    
+    while (!atomic_load(&_stopping)) {
+        
+        int count = epoll_wait(_epollFileDescriptor, events, sizeof(events) / sizeof(events[0]), -1);
+        
+        if (count < 0) {
+            
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            CDALog(@"Wi-Fi event thread stopped: %d", errno);
+            
+            break;
+        }
+        
+        for (int index = 0; index < count; index++) {
+            
+            @autoreleasepool {
+                
+                switch (events[index].data.u32) {
+                    
+                    case CDAWiFiEventEngineSourceWake: {
+                        
+                        uint64_t value;
+                        
+                        read(_wakeFileDescriptor, &value, sizeof(value));
+                        
+                        break;
+                    }
+                    
+                    case CDAWiFiEventEngineSourceGeneric:
+                        [self receiveGenericMessages];
+                        break;
+                    
+                    case CDAWiFiEventEngineSourceRoute:
+                        [self receiveRouteMessages];
+                        break;
+                }
+            }
+        }
+    }
+}
+
+- (void)receiveGenericMessages
+{
+    uint16_t family = _genericSocket.nl80211FamilyID;
+    
+    BOOL success = [_genericSocket receiveEventsWithHandler:^(const struct nlmsghdr *message) {
+        
+        if (message->nlmsg_type != family) {
+            return;
+        }
+        
+        [self dispatchGenericMessage:message];
+        
+    } error:NULL];
+    
+    /* Events were dropped, clients must re-sync their state. */
+    if (!success) {
+        [self deliverLostEvents];
+    }
+}
+
+- (void)dispatchGenericMessage:(const struct nlmsghdr *)message
+{
+    const struct genlmsghdr *header = NLMSG_DATA(message);
+    const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+    uint32_t interfaceIndex = 0;
+    
+    CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+    
+    if (attributes[NL80211_ATTR_IFINDEX] != NULL) {
+        interfaceIndex = CDAWiFiNetlinkAttributeU32(attributes[NL80211_ATTR_IFINDEX]);
+    }
+    
+    switch (header->cmd) {
+        
+        case NL80211_CMD_CONNECT:
+        case NL80211_CMD_DISCONNECT:
+            
+            if (header->cmd == NL80211_CMD_CONNECT) {
+                
+                /* Connections that time out carry no status code. */
+                uint16_t statusCode = (attributes[NL80211_ATTR_STATUS_CODE] != NULL) ?
+                    CDAWiFiNetlinkAttributeU16(attributes[NL80211_ATTR_STATUS_CODE]) : CDAWiFiStatusCodeUnspecifiedFailure;
+                
+                [self notifyConnectObserversForInterfaceIndex:interfaceIndex statusCode:statusCode];
+                
+                /* Drivers that finish the handshake before reporting the connection flag it here instead. */
+                if (statusCode != 0 || attributes[NL80211_ATTR_PORT_AUTHORIZED] != NULL) {
+                    [self notifyAuthorizationObserversForInterfaceIndex:interfaceIndex authorized:(statusCode == 0)];
+                }
+                
+                if (statusCode == 0) {
+                    [self notifyLinkObserversForInterfaceIndex:interfaceIndex type:CDAWiFiEventTypeBSSIDDidChange rssi:0];
+                }
+                
+            } else {
+                
+                [self notifyConnectObserversForInterfaceIndex:interfaceIndex statusCode:CDAWiFiStatusCodeUnspecifiedFailure];
+                [self notifyAuthorizationObserversForInterfaceIndex:interfaceIndex authorized:NO];
+                [self notifyLinkObserversForInterfaceIndex:interfaceIndex type:CDAWiFiEventTypeLinkDidChange rssi:0];
+            }
+            
+            [self deliverEventWithType:CDAWiFiEventTypeSSIDDidChange interfaceIndex:interfaceIndex];
+            [self deliverEventWithType:CDAWiFiEventTypeBSSIDDidChange interfaceIndex:interfaceIndex];
+            [self deliverEventWithType:CDAWiFiEventTypeLinkDidChange interfaceIndex:interfaceIndex];
+            break;
+        
+        case NL80211_CMD_PORT_AUTHORIZED:
+            [self notifyAuthorizationObserversForInterfaceIndex:interfaceIndex authorized:YES];
+            break;
+        
+        case NL80211_CMD_ROAM:
+            
+            if (attributes[NL80211_ATTR_PORT_AUTHORIZED] != NULL) {
+                [self notifyAuthorizationObserversForInterfaceIndex:interfaceIndex authorized:YES];
+            }
+            
+            [self notifyLinkObserversForInterfaceIndex:interfaceIndex type:CDAWiFiEventTypeBSSIDDidChange rssi:0];
+            [self deliverEventWithType:CDAWiFiEventTypeBSSIDDidChange interfaceIndex:interfaceIndex];
+            break;
+        
+        case NL80211_CMD_NOTIFY_CQM:
+        {
+            int rssi = 0;
+            
+            /* The RSSI level is only reported by recent kernels. */
+            if (attributes[NL80211_ATTR_CQM] != NULL) {
+                
+                const struct nlattr *quality[NL80211_ATTR_CQM_MAX + 1];
+                
+                CDAWiFiNetlinkParseNested(quality, NL80211_ATTR_CQM_MAX, attributes[NL80211_ATTR_CQM]);
+                
+                if (quality[NL80211_ATTR_CQM_RSSI_LEVEL] != NULL) {
+                    rssi = (int32_t)CDAWiFiNetlinkAttributeU32(quality[NL80211_ATTR_CQM_RSSI_LEVEL]);
+                }
+            }
+            
+            [self notifyLinkObserversForInterfaceIndex:interfaceIndex type:CDAWiFiEventTypeLinkQualityDidChange rssi:rssi];
+            [self deliverEventWithType:CDAWiFiEventTypeLinkQualityDidChange interfaceIndex:interfaceIndex];
+            break;
+        }
+        
+        case NL80211_CMD_NEW_SCAN_RESULTS:
+            [self notifyScanObserversForInterfaceIndex:interfaceIndex aborted:NO];
+            [self deliverEventWithType:CDAWiFiEventTypeScanCacheUpdated interfaceIndex:interfaceIndex];
+            break;
+        
+        case NL80211_CMD_SCAN_ABORTED:
+            [self notifyScanObserversForInterfaceIndex:interfaceIndex aborted:YES];
+            break;
+        
+        case NL80211_CMD_REG_CHANGE:
+        case NL80211_CMD_WIPHY_REG_CHANGE:
+            [self deliverEventWithType:CDAWiFiEventTypeCountryCodeDidChange interfaceIndex:0];
+            break;
+        
+        case NL80211_CMD_NEW_INTERFACE:
+        case NL80211_CMD_SET_INTERFACE:
+        case NL80211_CMD_DEL_INTERFACE:
+            [self deliverEventWithType:CDAWiFiEventTypeModeDidChange interfaceIndex:interfaceIndex];
+            break;
+        
+        default:
+            break;
+    }
+}
+
+- (void)receiveRouteMessages
+{
+    for (;;) {
+        
+        ssize_t length = recv(_routeFileDescriptor, _routeBuffer, CDAWiFiEventEngineRouteBufferSize, 0);
+        
+        if (length < 0) {
+            
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            if (errno == ENOBUFS) {
+                
+                /* Flags seen from now on can not be compared with the lost ones. */
+                [_interfaceFlags removeAllObjects];
+                
+                [self deliverLostEvents];
+                
+                continue;
+            }
+            
+            break;
+        }
+        
+        for (const struct nlmsghdr *message = (const struct nlmsghdr *)_routeBuffer;
+             NLMSG_OK(message, length);
+             message = NLMSG_NEXT(message, length)) {
+            
+            if ((message->nlmsg_type == RTM_NEWLINK || message->nlmsg_type == RTM_DELLINK) &&
+                message->nlmsg_len >= NLMSG_LENGTH(sizeof(struct ifinfomsg))) {
+                
+                [self handleLinkMessage:message];
+            }
+        }
+    }
+}
+
+- (void)handleLinkMessage:(const struct nlmsghdr *)message
+{
+    const struct ifinfomsg *link = NLMSG_DATA(message);
+    OFNumber *key = [OFNumber numberWithInt:link->ifi_index];
+    OFNumber *previousFlags = _interfaceFlags[key];
+    
+    if (message->nlmsg_type == RTM_DELLINK) {
+        
+        [_interfaceFlags removeObjectForKey:key];
+        
+        return;
+    }
+    
+    _interfaceFlags[key] = [OFNumber numberWithUInt:link->ifi_flags];
+    
+    /*
+     * The kernel reports the flags a notification changed in ifi_change, but leaves it empty for some changes,
+     * so it is only relied on for the first message of an interface, with nothing to compare with.
+     */
+    unsigned int changedFlags = (previousFlags != nil) ? ([previousFlags uIntValue] ^ link->ifi_flags) : link->ifi_change;
+    
+    if (changedFlags & IFF_UP) {
+        [self deliverEventWithType:CDAWiFiEventTypePowerDidChange interfaceIndex:link->ifi_index];
+    }
+    
+    if (changedFlags & (IFF_RUNNING | IFF_LOWER_UP)) {
+        [self deliverEventWithType:CDAWiFiEventTypeLinkDidChange interfaceIndex:link->ifi_index];
+    }
+}
+
+@end
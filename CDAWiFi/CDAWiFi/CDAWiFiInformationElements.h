@@ -0,0 +1,262 @@
+//
+//  CDAWiFiInformationElements.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/3/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+/* Zero-copy access to IEEE 802.11 information elements. Not part of the public API. */
+
+/*!
+ * @typedef CDAWiFiInformationElement
+ *
+ * @abstract The information elements located by CDAWiFiInformationElementIndexBuild().
+ */
+typedef enum
+{
+    CDAWiFiInformationElementSSID                       = 0,
+    CDAWiFiInformationElementSupportedRates             = 1,
+    CDAWiFiInformationElementDSParameterSet             = 2,
+    CDAWiFiInformationElementCountry                    = 3,
+    CDAWiFiInformationElementHTCapabilities             = 4,
+    CDAWiFiInformationElementRSN                        = 5,
+    CDAWiFiInformationElementExtendedSupportedRates     = 6,
+    CDAWiFiInformationElementHTOperation                = 7,
+    CDAWiFiInformationElementVHTCapabilities            = 8,
+    CDAWiFiInformationElementVHTOperation               = 9,
+    CDAWiFiInformationElementWPA                        = 10,
+    
+    CDAWiFiInformationElementCount
+} CDAWiFiInformationElement;
+
+/*!
+ * @typedef CDAWiFiInformationElementIndex
+ *
+ * @abstract Offset table over a buffer of information elements.
+ *
+ * @discussion
+ * Records where the first occurrence of every CDAWiFiInformationElement starts in the buffer.
+ * Nothing is copied or decoded when the index is built; elements are decoded in place on demand.
+ */
+typedef struct CDAWiFiInformationElementIndex {
+    
+    /* One bit per CDAWiFiInformationElement. */
+    uint32_t present;
+    
+    /* Offset of the element ID octet, valid if the corresponding bit is set. */
+    uint16_t offsets[CDAWiFiInformationElementCount];
+    
+} CDAWiFiInformationElementIndex;
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Walks the information elements in a buffer once and records the offsets of the elements of interest.
+ *
+ * @discussion
+ * The walk stops at the first truncated element. Elements starting beyond 64 KB are ignored.
+ */
+extern void CDAWiFiInformationElementIndexBuild(CDAWiFiInformationElementIndex *index, const uint8_t *bytes, size_t length);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns a pointer to the body of an indexed element, or NULL if the element is not present.
+ *
+ * @discussion
+ * The returned pointer references the indexed buffer, which must outlive its use.
+ */
+static inline const uint8_t *CDAWiFiInformationElementIndexGet(const CDAWiFiInformationElementIndex *index,
+                                                               const uint8_t *bytes,
+                                                               CDAWiFiInformationElement element,
+                                                               size_t *length)
+{
+    const uint8_t *header;
+    
+    if (!(index->present & (1u << element))) {
+        return NULL;
+    }
+    
+    header = bytes + index->offsets[element];
+    *length = header[1];
+    
+    return header + 2;
+}
+
+/*! @functiongroup Indexing Batches */
+
+/*!
+ * @constant CDAWiFiInformationElementBatchPadding
+ *
+ * @abstract Number of readable bytes required after every element buffer of a batch.
+ *
+ * @discussion
+ * The AVX2 scanner loads element headers 4 bytes at a time and may read past the end of a buffer.
+ * Buffers appended to a CDAWiFiScanArena always have this many readable bytes after them.
+ */
+#define CDAWiFiInformationElementBatchPadding 4
+
+/*!
+ * @typedef CDAWiFiInformationElementScanner
+ *
+ * @abstract Implementations of CDAWiFiInformationElementIndexBuildBatch().
+ *
+ * @constant CDAWiFiInformationElementScannerScalar
+ * Walks one buffer at a time.
+ *
+ * @constant CDAWiFiInformationElementScannerAVX2
+ * Walks the element chains of 8 buffers at a time, using AVX2 gathers to load the element headers.
+ *
+ * @constant CDAWiFiInformationElementScannerSSE2
+ * Walks the element chains of 4 buffers at a time. SSE2 has no gathers, the headers are loaded lane by lane.
+ */
+typedef enum
+{
+    CDAWiFiInformationElementScannerScalar  = 0,
+    CDAWiFiInformationElementScannerAVX2    = 1,
+    CDAWiFiInformationElementScannerSSE2    = 2,
+} CDAWiFiInformationElementScanner;
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the fastest scanner supported by the CPU.
+ */
+extern CDAWiFiInformationElementScanner CDAWiFiInformationElementScannerBest(void);
+
+/*!
+ * @function
+ *
+ * @param indexes
+ * A C array of count indexes, filled upon return.
+ *
+ * @param elements
+ * A C array of count pointers to the information elements of each BSS, each followed by
+ * CDAWiFiInformationElementBatchPadding readable bytes. The elements are indexed in place, never copied.
+ *
+ * @param lengths
+ * A C array of count lengths of the information elements of each BSS.
+ *
+ * @abstract
+ * Builds the information element indexes of a whole batch of BSSes in one pass, with the fastest scanner available.
+ *
+ * @discussion
+ * Produces exactly the same indexes as calling CDAWiFiInformationElementIndexBuild() for every BSS.
+ */
+extern void CDAWiFiInformationElementIndexBuildBatch(CDAWiFiInformationElementIndex *indexes,
+                                                     const uint8_t *const *elements,
+                                                     const uint32_t *lengths,
+                                                     size_t count);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Same as CDAWiFiInformationElementIndexBuildBatch(), with an explicit scanner. Used for benchmarking.
+ *
+ * @discussion
+ * Falls back to the scalar scanner if the requested one is not supported by the CPU.
+ */
+extern void CDAWiFiInformationElementIndexBuildBatchWithScanner(CDAWiFiInformationElementIndex *indexes,
+                                                                const uint8_t *const *elements,
+                                                                const uint32_t *lengths,
+                                                                size_t count,
+                                                                CDAWiFiInformationElementScanner scanner);
+
+/*! @functiongroup Decoding Elements */
+
+/*!
+ * @typedef CDAWiFiAuthenticationKeyManagement
+ *
+ * @abstract Authentication and key management (AKM) suites advertised in an RSN or WPA element.
+ */
+typedef enum
+{
+    CDAWiFiAuthenticationKeyManagementNone      = 0,
+    CDAWiFiAuthenticationKeyManagement8021X     = (1UL << 0),
+    CDAWiFiAuthenticationKeyManagementPSK       = (1UL << 1),
+    CDAWiFiAuthenticationKeyManagementSAE       = (1UL << 2),
+    CDAWiFiAuthenticationKeyManagementFT        = (1UL << 3),
+    CDAWiFiAuthenticationKeyManagementOther     = (1UL << 4),
+} CDAWiFiAuthenticationKeyManagement;
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Decodes the AKM suites of an RSN element body (isWPA NO) or of a WPA vendor element body (isWPA YES).
+ *
+ * @discussion
+ * Fields omitted at the end of the element take their default values (IEEE 802.11-2012, 8.4.2.27),
+ * so an element without an AKM suite list advertises 802.1X.
+ */
+extern CDAWiFiAuthenticationKeyManagement CDAWiFiInformationElementAuthenticationKeyManagement(const uint8_t *body, size_t length, BOOL isWPA);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns YES if a Supported Rates or Extended Supported Rates element body contains a DSSS/CCK (802.11b) rate.
+ */
+extern BOOL CDAWiFiInformationElementRatesContainCCK(const uint8_t *body, size_t length);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns YES if a Supported Rates or Extended Supported Rates element body contains an OFDM (802.11a/g) rate.
+ */
+extern BOOL CDAWiFiInformationElementRatesContainOFDM(const uint8_t *body, size_t length);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the operating channel width advertised by the HT and VHT Operation elements of an index.
+ */
+extern CDAWiFiChannelWidth CDAWiFiInformationElementIndexChannelWidth(const CDAWiFiInformationElementIndex *index, const uint8_t *bytes);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns YES if the RSN and WPA elements of an index (or the lack of them) advertise a security type.
+ *
+ * @param privacy
+ * Whether the privacy bit of the capability information field is set.
+ *
+ * @param security
+ * The security type to test.
+ */
+extern BOOL CDAWiFiInformationElementIndexSupportsSecurity(const CDAWiFiInformationElementIndex *index,
+                                                           const uint8_t *bytes,
+                                                           BOOL privacy,
+                                                           CDAWiFiSecurity security);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the strongest security type advertised by the RSN and WPA elements of an index.
+ */
+extern CDAWiFiSecurity CDAWiFiInformationElementIndexSecurity(const CDAWiFiInformationElementIndex *index,
+                                                              const uint8_t *bytes,
+                                                              BOOL privacy);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns YES if the elements of an index advertise support for a PHY mode in the band of the BSS.
+ */
+extern BOOL CDAWiFiInformationElementIndexSupportsPHYMode(const CDAWiFiInformationElementIndex *index,
+                                                         const uint8_t *bytes,
+                                                         CDAWiFiChannelBand band,
+                                                         CDAWiFiPHYMode phyMode);
@@ -0,0 +1,671 @@
+//
+//  CDAWiFiInformationElements.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/3/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiInformationElements.h"
+#include <dispatch/dispatch.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CDAWiFiInformationElementsSSE2 1
+#define CDAWiFiInformationElementsAVX2 1
+#include <immintrin.h>
+#endif
+
+/* Element IDs (IEEE 802.11-2012, 8.4.2.1) */
+enum {
+    CDAWiFiElementIDSSID                    = 0,
+    CDAWiFiElementIDSupportedRates          = 1,
+    CDAWiFiElementIDDSParameterSet          = 3,
+    CDAWiFiElementIDCountry                 = 7,
+    CDAWiFiElementIDHTCapabilities          = 45,
+    CDAWiFiElementIDRSN                     = 48,
+    CDAWiFiElementIDExtendedSupportedRates  = 50,
+    CDAWiFiElementIDHTOperation             = 61,
+    CDAWiFiElementIDVHTCapabilities         = 191,
+    CDAWiFiElementIDVHTOperation            = 192,
+    CDAWiFiElementIDVendorSpecific          = 221,
+};
+
+/* Maps element IDs to CDAWiFiInformationElement values, -1 for elements that are not indexed. */
+static const int8_t CDAWiFiInformationElementForID[256] = {
+    [0 ... 255]                                 = -1,
+    [CDAWiFiElementIDSSID]                      = CDAWiFiInformationElementSSID,
+    [CDAWiFiElementIDSupportedRates]            = CDAWiFiInformationElementSupportedRates,
+    [CDAWiFiElementIDDSParameterSet]            = CDAWiFiInformationElementDSParameterSet,
+    [CDAWiFiElementIDCountry]                   = CDAWiFiInformationElementCountry,
+    [CDAWiFiElementIDHTCapabilities]            = CDAWiFiInformationElementHTCapabilities,
+    [CDAWiFiElementIDRSN]                       = CDAWiFiInformationElementRSN,
+    [CDAWiFiElementIDExtendedSupportedRates]    = CDAWiFiInformationElementExtendedSupportedRates,
+    [CDAWiFiElementIDHTOperation]               = CDAWiFiInformationElementHTOperation,
+    [CDAWiFiElementIDVHTCapabilities]           = CDAWiFiInformationElementVHTCapabilities,
+    [CDAWiFiElementIDVHTOperation]              = CDAWiFiInformationElementVHTOperation,
+};
+
+static const uint8_t CDAWiFiRSNSuiteOUI[3] = { 0x00, 0x0F, 0xAC };
+static const uint8_t CDAWiFiWPASuiteOUI[3] = { 0x00, 0x50, 0xF2 };
+
+#pragma mark - Index
+
+/* Records the first occurrence of an element found at an offset of a buffer. */
+static inline void CDAWiFiInformationElementIndexAdd(CDAWiFiInformationElementIndex *index, const uint8_t *header, uint32_t offset)
+{
+    int element = CDAWiFiInformationElementForID[header[0]];
+    
+    /* The WPA element is the vendor specific element with the Microsoft OUI and type 1. */
+    if (header[0] == CDAWiFiElementIDVendorSpecific && header[1] >= 4 && memcmp(header + 2, CDAWiFiWPASuiteOUI, 3) == 0 && header[5] == 1) {
+        element = CDAWiFiInformationElementWPA;
+    }
+    
+    if (element >= 0 && !(index->present & (1u << element))) {
+        index->present |= (1u << element);
+        index->offsets[element] = (uint16_t)offset;
+    }
+}
+
+void CDAWiFiInformationElementIndexBuild(CDAWiFiInformationElementIndex *index, const uint8_t *bytes, size_t length)
+{
+    size_t offset = 0;
+    
+    index->present = 0;
+    
+    while (offset + 2 <= length && offset <= UINT16_MAX) {
+        
+        if (offset + 2 + bytes[offset + 1] > length) {
+            break;
+        }
+        
+        CDAWiFiInformationElementIndexAdd(index, bytes + offset, (uint32_t)offset);
+        
+        offset += 2 + bytes[offset + 1];
+    }
+}
+
+#pragma mark - Batches
+
+static void CDAWiFiInformationElementIndexBuildBatchScalar(CDAWiFiInformationElementIndex *indexes,
+                                                           const uint8_t *const *elements,
+                                                           const uint32_t *lengths,
+                                                           size_t count)
+{
+    for (size_t index = 0; index < count; index++) {
+        CDAWiFiInformationElementIndexBuild(&indexes[index], elements[index], lengths[index]);
+    }
+}
+
+#if CDAWiFiInformationElementsSSE2
+
+/*
+ * Walks the element chains of 4 BSSes in lock step. SSE2 has no gathers, so the element headers are loaded one lane
+ * at a time, but the 4 independent chains overlap their load latencies, and the bounds of every lane are checked at once.
+ */
+__attribute__((target("sse2")))
+static void CDAWiFiInformationElementIndexBuildBatchSSE2(CDAWiFiInformationElementIndex *indexes,
+                                                         const uint8_t *const *elements,
+                                                         const uint32_t *lengths,
+                                                         size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    size_t group = 0;
+    
+    for (; group + 4 <= count; group += 4) {
+        
+        const uint8_t *const *buffers = elements + group;
+        __m128i end = _mm_loadu_si128((const __m128i *)(lengths + group));
+        __m128i tooLong = _mm_srli_epi32(end, 16);
+        
+        /* Offsets in the index are 16 bits wide, leave the rare oversized buffers to the scalar walk. */
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(tooLong, zero)) != 0xFFFF) {
+            CDAWiFiInformationElementIndexBuildBatchScalar(indexes + group, buffers, lengths + group, 4);
+            continue;
+        }
+        
+        __m128i cursor = zero;
+        
+        for (int lane = 0; lane < 4; lane++) {
+            indexes[group + lane].present = 0;
+        }
+        
+        for (;;) {
+            
+            /* At least an element header left. */
+            __m128i active = _mm_cmpgt_epi32(_mm_sub_epi32(end, cursor), one);
+            int activeLanes = _mm_movemask_ps(_mm_castsi128_ps(active));
+            
+            if (activeLanes == 0) {
+                break;
+            }
+            
+            uint32_t laneCursors[4];
+            uint32_t laneLengths[4] = { 0, 0, 0, 0 };
+            
+            _mm_storeu_si128((__m128i *)laneCursors, cursor);
+            
+            for (int lane = 0; lane < 4; lane++) {
+                
+                if (activeLanes & (1 << lane)) {
+                    laneLengths[lane] = buffers[lane][laneCursors[lane] + 1];
+                }
+            }
+            
+            __m128i next = _mm_add_epi32(_mm_add_epi32(cursor, two), _mm_loadu_si128((const __m128i *)laneLengths));
+            __m128i fits = _mm_andnot_si128(_mm_cmpgt_epi32(next, end), active);
+            int fittingLanes = _mm_movemask_ps(_mm_castsi128_ps(fits));
+            
+            for (int lane = 0; lane < 4; lane++) {
+                
+                if (fittingLanes & (1 << lane)) {
+                    CDAWiFiInformationElementIndexAdd(&indexes[group + lane], buffers[lane] + laneCursors[lane], laneCursors[lane]);
+                }
+            }
+            
+            /* Lanes whose chain ended or is truncated are parked at the end of their buffer. */
+            cursor = _mm_or_si128(_mm_and_si128(fits, next), _mm_andnot_si128(fits, end));
+        }
+    }
+    
+    CDAWiFiInformationElementIndexBuildBatchScalar(indexes + group, elements + group, lengths + group, count - group);
+}
+
+#endif
+
+#if CDAWiFiInformationElementsAVX2
+
+/* CDAWiFiInformationElementForID widened to 32 bits, for gathers. */
+static const int32_t CDAWiFiInformationElementForID32[256] = {
+    [0 ... 255]                                 = -1,
+    [CDAWiFiElementIDSSID]                      = CDAWiFiInformationElementSSID,
+    [CDAWiFiElementIDSupportedRates]            = CDAWiFiInformationElementSupportedRates,
+    [CDAWiFiElementIDDSParameterSet]            = CDAWiFiInformationElementDSParameterSet,
+    [CDAWiFiElementIDCountry]                   = CDAWiFiInformationElementCountry,
+    [CDAWiFiElementIDHTCapabilities]            = CDAWiFiInformationElementHTCapabilities,
+    [CDAWiFiElementIDRSN]                       = CDAWiFiInformationElementRSN,
+    [CDAWiFiElementIDExtendedSupportedRates]    = CDAWiFiInformationElementExtendedSupportedRates,
+    [CDAWiFiElementIDHTOperation]               = CDAWiFiInformationElementHTOperation,
+    [CDAWiFiElementIDVHTCapabilities]           = CDAWiFiInformationElementVHTCapabilities,
+    [CDAWiFiElementIDVHTOperation]              = CDAWiFiInformationElementVHTOperation,
+};
+
+/*
+ * Walks the element chains of 8 BSSes in lock step, one element per lane and iteration.
+ * Lanes whose chain ended (or is truncated) are parked at the end of their buffer and masked out of the gathers.
+ * The buffers are addressed by 32 bit offsets from the lowest of them, groups spread over more than 2 GB are
+ * left to the scalar walk.
+ */
+__attribute__((target("avx2")))
+static void CDAWiFiInformationElementIndexBuildBatchAVX2(CDAWiFiInformationElementIndex *indexes,
+                                                         const uint8_t *const *elements,
+                                                         const uint32_t *lengths,
+                                                         size_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i minusOne = _mm256_set1_epi32(-1);
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i vendorSpecificID = _mm256_set1_epi32(CDAWiFiElementIDVendorSpecific);
+    const __m256i wpaSignature = _mm256_set1_epi32(0x01F25000); /* 00:50:F2, type 1 */
+    const __m256i wpaElement = _mm256_set1_epi32(CDAWiFiInformationElementWPA);
+    size_t group = 0;
+    
+    for (; group + 8 <= count; group += 8) {
+        
+        const uint8_t *base = elements[group];
+        const uint8_t *limit = elements[group] + lengths[group];
+        uint32_t offsets[8];
+        
+        for (int lane = 1; lane < 8; lane++) {
+            base = OF_MIN(base, elements[group + lane]);
+            limit = OF_MAX(limit, elements[group + lane] + lengths[group + lane]);
+        }
+        
+        if ((uintptr_t)(limit - base) > INT32_MAX) {
+            CDAWiFiInformationElementIndexBuildBatchScalar(indexes + group, elements + group, lengths + group, 8);
+            continue;
+        }
+        
+        for (int lane = 0; lane < 8; lane++) {
+            offsets[lane] = (uint32_t)(elements[group + lane] - base);
+        }
+        
+        __m256i start = _mm256_loadu_si256((const __m256i *)offsets);
+        __m256i length = _mm256_loadu_si256((const __m256i *)(lengths + group));
+        __m256i tooLong = _mm256_srli_epi32(length, 16);
+        
+        /* Offsets in the index are 16 bits wide, leave the rare oversized buffers to the scalar walk. */
+        if (!_mm256_testz_si256(tooLong, tooLong)) {
+            CDAWiFiInformationElementIndexBuildBatchScalar(indexes + group, elements + group, lengths + group, 8);
+            continue;
+        }
+        
+        __m256i end = _mm256_add_epi32(start, length);
+        __m256i cursor = start;
+        __m256i present = zero;
+        
+        for (;;) {
+            
+            /* At least an element header left. */
+            __m256i active = _mm256_cmpgt_epi32(_mm256_sub_epi32(end, cursor), one);
+            
+            if (_mm256_testz_si256(active, active)) {
+                break;
+            }
+            
+            __m256i header = _mm256_mask_i32gather_epi32(zero, (const int *)base, cursor, active, 1);
+            __m256i identifier = _mm256_and_si256(header, byteMask);
+            __m256i elementLength = _mm256_and_si256(_mm256_srli_epi32(header, 8), byteMask);
+            __m256i next = _mm256_add_epi32(_mm256_add_epi32(cursor, two), elementLength);
+            __m256i fits = _mm256_andnot_si256(_mm256_cmpgt_epi32(next, end), active);
+            __m256i element = _mm256_mask_i32gather_epi32(minusOne, CDAWiFiInformationElementForID32, identifier, fits, 4);
+            
+            __m256i vendorSpecific = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi32(identifier, vendorSpecificID),
+                                                                       _mm256_cmpgt_epi32(elementLength, three)),
+                                                      fits);
+            
+            if (!_mm256_testz_si256(vendorSpecific, vendorSpecific)) {
+                
+                __m256i signature = _mm256_mask_i32gather_epi32(zero, (const int *)base, _mm256_add_epi32(cursor, two), vendorSpecific, 1);
+                __m256i wpa = _mm256_and_si256(vendorSpecific, _mm256_cmpeq_epi32(signature, wpaSignature));
+                
+                element = _mm256_blendv_epi8(element, wpaElement, wpa);
+            }
+            
+            /* Shifting by -1 (not indexed) yields 0. Only the first occurrence of an element is recorded. */
+            __m256i newElements = _mm256_andnot_si256(present, _mm256_sllv_epi32(one, element));
+            int newLanes = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(newElements, zero)));
+            
+            present = _mm256_or_si256(present, newElements);
+            
+            if (newLanes != 0) {
+                
+                uint32_t laneOffsets[8];
+                int32_t laneElements[8];
+                
+                _mm256_storeu_si256((__m256i *)laneOffsets, _mm256_sub_epi32(cursor, start));
+                _mm256_storeu_si256((__m256i *)laneElements, element);
+                
+                while (newLanes != 0) {
+                    
+                    int lane = __builtin_ctz(newLanes);
+                    
+                    indexes[group + lane].offsets[laneElements[lane]] = (uint16_t)laneOffsets[lane];
+                    
+                    newLanes &= newLanes - 1;
+                }
+            }
+            
+            cursor = _mm256_blendv_epi8(end, next, fits);
+        }
+        
+        uint32_t lanePresent[8];
+        
+        _mm256_storeu_si256((__m256i *)lanePresent, present);
+        
+        for (int lane = 0; lane < 8; lane++) {
+            indexes[group + lane].present = lanePresent[lane];
+        }
+    }
+    
+    CDAWiFiInformationElementIndexBuildBatchScalar(indexes + group, elements + group, lengths + group, count - group);
+}
+
+#endif
+
+CDAWiFiInformationElementScanner CDAWiFiInformationElementScannerBest(void)
+{
+#if CDAWiFiInformationElementsAVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return CDAWiFiInformationElementScannerAVX2;
+    }
+#endif
+    
+#if CDAWiFiInformationElementsSSE2
+    if (__builtin_cpu_supports("sse2")) {
+        return CDAWiFiInformationElementScannerSSE2;
+    }
+#endif
+    
+    return CDAWiFiInformationElementScannerScalar;
+}
+
+void CDAWiFiInformationElementIndexBuildBatchWithScanner(CDAWiFiInformationElementIndex *indexes,
+                                                         const uint8_t *const *elements,
+                                                         const uint32_t *lengths,
+                                                         size_t count,
+                                                         CDAWiFiInformationElementScanner scanner)
+{
+#if CDAWiFiInformationElementsAVX2
+    if (scanner == CDAWiFiInformationElementScannerAVX2 && __builtin_cpu_supports("avx2")) {
+        CDAWiFiInformationElementIndexBuildBatchAVX2(indexes, elements, lengths, count);
+        return;
+    }
+#endif
+    
+#if CDAWiFiInformationElementsSSE2
+    if (scanner == CDAWiFiInformationElementScannerSSE2 && __builtin_cpu_supports("sse2")) {
+        CDAWiFiInformationElementIndexBuildBatchSSE2(indexes, elements, lengths, count);
+        return;
+    }
+#endif
+    
+    CDAWiFiInformationElementIndexBuildBatchScalar(indexes, elements, lengths, count);
+}
+
+void CDAWiFiInformationElementIndexBuildBatch(CDAWiFiInformationElementIndex *indexes,
+                                              const uint8_t *const *elements,
+                                              const uint32_t *lengths,
+                                              size_t count)
+{
+    /* Scans of several interfaces may build their indexes at the same time. */
+    static CDAWiFiInformationElementScanner scanner;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        scanner = CDAWiFiInformationElementScannerBest();
+    });
+    
+    CDAWiFiInformationElementIndexBuildBatchWithScanner(indexes, elements, lengths, count, scanner);
+}
+
+#pragma mark - Decoding
+
+CDAWiFiAuthenticationKeyManagement CDAWiFiInformationElementAuthenticationKeyManagement(const uint8_t *body, size_t length, BOOL isWPA)
+{
+    const uint8_t *suiteOUI = isWPA ? CDAWiFiWPASuiteOUI : CDAWiFiRSNSuiteOUI;
+    CDAWiFiAuthenticationKeyManagement keyManagement = CDAWiFiAuthenticationKeyManagementNone;
+    size_t offset = 0;
+    uint16_t count;
+    
+    /* The WPA element body starts with the OUI and the OUI type. */
+    if (isWPA) {
+        offset += 4;
+    }
+    
+    /* Version and group data cipher suite. */
+    offset += 2 + 4;
+    
+    /* Pairwise cipher suite list. */
+    if (offset + 2 > length) {
+        return CDAWiFiAuthenticationKeyManagement8021X;
+    }
+    
+    count = body[offset] | (body[offset + 1] << 8);
+    offset += 2 + (size_t)count * 4;
+    
+    /* AKM suite list. */
+    if (offset + 2 > length) {
+        return CDAWiFiAuthenticationKeyManagement8021X;
+    }
+    
+    count = body[offset] | (body[offset + 1] << 8);
+    offset += 2;
+    
+    for (uint16_t suite = 0; suite < count && offset + 4 <= length; suite++, offset += 4) {
+        
+        const uint8_t *selector = body + offset;
+        
+        if (memcmp(selector, suiteOUI, 3) != 0) {
+            keyManagement |= CDAWiFiAuthenticationKeyManagementOther;
+            continue;
+        }
+        
+        switch (selector[3]) {
+            case 1:     /* 802.1X */
+            case 5:     /* 802.1X SHA-256 */
+            case 11:    /* Suite B */
+            case 12:    /* Suite B 192-bit */
+                keyManagement |= CDAWiFiAuthenticationKeyManagement8021X;
+                break;
+                
+            case 2:     /* PSK */
+            case 6:     /* PSK SHA-256 */
+                keyManagement |= CDAWiFiAuthenticationKeyManagementPSK;
+                break;
+                
+            case 3:     /* FT over 802.1X */
+            case 13:    /* FT over 802.1X SHA-384 */
+                keyManagement |= (isWPA ? CDAWiFiAuthenticationKeyManagementOther :
+                                  CDAWiFiAuthenticationKeyManagement8021X | CDAWiFiAuthenticationKeyManagementFT);
+                break;
+                
+            case 4:     /* FT using PSK */
+                keyManagement |= (isWPA ? CDAWiFiAuthenticationKeyManagementOther :
+                                  CDAWiFiAuthenticationKeyManagementPSK | CDAWiFiAuthenticationKeyManagementFT);
+                break;
+                
+            case 8:     /* SAE */
+            case 9:     /* FT over SAE */
+                keyManagement |= (isWPA ? CDAWiFiAuthenticationKeyManagementOther : CDAWiFiAuthenticationKeyManagementSAE);
+                break;
+                
+            default:
+                keyManagement |= CDAWiFiAuthenticationKeyManagementOther;
+                break;
+        }
+    }
+    
+    return keyManagement;
+}
+
+BOOL CDAWiFiInformationElementRatesContainCCK(const uint8_t *body, size_t length)
+{
+    for (size_t index = 0; index < length; index++) {
+        
+        /* Rates are in units of 500 kbit/s, the high bit flags basic rates. */
+        switch (body[index] & 0x7F) {
+            case 2:     /* 1 Mbit/s */
+            case 4:     /* 2 Mbit/s */
+            case 11:    /* 5.5 Mbit/s */
+            case 22:    /* 11 Mbit/s */
+                return YES;
+        }
+    }
+    
+    return NO;
+}
+
+BOOL CDAWiFiInformationElementRatesContainOFDM(const uint8_t *body, size_t length)
+{
+    for (size_t index = 0; index < length; index++) {
+        
+        switch (body[index] & 0x7F) {
+            case 12:    /* 6 Mbit/s */
+            case 18:    /* 9 Mbit/s */
+            case 24:    /* 12 Mbit/s */
+            case 36:    /* 18 Mbit/s */
+            case 48:    /* 24 Mbit/s */
+            case 72:    /* 36 Mbit/s */
+            case 96:    /* 48 Mbit/s */
+            case 108:   /* 54 Mbit/s */
+                return YES;
+        }
+    }
+    
+    return NO;
+}
+
+CDAWiFiChannelWidth CDAWiFiInformationElementIndexChannelWidth(const CDAWiFiInformationElementIndex *index, const uint8_t *bytes)
+{
+    const uint8_t *body;
+    size_t length;
+    
+    body = CDAWiFiInformationElementIndexGet(index, bytes, CDAWiFiInformationElementVHTOperation, &length);
+    
+    if (body != NULL && length >= 3) {
+        
+        switch (body[0]) {
+            case 1:
+                /* 80 MHz, or 160/80+80 MHz when the second center frequency segment is set. */
+                return (body[2] != 0) ? CDAWiFiChannelWidth160MHz : CDAWiFiChannelWidth80MHz;
+                
+            case 2:
+            case 3:
+                return CDAWiFiChannelWidth160MHz;
+        }
+    }
+    
+    body = CDAWiFiInformationElementIndexGet(index, bytes, CDAWiFiInformationElementHTOperation, &length);
+    
+    if (body != NULL && length >= 2) {
+        
+        /* Secondary channel offset and STA channel width. */
+        if ((body[1] & 0x03) != 0 && (body[1] & 0x04) != 0) {
+            return CDAWiFiChannelWidth40MHz;
+        }
+    }
+    
+    return CDAWiFiChannelWidth20MHz;
+}
+
+/* Returns the AKM suites advertised by the RSN and WPA elements. */
+static void CDAWiFiInformationElementIndexKeyManagement(const CDAWiFiInformationElementIndex *index,
+                                                        const uint8_t *bytes,
+                                                        CDAWiFiAuthenticationKeyManagement *rsn,
+                                                        CDAWiFiAuthenticationKeyManagement *wpa)
+{
+    const uint8_t *body;
+    size_t length;
+    
+    body = CDAWiFiInformationElementIndexGet(index, bytes, CDAWiFiInformationElementRSN, &length);
+    *rsn = (body != NULL) ? CDAWiFiInformationElementAuthenticationKeyManagement(body, length, NO) : CDAWiFiAuthenticationKeyManagementNone;
+    
+    body = CDAWiFiInformationElementIndexGet(index, bytes, CDAWiFiInformationElementWPA, &length);
+    *wpa = (body != NULL) ? CDAWiFiInformationElementAuthenticationKeyManagement(body, length, YES) : CDAWiFiAuthenticationKeyManagementNone;
+}
+
+BOOL CDAWiFiInformationElementIndexSupportsSecurity(const CDAWiFiInformationElementIndex *index,
+                                                    const uint8_t *bytes,
+                                                    BOOL privacy,
+                                                    CDAWiFiSecurity security)
+{
+    CDAWiFiAuthenticationKeyManagement rsn, wpa;
+    
+    CDAWiFiInformationElementIndexKeyManagement(index, bytes, &rsn, &wpa);
+    
+    BOOL rsnPersonal = (rsn & (CDAWiFiAuthenticationKeyManagementPSK | CDAWiFiAuthenticationKeyManagementSAE)) != 0;
+    BOOL wpaPersonal = (wpa & CDAWiFiAuthenticationKeyManagementPSK) != 0;
+    BOOL rsnEnterprise = (rsn & CDAWiFiAuthenticationKeyManagement8021X) != 0;
+    BOOL wpaEnterprise = (wpa & CDAWiFiAuthenticationKeyManagement8021X) != 0;
+    BOOL robust = (index->present & ((1u << CDAWiFiInformationElementRSN) | (1u << CDAWiFiInformationElementWPA))) != 0;
+    
+    switch (security) {
+        case CDAWiFiSecurityNone:
+            return !privacy && !robust;
+            
+        case CDAWiFiSecurityWEP:
+            return privacy && !robust;
+            
+        case CDAWiFiSecurityWPAPersonal:
+            return wpaPersonal;
+            
+        case CDAWiFiSecurityWPAPersonalMixed:
+            return wpaPersonal && rsnPersonal;
+            
+        case CDAWiFiSecurityWPA2Personal:
+            return rsnPersonal;
+            
+        case CDAWiFiSecurityPersonal:
+            return wpaPersonal || rsnPersonal;
+            
+        case CDAWiFiSecurityWPAEnterprise:
+            return wpaEnterprise;
+            
+        case CDAWiFiSecurityWPAEnterpriseMixed:
+            return wpaEnterprise && rsnEnterprise;
+            
+        case CDAWiFiSecurityWPA2Enterprise:
+            return rsnEnterprise;
+            
+        case CDAWiFiSecurityEnterprise:
+            return wpaEnterprise || rsnEnterprise;
+            
+        /* Dynamic WEP is indistinguishable from static WEP in beacons and probe responses. */
+        case CDAWiFiSecurityDynamicWEP:
+        default:
+            return NO;
+    }
+}
+
+CDAWiFiSecurity CDAWiFiInformationElementIndexSecurity(const CDAWiFiInformationElementIndex *index,
+                                                       const uint8_t *bytes,
+                                                       BOOL privacy)
+{
+    CDAWiFiAuthenticationKeyManagement rsn, wpa;
+    
+    CDAWiFiInformationElementIndexKeyManagement(index, bytes, &rsn, &wpa);
+    
+    if (rsn & CDAWiFiAuthenticationKeyManagement8021X) {
+        return (wpa & CDAWiFiAuthenticationKeyManagement8021X) ? CDAWiFiSecurityWPAEnterpriseMixed : CDAWiFiSecurityWPA2Enterprise;
+    }
+    
+    if (rsn & (CDAWiFiAuthenticationKeyManagementPSK | CDAWiFiAuthenticationKeyManagementSAE)) {
+        return (wpa & CDAWiFiAuthenticationKeyManagementPSK) ? CDAWiFiSecurityWPAPersonalMixed : CDAWiFiSecurityWPA2Personal;
+    }
+    
+    if (wpa & CDAWiFiAuthenticationKeyManagement8021X) {
+        return CDAWiFiSecurityWPAEnterprise;
+    }
+    
+    if (wpa & CDAWiFiAuthenticationKeyManagementPSK) {
+        return CDAWiFiSecurityWPAPersonal;
+    }
+    
+    if (index->present & ((1u << CDAWiFiInformationElementRSN) | (1u << CDAWiFiInformationElementWPA))) {
+        return CDAWiFiSecurityUnknown;
+    }
+    
+    return privacy ? CDAWiFiSecurityWEP : CDAWiFiSecurityNone;
+}
+
+BOOL CDAWiFiInformationElementIndexSupportsPHYMode(const CDAWiFiInformationElementIndex *index,
+                                                  const uint8_t *bytes,
+                                                  CDAWiFiChannelBand band,
+                                                  CDAWiFiPHYMode phyMode)
+{
+    const uint8_t *body;
+    size_t length;
+    BOOL cck = NO, ofdm = NO;
+    
+    switch (phyMode) {
+        case CDAWiFiPHYMode11ac:
+            return (index->present & (1u << CDAWiFiInformationElementVHTCapabilities)) != 0;
+            
+        case CDAWiFiPHYMode11n:
+            return (index->present & (1u << CDAWiFiInformationElementHTCapabilities)) != 0;
+            
+        case CDAWiFiPHYMode11a:
+            return band == CDAWiFiChannelBand5GHz;
+            
+        case CDAWiFiPHYMode11b:
+        case CDAWiFiPHYMode11g:
+            
+            if (band != CDAWiFiChannelBand2GHz) {
+                return NO;
+            }
+            
+            body = CDAWiFiInformationElementIndexGet(index, bytes, CDAWiFiInformationElementSupportedRates, &length);
+            
+            if (body != NULL) {
+                cck = CDAWiFiInformationElementRatesContainCCK(body, length);
+                ofdm = CDAWiFiInformationElementRatesContainOFDM(body, length);
+            }
+            
+            body = CDAWiFiInformationElementIndexGet(index, bytes, CDAWiFiInformationElementExtendedSupportedRates, &length);
+            
+            if (body != NULL) {
+                cck = cck || CDAWiFiInformationElementRatesContainCCK(body, length);
+                ofdm = ofdm || CDAWiFiInformationElementRatesContainOFDM(body, length);
+            }
+            
+            return (phyMode == CDAWiFiPHYMode11b) ? cck : ofdm;
+            
+        default:
+            return NO;
+    }
+}
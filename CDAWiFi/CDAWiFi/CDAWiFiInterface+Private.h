@@ -0,0 +1,197 @@
+//
+//  CDAWiFiInterface+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/2/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiInterface.h>
+#import <CDAWiFi/CDAWiFiLinkSampler.h>
+#import <CDAWiFi/CDAWiFiChannelSurvey.h>
+
+@class CDAWiFiNetlinkSocket, CDAWiFiClient, CDAWiFiScanCacheChanges, CDAWiFiRoamingEngine, CDAWiFiAutoJoinEngine;
+
+@interface CDAWiFiInterface (Private)
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes a CDAWiFiInterface bound to a kernel network interface.
+ *
+ * @discussion
+ * Interfaces are created by CDAWiFiClient and share the client's netlink socket.
+ */
+- (instancetype)initWithInterfaceName:(OFString *)interfaceName
+                       interfaceIndex:(uint32_t)interfaceIndex
+                           wiphyIndex:(uint32_t)wiphyIndex
+                               socket:(CDAWiFiNetlinkSocket *)socket;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The kernel interface index.
+ */
+@property (readonly) uint32_t interfaceIndex;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The index of the wireless PHY the interface belongs to.
+ */
+@property (readonly) uint32_t wiphyIndex;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The client that created the interface, whose delegate receives the interface events.
+ */
+@property (weak) CDAWiFiClient *client;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Drops the current interface state, so the next getter fetches a new one.
+ *
+ * @discussion
+ * Called when an event reports that the interface state changed, and the state is not maintained.
+ */
+- (void)invalidateState;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Whether events keep the state current. If YES, getters never refresh a state that exists.
+ */
+@property (getter=isStateMaintained) BOOL stateMaintained;
+
+/*!
+ * @method
+ *
+ * @param includeNoise
+ * Whether to also dump the channel survey for the noise floor, in the same exchange.
+ *
+ * @abstract
+ * Reads the signal and transmit rate of the current link without touching the interface state.
+ * Returns NO if the interface is not associated.
+ */
+- (BOOL)getLinkSample:(CDAWiFiLinkSample *)sample includeNoise:(BOOL)includeNoise;
+
+/*!
+ * @method
+ *
+ * @param entries
+ * A data array of CDAWiFiChannelSurveyEntry items, which upon return has one more item per channel reported.
+ * Only the frequency, channel number and band, in use flag, noise and times are set.
+ *
+ * @abstract
+ * Dumps the channel survey of every channel the driver has statistics for, in a single exchange.
+ */
+- (BOOL)getChannelSurveyEntries:(OFDataArray *)entries error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Updates the scan cache from the kernel, and notifies the client delegate of the changes.
+ *
+ * @result
+ * The changes made by the update, or nil if an error occurs.
+ */
+- (CDAWiFiScanCacheChanges *)updateScanCacheAndReturnError:(out CDAError **)error;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Whether a scan triggered by the interface was not dumped yet. Its own dump will update the scan cache.
+ */
+@property (readonly, getter=isScanning) BOOL scanning;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Whether the interface is in HostAP mode and runs an access point. The kernel only reports the SSID of an access point that beacons.
+ */
+@property (readonly, getter=isBeaconing) BOOL beaconing;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The roaming engine running on the interface, which is told about every scan cache change.
+ */
+@property (weak) CDAWiFiRoamingEngine *roamingEngine;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The auto-join engine running on the interface, which is told about every scan cache change.
+ */
+@property (weak) CDAWiFiAutoJoinEngine *autoJoinEngine;
+
+/*!
+ * @method
+ *
+ * @param previousBSSID
+ * The BSSID of the access point the interface is associated to, or 0.
+ *
+ * @abstract
+ * Associates to a network. If a previous BSSID is specified, sends a reassociation request, to roam within an ESS.
+ */
+- (BOOL)associateToNetwork:(CDAWiFiNetwork *)network
+                  password:(OFString *)password
+             previousBSSID:(CDAWiFiMACAddress)previousBSSID
+                     error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Copies the key set with setPairwiseMasterKey:error:, or by the last WPA Personal association, to a 32 octet buffer.
+ * Returns NO if there is none.
+ */
+- (BOOL)getPairwiseMasterKey:(uint8_t *)key;
+
+/*!
+ * @method
+ *
+ * @param identifier
+ * The 16 octet PMKID.
+ *
+ * @param key
+ * The PMK, passed to drivers that run the 4-way handshake. May be NULL.
+ *
+ * @abstract
+ * Adds a PMK security association for an access point to the driver's PMKSA cache.
+ */
+- (BOOL)setPairwiseMasterKeyIdentifier:(const uint8_t *)identifier
+                                   key:(const uint8_t *)key
+                              forBSSID:(CDAWiFiMACAddress)bssid
+                                 error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes a PMK security association from the driver's PMKSA cache.
+ */
+- (void)removePairwiseMasterKeyIdentifier:(const uint8_t *)identifier forBSSID:(CDAWiFiMACAddress)bssid;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Asks the driver to send a connection quality event whenever the RSSI crosses the threshold, in dBm.
+ */
+- (BOOL)setConnectionQualityThreshold:(int)threshold hysteresis:(uint32_t)hysteresis error:(out CDAError **)error;
+
+@end
@@ -9,8 +9,9 @@
 #import <ObjFW/ObjFW.h>
 #import <CDAFoundation/CDAFoundation.h>
 #import <CDAWiFi/CDAWiFiTypes.h>
+#include <dispatch/dispatch.h>
 
-@class CDAWiFiChannel, CDAWiFiNetwork, CDAWiFiConfiguration;
+@class CDAWiFiChannel, CDAWiFiNetwork, CDAWiFiConfiguration, CDAWiFiScanCacheChanges, CDAWiFiInterfaceState, CDAWiFiScanQuery;
 
 /*!
  * @class
@@ -31,6 +32,62 @@
  */
 @property (readonly) OFString *interfaceName;
 
+/*! @functiongroup Refreshing the Interface State */
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The maximum age (in seconds) of the interface state returned by the getters. Defaults to 1 second.
+ *
+ * @discussion
+ * The getters from -[CDAWiFiInterface powerOn] to -[CDAWiFiInterface serviceActive] are answered from a single snapshot
+ * of the interface state. The snapshot is fetched with one batch of nl80211 requests
+ * (NL80211_CMD_GET_INTERFACE, NL80211_CMD_GET_STATION, NL80211_CMD_GET_SURVEY and NL80211_CMD_GET_REG)
+ * and is refreshed automatically by the first getter called after it expired.
+ * Set to 0 to refresh on every call.
+ *
+ * Ignored while the client maintains the interface state from events,
+ * see -[CDAWiFiClient startMaintainingInterfaceStateAndReturnError:].
+ */
+@property of_time_interval_t stateRefreshInterval;
+
+/*!
+ * @method
+ *
+ * @result
+ * The current state, or nil if it could not be fetched.
+ *
+ * @abstract
+ * Returns the whole interface state at once, so every value comes from the same snapshot.
+ *
+ * @discussion
+ * States are immutable and replaced atomically, reading the current one takes no lock and no system call:
+ * a hazard pointer of the thread keeps it alive until it is retained.
+ * The state is refreshed first if it expired, see stateRefreshInterval.
+ */
+- (CDAWiFiInterfaceState *)state;
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Fetches a new snapshot of the interface state from the kernel.
+ *
+ * @discussion
+ * Costs two kernel round trips, regardless of how many getters are read afterwards: the requests are sent together,
+ * except the survey dump, which follows once the station dump is done since the kernel runs one dump per socket at a time.
+ * The security of a new BSS is read from the scan cache as it is, the scan cache is neither dumped nor changed.
+ */
+- (BOOL)updateStateAndReturnError:(out CDAError **)error;
+
 /*!
  * @method
  *
@@ -55,7 +112,8 @@
  * Returns the set of channels supported by the Wi-Fi interface for the currently adopted country code.
  *
  * @discussion
- * Returns nil if an error occurs.
+ * Returns nil if an error occurs. A channel is listed with a width only if the regulatory domain allows
+ * every 20 MHz channel of the span to be used that wide.
  */
 - (OFSet *)supportedWLANChannels;
 
@@ -116,6 +174,17 @@
  */
 - (NSString *)bssid;
 
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the current basic service set identifier (BSSID) of the Wi-Fi interface, as a packed integer.
+ *
+ * @discussion
+ * Returns 0 if an error occurred, or if the interface is not participating in a Wi-Fi network.
+ */
+- (CDAWiFiMACAddress)bssidValue;
+
 /*!
  * @method
  *
@@ -146,6 +215,7 @@
  *
  * @discussion
  * ReturnsCDAWiFiSecurityUnknown if an error occurs, or if the interface is not participating in a Wi-Fi network.
+ * Also unknown while the BSS is missing from the scan cache, which states read without updating it.
  */
 - (CDAWiFiSecurity)security;
 
@@ -171,6 +241,17 @@
  */
 - (NSString *)countryCode;
 
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the currently adopted country code for the Wi-Fi interface, as a packed integer.
+ *
+ * @discussion
+ * Returns 0 if an error occurs, or if the Wi-Fi interface is off.
+ */
+- (CDAWiFiCountryCode)countryCodeValue;
+
 /*!
  * @method
  *
@@ -206,6 +287,17 @@
  */
 - (NSString *)hardwareAddress;
 
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the hardware media access control (MAC) address for the Wi-Fi interface, as a packed integer.
+ *
+ * @discussion
+ * Returns 0 if an error occurs.
+ */
+- (CDAWiFiMACAddress)hardwareAddressValue;
+
 /*!
  * @method
  *
@@ -230,10 +322,64 @@
  * Returns the scan results currently in the scan cache for the Wi-Fi interface.
  *
  * @discussion
+ * Returns the same set object as long as the scan cache did not change.
+ * Use -[CDAWiFiInterface scanCacheChangesSinceGeneration:error:] to get only what changed between two calls.
  * Returns nil if an error occurs.
  */
 - (OFSet *)cachedScanResults;
 
+/*!
+ * @method
+ *
+ * @param query
+ * The criteria and the order of the results.
+ *
+ * @result
+ * An OFArray of CDAWiFiNetwork objects, in the sort order of the query.
+ *
+ * @abstract
+ * Returns the scan results in the scan cache matching a query.
+ *
+ * @discussion
+ * Answered from the indexes of the scan cache as of its last update, without asking the kernel,
+ * so it is cheap enough to call many times per second. Update the scan cache with -[CDAWiFiInterface cachedScanResults],
+ * -[CDAWiFiInterface scanCacheChangesSinceGeneration:error:] or a scan first.
+ */
+- (OFArray *)cachedScanResultsMatchingQuery:(CDAWiFiScanQuery *)query;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The generation of the scan cache, incremented by every update that adds, changes or removes networks.
+ *
+ * @discussion
+ * Does not update the scan cache.
+ */
+@property (readonly) uint64_t scanCacheGeneration;
+
+/*!
+ * @method
+ *
+ * @param generation
+ * The generation of the last changes applied by the caller. Pass 0 to get the whole scan cache.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A CDAWiFiScanCacheChanges object, or nil if an error occurs.
+ *
+ * @abstract
+ * Updates the scan cache from the kernel, and returns the networks added, changed or removed since a generation.
+ *
+ * @discussion
+ * Costs time proportional to the number of changes, not to the size of the scan cache.
+ * Keep the generation of the returned changes for the next call.
+ */
+- (CDAWiFiScanCacheChanges *)scanCacheChangesSinceGeneration:(uint64_t)generation error:(out CDAError **)error;
+
 /*!
  * @method
  *
@@ -287,6 +433,9 @@
  *
  * @discussion
  * Setting the channel while the interface is associated to a Wi-Fi network is not permitted.
+ * In HostAP mode the channel can only be set before the access point starts. A running access point must announce
+ * the switch to its clients in its beacons, which only the process that builds them (for example hostapd) can do,
+ * so this method fails with a CDAWiFiNotSupportedError error.
  */
 - (BOOL)setWLANChannel:(CDAWiFiChannel *)channel error:(out CDAError **)error;
 
@@ -311,6 +460,7 @@
  *
  * @discussion
  * The specified key must be exactly 32 octets.
+ * It is used by the next association to a WPA Personal network made without a password.
  */
 - (BOOL)setPairwiseMasterKey:(OFDataArray *)key error:(out CDAError **)error;
 
@@ -389,6 +539,68 @@
  */
 - (OFSet *)scanForNetworksWithName:(OFString *)networkName error:(out CDAError **)error;
 
+/*!
+ * @method
+ *
+ * @param ssid
+ * Probe request SSID.
+ * Pass an SSID to perform a directed scan for hidden Wi-Fi networks.
+ * This parameter is optional.
+ *
+ * @param queue
+ * The dispatch queue the handlers are invoked on. Use a serial queue to receive every result before the completion.
+ *
+ * @param resultHandler
+ * Invoked with each CDAWiFiNetwork object as soon as it is parsed from the scan results.
+ * This parameter is optional.
+ *
+ * @param completionHandler
+ * Invoked once the scan is over, with the NSSet of CDAWiFiNetwork objects in the scan cache,
+ * or nil and the CDAError that occurred.
+ *
+ * @abstract
+ * Starts a scan for Wi-Fi networks and returns immediately.
+ *
+ * @discussion
+ * No thread is blocked while the hardware scans: the scan completion is received from the kernel
+ * on a dispatch source, then the scan results are dumped and parsed on a global queue.
+ * Scans that do not complete within 10 seconds fail with CDAWiFiTimeoutError.
+ */
+- (void)scanForNetworksWithSSID:(OFDataArray *)ssid
+                          queue:(dispatch_queue_t)queue
+                  resultHandler:(void (^)(CDAWiFiNetwork *network))resultHandler
+              completionHandler:(void (^)(OFSet *networks, CDAError *error))completionHandler;
+
+/*!
+ * @method
+ *
+ * @param networkName
+ * Probe request SSID, encoded as an UTF-8 string.
+ * Pass a networkName to perform a directed scan for hidden Wi-Fi networks.
+ * This parameter is optional.
+ *
+ * @param queue
+ * The dispatch queue the handlers are invoked on. Use a serial queue to receive every result before the completion.
+ *
+ * @param resultHandler
+ * Invoked with each CDAWiFiNetwork object as soon as it is parsed from the scan results.
+ * This parameter is optional.
+ *
+ * @param completionHandler
+ * Invoked once the scan is over, with the NSSet of CDAWiFiNetwork objects in the scan cache,
+ * or nil and the CDAError that occurred.
+ *
+ * @abstract
+ * Starts a scan for Wi-Fi networks and returns immediately.
+ *
+ * @discussion
+ * See -[CDAWiFiInterface scanForNetworksWithSSID:queue:resultHandler:completionHandler:].
+ */
+- (void)scanForNetworksWithName:(OFString *)networkName
+                          queue:(dispatch_queue_t)queue
+                  resultHandler:(void (^)(CDAWiFiNetwork *network))resultHandler
+              completionHandler:(void (^)(OFSet *networks, CDAError *error))completionHandler;
+
 /*! @functiongroup Joining a Network */
 
 /*!
@@ -413,6 +625,13 @@
  * @discussion
  * This method will block for the duration of the association.
  * Requires the <i>com.apple.wifi.associate</i> entitlement.
+ *
+ * The PMK derived from a WPA passphrase is cached by the client, so reconnecting does not derive it again.
+ * If password is nil, the key set with setPairwiseMasterKey:error: is used.
+ * WPA Personal networks require a driver that performs the 4-way handshake. The method returns once the driver reports the port
+ * authorized, with a CDAWiFiInvalidPMKError error if the handshake fails, or a CDAWiFiSupplicantTimeoutError error
+ * if it does not complete in time, in which case the interface is disassociated.
+ * WEP and enterprise networks fail with a CDAWiFiNotSupportedError error.
  */
 - (BOOL)associateToNetwork:(CDAWiFiNetwork *)network password:(OFString *)password error:(out CDAError **)error;
 
@@ -7,7 +7,1878 @@
 //
 
 #import "CDAWiFiInterface.h"
+#import "CDAWiFiInterface+Private.h"
+#import "CDAWiFiInterfaceState.h"
+#import "CDAWiFiInterfaceState+Private.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiChannel+Private.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiClient.h"
+#import "CDAWiFiClient+Private.h"
+#import "CDAWiFiEventEngine.h"
+#import "CDAWiFiScanCache.h"
+#import "CDAWiFiScanArena.h"
+#import "CDAWiFiCrypto.h"
+#import "CDAWiFiPairwiseMasterKeyCache.h"
+#import "CDAWiFiRSSIHistory.h"
+#import "CDAWiFiRoamingEngine.h"
+#import "CDAWiFiRoamingEngine+Private.h"
+#import "CDAWiFiAutoJoinEngine.h"
+#import "CDAWiFiAutoJoinEngine+Private.h"
+#import "CDAWiFiNetlink.h"
+#import "CDAWiFiInformationElements.h"
+#import "CDAWiFiUtilities.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+
+/* Maximum duration (seconds) of a scan, from the trigger to the results. */
+#define CDAWiFiInterfaceScanTimeout 10
+
+/* Maximum duration (seconds) of an association, from the connect request to the 4-way handshake completion. */
+#define CDAWiFiInterfaceAssociationTimeout 15
+
+/* Cipher and AKM suite selectors (IEEE 802.11-2012, 8.4.2.27.2) */
+#define CDAWiFiCipherSuiteTKIP  0x000FAC02
+#define CDAWiFiCipherSuiteCCMP  0x000FAC04
+#define CDAWiFiAKMSuitePSK      0x000FAC02
+
+/* Reason code of a station leaving the BSS (IEEE 802.11-2012, 8.4.1.7) */
+#define CDAWiFiReasonCodeDeauthenticationLeaving 3
+
+/* Requests of the batched state exchange, in order. */
+enum {
+    CDAWiFiInterfaceStateRequestInterface,
+    CDAWiFiInterfaceStateRequestStation,
+    CDAWiFiInterfaceStateRequestSurvey,
+    CDAWiFiInterfaceStateRequestRegulatory,
+    CDAWiFiInterfaceStateRequestCount
+};
+
+/* Noise floor per channel, from a survey dump. */
+typedef struct CDAWiFiNoiseTable {
+    size_t count;
+    struct {
+        uint32_t frequency;
+        int noise;
+    } channels[64];
+} CDAWiFiNoiseTable;
+
+static void CDAWiFiNoiseTableParseSurvey(CDAWiFiNoiseTable *table, const struct nlmsghdr *message)
+{
+    const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+    const struct nlattr *surveyInfo[NL80211_SURVEY_INFO_MAX + 1];
+    
+    CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+    
+    if (attributes[NL80211_ATTR_SURVEY_INFO] == NULL || table->count == sizeof(table->channels) / sizeof(table->channels[0])) {
+        return;
+    }
+    
+    CDAWiFiNetlinkParseNested(surveyInfo, NL80211_SURVEY_INFO_MAX, attributes[NL80211_ATTR_SURVEY_INFO]);
+    
+    if (surveyInfo[NL80211_SURVEY_INFO_FREQUENCY] == NULL || surveyInfo[NL80211_SURVEY_INFO_NOISE] == NULL) {
+        return;
+    }
+    
+    table->channels[table->count].frequency = CDAWiFiNetlinkAttributeU32(surveyInfo[NL80211_SURVEY_INFO_FREQUENCY]);
+    table->channels[table->count].noise = (int8_t)CDAWiFiNetlinkAttributeU8(surveyInfo[NL80211_SURVEY_INFO_NOISE]);
+    table->count++;
+}
+
+static int CDAWiFiNoiseTableNoise(const CDAWiFiNoiseTable *table, uint32_t frequency)
+{
+    for (size_t index = 0; index < table->count; index++) {
+        
+        if (table->channels[index].frequency == frequency) {
+            return table->channels[index].noise;
+        }
+    }
+    
+    return 0;
+}
+
+static CDAWiFiInterfaceMode CDAWiFiInterfaceModeForNL80211Type(uint32_t type)
+{
+    switch (type) {
+        case NL80211_IFTYPE_STATION:
+        case NL80211_IFTYPE_P2P_CLIENT:
+            return CDAWiFiInterfaceModeStation;
+        
+        case NL80211_IFTYPE_ADHOC:
+            return CDAWiFiInterfaceModeIBSS;
+        
+        case NL80211_IFTYPE_AP:
+        case NL80211_IFTYPE_P2P_GO:
+            return CDAWiFiInterfaceModeHostAP;
+        
+        default:
+            return CDAWiFiInterfaceModeNone;
+    }
+}
+
+static void CDAWiFiInterfaceSnapshotParseInterface(CDAWiFiInterfaceSnapshot *snapshot, const struct nlmsghdr *message)
+{
+    const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+    
+    CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+    
+    if (attributes[NL80211_ATTR_IFTYPE] != NULL) {
+        snapshot->interfaceMode = CDAWiFiInterfaceModeForNL80211Type(CDAWiFiNetlinkAttributeU32(attributes[NL80211_ATTR_IFTYPE]));
+    }
+    
+    if (attributes[NL80211_ATTR_MAC] != NULL && CDAWiFiNetlinkAttributeLength(attributes[NL80211_ATTR_MAC]) == 6) {
+        snapshot->hardwareAddress = CDAWiFiMACAddressMake(CDAWiFiNetlinkAttributeData(attributes[NL80211_ATTR_MAC]));
+    }
+    
+    if (attributes[NL80211_ATTR_SSID] != NULL) {
+        size_t length = CDAWiFiNetlinkAttributeLength(attributes[NL80211_ATTR_SSID]);
+        snapshot->ssidLength = length < sizeof(snapshot->ssid) ? length : sizeof(snapshot->ssid);
+        memcpy(snapshot->ssid, CDAWiFiNetlinkAttributeData(attributes[NL80211_ATTR_SSID]), snapshot->ssidLength);
+    }
+    
+    if (attributes[NL80211_ATTR_WIPHY_FREQ] != NULL) {
+        snapshot->frequency = CDAWiFiNetlinkAttributeU32(attributes[NL80211_ATTR_WIPHY_FREQ]);
+    }
+    
+    if (attributes[NL80211_ATTR_CHANNEL_WIDTH] != NULL) {
+        snapshot->channelWidth = CDAWiFiNetlinkAttributeU32(attributes[NL80211_ATTR_CHANNEL_WIDTH]);
+    }
+    
+    if (attributes[NL80211_ATTR_WIPHY_TX_POWER_LEVEL] != NULL) {
+        snapshot->transmitPower = (int32_t)CDAWiFiNetlinkAttributeU32(attributes[NL80211_ATTR_WIPHY_TX_POWER_LEVEL]);
+        snapshot->hasTransmitPower = YES;
+    }
+}
+
+static void CDAWiFiInterfaceSnapshotParseStation(CDAWiFiInterfaceSnapshot *snapshot, const struct nlmsghdr *message)
+{
+    const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+    const struct nlattr *stationInfo[NL80211_STA_INFO_MAX + 1];
+    const struct nlattr *rateInfo[NL80211_RATE_INFO_MAX + 1];
+    
+    /* A station interface has a single peer, the access point. Other modes are cleared by the finalization. */
+    if (snapshot->associated) {
+        return;
+    }
+    
+    CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+    
+    if (attributes[NL80211_ATTR_MAC] == NULL || CDAWiFiNetlinkAttributeLength(attributes[NL80211_ATTR_MAC]) != 6 ||
+        attributes[NL80211_ATTR_STA_INFO] == NULL) {
+        
+        return;
+    }
+    
+    snapshot->associated = YES;
+    snapshot->bssid = CDAWiFiMACAddressMake(CDAWiFiNetlinkAttributeData(attributes[NL80211_ATTR_MAC]));
+    
+    CDAWiFiNetlinkParseNested(stationInfo, NL80211_STA_INFO_MAX, attributes[NL80211_ATTR_STA_INFO]);
+    
+    if (stationInfo[NL80211_STA_INFO_SIGNAL] != NULL) {
+        snapshot->rssi = (int8_t)CDAWiFiNetlinkAttributeU8(stationInfo[NL80211_STA_INFO_SIGNAL]);
+    }
+    
+    if (stationInfo[NL80211_STA_INFO_TX_BITRATE] == NULL) {
+        return;
+    }
+    
+    CDAWiFiNetlinkParseNested(rateInfo, NL80211_RATE_INFO_MAX, stationInfo[NL80211_STA_INFO_TX_BITRATE]);
+    
+    if (rateInfo[NL80211_RATE_INFO_BITRATE32] != NULL) {
+        snapshot->transmitBitrate = CDAWiFiNetlinkAttributeU32(rateInfo[NL80211_RATE_INFO_BITRATE32]);
+    } else if (rateInfo[NL80211_RATE_INFO_BITRATE] != NULL) {
+        snapshot->transmitBitrate = CDAWiFiNetlinkAttributeU16(rateInfo[NL80211_RATE_INFO_BITRATE]);
+    }
+    
+    if (rateInfo[NL80211_RATE_INFO_HE_MCS] != NULL || rateInfo[NL80211_RATE_INFO_VHT_MCS] != NULL) {
+        snapshot->activePHYMode = CDAWiFiPHYMode11ac;
+    } else if (rateInfo[NL80211_RATE_INFO_MCS] != NULL) {
+        snapshot->activePHYMode = CDAWiFiPHYMode11n;
+    }
+}
+
+static void CDAWiFiInterfaceSnapshotParseSurvey(CDAWiFiInterfaceSnapshot *snapshot, const struct nlmsghdr *message)
+{
+    const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+    const struct nlattr *surveyInfo[NL80211_SURVEY_INFO_MAX + 1];
+    
+    CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+    
+    if (attributes[NL80211_ATTR_SURVEY_INFO] == NULL) {
+        return;
+    }
+    
+    CDAWiFiNetlinkParseNested(surveyInfo, NL80211_SURVEY_INFO_MAX, attributes[NL80211_ATTR_SURVEY_INFO]);
+    
+    /* Only the channel currently in use reports the noise floor of the interface. */
+    if (surveyInfo[NL80211_SURVEY_INFO_IN_USE] != NULL && surveyInfo[NL80211_SURVEY_INFO_NOISE] != NULL) {
+        snapshot->noise = (int8_t)CDAWiFiNetlinkAttributeU8(surveyInfo[NL80211_SURVEY_INFO_NOISE]);
+    }
+}
+
+static void CDAWiFiInterfaceSnapshotParseRegulatory(CDAWiFiInterfaceSnapshot *snapshot, const struct nlmsghdr *message)
+{
+    const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+    
+    CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+    
+    if (attributes[NL80211_ATTR_REG_ALPHA2] != NULL && CDAWiFiNetlinkAttributeLength(attributes[NL80211_ATTR_REG_ALPHA2]) >= 2) {
+        snapshot->countryCode = CDAWiFiCountryCodeMake(CDAWiFiNetlinkAttributeData(attributes[NL80211_ATTR_REG_ALPHA2]));
+    }
+}
+
+static void CDAWiFiInterfaceSnapshotFinalize(CDAWiFiInterfaceSnapshot *snapshot)
+{
+    /* The station dump of an access point or an IBSS lists its peers, none of them is a BSS the interface joined. */
+    if (snapshot->interfaceMode != CDAWiFiInterfaceModeStation) {
+        
+        snapshot->associated = NO;
+        snapshot->bssid = 0;
+        snapshot->rssi = 0;
+        snapshot->transmitBitrate = 0;
+        snapshot->activePHYMode = CDAWiFiPHYModeNone;
+    }
+    
+    /* Legacy rates do not carry a PHY mode, derive it from the band and the rate. */
+    if (snapshot->associated && snapshot->activePHYMode == CDAWiFiPHYModeNone) {
+        
+        if (CDAWiFiChannelBandForFrequency(snapshot->frequency) == CDAWiFiChannelBand5GHz) {
+            snapshot->activePHYMode = CDAWiFiPHYMode11a;
+        } else if (snapshot->transmitBitrate == 10 || snapshot->transmitBitrate == 20 ||
+                   snapshot->transmitBitrate == 55 || snapshot->transmitBitrate == 110) {
+            snapshot->activePHYMode = CDAWiFiPHYMode11b;
+        } else if (snapshot->transmitBitrate != 0) {
+            snapshot->activePHYMode = CDAWiFiPHYMode11g;
+        }
+    }
+}
 
 @implementation CDAWiFiInterface
+{
+    CDAWiFiNetlinkSocket *_socket;
+    __weak CDAWiFiClient *_client;
+    uint32_t _interfaceIndex;
+    uint32_t _wiphyIndex;
+    
+    /* The current CDAWiFiInterfaceState, retained. Replaced atomically, read without locking under a hazard pointer. */
+    _Atomic(void *) _state;
+    
+    /* Replaced states a reader may still be retaining, released by a later publication. Protected by the mutex. */
+    OFMutex *_stateMutex;
+    OFMutableArray *_retiredStates;
+    _Atomic(bool) _stateMaintained;
+    
+    CDAWiFiScanCache *_scanCache;
+    
+    /* Serial queue waiting for scan completion events. */
+    dispatch_queue_t _scanQueue;
+    
+    /* Scans triggered whose results were not dumped yet. */
+    _Atomic(unsigned int) _scansInFlight;
+    
+    /* The PMK used by the next WPA Personal association, set by setPairwiseMasterKey:error:. */
+    OFMutex *_keyMutex;
+    uint8_t _pairwiseMasterKey[CDAWiFiPairwiseMasterKeyLength];
+    BOOL _hasPairwiseMasterKey;
+    
+    __weak CDAWiFiRoamingEngine *_roamingEngine;
+    __weak CDAWiFiAutoJoinEngine *_autoJoinEngine;
+}
+
+@synthesize interfaceName = _interfaceName, interfaceIndex = _interfaceIndex, wiphyIndex = _wiphyIndex, client = _client;
+@synthesize roamingEngine = _roamingEngine, autoJoinEngine = _autoJoinEngine;
+
+#pragma mark - Initialization
+
+- (instancetype)initWithInterfaceName:(OFString *)interfaceName
+                       interfaceIndex:(uint32_t)interfaceIndex
+                           wiphyIndex:(uint32_t)wiphyIndex
+                               socket:(CDAWiFiNetlinkSocket *)socket
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _interfaceName = [interfaceName copy];
+        _interfaceIndex = interfaceIndex;
+        _wiphyIndex = wiphyIndex;
+        _socket = socket;
+        atomic_init(&_state, NULL);
+        _stateMutex = [OFMutex mutex];
+        _retiredStates = [OFMutableArray array];
+        atomic_init(&_stateMaintained, false);
+        atomic_init(&_scansInFlight, 0);
+        _stateRefreshInterval = 1.0;
+        _scanCache = [[CDAWiFiScanCache alloc] init];
+        _scanQueue = dispatch_queue_create("CDAWiFiInterface.scan", DISPATCH_QUEUE_SERIAL);
+        _keyMutex = [OFMutex mutex];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    /* No reader is left, the current state is released like the retired ones. */
+    CDAWiFiInterfaceState *state = (__bridge_transfer CDAWiFiInterfaceState *)atomic_load_explicit(&_state, memory_order_acquire);
+    
+    state = nil;
+    
+    if (_scanQueue != NULL) {
+        CDAWiFiDispatchRelease(_scanQueue);
+    }
+    
+    CDAWiFiSecureZero(_pairwiseMasterKey, sizeof(_pairwiseMasterKey));
+}
+
+#pragma mark - State
+
+- (BOOL)updateStateAndReturnError:(out CDAError **)error
+{
+    CDAWiFiNetlinkMessage requests[CDAWiFiInterfaceStateRequestCount];
+    CDAWiFiInterfaceSnapshot snapshot;
+    CDAWiFiInterfaceSnapshot *snapshotPointer = &snapshot;
+    int results[CDAWiFiInterfaceStateRequestCount];
+    uint16_t family = _socket.nl80211FamilyID;
+    struct ifreq interfaceRequest;
+    
+    memset(&snapshot, 0, sizeof(snapshot));
+    
+    CDAWiFiNetlinkMessageInit(&requests[CDAWiFiInterfaceStateRequestInterface], family, 0, NL80211_CMD_GET_INTERFACE);
+    CDAWiFiNetlinkMessagePutU32(&requests[CDAWiFiInterfaceStateRequestInterface], NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    CDAWiFiNetlinkMessageInit(&requests[CDAWiFiInterfaceStateRequestStation], family, NLM_F_DUMP, NL80211_CMD_GET_STATION);
+    CDAWiFiNetlinkMessagePutU32(&requests[CDAWiFiInterfaceStateRequestStation], NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    CDAWiFiNetlinkMessageInit(&requests[CDAWiFiInterfaceStateRequestSurvey], family, NLM_F_DUMP, NL80211_CMD_GET_SURVEY);
+    CDAWiFiNetlinkMessagePutU32(&requests[CDAWiFiInterfaceStateRequestSurvey], NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    CDAWiFiNetlinkMessageInit(&requests[CDAWiFiInterfaceStateRequestRegulatory], family, 0, NL80211_CMD_GET_REG);
+    
+    BOOL success = [_socket performRequests:requests
+                                      count:CDAWiFiInterfaceStateRequestCount
+                                    handler:^(size_t requestIndex, const struct nlmsghdr *message) {
+                                        
+                                        switch (requestIndex) {
+                                            case CDAWiFiInterfaceStateRequestInterface:
+                                                CDAWiFiInterfaceSnapshotParseInterface(snapshotPointer, message);
+                                                break;
+                                            case CDAWiFiInterfaceStateRequestStation:
+                                                CDAWiFiInterfaceSnapshotParseStation(snapshotPointer, message);
+                                                break;
+                                            case CDAWiFiInterfaceStateRequestSurvey:
+                                                CDAWiFiInterfaceSnapshotParseSurvey(snapshotPointer, message);
+                                                break;
+                                            case CDAWiFiInterfaceStateRequestRegulatory:
+                                                CDAWiFiInterfaceSnapshotParseRegulatory(snapshotPointer, message);
+                                                break;
+                                        }
+                                        
+                                    } results:results error:error];
+    
+    if (!success) {
+        return NO;
+    }
+    
+    /* Station, survey and regulatory information is optional, the interface itself is not. */
+    if (results[CDAWiFiInterfaceStateRequestInterface] != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(results[CDAWiFiInterfaceStateRequestInterface]);
+        }
+        
+        return NO;
+    }
+    
+    /* The power and link state are netdevice flags, read with the same socket. */
+    memset(&interfaceRequest, 0, sizeof(interfaceRequest));
+    strncpy(interfaceRequest.ifr_name, _interfaceName.UTF8String, IFNAMSIZ - 1);
+    
+    if (ioctl(_socket.fileDescriptor, SIOCGIFFLAGS, &interfaceRequest) == 0) {
+        snapshot.powerOn = (interfaceRequest.ifr_flags & IFF_UP) != 0;
+        snapshot.serviceActive = (interfaceRequest.ifr_flags & IFF_RUNNING) != 0;
+    }
+    
+    CDAWiFiInterfaceSnapshotFinalize(&snapshot);
+    
+    /*
+     * The security of the BSS is only looked up when the BSS changed, in the scan cache as it is, without a dump.
+     * Until a scan or a dump adds the BSS to the cache it is unknown, and looked up again by the next refresh.
+     */
+    CDAWiFiInterfaceState *previousState = [self currentState];
+    CDAWiFiSecurity security = CDAWiFiSecurityUnknown;
+    
+    if (snapshot.associated) {
+        
+        if (previousState != nil && previousState.bssidValue == snapshot.bssid && previousState.security != CDAWiFiSecurityUnknown) {
+            security = previousState.security;
+        } else {
+            
+            CDAWiFiNetwork *network = [_scanCache networkWithBSSID:snapshot.bssid lastSeen:NULL];
+            
+            if (network != nil) {
+                security = network.security;
+            }
+        }
+    }
+    
+    [self publishState:[[CDAWiFiInterfaceState alloc] initWithSnapshot:&snapshot
+                                                              security:security
+                                                             timestamp:CDAWiFiMonotonicTime()]];
+    
+    return YES;
+}
+
+/* Returns the current state, retained, without refreshing it. */
+- (CDAWiFiInterfaceState *)currentState
+{
+    /* Protected from the time it is loaded until it is retained by the assignment. */
+    CDAWiFiInterfaceState *state = (__bridge CDAWiFiInterfaceState *)CDAWiFiHazardPointerAcquire(&_state);
+    
+    CDAWiFiHazardPointerRelease();
+    
+    return state;
+}
+
+/*
+ * Replaces the current state. The replaced one is retired, and released once no reader protects it,
+ * by this publication or a later one. Readers hold their own reference by then.
+ */
+- (void)publishState:(CDAWiFiInterfaceState *)state
+{
+    void *previousValue = atomic_exchange_explicit(&_state, (__bridge_retained void *)state, memory_order_seq_cst);
+    CDAWiFiInterfaceState *previousState = (__bridge_transfer CDAWiFiInterfaceState *)previousValue;
+    OFMutableArray *releasedStates = nil;
+    
+    [_stateMutex lock];
+    
+    if (previousState != nil) {
+        [_retiredStates addObject:previousState];
+    }
+    
+    for (size_t index = _retiredStates.count; index > 0; index--) {
+        
+        CDAWiFiInterfaceState *retiredState = _retiredStates[index - 1];
+        
+        if (CDAWiFiHazardPointerIsProtected((__bridge void *)retiredState)) {
+            continue;
+        }
+        
+        if (releasedStates == nil) {
+            releasedStates = [OFMutableArray array];
+        }
+        
+        [releasedStates addObject:retiredState];
+        [_retiredStates removeObjectAtIndex:index - 1];
+    }
+    
+    [_stateMutex unlock];
+    
+    /* Released after unlocking, so their dealloc never runs under the mutex. */
+    previousState = nil;
+    releasedStates = nil;
+}
+
+- (void)invalidateState
+{
+    [self publishState:nil];
+}
+
+- (BOOL)isStateMaintained
+{
+    return atomic_load_explicit(&_stateMaintained, memory_order_relaxed);
+}
+
+- (void)setStateMaintained:(BOOL)stateMaintained
+{
+    atomic_store_explicit(&_stateMaintained, stateMaintained, memory_order_relaxed);
+}
+
+- (BOOL)isScanning
+{
+    return atomic_load_explicit(&_scansInFlight, memory_order_relaxed) != 0;
+}
+
+- (BOOL)isBeaconing
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return (state.interfaceMode == CDAWiFiInterfaceModeHostAP && state.ssidData.count != 0);
+}
+
+/*
+ * Returns the current state, fetching it first if there is none or,
+ * unless events maintain it, if it is older than stateRefreshInterval.
+ */
+- (CDAWiFiInterfaceState *)state
+{
+    CDAWiFiInterfaceState *state = [self currentState];
+    
+    if (state != nil &&
+        (atomic_load_explicit(&_stateMaintained, memory_order_relaxed) ||
+         CDAWiFiMonotonicTime() - state.timestamp < _stateRefreshInterval)) {
+        
+        return state;
+    }
+    
+    [self updateStateAndReturnError:NULL];
+    
+    return [self currentState];
+}
+
+- (BOOL)getLinkSample:(CDAWiFiLinkSample *)sample includeNoise:(BOOL)includeNoise
+{
+    CDAWiFiNetlinkMessage requests[2];
+    CDAWiFiInterfaceSnapshot snapshot;
+    CDAWiFiInterfaceSnapshot *snapshotPointer = &snapshot;
+    int results[2];
+    uint16_t family = _socket.nl80211FamilyID;
+    
+    memset(&snapshot, 0, sizeof(snapshot));
+    
+    CDAWiFiNetlinkMessageInit(&requests[0], family, NLM_F_DUMP, NL80211_CMD_GET_STATION);
+    CDAWiFiNetlinkMessagePutU32(&requests[0], NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    CDAWiFiNetlinkMessageInit(&requests[1], family, NLM_F_DUMP, NL80211_CMD_GET_SURVEY);
+    CDAWiFiNetlinkMessagePutU32(&requests[1], NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    BOOL success = [_socket performRequests:requests
+                                      count:includeNoise ? 2 : 1
+                                    handler:^(size_t requestIndex, const struct nlmsghdr *message) {
+                                        
+                                        if (requestIndex == 0) {
+                                            CDAWiFiInterfaceSnapshotParseStation(snapshotPointer, message);
+                                        } else {
+                                            CDAWiFiInterfaceSnapshotParseSurvey(snapshotPointer, message);
+                                        }
+                                        
+                                    } results:results error:NULL];
+    
+    /* Drivers without survey support still report the station. */
+    if (!success || !snapshot.associated) {
+        return NO;
+    }
+    
+    sample->timestamp = CDAWiFiMonotonicTime();
+    sample->rssiValue = snapshot.rssi;
+    sample->noiseMeasurement = snapshot.noise;
+    sample->transmitRate = snapshot.transmitBitrate / 10.0;
+    
+    return YES;
+}
+
+- (BOOL)getChannelSurveyEntries:(OFDataArray *)entries error:(out CDAError **)error
+{
+    CDAWiFiNetlinkMessage request;
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, NLM_F_DUMP, NL80211_CMD_GET_SURVEY);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    return [_socket performRequests:&request count:1 handler:^(size_t requestIndex, const struct nlmsghdr *message) {
+        
+        const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+        const struct nlattr *surveyInfo[NL80211_SURVEY_INFO_MAX + 1];
+        CDAWiFiChannelSurveyEntry entry;
+        
+        CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+        
+        if (attributes[NL80211_ATTR_SURVEY_INFO] == NULL) {
+            return;
+        }
+        
+        CDAWiFiNetlinkParseNested(surveyInfo, NL80211_SURVEY_INFO_MAX, attributes[NL80211_ATTR_SURVEY_INFO]);
+        
+        if (surveyInfo[NL80211_SURVEY_INFO_FREQUENCY] == NULL) {
+            return;
+        }
+        
+        memset(&entry, 0, sizeof(entry));
+        
+        entry.frequency = CDAWiFiNetlinkAttributeU32(surveyInfo[NL80211_SURVEY_INFO_FREQUENCY]);
+        entry.channelNumber = CDAWiFiChannelNumberForFrequency(entry.frequency);
+        entry.channelBand = CDAWiFiChannelBandForFrequency(entry.frequency);
+        entry.inUse = (surveyInfo[NL80211_SURVEY_INFO_IN_USE] != NULL);
+        
+        if (surveyInfo[NL80211_SURVEY_INFO_NOISE] != NULL) {
+            entry.noise = (int8_t)CDAWiFiNetlinkAttributeU8(surveyInfo[NL80211_SURVEY_INFO_NOISE]);
+        }
+        
+        /* Cumulative times, in milliseconds. */
+        if (surveyInfo[NL80211_SURVEY_INFO_TIME] != NULL) {
+            entry.activeTime = CDAWiFiNetlinkAttributeU64(surveyInfo[NL80211_SURVEY_INFO_TIME]);
+        }
+        
+        if (surveyInfo[NL80211_SURVEY_INFO_TIME_BUSY] != NULL) {
+            entry.busyTime = CDAWiFiNetlinkAttributeU64(surveyInfo[NL80211_SURVEY_INFO_TIME_BUSY]);
+        }
+        
+        if (surveyInfo[NL80211_SURVEY_INFO_TIME_RX] != NULL) {
+            entry.receiveTime = CDAWiFiNetlinkAttributeU64(surveyInfo[NL80211_SURVEY_INFO_TIME_RX]);
+        }
+        
+        if (surveyInfo[NL80211_SURVEY_INFO_TIME_TX] != NULL) {
+            entry.transmitTime = CDAWiFiNetlinkAttributeU64(surveyInfo[NL80211_SURVEY_INFO_TIME_TX]);
+        }
+        
+        [entries addItem:&entry];
+        
+    } results:NULL error:error];
+}
+
+#pragma mark - Getters
+
+- (BOOL)powerOn
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.powerOn;
+}
+
+- (CDAWiFiChannel *)wlanChannel
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.wlanChannel;
+}
+
+/* Number of nl80211 bands tracked by -supportedWLANChannels (2.4, 5 and 60 GHz). */
+#define CDAWiFiInterfaceBandCount 3
+
+/* Channel widths the regulatory domain rules out around a frequency, from its NL80211_FREQUENCY_ATTR_NO_* flags. */
+typedef enum
+{
+    CDAWiFiInterfaceFrequencyNoHT40Minus    = 1 << 0,
+    CDAWiFiInterfaceFrequencyNoHT40Plus     = 1 << 1,
+    CDAWiFiInterfaceFrequencyNo80MHz        = 1 << 2,
+    CDAWiFiInterfaceFrequencyNo160MHz       = 1 << 3
+    
+} CDAWiFiInterfaceFrequencyRestriction;
+
+typedef struct
+{
+    uint32_t frequency;
+    uint32_t band;
+    uint32_t restrictions;
+    
+} CDAWiFiInterfaceBandFrequency;
+
+/*
+ * Whether a channel can be that wide: every 20 MHz channel of its span must be enabled, and none may carry a flag
+ * ruling the width out. The lower channel of a 40 MHz span has the upper one as its HT40+ secondary, and conversely.
+ */
+static BOOL CDAWiFiInterfaceSupportsChannelWidth(const CDAWiFiInterfaceBandFrequency *frequencies, size_t count,
+                                                 int channelNumber, CDAWiFiChannelWidth width, CDAWiFiChannelBand band)
+{
+    if (width == CDAWiFiChannelWidth20MHz) {
+        return YES;
+    }
+    
+    uint32_t center = CDAWiFiCenterFrequencyForChannel(channelNumber, width, band);
+    uint32_t halfWidth = 10u << (width - CDAWiFiChannelWidth20MHz);
+    
+    if (center == 0) {
+        return NO;
+    }
+    
+    for (uint32_t frequency = center - halfWidth + 10; frequency < center + halfWidth; frequency += 20) {
+        
+        size_t index = 0;
+        
+        while (index < count && frequencies[index].frequency != frequency) {
+            index++;
+        }
+        
+        if (index == count) {
+            return NO;
+        }
+        
+        uint32_t restrictions = frequencies[index].restrictions;
+        
+        switch (width) {
+            
+            case CDAWiFiChannelWidth40MHz:
+                
+                if (restrictions & ((frequency < center) ? CDAWiFiInterfaceFrequencyNoHT40Plus : CDAWiFiInterfaceFrequencyNoHT40Minus)) {
+                    return NO;
+                }
+                
+                break;
+            
+            case CDAWiFiChannelWidth80MHz:
+                
+                if (restrictions & CDAWiFiInterfaceFrequencyNo80MHz) {
+                    return NO;
+                }
+                
+                break;
+            
+            default:
+                
+                if (restrictions & CDAWiFiInterfaceFrequencyNo160MHz) {
+                    return NO;
+                }
+                
+                break;
+        }
+    }
+    
+    return YES;
+}
+
+- (OFSet *)supportedWLANChannels
+{
+    CDAWiFiNetlinkMessage request;
+    OFDataArray *frequencies = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiInterfaceBandFrequency)];
+    CDAWiFiChannelWidth maximumWidths[CDAWiFiInterfaceBandCount];
+    CDAWiFiChannelWidth *bandWidths = maximumWidths;
+    
+    for (int band = 0; band < CDAWiFiInterfaceBandCount; band++) {
+        maximumWidths[band] = CDAWiFiChannelWidth20MHz;
+    }
+    
+    /* Band capabilities and frequencies may arrive in different messages of a split dump. */
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, NLM_F_DUMP, NL80211_CMD_GET_WIPHY);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_WIPHY, _wiphyIndex);
+    CDAWiFiNetlinkMessagePutFlag(&request, NL80211_ATTR_SPLIT_WIPHY_DUMP);
+    
+    BOOL success = [_socket performRequests:&request count:1 handler:^(size_t requestIndex, const struct nlmsghdr *message) {
+        
+        const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+        
+        CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+        
+        if (attributes[NL80211_ATTR_WIPHY_BANDS] == NULL) {
+            return;
+        }
+        
+        const struct nlattr *bands = attributes[NL80211_ATTR_WIPHY_BANDS];
+        const uint8_t *cursor = CDAWiFiNetlinkAttributeData(bands);
+        const uint8_t *end = cursor + CDAWiFiNetlinkAttributeLength(bands);
+        
+        while (cursor + NLA_HDRLEN <= end) {
+            
+            const struct nlattr *band = (const struct nlattr *)cursor;
+            int bandIndex = band->nla_type & NLA_TYPE_MASK;
+            
+            if (band->nla_len < NLA_HDRLEN || cursor + band->nla_len > end) {
+                break;
+            }
+            
+            cursor += NLA_ALIGN(band->nla_len);
+            
+            if (bandIndex >= CDAWiFiInterfaceBandCount) {
+                continue;
+            }
+            
+            const struct nlattr *bandAttributes[NL80211_BAND_ATTR_MAX + 1];
+            
+            CDAWiFiNetlinkParseNested(bandAttributes, NL80211_BAND_ATTR_MAX, band);
+            
+            /* HT capability bit 1: 20/40 MHz operation supported. */
+            if (bandAttributes[NL80211_BAND_ATTR_HT_CAPA] != NULL &&
+                (CDAWiFiNetlinkAttributeU16(bandAttributes[NL80211_BAND_ATTR_HT_CAPA]) & 0x0002) &&
+                bandWidths[bandIndex] < CDAWiFiChannelWidth40MHz) {
+                
+                bandWidths[bandIndex] = CDAWiFiChannelWidth40MHz;
+            }
+            
+            /* VHT is 80 MHz capable, bits 2-3 announce 160 MHz. */
+            if (bandAttributes[NL80211_BAND_ATTR_VHT_CAPA] != NULL) {
+                
+                uint32_t capabilities = CDAWiFiNetlinkAttributeU32(bandAttributes[NL80211_BAND_ATTR_VHT_CAPA]);
+                CDAWiFiChannelWidth width = (capabilities & 0x000C) ? CDAWiFiChannelWidth160MHz : CDAWiFiChannelWidth80MHz;
+                
+                if (bandWidths[bandIndex] < width) {
+                    bandWidths[bandIndex] = width;
+                }
+            }
+            
+            if (bandAttributes[NL80211_BAND_ATTR_FREQS] == NULL) {
+                continue;
+            }
+            
+            const struct nlattr *frequencyList = bandAttributes[NL80211_BAND_ATTR_FREQS];
+            const uint8_t *frequencyCursor = CDAWiFiNetlinkAttributeData(frequencyList);
+            const uint8_t *frequencyEnd = frequencyCursor + CDAWiFiNetlinkAttributeLength(frequencyList);
+            
+            while (frequencyCursor + NLA_HDRLEN <= frequencyEnd) {
+                
+                const struct nlattr *frequency = (const struct nlattr *)frequencyCursor;
+                
+                if (frequency->nla_len < NLA_HDRLEN || frequencyCursor + frequency->nla_len > frequencyEnd) {
+                    break;
+                }
+                
+                frequencyCursor += NLA_ALIGN(frequency->nla_len);
+                
+                const struct nlattr *frequencyAttributes[NL80211_FREQUENCY_ATTR_MAX + 1];
+                
+                CDAWiFiNetlinkParseNested(frequencyAttributes, NL80211_FREQUENCY_ATTR_MAX, frequency);
+                
+                if (frequencyAttributes[NL80211_FREQUENCY_ATTR_FREQ] == NULL ||
+                    frequencyAttributes[NL80211_FREQUENCY_ATTR_DISABLED] != NULL) {
+                    
+                    continue;
+                }
+                
+                CDAWiFiInterfaceBandFrequency bandFrequency;
+                
+                bandFrequency.frequency = CDAWiFiNetlinkAttributeU32(frequencyAttributes[NL80211_FREQUENCY_ATTR_FREQ]);
+                bandFrequency.band = bandIndex;
+                bandFrequency.restrictions = 0;
+                
+                if (frequencyAttributes[NL80211_FREQUENCY_ATTR_NO_HT40_MINUS] != NULL) {
+                    bandFrequency.restrictions |= CDAWiFiInterfaceFrequencyNoHT40Minus;
+                }
+                
+                if (frequencyAttributes[NL80211_FREQUENCY_ATTR_NO_HT40_PLUS] != NULL) {
+                    bandFrequency.restrictions |= CDAWiFiInterfaceFrequencyNoHT40Plus;
+                }
+                
+                if (frequencyAttributes[NL80211_FREQUENCY_ATTR_NO_80MHZ] != NULL) {
+                    bandFrequency.restrictions |= CDAWiFiInterfaceFrequencyNo80MHz;
+                }
+                
+                if (frequencyAttributes[NL80211_FREQUENCY_ATTR_NO_160MHZ] != NULL) {
+                    bandFrequency.restrictions |= CDAWiFiInterfaceFrequencyNo160MHz;
+                }
+                
+                [frequencies addItem:&bandFrequency];
+            }
+        }
+        
+    } results:NULL error:NULL];
+    
+    if (!success) {
+        return nil;
+    }
+    
+    /* Channels are interned, so building the set allocates nothing but the set itself. */
+    OFMutableSet *channels = [OFMutableSet set];
+    
+    const CDAWiFiInterfaceBandFrequency *bandFrequencies = frequencies.items;
+    size_t count = frequencies.count;
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        int channelNumber = CDAWiFiChannelNumberForFrequency(bandFrequencies[index].frequency);
+        CDAWiFiChannelBand channelBand = CDAWiFiChannelBandForFrequency(bandFrequencies[index].frequency);
+        
+        if (channelNumber == 0) {
+            continue;
+        }
+        
+        for (CDAWiFiChannelWidth width = CDAWiFiChannelWidth20MHz; width <= maximumWidths[bandFrequencies[index].band]; width++) {
+            
+            /* 2.4 GHz channels are at most 40 MHz wide. */
+            if (channelBand == CDAWiFiChannelBand2GHz && width > CDAWiFiChannelWidth40MHz) {
+                break;
+            }
+            
+            if (!CDAWiFiInterfaceSupportsChannelWidth(bandFrequencies, count, channelNumber, width, channelBand)) {
+                continue;
+            }
+            
+            [channels addObject:[CDAWiFiChannel channelWithChannelNumber:channelNumber
+                                                            channelWidth:width
+                                                             channelBand:channelBand]];
+        }
+    }
+    
+    [channels makeImmutable];
+    
+    return channels;
+}
+
+- (CDAWiFiPHYMode)activePHYMode
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.activePHYMode;
+}
+
+- (OFString *)ssid
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.ssid;
+}
+
+- (OFDataArray *)ssidData
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.ssidData;
+}
+
+- (OFString *)bssid
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.bssid;
+}
+
+- (CDAWiFiMACAddress)bssidValue
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.bssidValue;
+}
+
+- (int)rssiValue
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.rssiValue;
+}
+
+- (int)noiseMeasurement
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.noiseMeasurement;
+}
+
+- (double)transmitRate
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.transmitRate;
+}
+
+- (OFString *)countryCode
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.countryCode;
+}
+
+- (CDAWiFiCountryCode)countryCodeValue
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.countryCodeValue;
+}
+
+- (CDAWiFiInterfaceMode)interfaceMode
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.interfaceMode;
+}
+
+- (int)transmitPower
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.transmitPower;
+}
+
+- (OFString *)hardwareAddress
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.hardwareAddress;
+}
+
+- (CDAWiFiMACAddress)hardwareAddressValue
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.hardwareAddressValue;
+}
+
+- (BOOL)serviceActive
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return state.serviceActive;
+}
+
+- (CDAWiFiSecurity)security
+{
+    CDAWiFiInterfaceState *state = self.state;
+    
+    return (state != nil) ? state.security : CDAWiFiSecurityUnknown;
+}
+
+#pragma mark - Scan Results
+
+_Static_assert(CDAWiFiScanArenaPadding >= CDAWiFiInformationElementBatchPadding, "Scan arena payloads are indexed in place");
+
+/*
+ * Builds the information element indexes of networks in one pass over their elements, in place in the scan arena,
+ * instead of one lazy walk per network and accessor.
+ */
+static void CDAWiFiIndexNetworks(OFArray *networks)
+{
+    size_t count = networks.count;
+    
+    if (count == 0) {
+        return;
+    }
+    
+    CDAWiFiInformationElementIndex *indexes = malloc(count * sizeof(CDAWiFiInformationElementIndex));
+    const uint8_t **elements = malloc(count * sizeof(const uint8_t *));
+    uint32_t *lengths = malloc(count * sizeof(uint32_t));
+    
+    if (indexes == NULL || elements == NULL || lengths == NULL) {
+        
+        /* Networks fall back to lazy indexing. */
+        free(indexes);
+        free(elements);
+        free(lengths);
+        
+        return;
+    }
+    
+    size_t networkIndex = 0;
+    
+    for (CDAWiFiNetwork *network in networks) {
+        
+        elements[networkIndex] = network.informationElements;
+        lengths[networkIndex] = (uint32_t)network.informationElementLength;
+        
+        networkIndex++;
+    }
+    
+    CDAWiFiInformationElementIndexBuildBatch(indexes, elements, lengths, count);
+    
+    networkIndex = 0;
+    
+    for (CDAWiFiNetwork *network in networks) {
+        
+        [network setInformationElementIndex:&indexes[networkIndex]];
+        
+        networkIndex++;
+    }
+    
+    free(indexes);
+    free(elements);
+    free(lengths);
+}
+
+/*
+ * Dumps the kernel scan cache. The survey is dumped first, in the same batch,
+ * so every network is created with the noise floor of its channel.
+ * Returns the networks once the whole dump is parsed and indexed.
+ * The handler, if any, is invoked with each network as soon as it is parsed.
+ */
+- (OFArray *)loadScanResultsWithHandler:(void (^)(CDAWiFiNetwork *network))handler error:(out CDAError **)error
+{
+    enum {
+        CDAWiFiScanRequestSurvey,
+        CDAWiFiScanRequestScan,
+        CDAWiFiScanRequestCount
+    };
+    
+    CDAWiFiNetlinkMessage requests[CDAWiFiScanRequestCount];
+    CDAWiFiNoiseTable noiseTable;
+    CDAWiFiNoiseTable *noiseTablePointer = &noiseTable;
+    int results[CDAWiFiScanRequestCount];
+    uint16_t family = _socket.nl80211FamilyID;
+    
+    OFMutableArray *networks = [OFMutableArray array];
+    
+    /* The payloads of every network of the dump share one arena, freed with the last of them. */
+    CDAWiFiScanArena *arena = [[CDAWiFiScanArena alloc] init];
+    
+    noiseTable.count = 0;
+    
+    CDAWiFiNetlinkMessageInit(&requests[CDAWiFiScanRequestSurvey], family, NLM_F_DUMP, NL80211_CMD_GET_SURVEY);
+    CDAWiFiNetlinkMessagePutU32(&requests[CDAWiFiScanRequestSurvey], NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    CDAWiFiNetlinkMessageInit(&requests[CDAWiFiScanRequestScan], family, NLM_F_DUMP, NL80211_CMD_GET_SCAN);
+    CDAWiFiNetlinkMessagePutU32(&requests[CDAWiFiScanRequestScan], NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    BOOL success = [_socket performRequests:requests
+                                      count:CDAWiFiScanRequestCount
+                                    handler:^(size_t requestIndex, const struct nlmsghdr *message) {
+                                        
+                                        if (requestIndex == CDAWiFiScanRequestSurvey) {
+                                            
+                                            CDAWiFiNoiseTableParseSurvey(noiseTablePointer, message);
+                                            
+                                            return;
+                                        }
+                                        
+                                        const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+                                        const struct nlattr *bss[NL80211_BSS_MAX + 1];
+                                        
+                                        CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+                                        
+                                        if (attributes[NL80211_ATTR_BSS] == NULL) {
+                                            return;
+                                        }
+                                        
+                                        CDAWiFiNetlinkParseNested(bss, NL80211_BSS_MAX, attributes[NL80211_ATTR_BSS]);
+                                        
+                                        uint32_t frequency = (bss[NL80211_BSS_FREQUENCY] != NULL) ? CDAWiFiNetlinkAttributeU32(bss[NL80211_BSS_FREQUENCY]) : 0;
+                                        
+                                        CDAWiFiNetwork *network = [[CDAWiFiNetwork alloc] initWithBSSAttribute:attributes[NL80211_ATTR_BSS]
+                                                                                             noiseMeasurement:CDAWiFiNoiseTableNoise(noiseTablePointer, frequency)
+                                                                                                        arena:arena];
+                                        
+                                        if (network != nil) {
+                                            
+                                            [networks addObject:network];
+                                            
+                                            if (handler != nil) {
+                                                handler(network);
+                                            }
+                                        }
+                                        
+                                    } results:results error:error];
+    
+    if (!success) {
+        return nil;
+    }
+    
+    /* Not every driver implements surveys, only the scan dump is required. */
+    if (results[CDAWiFiScanRequestScan] != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(results[CDAWiFiScanRequestScan]);
+        }
+        
+        return nil;
+    }
+    
+    CDAWiFiIndexNetworks(networks);
+    
+    [networks makeImmutable];
+    
+    return networks;
+}
+
+/* Updates the scan cache from the kernel, and notifies the client delegate of the changes. */
+- (CDAWiFiScanCacheChanges *)updateScanCacheAndReturnError:(out CDAError **)error
+{
+    OFArray *networks = [self loadScanResultsWithHandler:nil error:error];
+    
+    if (networks == nil) {
+        return nil;
+    }
+    
+    return [self updateScanCacheWithNetworks:networks];
+}
+
+- (CDAWiFiScanCacheChanges *)updateScanCacheWithNetworks:(OFArray *)networks
+{
+    CDAWiFiScanCacheChanges *changes = [_scanCache updateWithNetworks:networks];
+    
+    [self.client.rssiHistory addSamplesWithNetworks:networks];
+    
+    if (!changes.empty) {
+        
+        id<CDAWiFiEventDelegate> delegate = self.client.delegate;
+        
+        [self.roamingEngine scanCacheDidChange:changes];
+        [self.autoJoinEngine scanCacheDidChange:changes];
+        
+        if ([(id)delegate respondsToSelector:@selector(scanCacheDidChangeForWiFiInterfaceWithName:changes:)]) {
+            [delegate scanCacheDidChangeForWiFiInterfaceWithName:_interfaceName changes:changes];
+        }
+    }
+    
+    return changes;
+}
+
+- (OFSet *)cachedScanResults
+{
+    if ([self updateScanCacheAndReturnError:NULL] == nil) {
+        return nil;
+    }
+    
+    return [_scanCache networks];
+}
+
+- (OFArray *)cachedScanResultsMatchingQuery:(CDAWiFiScanQuery *)query
+{
+    return [_scanCache networksMatchingQuery:query];
+}
+
+- (uint64_t)scanCacheGeneration
+{
+    return _scanCache.generation;
+}
+
+- (CDAWiFiScanCacheChanges *)scanCacheChangesSinceGeneration:(uint64_t)generation error:(out CDAError **)error
+{
+    if ([self updateScanCacheAndReturnError:error] == nil) {
+        return nil;
+    }
+    
+    return [_scanCache changesSinceGeneration:generation];
+}
+
+#pragma mark - Scanning
+
+- (BOOL)triggerScanWithSSID:(OFDataArray *)ssid error:(out CDAError **)error
+{
+    CDAWiFiNetlinkMessage request;
+    
+    if (ssid != nil && (ssid.count == 0 || ssid.count > 32)) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, 0, NL80211_CMD_TRIGGER_SCAN);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    /* Probe for the directed SSID, and for the wildcard SSID so broadcasting networks are found too. */
+    size_t ssids = CDAWiFiNetlinkMessageBeginNested(&request, NL80211_ATTR_SCAN_SSIDS);
+    
+    if (ssid != nil) {
+        CDAWiFiNetlinkMessagePut(&request, 1, ssid.items, ssid.count);
+    }
+    
+    CDAWiFiNetlinkMessagePut(&request, (ssid != nil) ? 2 : 1, NULL, 0);
+    CDAWiFiNetlinkMessageEndNested(&request, ssids);
+    
+    return [_socket performRequests:&request count:1 handler:nil results:NULL error:error];
+}
+
+/* Dumps the scan results, streaming each network to the queue, then completes with the scan cache. */
+- (void)finishScanOnQueue:(dispatch_queue_t)queue
+            resultHandler:(void (^)(CDAWiFiNetwork *network))resultHandler
+        completionHandler:(void (^)(OFSet *networks, CDAError *error))completionHandler
+{
+    CDAError *error;
+    OFArray *networks;
+    
+    if (resultHandler != nil) {
+        
+        networks = [self loadScanResultsWithHandler:^(CDAWiFiNetwork *network) {
+            
+            dispatch_async(queue, ^{
+                resultHandler(network);
+            });
+            
+        } error:&error];
+        
+    } else {
+        
+        networks = [self loadScanResultsWithHandler:nil error:&error];
+    }
+    
+    OFSet *results = nil;
+    
+    if (networks != nil) {
+        
+        [self updateScanCacheWithNetworks:networks];
+        
+        results = [_scanCache networks];
+    }
+    
+    atomic_fetch_sub_explicit(&_scansInFlight, 1, memory_order_relaxed);
+    
+    dispatch_async(queue, ^{
+        
+        completionHandler(results, (results != nil) ? nil : error);
+        
+        CDAWiFiDispatchRelease(queue);
+    });
+}
+
+- (void)scanForNetworksWithSSID:(OFDataArray *)ssid
+                          queue:(dispatch_queue_t)queue
+                  resultHandler:(void (^)(CDAWiFiNetwork *network))resultHandler
+              completionHandler:(void (^)(OFSet *networks, CDAError *error))completionHandler
+{
+    CDAError *error;
+    CDAWiFiEventEngine *eventEngine = self.client.eventEngine;
+    
+    /* Released once the completion handler ran. */
+    CDAWiFiDispatchRetain(queue);
+    
+    if (eventEngine == nil) {
+        error = CDAWiFiErrorWithCode(CDAWiFiReferenceNotBoundError);
+    }
+    
+    if (eventEngine == nil || ![eventEngine startAndReturnError:&error]) {
+        
+        dispatch_async(queue, ^{
+            
+            completionHandler(nil, error);
+            
+            CDAWiFiDispatchRelease(queue);
+        });
+        
+        return;
+    }
+    
+    dispatch_queue_t scanQueue = _scanQueue;
+    __block BOOL finished = NO;
+    __block id observer;
+    
+    /* Runs on the scan queue, exactly once. */
+    void (^finish)(CDAError *) = ^(CDAError *scanError) {
+        
+        if (finished) {
+            return;
+        }
+        
+        finished = YES;
+        
+        [eventEngine removeScanObserver:observer];
+        
+        /* The observer retains its handler, which retains this block, which retains the observer. */
+        observer = nil;
+        
+        if (scanError != nil) {
+            
+            atomic_fetch_sub_explicit(&self->_scansInFlight, 1, memory_order_relaxed);
+            
+            dispatch_async(queue, ^{
+                
+                completionHandler(nil, scanError);
+                
+                CDAWiFiDispatchRelease(queue);
+            });
+            
+            return;
+        }
+        
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            
+            [self finishScanOnQueue:queue resultHandler:resultHandler completionHandler:completionHandler];
+        });
+    };
+    
+    /* Counted before triggering, so the scan cache event of the scan always finds it in flight. */
+    atomic_fetch_add_explicit(&_scansInFlight, 1, memory_order_relaxed);
+    
+    /* Observe before triggering, so the completion event can not be missed. */
+    dispatch_sync(scanQueue, ^{
+        
+        observer = [eventEngine addScanObserverForInterfaceIndex:_interfaceIndex handler:^(BOOL aborted) {
+            
+            dispatch_async(scanQueue, ^{
+                
+                finish(aborted ? CDAWiFiErrorWithCode(CDAWiFiUnspecifiedFailureError) : nil);
+            });
+        }];
+    });
+    
+    if (![self triggerScanWithSSID:ssid error:&error]) {
+        
+        dispatch_async(scanQueue, ^{
+            
+            finish(error);
+        });
+        
+        return;
+    }
+    
+    /* Events lost to a socket buffer overflow are covered by the timeout. */
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, CDAWiFiInterfaceScanTimeout * NSEC_PER_SEC), scanQueue, ^{
+        
+        finish(CDAWiFiErrorWithCode(CDAWiFiTimeoutError));
+    });
+}
+
+- (void)scanForNetworksWithName:(OFString *)networkName
+                          queue:(dispatch_queue_t)queue
+                  resultHandler:(void (^)(CDAWiFiNetwork *network))resultHandler
+              completionHandler:(void (^)(OFSet *networks, CDAError *error))completionHandler
+{
+    OFDataArray *ssid = nil;
+    
+    if (networkName != nil) {
+        
+        ssid = [OFDataArray dataArray];
+        
+        [ssid addItems:[networkName UTF8String] count:[networkName UTF8StringLength]];
+    }
+    
+    [self scanForNetworksWithSSID:ssid queue:queue resultHandler:resultHandler completionHandler:completionHandler];
+}
+
+- (OFSet *)scanForNetworksWithSSID:(OFDataArray *)ssid error:(out CDAError **)error
+{
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block OFSet *results;
+    __block CDAError *scanError;
+    
+    [self scanForNetworksWithSSID:ssid
+                            queue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+                    resultHandler:nil
+                completionHandler:^(OFSet *networks, CDAError *completionError) {
+                    
+                    results = networks;
+                    scanError = completionError;
+                    
+                    dispatch_semaphore_signal(semaphore);
+                }];
+    
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    
+    CDAWiFiDispatchRelease(semaphore);
+    
+    if (results == nil && error != NULL) {
+        *error = scanError;
+    }
+    
+    return results;
+}
+
+- (OFSet *)scanForNetworksWithName:(OFString *)networkName error:(out CDAError **)error
+{
+    OFDataArray *ssid = nil;
+    
+    if (networkName != nil) {
+        
+        ssid = [OFDataArray dataArray];
+        
+        [ssid addItems:[networkName UTF8String] count:[networkName UTF8StringLength]];
+    }
+    
+    return [self scanForNetworksWithSSID:ssid error:error];
+}
+
+#pragma mark - Channel
+
+- (BOOL)setWLANChannel:(CDAWiFiChannel *)channel error:(out CDAError **)error
+{
+    uint32_t frequency = CDAWiFiFrequencyForChannelNumber(channel.channelNumber, channel.channelBand);
+    uint32_t centerFrequency = CDAWiFiCenterFrequencyForChannel(channel.channelNumber, channel.channelWidth, channel.channelBand);
+    
+    if (frequency == 0 || centerFrequency == 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    /* The association must be current, a stale state could let the channel change under a link. */
+    if (![self updateStateAndReturnError:error]) {
+        return NO;
+    }
+    
+    CDAWiFiInterfaceState *state = self.state;
+    
+    /* Access points list their clients as stations too, only a station link is in the way. */
+    if (state.interfaceMode == CDAWiFiInterfaceModeStation && state.associated) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    /*
+     * A running access point must announce the switch in its beacons first (NL80211_CMD_CHANNEL_SWITCH),
+     * which takes the beacons before and after the switch. Only the process that builds them, such as hostapd, can.
+     */
+    if (state.interfaceMode == CDAWiFiInterfaceModeHostAP && state.ssidData.count != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiNotSupportedError);
+        }
+        
+        return NO;
+    }
+    
+    CDAWiFiNetlinkMessage request;
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, 0, NL80211_CMD_SET_WIPHY);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_IFINDEX, _interfaceIndex);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_WIPHY_FREQ, frequency);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_CHANNEL_WIDTH, CDAWiFiNL80211ChannelWidthForChannelWidth(channel.channelWidth));
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_CENTER_FREQ1, centerFrequency);
+    
+    if (![_socket performRequests:&request count:1 handler:nil results:NULL error:error]) {
+        return NO;
+    }
+    
+    [self invalidateState];
+    
+    return YES;
+}
+
+#pragma mark - Keys
+
+- (BOOL)setPairwiseMasterKey:(OFDataArray *)key error:(out CDAError **)error
+{
+    if (key != nil && key.count * key.itemSize != CDAWiFiPairwiseMasterKeyLength) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    [_keyMutex lock];
+    
+    if (key != nil) {
+        memcpy(_pairwiseMasterKey, key.items, CDAWiFiPairwiseMasterKeyLength);
+    } else {
+        CDAWiFiSecureZero(_pairwiseMasterKey, sizeof(_pairwiseMasterKey));
+    }
+    
+    _hasPairwiseMasterKey = (key != nil);
+    
+    [_keyMutex unlock];
+    
+    return YES;
+}
+
+- (BOOL)getPairwiseMasterKey:(uint8_t *)key
+{
+    [_keyMutex lock];
+    
+    BOOL hasKey = _hasPairwiseMasterKey;
+    
+    if (hasKey) {
+        memcpy(key, _pairwiseMasterKey, CDAWiFiPairwiseMasterKeyLength);
+    }
+    
+    [_keyMutex unlock];
+    
+    return hasKey;
+}
+
+- (BOOL)setPairwiseMasterKeyIdentifier:(const uint8_t *)identifier
+                                   key:(const uint8_t *)key
+                              forBSSID:(CDAWiFiMACAddress)bssid
+                                 error:(out CDAError **)error
+{
+    CDAWiFiNetlinkMessage request;
+    uint8_t address[6];
+    
+    CDAWiFiMACAddressGetOctets(bssid, address);
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, 0, NL80211_CMD_SET_PMKSA);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_IFINDEX, _interfaceIndex);
+    CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_MAC, address, sizeof(address));
+    CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_PMKID, identifier, CDAWiFiPairwiseMasterKeyIdentifierLength);
+    
+    /* Drivers running the 4-way handshake also need the key itself. */
+    if (key != NULL) {
+        CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_PMK, key, CDAWiFiPairwiseMasterKeyLength);
+    }
+    
+    BOOL success = [_socket performRequests:&request count:1 handler:nil results:NULL error:error];
+    
+    CDAWiFiSecureZero(&request, sizeof(request));
+    
+    return success;
+}
+
+- (void)removePairwiseMasterKeyIdentifier:(const uint8_t *)identifier forBSSID:(CDAWiFiMACAddress)bssid
+{
+    CDAWiFiNetlinkMessage request;
+    uint8_t address[6];
+    
+    CDAWiFiMACAddressGetOctets(bssid, address);
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, 0, NL80211_CMD_DEL_PMKSA);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_IFINDEX, _interfaceIndex);
+    CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_MAC, address, sizeof(address));
+    CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_PMKID, identifier, CDAWiFiPairwiseMasterKeyIdentifierLength);
+    
+    [_socket performRequests:&request count:1 handler:nil results:NULL error:NULL];
+}
+
+#pragma mark - Connection Quality
+
+- (BOOL)setConnectionQualityThreshold:(int)threshold hysteresis:(uint32_t)hysteresis error:(out CDAError **)error
+{
+    CDAWiFiNetlinkMessage request;
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, 0, NL80211_CMD_SET_CQM);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_IFINDEX, _interfaceIndex);
+    
+    size_t nested = CDAWiFiNetlinkMessageBeginNested(&request, NL80211_ATTR_CQM);
+    
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_CQM_RSSI_THOLD, (uint32_t)threshold);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_CQM_RSSI_HYST, hysteresis);
+    
+    CDAWiFiNetlinkMessageEndNested(&request, nested);
+    
+    return [_socket performRequests:&request count:1 handler:nil results:NULL error:error];
+}
+
+#pragma mark - Association
+
+/*
+ * Reads the group cipher and the best pairwise cipher (CCMP, else TKIP) of an RSN or WPA element body.
+ * WPA elements use the same suite types under the Microsoft OUI, nl80211 expects them as RSN selectors.
+ */
+static BOOL CDAWiFiGetCipherSuites(const uint8_t *element, size_t length, BOOL wpa, uint32_t *groupCipher, uint32_t *pairwiseCipher)
+{
+    /* RSN: version (2), group suite (4), pairwise count (2), pairwise suites. WPA: OUI and type (4) first. */
+    size_t offset = wpa ? 6 : 2;
+    
+    if (length < offset + 6) {
+        return NO;
+    }
+    
+    *groupCipher = 0x000FAC00 | element[offset + 3];
+    
+    size_t count = element[offset + 4] | (element[offset + 5] << 8);
+    
+    offset += 6;
+    *pairwiseCipher = 0;
+    
+    for (size_t index = 0; index < count && offset + 4 <= length; index++, offset += 4) {
+        
+        uint32_t suite = 0x000FAC00 | element[offset + 3];
+        
+        if (suite == CDAWiFiCipherSuiteCCMP || (suite == CDAWiFiCipherSuiteTKIP && *pairwiseCipher == 0)) {
+            *pairwiseCipher = suite;
+        }
+    }
+    
+    return (*pairwiseCipher != 0);
+}
+
+- (BOOL)associateToNetwork:(CDAWiFiNetwork *)network password:(OFString *)password error:(out CDAError **)error
+{
+    return [self associateToNetwork:network password:password previousBSSID:0 error:error];
+}
+
+- (BOOL)associateToNetwork:(CDAWiFiNetwork *)network
+                  password:(OFString *)password
+             previousBSSID:(CDAWiFiMACAddress)previousBSSID
+                     error:(out CDAError **)error
+{
+    CDAWiFiEventEngine *eventEngine = self.client.eventEngine;
+    OFDataArray *ssid = network.ssidData;
+    CDAWiFiNetlinkMessage request;
+    uint8_t bssid[6];
+    
+    if (network == nil || ssid == nil || ssid.count == 0 || ssid.count > 32 || eventEngine == nil) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    CDAWiFiMACAddressGetOctets(network.bssidValue, bssid);
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, 0, NL80211_CMD_CONNECT);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_IFINDEX, _interfaceIndex);
+    CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_SSID, ssid.items, ssid.count);
+    CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_MAC, bssid, sizeof(bssid));
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_WIPHY_FREQ, network.frequency);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_AUTH_TYPE, NL80211_AUTHTYPE_OPEN_SYSTEM);
+    
+    /* A reassociation request, so the current AP can forward buffered frames to the new one. */
+    if (previousBSSID != 0) {
+        
+        uint8_t previous[6];
+        
+        CDAWiFiMACAddressGetOctets(previousBSSID, previous);
+        CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_PREV_BSSID, previous, sizeof(previous));
+    }
+    
+    switch (network.security) {
+        
+        case CDAWiFiSecurityNone:
+            break;
+        
+        case CDAWiFiSecurityWPAPersonal:
+        case CDAWiFiSecurityWPAPersonalMixed:
+        case CDAWiFiSecurityWPA2Personal:
+        case CDAWiFiSecurityPersonal:
+        {
+            uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+            size_t elementLength;
+            const uint8_t *element = [network informationElement:CDAWiFiInformationElementRSN length:&elementLength];
+            BOOL wpa = (element == NULL);
+            uint32_t groupCipher, pairwiseCipher;
+            
+            if (wpa) {
+                element = [network informationElement:CDAWiFiInformationElementWPA length:&elementLength];
+            }
+            
+            if (element == NULL || !CDAWiFiGetCipherSuites(element, elementLength, wpa, &groupCipher, &pairwiseCipher)) {
+                
+                if (error != NULL) {
+                    *error = CDAWiFiErrorWithCode(CDAWiFiInvalidInformationElementError);
+                }
+                
+                return NO;
+            }
+            
+            /* Repeat connections find the key derived the first time. */
+            if (password != nil) {
+                
+                if (![self.client.pairwiseMasterKeyCache getPairwiseMasterKey:key forSSID:ssid passphrase:password error:error]) {
+                    return NO;
+                }
+                
+                OFDataArray *keyData = [OFDataArray dataArray];
+                
+                [keyData addItems:key count:sizeof(key)];
+                
+                [self setPairwiseMasterKey:keyData error:NULL];
+                
+                CDAWiFiSecureZero(keyData.items, keyData.count);
+            }
+            
+            [_keyMutex lock];
+            
+            BOOL hasKey = _hasPairwiseMasterKey;
+            
+            memcpy(key, _pairwiseMasterKey, sizeof(key));
+            
+            [_keyMutex unlock];
+            
+            if (!hasKey) {
+                
+                if (error != NULL) {
+                    *error = CDAWiFiErrorWithCode(CDAWiFiInvalidPMKError);
+                }
+                
+                return NO;
+            }
+            
+            CDAWiFiNetlinkMessagePutFlag(&request, NL80211_ATTR_PRIVACY);
+            CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_WPA_VERSIONS, wpa ? NL80211_WPA_VERSION_1 : NL80211_WPA_VERSION_2);
+            CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_CIPHER_SUITES_PAIRWISE, pairwiseCipher);
+            CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_CIPHER_SUITE_GROUP, groupCipher);
+            CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_AKM_SUITES, CDAWiFiAKMSuitePSK);
+            
+            /* The driver runs the 4-way handshake with the PMK. */
+            CDAWiFiNetlinkMessagePut(&request, NL80211_ATTR_PMK, key, sizeof(key));
+            
+            CDAWiFiSecureZero(key, sizeof(key));
+            
+            break;
+        }
+        
+        default:
+            
+            /* WEP and 802.1X need a supplicant. */
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiNotSupportedError);
+            }
+            
+            return NO;
+    }
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    dispatch_semaphore_t authorizationSemaphore = dispatch_semaphore_create(0);
+    __block uint16_t statusCode = CDAWiFiStatusCodeUnspecifiedFailure;
+    __block BOOL authorized = NO;
+    id authorizationObserver = nil;
+    
+    if (![eventEngine startAndReturnError:error]) {
+        
+        CDAWiFiSecureZero(&request, sizeof(request));
+        CDAWiFiDispatchRelease(semaphore);
+        CDAWiFiDispatchRelease(authorizationSemaphore);
+        
+        return NO;
+    }
+    
+    /* Observe before connecting, so the completion can not be missed. */
+    id observer = [eventEngine addConnectObserverForInterfaceIndex:_interfaceIndex handler:^(uint16_t completionStatusCode) {
+        
+        statusCode = completionStatusCode;
+        
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    /* The connection completes before the 4-way handshake, the port is only usable once authorized. */
+    if (network.security != CDAWiFiSecurityNone) {
+        
+        authorizationObserver = [eventEngine addAuthorizationObserverForInterfaceIndex:_interfaceIndex handler:^(BOOL portAuthorized) {
+            
+            authorized = portAuthorized;
+            
+            dispatch_semaphore_signal(authorizationSemaphore);
+        }];
+    }
+    
+    dispatch_time_t deadline = dispatch_time(DISPATCH_TIME_NOW, CDAWiFiInterfaceAssociationTimeout * NSEC_PER_SEC);
+    BOOL success = [_socket performRequests:&request count:1 handler:nil results:NULL error:error];
+    
+    CDAWiFiSecureZero(&request, sizeof(request));
+    
+    if (success && dispatch_semaphore_wait(semaphore, deadline) != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiTimeoutError);
+        }
+        
+        success = NO;
+    }
+    
+    if (success && statusCode != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithStatusCode(statusCode);
+        }
+        
+        success = NO;
+    }
+    
+    if (success && authorizationObserver != nil) {
+        
+        if (dispatch_semaphore_wait(authorizationSemaphore, deadline) != 0) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiSupplicantTimeoutError);
+            }
+            
+            /* Do not stay associated with a port that never opened. */
+            [self disassociate];
+            
+            success = NO;
+            
+        } else if (!authorized) {
+            
+            /* The AP tears the connection down when the handshake fails, most often because of a wrong passphrase. */
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidPMKError);
+            }
+            
+            success = NO;
+        }
+    }
+    
+    [eventEngine removeConnectObserver:observer];
+    
+    if (authorizationObserver != nil) {
+        [eventEngine removeAuthorizationObserver:authorizationObserver];
+    }
+    
+    CDAWiFiDispatchRelease(semaphore);
+    CDAWiFiDispatchRelease(authorizationSemaphore);
+    
+    [self invalidateState];
+    
+    return success;
+}
+
+- (void)disassociate
+{
+    CDAWiFiNetlinkMessage request;
+    
+    CDAWiFiNetlinkMessageInit(&request, _socket.nl80211FamilyID, 0, NL80211_CMD_DISCONNECT);
+    CDAWiFiNetlinkMessagePutU32(&request, NL80211_ATTR_IFINDEX, _interfaceIndex);
+    CDAWiFiNetlinkMessagePutU16(&request, NL80211_ATTR_REASON_CODE, CDAWiFiReasonCodeDeauthenticationLeaving);
+    
+    [_socket performRequests:&request count:1 handler:nil results:NULL error:NULL];
+    
+    [self invalidateState];
+}
 
 @end
@@ -0,0 +1,65 @@
+//
+//  CDAWiFiInterfaceState+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/12/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiInterfaceState.h>
+
+/*!
+ * @typedef CDAWiFiInterfaceSnapshot
+ *
+ * @abstract Every value of an interface state, as parsed from a single batched exchange with the kernel.
+ */
+typedef struct CDAWiFiInterfaceSnapshot {
+    BOOL powerOn;
+    BOOL serviceActive;
+    CDAWiFiInterfaceMode interfaceMode;
+    
+    CDAWiFiMACAddress hardwareAddress;
+    
+    uint8_t ssid[32];
+    size_t ssidLength;
+    
+    BOOL associated;
+    CDAWiFiMACAddress bssid;
+    int rssi;
+    uint32_t transmitBitrate; /* 100 kbit/s */
+    CDAWiFiPHYMode activePHYMode;
+    
+    uint32_t frequency;
+    uint32_t channelWidth; /* enum nl80211_chan_width */
+    int noise;
+    
+    BOOL hasTransmitPower;
+    int transmitPower; /* mBm */
+    
+    CDAWiFiCountryCode countryCode;
+} CDAWiFiInterfaceSnapshot;
+
+@class CDAWiFiSSID;
+
+@interface CDAWiFiInterfaceState (Private)
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes a state with the values of a snapshot. Only the channel and the interned SSID are created up front,
+ * the string properties are formatted when asked for.
+ */
+- (instancetype)initWithSnapshot:(const CDAWiFiInterfaceSnapshot *)snapshot
+                        security:(CDAWiFiSecurity)security
+                       timestamp:(double)timestamp;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interned SSID, or nil if the interface is not participating in a network.
+ */
+@property (readonly) CDAWiFiSSID *internedSSID;
+
+@end
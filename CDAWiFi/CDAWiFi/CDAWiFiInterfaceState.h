@@ -0,0 +1,188 @@
+//
+//  CDAWiFiInterfaceState.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/12/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiChannel;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * An immutable snapshot of the state of a Wi-Fi interface.
+ *
+ * @discussion
+ * Every value was fetched by the same nl80211 exchange, so they are consistent with each other.
+ * The properties match the getters of CDAWiFiInterface, which read them from the current state.
+ */
+@interface CDAWiFiInterfaceState : OFObject
+
+/*!
+ * @property
+ *
+ * @abstract
+ * When the state was fetched, in seconds on the CDAWiFiMonotonicTime() clock.
+ */
+@property (readonly) double timestamp;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Whether the interface is powered on.
+ */
+@property (readonly) BOOL powerOn;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Whether the interface is up and its link is running.
+ */
+@property (readonly) BOOL serviceActive;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The operating mode of the interface.
+ */
+@property (readonly) CDAWiFiInterfaceMode interfaceMode;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The hardware media access control (MAC) address, or 0.
+ */
+@property (readonly) CDAWiFiMACAddress hardwareAddressValue;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The hardware media access control (MAC) address, as a string of 6 colon separated hexadecimal octets, or nil.
+ */
+@property (readonly) OFString *hardwareAddress;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The current service set identifier (SSID) decoded as an UTF-8 string, or nil.
+ */
+@property (readonly) OFString *ssid;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * A new copy of the SSID octets, or nil.
+ */
+@property (readonly) OFDataArray *ssidData;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Whether the interface is associated to an access point. Always NO unless the interface is in station mode,
+ * the peers of an access point or an IBSS are not reported here.
+ */
+@property (readonly, getter=isAssociated) BOOL associated;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The basic service set identifier (BSSID), or 0 if the interface is not associated.
+ */
+@property (readonly) CDAWiFiMACAddress bssidValue;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The BSSID as a string of 6 colon separated hexadecimal octets, or nil if the interface is not associated.
+ */
+@property (readonly) OFString *bssid;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The aggregate received signal strength indication (RSSI) measurement (dBm), or 0 if the interface is not associated.
+ */
+@property (readonly) int rssiValue;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The aggregate noise measurement (dBm), or 0 if the interface is not associated or the driver does not report it.
+ */
+@property (readonly) int noiseMeasurement;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The transmit rate (Mbit/s), or 0 if the interface is not associated.
+ */
+@property (readonly) double transmitRate;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The active physical layer (PHY) mode.
+ */
+@property (readonly) CDAWiFiPHYMode activePHYMode;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The current channel, or nil.
+ */
+@property (readonly) CDAWiFiChannel *wlanChannel;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The security type of the associated network, or CDAWiFiSecurityUnknown.
+ */
+@property (readonly) CDAWiFiSecurity security;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The regulatory country code, or 0 if the interface is powered off.
+ */
+@property (readonly) CDAWiFiCountryCode countryCodeValue;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The regulatory country code as a string of 2 characters, or nil.
+ */
+@property (readonly) OFString *countryCode;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The transmit power (mW), or 0 if the driver does not report it.
+ */
+@property (readonly) int transmitPower;
+
+@end
@@ -0,0 +1,104 @@
+//
+//  CDAWiFiInterfaceState.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/12/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiInterfaceState.h"
+#import "CDAWiFiInterfaceState+Private.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiChannel+Private.h"
+#import "CDAWiFiSSID.h"
+#import "CDAWiFiUtilities.h"
+#include <math.h>
+
+@implementation CDAWiFiInterfaceState
+{
+    CDAWiFiSSID *_internedSSID;
+}
+
+@synthesize timestamp = _timestamp, powerOn = _powerOn, serviceActive = _serviceActive, interfaceMode = _interfaceMode;
+@synthesize hardwareAddressValue = _hardwareAddressValue, internedSSID = _internedSSID;
+@synthesize associated = _associated, bssidValue = _bssidValue;
+@synthesize rssiValue = _rssiValue, noiseMeasurement = _noiseMeasurement, transmitRate = _transmitRate;
+@synthesize activePHYMode = _activePHYMode, wlanChannel = _wlanChannel, security = _security;
+@synthesize countryCodeValue = _countryCodeValue, transmitPower = _transmitPower;
+
+- (instancetype)initWithSnapshot:(const CDAWiFiInterfaceSnapshot *)snapshot
+                        security:(CDAWiFiSecurity)security
+                       timestamp:(double)timestamp
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _timestamp = timestamp;
+        _powerOn = snapshot->powerOn;
+        _serviceActive = snapshot->serviceActive;
+        _interfaceMode = snapshot->interfaceMode;
+        _activePHYMode = snapshot->activePHYMode;
+        _security = security;
+        
+        _hardwareAddressValue = snapshot->hardwareAddress;
+        
+        if (snapshot->ssidLength != 0) {
+            _internedSSID = [CDAWiFiSSID SSIDWithBytes:snapshot->ssid length:snapshot->ssidLength];
+        }
+        
+        if (snapshot->frequency != 0) {
+            _wlanChannel = [CDAWiFiChannel channelWithFrequency:snapshot->frequency nl80211ChannelWidth:snapshot->channelWidth];
+        }
+        
+        /* Link values are only meaningful while associated. */
+        if (snapshot->associated) {
+            
+            _associated = YES;
+            _bssidValue = snapshot->bssid;
+            _rssiValue = snapshot->rssi;
+            _noiseMeasurement = snapshot->noise;
+            _transmitRate = snapshot->transmitBitrate / 10.0;
+        }
+        
+        if (snapshot->powerOn) {
+            _countryCodeValue = snapshot->countryCode;
+        }
+        
+        /* mBm to mW */
+        if (snapshot->hasTransmitPower) {
+            _transmitPower = (int)lround(pow(10.0, snapshot->transmitPower / 1000.0));
+        }
+    }
+    
+    return self;
+}
+
+/* The string forms are only formatted when asked for, most states are replaced before anyone reads them. */
+- (OFString *)hardwareAddress
+{
+    return (_hardwareAddressValue != 0) ? CDAWiFiMACAddressString(_hardwareAddressValue) : nil;
+}
+
+- (OFString *)bssid
+{
+    return _associated ? CDAWiFiMACAddressString(_bssidValue) : nil;
+}
+
+- (OFString *)countryCode
+{
+    return CDAWiFiCountryCodeString(_countryCodeValue);
+}
+
+- (OFString *)ssid
+{
+    return _internedSSID.string;
+}
+
+- (OFDataArray *)ssidData
+{
+    /* OFDataArray is mutable, so the state never hands out its own bytes. */
+    return _internedSSID.data;
+}
+
+@end
@@ -0,0 +1,180 @@
+//
+//  CDAWiFiLinkSampler.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/12/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiInterface;
+
+/*!
+ * @constant CDAWiFiLinkSamplerDefaultCapacity
+ *
+ * @abstract The default number of samples a sampler keeps, 20 seconds at 50 Hz.
+ */
+#define CDAWiFiLinkSamplerDefaultCapacity 1024
+
+/*!
+ * @typedef CDAWiFiLinkSample
+ *
+ * @abstract A measurement of the link of an associated interface.
+ */
+typedef struct CDAWiFiLinkSample {
+    double timestamp;       /* Seconds, CDAWiFiMonotonicTime() clock */
+    int rssiValue;          /* dBm */
+    int noiseMeasurement;   /* dBm, 0 if unknown */
+    double transmitRate;    /* Mbit/s */
+} CDAWiFiLinkSample;
+
+/*!
+ * @typedef CDAWiFiLinkMetricStatistics
+ *
+ * @abstract The statistics of one metric over a window of samples.
+ *
+ * @discussion
+ * The average is an exponentially weighted moving average with a span of the number of samples in the window,
+ * newest samples weighing most. Percentiles use the nearest rank.
+ */
+typedef struct CDAWiFiLinkMetricStatistics {
+    double average;
+    double minimum;
+    double maximum;
+    double median;
+    double percentile95;
+    double percentile99;
+} CDAWiFiLinkMetricStatistics;
+
+/*!
+ * @typedef CDAWiFiLinkStatistics
+ *
+ * @abstract The statistics of every metric over a window of samples.
+ */
+typedef struct CDAWiFiLinkStatistics {
+    size_t sampleCount;
+    CDAWiFiLinkMetricStatistics rssi;
+    CDAWiFiLinkMetricStatistics noise;          /* Samples without a noise measurement are left out */
+    CDAWiFiLinkMetricStatistics transmitRate;
+} CDAWiFiLinkStatistics;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Samples the link of an interface at a fixed rate into a lock free ring, and aggregates windows of samples on demand.
+ *
+ * @discussion
+ * Each tick reads the station information of the access point in a single netlink exchange. The noise floor changes
+ * slowly, the channel survey is only dumped once per second.
+ *
+ * The sampler's queue is the only writer of the ring. Every slot carries a sequence number, readers copy samples
+ * optimistically and retry nothing: a sample overwritten while being copied ends the window. Readers never take a lock,
+ * and never delay the sampler. Ticks are skipped while the interface is not associated.
+ */
+@interface CDAWiFiLinkSampler : OFObject
+
+/*!
+ * @method
+ *
+ * @param interface
+ * The interface to sample.
+ *
+ * @param capacity
+ * The number of samples kept, rounded up to a power of two.
+ */
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface capacity:(size_t)capacity;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interface the sampler measures.
+ */
+@property (readonly) CDAWiFiInterface *interface;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The number of samples kept.
+ */
+@property (readonly) size_t capacity;
+
+/*! @functiongroup Sampling */
+
+/*!
+ * @method
+ *
+ * @param frequency
+ * The number of samples per second.
+ *
+ * @abstract
+ * Starts sampling, or changes the frequency if the sampler is running.
+ */
+- (void)startWithFrequency:(double)frequency;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Stops sampling. The samples are kept.
+ */
+- (void)stop;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The number of samples recorded since the sampler was created, including the overwritten ones.
+ */
+@property (readonly) uint64_t sampleCount;
+
+/*! @functiongroup Reading Samples */
+
+/*!
+ * @method
+ *
+ * @result
+ * NO if there is no sample yet.
+ *
+ * @abstract
+ * Copies the newest sample.
+ */
+- (BOOL)getLatestSample:(CDAWiFiLinkSample *)sample;
+
+/*!
+ * @method
+ *
+ * @param samples
+ * A C array of maximumCount elements which upon return contains the samples, oldest first.
+ *
+ * @param window
+ * The age (seconds) of the oldest sample copied.
+ *
+ * @result
+ * The number of samples copied.
+ *
+ * @abstract
+ * Copies the newest samples within a window.
+ */
+- (size_t)getSamples:(CDAWiFiLinkSample *)samples maximumCount:(size_t)maximumCount window:(of_time_interval_t)window;
+
+/*!
+ * @method
+ *
+ * @param window
+ * The age (seconds) of the oldest sample aggregated.
+ *
+ * @result
+ * NO if there is no sample within the window.
+ *
+ * @abstract
+ * Computes the statistics of the samples within a window.
+ */
+- (BOOL)getStatistics:(CDAWiFiLinkStatistics *)statistics window:(of_time_interval_t)window;
+
+@end
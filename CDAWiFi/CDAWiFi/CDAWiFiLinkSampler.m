@@ -0,0 +1,352 @@
+//
+//  CDAWiFiLinkSampler.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/12/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiLinkSampler.h"
+#import "CDAWiFiInterface.h"
+#import "CDAWiFiInterface+Private.h"
+#import "CDAWiFiUtilities.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Interval (seconds) between channel survey dumps. */
+#define CDAWiFiLinkSamplerNoiseInterval 1.0
+
+/*
+ * A sample of the ring. The sequence is 2 * (n + 1) once sample n is written, and odd while it is being written.
+ * Every field is atomic so readers racing the writer read stale values instead of torn ones, then reject them.
+ */
+typedef struct CDAWiFiLinkSamplerSlot {
+    atomic_uint_fast64_t sequence;
+    atomic_uint_fast64_t timestamp;     /* Bits of the double */
+    atomic_uint_fast64_t transmitRate;  /* Bits of the double */
+    atomic_int rssiValue;
+    atomic_int noiseMeasurement;
+} CDAWiFiLinkSamplerSlot;
+
+static inline uint64_t CDAWiFiLinkSamplerBitsFromDouble(double value)
+{
+    uint64_t bits;
+    
+    memcpy(&bits, &value, sizeof(bits));
+    
+    return bits;
+}
+
+static inline double CDAWiFiLinkSamplerDoubleFromBits(uint64_t bits)
+{
+    double value;
+    
+    memcpy(&value, &bits, sizeof(value));
+    
+    return value;
+}
+
+static void CDAWiFiLinkSamplerSlotWrite(CDAWiFiLinkSamplerSlot *slot, uint64_t index, const CDAWiFiLinkSample *sample)
+{
+    atomic_store_explicit(&slot->sequence, 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    atomic_store_explicit(&slot->timestamp, CDAWiFiLinkSamplerBitsFromDouble(sample->timestamp), memory_order_relaxed);
+    atomic_store_explicit(&slot->transmitRate, CDAWiFiLinkSamplerBitsFromDouble(sample->transmitRate), memory_order_relaxed);
+    atomic_store_explicit(&slot->rssiValue, sample->rssiValue, memory_order_relaxed);
+    atomic_store_explicit(&slot->noiseMeasurement, sample->noiseMeasurement, memory_order_relaxed);
+    
+    atomic_store_explicit(&slot->sequence, 2 * index + 2, memory_order_release);
+}
+
+/* Returns NO if the slot does not hold sample index, or if it was overwritten while being copied. */
+static BOOL CDAWiFiLinkSamplerSlotRead(CDAWiFiLinkSamplerSlot *slot, uint64_t index, CDAWiFiLinkSample *sample)
+{
+    uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    
+    if (sequence != 2 * index + 2) {
+        return NO;
+    }
+    
+    sample->timestamp = CDAWiFiLinkSamplerDoubleFromBits(atomic_load_explicit(&slot->timestamp, memory_order_relaxed));
+    sample->transmitRate = CDAWiFiLinkSamplerDoubleFromBits(atomic_load_explicit(&slot->transmitRate, memory_order_relaxed));
+    sample->rssiValue = atomic_load_explicit(&slot->rssiValue, memory_order_relaxed);
+    sample->noiseMeasurement = atomic_load_explicit(&slot->noiseMeasurement, memory_order_relaxed);
+    
+    atomic_thread_fence(memory_order_acquire);
+    
+    return atomic_load_explicit(&slot->sequence, memory_order_relaxed) == sequence;
+}
+
+static int CDAWiFiLinkSamplerCompareDoubles(const void *first, const void *second)
+{
+    double a = *(const double *)first, b = *(const double *)second;
+    
+    return (a > b) - (a < b);
+}
+
+/* Computes the statistics of values, oldest first. Sorts values in place. */
+static void CDAWiFiLinkMetricStatisticsCompute(CDAWiFiLinkMetricStatistics *statistics, double *values, size_t count)
+{
+    memset(statistics, 0, sizeof(*statistics));
+    
+    if (count == 0) {
+        return;
+    }
+    
+    double alpha = 2.0 / (count + 1);
+    double average = values[0];
+    
+    for (size_t index = 1; index < count; index++) {
+        average += alpha * (values[index] - average);
+    }
+    
+    qsort(values, count, sizeof(double), CDAWiFiLinkSamplerCompareDoubles);
+    
+    /* Nearest rank, ceil(p * n) - 1 */
+    statistics->average = average;
+    statistics->minimum = values[0];
+    statistics->maximum = values[count - 1];
+    statistics->median = values[(size_t)ceil(0.50 * count) - 1];
+    statistics->percentile95 = values[(size_t)ceil(0.95 * count) - 1];
+    statistics->percentile99 = values[(size_t)ceil(0.99 * count) - 1];
+}
+
+@implementation CDAWiFiLinkSampler
+{
+    CDAWiFiLinkSamplerSlot *_slots;
+    uint64_t _mask;
+    atomic_uint_fast64_t _head;    /* Index of the next sample */
+    
+    /* Only used on the queue. */
+    dispatch_queue_t _queue;
+    dispatch_source_t _timer;
+    double _noiseTimestamp;
+    int _noiseMeasurement;
+}
+
+@synthesize interface = _interface, capacity = _capacity;
+
+#pragma mark - Initialization
+
+- (instancetype)init
+{
+    return [self initWithInterface:nil capacity:CDAWiFiLinkSamplerDefaultCapacity];
+}
+
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface capacity:(size_t)capacity
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _interface = interface;
+        _capacity = 2;
+        
+        while (_capacity < capacity) {
+            _capacity *= 2;
+        }
+        
+        /* Sequence 0 matches no sample, zeroed slots are empty. */
+        _mask = _capacity - 1;
+        _slots = calloc(_capacity, sizeof(CDAWiFiLinkSamplerSlot));
+        _queue = dispatch_queue_create("CDAWiFiLinkSampler", DISPATCH_QUEUE_SERIAL);
+        
+        atomic_init(&_head, 0);
+        
+        if (_slots == NULL || _interface == nil) {
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_timer != NULL) {
+        
+        dispatch_source_cancel(_timer);
+        
+        CDAWiFiDispatchRelease(_timer);
+    }
+    
+    if (_queue != NULL) {
+        CDAWiFiDispatchRelease(_queue);
+    }
+    
+    free(_slots);
+}
+
+#pragma mark - Sampling
+
+- (void)startWithFrequency:(double)frequency
+{
+    if (!(frequency > 0)) {
+        return;
+    }
+    
+    uint64_t interval = (uint64_t)(NSEC_PER_SEC / frequency);
+    
+    dispatch_sync(_queue, ^{
+        
+        if (_timer == NULL) {
+            
+            __weak CDAWiFiLinkSampler *weakSelf = self;
+            
+            _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+            
+            dispatch_source_set_event_handler(_timer, ^{
+                
+                [weakSelf recordSample];
+            });
+            
+            dispatch_resume(_timer);
+        }
+        
+        dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, 0), interval, interval / 20);
+    });
+}
+
+- (void)stop
+{
+    dispatch_sync(_queue, ^{
+        
+        if (_timer == NULL) {
+            return;
+        }
+        
+        dispatch_source_cancel(_timer);
+        
+        CDAWiFiDispatchRelease(_timer);
+        
+        _timer = NULL;
+    });
+}
+
+- (uint64_t)sampleCount
+{
+    return atomic_load_explicit(&_head, memory_order_acquire);
+}
+
+/* The single writer of the ring, runs on the queue. */
+- (void)recordSample
+{
+    CDAWiFiLinkSample sample;
+    BOOL includeNoise = (CDAWiFiMonotonicTime() - _noiseTimestamp >= CDAWiFiLinkSamplerNoiseInterval);
+    
+    if (![_interface getLinkSample:&sample includeNoise:includeNoise]) {
+        return;
+    }
+    
+    if (includeNoise) {
+        
+        _noiseTimestamp = sample.timestamp;
+        _noiseMeasurement = sample.noiseMeasurement;
+        
+    } else {
+        
+        sample.noiseMeasurement = _noiseMeasurement;
+    }
+    
+    uint64_t index = atomic_load_explicit(&_head, memory_order_relaxed);
+    
+    CDAWiFiLinkSamplerSlotWrite(&_slots[index & _mask], index, &sample);
+    
+    atomic_store_explicit(&_head, index + 1, memory_order_release);
+}
+
+#pragma mark - Reading Samples
+
+/* Copies the samples not older than oldestTimestamp, newest first, stopping at the first overwritten one. */
+- (size_t)copySamples:(CDAWiFiLinkSample *)samples maximumCount:(size_t)maximumCount oldestTimestamp:(double)oldestTimestamp
+{
+    uint64_t head = atomic_load_explicit(&_head, memory_order_acquire);
+    size_t count = 0;
+    
+    while (count < maximumCount && count < _capacity && count < head) {
+        
+        uint64_t index = head - 1 - count;
+        
+        if (!CDAWiFiLinkSamplerSlotRead(&_slots[index & _mask], index, &samples[count]) ||
+            samples[count].timestamp < oldestTimestamp) {
+            
+            break;
+        }
+        
+        count++;
+    }
+    
+    return count;
+}
+
+- (BOOL)getLatestSample:(CDAWiFiLinkSample *)sample
+{
+    return [self copySamples:sample maximumCount:1 oldestTimestamp:-INFINITY] == 1;
+}
+
+- (size_t)getSamples:(CDAWiFiLinkSample *)samples maximumCount:(size_t)maximumCount window:(of_time_interval_t)window
+{
+    size_t count = [self copySamples:samples maximumCount:maximumCount oldestTimestamp:CDAWiFiMonotonicTime() - window];
+    
+    for (size_t index = 0; index < count / 2; index++) {
+        
+        CDAWiFiLinkSample sample = samples[index];
+        
+        samples[index] = samples[count - 1 - index];
+        samples[count - 1 - index] = sample;
+    }
+    
+    return count;
+}
+
+- (BOOL)getStatistics:(CDAWiFiLinkStatistics *)statistics window:(of_time_interval_t)window
+{
+    CDAWiFiLinkSample *samples = malloc(_capacity * sizeof(CDAWiFiLinkSample));
+    double *values = malloc(_capacity * sizeof(double));
+    
+    memset(statistics, 0, sizeof(*statistics));
+    
+    if (samples == NULL || values == NULL) {
+        
+        free(samples);
+        free(values);
+        
+        return NO;
+    }
+    
+    size_t count = [self getSamples:samples maximumCount:_capacity window:window];
+    size_t noiseCount = 0;
+    
+    statistics->sampleCount = count;
+    
+    for (size_t index = 0; index < count; index++) {
+        values[index] = samples[index].rssiValue;
+    }
+    
+    CDAWiFiLinkMetricStatisticsCompute(&statistics->rssi, values, count);
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        if (samples[index].noiseMeasurement != 0) {
+            values[noiseCount++] = samples[index].noiseMeasurement;
+        }
+    }
+    
+    CDAWiFiLinkMetricStatisticsCompute(&statistics->noise, values, noiseCount);
+    
+    for (size_t index = 0; index < count; index++) {
+        values[index] = samples[index].transmitRate;
+    }
+    
+    CDAWiFiLinkMetricStatisticsCompute(&statistics->transmitRate, values, count);
+    
+    free(samples);
+    free(values);
+    
+    return count > 0;
+}
+
+@end
@@ -0,0 +1,32 @@
+//
+//  CDAWiFiMergedScanResult+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/7/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiMergedScanResult.h>
+
+@interface CDAWiFiMergedScanResult (Private)
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes a merged scan result with the first interface that saw the BSS.
+ */
+- (instancetype)initWithNetwork:(CDAWiFiNetwork *)network interfaceName:(OFString *)interfaceName;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Records the scan result of another interface for the same BSS.
+ *
+ * @discussion
+ * Not thread safe, merged scan results must be completed before they are published.
+ */
+- (void)addNetwork:(CDAWiFiNetwork *)network interfaceName:(OFString *)interfaceName;
+
+@end
@@ -0,0 +1,67 @@
+//
+//  CDAWiFiMergedScanResult.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/7/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiNetwork;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * A BSS seen by one or more Wi-Fi interfaces during a multi-radio scan.
+ *
+ * @discussion
+ * Returned by -[CDAWiFiClient scanForNetworksOnInterfaces:ssid:queue:completionHandler:].
+ * Two merged scan results are equal if they describe the same BSSID.
+ */
+@interface CDAWiFiMergedScanResult : OFObject
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The scan result of the interface that received the BSS with the strongest signal.
+ */
+@property (readonly) CDAWiFiNetwork *network;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The name of the interface that received the BSS with the strongest signal.
+ */
+@property (readonly) OFString *interfaceName;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The names of every interface that saw the BSS.
+ */
+@property (readonly) OFSet *interfaceNames;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The received signal strength indication (RSSI) measurement (dBm) of the BSS on every interface that saw it,
+ * as OFNumber objects keyed by interface name.
+ */
+@property (readonly) OFDictionary *rssiValues;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the RSSI measurement (dBm) of the BSS on the specified interface, or 0 if the interface did not see it.
+ */
+- (int)rssiValueForInterfaceName:(OFString *)interfaceName;
+
+@end
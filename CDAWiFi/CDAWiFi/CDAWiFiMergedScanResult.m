@@ -0,0 +1,79 @@
+//
+//  CDAWiFiMergedScanResult.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/7/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiMergedScanResult.h"
+#import "CDAWiFiMergedScanResult+Private.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+
+@implementation CDAWiFiMergedScanResult
+{
+    OFMutableDictionary *_rssiValues;
+}
+
+@synthesize rssiValues = _rssiValues;
+
+#pragma mark - Initialization
+
+- (instancetype)initWithNetwork:(CDAWiFiNetwork *)network interfaceName:(OFString *)interfaceName
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _network = network;
+        _interfaceName = interfaceName;
+        _rssiValues = [OFMutableDictionary dictionary];
+        _rssiValues[interfaceName] = [OFNumber numberWithInt:network.rssiValue];
+    }
+    
+    return self;
+}
+
+- (void)addNetwork:(CDAWiFiNetwork *)network interfaceName:(OFString *)interfaceName
+{
+    _rssiValues[interfaceName] = [OFNumber numberWithInt:network.rssiValue];
+    
+    if (network.rssiValue > _network.rssiValue) {
+        
+        _network = network;
+        _interfaceName = interfaceName;
+    }
+}
+
+#pragma mark - Properties
+
+- (OFSet *)interfaceNames
+{
+    return [OFSet setWithArray:[_rssiValues allKeys]];
+}
+
+- (int)rssiValueForInterfaceName:(OFString *)interfaceName
+{
+    return [_rssiValues[interfaceName] intValue];
+}
+
+#pragma mark - Equality
+
+- (bool)isEqual:(id)other
+{
+    if (other == self) {
+        return YES;
+    } else if (![other isKindOfClass:[CDAWiFiMergedScanResult class]]) {
+        return NO;
+    } else {
+        return _network.bssidValue == ((CDAWiFiMergedScanResult *)other)->_network.bssidValue;
+    }
+}
+
+- (uint32_t)hash
+{
+    return _network.hash;
+}
+
+@end
@@ -0,0 +1,328 @@
+//
+//  CDAWiFiNetlink.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/2/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/nl80211.h>
+
+/* Minimal generic netlink transport used to talk to nl80211. Not part of the public API. */
+
+/*! @functiongroup Building Messages */
+
+/*!
+ * @constant CDAWiFiNetlinkMessageCapacity
+ *
+ * @abstract Maximum size in bytes of a request built with CDAWiFiNetlinkMessage.
+ */
+#define CDAWiFiNetlinkMessageCapacity 1024
+
+/*!
+ * @typedef CDAWiFiNetlinkMessage
+ *
+ * @abstract A generic netlink request built in place, without any heap allocation.
+ */
+typedef struct CDAWiFiNetlinkMessage {
+    union {
+        struct nlmsghdr header;
+        uint8_t bytes[CDAWiFiNetlinkMessageCapacity];
+    } buffer;
+    BOOL overflow;
+} CDAWiFiNetlinkMessage;
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Initializes a generic netlink request for the specified family and command.
+ *
+ * @discussion
+ * NLM_F_REQUEST is always set. Pass NLM_F_DUMP in flags for dump requests.
+ */
+extern void CDAWiFiNetlinkMessageInit(CDAWiFiNetlinkMessage *message, uint16_t family, uint16_t flags, uint8_t command);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Appends an attribute to the message. Returns NO if the message capacity is exceeded.
+ */
+extern BOOL CDAWiFiNetlinkMessagePut(CDAWiFiNetlinkMessage *message, uint16_t type, const void *data, size_t length);
+
+static inline BOOL CDAWiFiNetlinkMessagePutU8(CDAWiFiNetlinkMessage *message, uint16_t type, uint8_t value)
+{
+    return CDAWiFiNetlinkMessagePut(message, type, &value, sizeof(value));
+}
+
+static inline BOOL CDAWiFiNetlinkMessagePutU16(CDAWiFiNetlinkMessage *message, uint16_t type, uint16_t value)
+{
+    return CDAWiFiNetlinkMessagePut(message, type, &value, sizeof(value));
+}
+
+static inline BOOL CDAWiFiNetlinkMessagePutU32(CDAWiFiNetlinkMessage *message, uint16_t type, uint32_t value)
+{
+    return CDAWiFiNetlinkMessagePut(message, type, &value, sizeof(value));
+}
+
+static inline BOOL CDAWiFiNetlinkMessagePutFlag(CDAWiFiNetlinkMessage *message, uint16_t type)
+{
+    return CDAWiFiNetlinkMessagePut(message, type, NULL, 0);
+}
+
+static inline BOOL CDAWiFiNetlinkMessagePutString(CDAWiFiNetlinkMessage *message, uint16_t type, const char *string)
+{
+    return CDAWiFiNetlinkMessagePut(message, type, string, strlen(string) + 1);
+}
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Opens a nested attribute. Close it with CDAWiFiNetlinkMessageEndNested().
+ *
+ * @result
+ * An opaque offset into the message, or 0 if the message capacity is exceeded.
+ */
+extern size_t CDAWiFiNetlinkMessageBeginNested(CDAWiFiNetlinkMessage *message, uint16_t type);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Closes a nested attribute opened with CDAWiFiNetlinkMessageBeginNested().
+ */
+extern void CDAWiFiNetlinkMessageEndNested(CDAWiFiNetlinkMessage *message, size_t nested);
+
+/*! @functiongroup Parsing Messages */
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Indexes the attributes in a buffer by type.
+ *
+ * @discussion
+ * The table must have room for maximumType + 1 entries. Missing attributes are set to NULL.
+ * Attributes are referenced in place, nothing is copied.
+ */
+extern void CDAWiFiNetlinkParseAttributes(const struct nlattr **table, int maximumType, const void *data, size_t length);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Indexes the top level attributes of a generic netlink message.
+ */
+extern void CDAWiFiNetlinkParseMessage(const struct nlattr **table, int maximumType, const struct nlmsghdr *message);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Indexes the attributes nested inside an attribute.
+ */
+static inline void CDAWiFiNetlinkParseNested(const struct nlattr **table, int maximumType, const struct nlattr *attribute)
+{
+    CDAWiFiNetlinkParseAttributes(table, maximumType,
+                                  (const uint8_t *)attribute + NLA_HDRLEN,
+                                  attribute->nla_len - NLA_HDRLEN);
+}
+
+static inline const void *CDAWiFiNetlinkAttributeData(const struct nlattr *attribute)
+{
+    return (const uint8_t *)attribute + NLA_HDRLEN;
+}
+
+static inline size_t CDAWiFiNetlinkAttributeLength(const struct nlattr *attribute)
+{
+    return attribute->nla_len - NLA_HDRLEN;
+}
+
+static inline uint8_t CDAWiFiNetlinkAttributeU8(const struct nlattr *attribute)
+{
+    return *(const uint8_t *)CDAWiFiNetlinkAttributeData(attribute);
+}
+
+static inline uint16_t CDAWiFiNetlinkAttributeU16(const struct nlattr *attribute)
+{
+    uint16_t value;
+    memcpy(&value, CDAWiFiNetlinkAttributeData(attribute), sizeof(value));
+    return value;
+}
+
+static inline uint32_t CDAWiFiNetlinkAttributeU32(const struct nlattr *attribute)
+{
+    uint32_t value;
+    memcpy(&value, CDAWiFiNetlinkAttributeData(attribute), sizeof(value));
+    return value;
+}
+
+static inline uint64_t CDAWiFiNetlinkAttributeU64(const struct nlattr *attribute)
+{
+    uint64_t value;
+    memcpy(&value, CDAWiFiNetlinkAttributeData(attribute), sizeof(value));
+    return value;
+}
+
+/*!
+ * @typedef CDAWiFiNetlinkResponseHandler
+ *
+ * @abstract Invoked for every data message received in response to a batch of requests.
+ *
+ * @param requestIndex
+ * The index of the request in the batch the message answers.
+ *
+ * @param message
+ * The response message. Only valid for the duration of the call.
+ */
+typedef void (^CDAWiFiNetlinkResponseHandler)(size_t requestIndex, const struct nlmsghdr *message);
+
+/*!
+ * @typedef CDAWiFiNetlinkEventHandler
+ *
+ * @abstract Invoked for every multicast message received.
+ *
+ * @param message
+ * The event message. Only valid for the duration of the call.
+ */
+typedef void (^CDAWiFiNetlinkEventHandler)(const struct nlmsghdr *message);
+
+/*!
+ * @constant CDAWiFiNetlinkMaximumBatchCount
+ *
+ * @abstract Maximum number of requests that can be sent in a single batch.
+ */
+#define CDAWiFiNetlinkMaximumBatchCount 16
+
+/*!
+ * @class
+ *
+ * @abstract
+ * A long-lived generic netlink socket bound to the nl80211 family.
+ *
+ * @discussion
+ * Requests are sent in batches: all the messages of a batch are written with a single system call
+ * and every reply is read back before the method returns, so a batch costs one kernel round trip.
+ * The socket is serialized internally and can be shared between threads.
+ */
+@interface CDAWiFiNetlinkSocket : OFObject
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The file descriptor of the underlying netlink socket.
+ */
+@property (readonly) int fileDescriptor;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The generic netlink family identifier of nl80211.
+ */
+@property (readonly) uint16_t nl80211FamilyID;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Opens a generic netlink socket and resolves the nl80211 family.
+ *
+ * @discussion
+ * Returns nil if the socket can not be opened, or if the kernel does not provide nl80211.
+ */
+- (instancetype)initAndReturnError:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the identifier of the nl80211 multicast group with the specified name (e.g. "scan"), or 0 if there is none.
+ */
+- (uint32_t)multicastGroupIDWithName:(OFString *)name;
+
+/*!
+ * @method
+ *
+ * @param name
+ * The name of an nl80211 multicast group (e.g. "scan").
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Subscribes the socket to an nl80211 multicast group.
+ *
+ * @discussion
+ * Events are interleaved with request replies, use a dedicated socket to receive them.
+ */
+- (BOOL)addMembershipToMulticastGroupWithName:(OFString *)name error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @param handler
+ * Invoked on the calling thread for every message received. Must not use the receiver.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Reads every message queued on the socket, without blocking.
+ *
+ * @discussion
+ * Fails with CDAWiFiNoMemoryError if the kernel dropped messages because the socket buffer overflowed.
+ * The messages queued after the overflow are still delivered.
+ */
+- (BOOL)receiveEventsWithHandler:(CDAWiFiNetlinkEventHandler)handler error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @param requests
+ * A C array of requests. Sequence numbers are assigned by the receiver.
+ *
+ * @param count
+ * The number of requests, at most CDAWiFiNetlinkMaximumBatchCount.
+ *
+ * @param handler
+ * Invoked on the calling thread for every data message received. Must not use the receiver.
+ *
+ * @param results
+ * A C array of count elements which upon return contains the errno value reported for each request (0 on success).
+ * This parameter is optional. If specified, kernel errors for individual requests do not fail the batch.
+ *
+ * @result
+ * YES if every request succeeded (or, if results is specified, if the batch could be exchanged), NO otherwise.
+ *
+ * @abstract
+ * Sends a batch of requests with a single system call and waits for every reply.
+ *
+ * @discussion
+ * Every reply is drained even if a request fails, so the socket always stays in sync.
+ * If several requests fail, the error of the first failure is returned.
+ * The kernel runs one dump per socket at a time, so when a batch contains several dump requests
+ * each additional dump is sent as soon as the previous one completes.
+ */
+- (BOOL)performRequests:(CDAWiFiNetlinkMessage *)requests
+                  count:(size_t)count
+                handler:(CDAWiFiNetlinkResponseHandler)handler
+                results:(int *)results
+                  error:(out CDAError **)error;
+
+@end
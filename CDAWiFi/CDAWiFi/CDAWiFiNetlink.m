@@ -0,0 +1,565 @@
+//
+//  CDAWiFiNetlink.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/2/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiNetlink.h"
+#import "CDAWiFiUtilities.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+
+/* Large enough for the biggest nl80211 dump message (wiphy and scan results). */
+#define CDAWiFiNetlinkReceiveBufferSize (64 * 1024)
+
+/* Upper bound for a single request/response exchange. */
+#define CDAWiFiNetlinkReceiveTimeout 5
+
+#pragma mark - Building Messages
+
+void CDAWiFiNetlinkMessageInit(CDAWiFiNetlinkMessage *message, uint16_t family, uint16_t flags, uint8_t command)
+{
+    struct genlmsghdr *genericHeader;
+    
+    memset(&message->buffer.header, 0, NLMSG_HDRLEN + GENL_HDRLEN);
+    
+    message->overflow = NO;
+    message->buffer.header.nlmsg_len = NLMSG_HDRLEN + GENL_HDRLEN;
+    message->buffer.header.nlmsg_type = family;
+    message->buffer.header.nlmsg_flags = NLM_F_REQUEST | flags;
+    
+    genericHeader = (struct genlmsghdr *)(message->buffer.bytes + NLMSG_HDRLEN);
+    genericHeader->cmd = command;
+    genericHeader->version = 0;
+}
+
+BOOL CDAWiFiNetlinkMessagePut(CDAWiFiNetlinkMessage *message, uint16_t type, const void *data, size_t length)
+{
+    size_t offset = NLMSG_ALIGN(message->buffer.header.nlmsg_len);
+    size_t attributeLength = NLA_HDRLEN + length;
+    struct nlattr *attribute;
+    
+    if (offset + NLA_ALIGN(attributeLength) > CDAWiFiNetlinkMessageCapacity || attributeLength > UINT16_MAX) {
+        message->overflow = YES;
+        return NO;
+    }
+    
+    attribute = (struct nlattr *)(message->buffer.bytes + offset);
+    attribute->nla_type = type;
+    attribute->nla_len = (uint16_t)attributeLength;
+    
+    if (length > 0) {
+        memcpy(message->buffer.bytes + offset + NLA_HDRLEN, data, length);
+    }
+    
+    memset(message->buffer.bytes + offset + attributeLength, 0, NLA_ALIGN(attributeLength) - attributeLength);
+    
+    message->buffer.header.nlmsg_len = (uint32_t)(offset + NLA_ALIGN(attributeLength));
+    
+    return YES;
+}
+
+size_t CDAWiFiNetlinkMessageBeginNested(CDAWiFiNetlinkMessage *message, uint16_t type)
+{
+    size_t offset = NLMSG_ALIGN(message->buffer.header.nlmsg_len);
+    
+    if (!CDAWiFiNetlinkMessagePut(message, type | NLA_F_NESTED, NULL, 0)) {
+        return 0;
+    }
+    
+    return offset;
+}
+
+void CDAWiFiNetlinkMessageEndNested(CDAWiFiNetlinkMessage *message, size_t nested)
+{
+    struct nlattr *attribute;
+    
+    if (nested == 0) {
+        return;
+    }
+    
+    attribute = (struct nlattr *)(message->buffer.bytes + nested);
+    attribute->nla_len = (uint16_t)(message->buffer.header.nlmsg_len - nested);
+}
+
+#pragma mark - Parsing Messages
+
+void CDAWiFiNetlinkParseAttributes(const struct nlattr **table, int maximumType, const void *data, size_t length)
+{
+    const uint8_t *cursor = data;
+    const uint8_t *end = cursor + length;
+    
+    memset(table, 0, sizeof(*table) * (maximumType + 1));
+    
+    while (cursor + NLA_HDRLEN <= end) {
+        
+        const struct nlattr *attribute = (const struct nlattr *)cursor;
+        int type = attribute->nla_type & NLA_TYPE_MASK;
+        
+        if (attribute->nla_len < NLA_HDRLEN || cursor + attribute->nla_len > end) {
+            break;
+        }
+        
+        if (type <= maximumType) {
+            table[type] = attribute;
+        }
+        
+        cursor += NLA_ALIGN(attribute->nla_len);
+    }
+}
+
+void CDAWiFiNetlinkParseMessage(const struct nlattr **table, int maximumType, const struct nlmsghdr *message)
+{
+    size_t headerLength = NLMSG_HDRLEN + GENL_HDRLEN;
+    
+    if (message->nlmsg_len < headerLength) {
+        memset(table, 0, sizeof(*table) * (maximumType + 1));
+        return;
+    }
+    
+    CDAWiFiNetlinkParseAttributes(table, maximumType,
+                                  (const uint8_t *)message + headerLength,
+                                  message->nlmsg_len - headerLength);
+}
+
+#pragma mark - Socket
+
+@implementation CDAWiFiNetlinkSocket
+{
+    int _fileDescriptor;
+    uint16_t _nl80211FamilyID;
+    uint32_t _sequenceNumber;
+    OFMutex *_mutex;
+    uint8_t *_receiveBuffer;
+    OFMutableDictionary *_multicastGroups;
+}
+
+@synthesize fileDescriptor = _fileDescriptor, nl80211FamilyID = _nl80211FamilyID;
+
+#pragma mark - Initialization
+
+- (instancetype)init
+{
+    return [self initAndReturnError:NULL];
+}
+
+- (instancetype)initAndReturnError:(out CDAError **)error
+{
+    self = [super init];
+    
+    if (self) {
+        
+        struct sockaddr_nl address;
+        struct timeval timeout = { .tv_sec = CDAWiFiNetlinkReceiveTimeout };
+        int receiveBufferSize = 256 * 1024;
+        
+        _mutex = [OFMutex mutex];
+        _multicastGroups = [OFMutableDictionary dictionary];
+        _sequenceNumber = (uint32_t)time(NULL);
+        
+        _fileDescriptor = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+        
+        if (_fileDescriptor < 0) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errno);
+            }
+            
+            return nil;
+        }
+        
+        setsockopt(_fileDescriptor, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+        setsockopt(_fileDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        
+        memset(&address, 0, sizeof(address));
+        address.nl_family = AF_NETLINK;
+        
+        if (bind(_fileDescriptor, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errno);
+            }
+            
+            return nil;
+        }
+        
+        _receiveBuffer = malloc(CDAWiFiNetlinkReceiveBufferSize);
+        
+        if (_receiveBuffer == NULL) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiNoMemoryError);
+            }
+            
+            return nil;
+        }
+        
+        if (![self resolveFamilyAndReturnError:error]) {
+            
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0) {
+        close(_fileDescriptor);
+    }
+    
+    free(_receiveBuffer);
+}
+
+#pragma mark - Family
+
+- (BOOL)resolveFamilyAndReturnError:(out CDAError **)error
+{
+    CDAWiFiNetlinkMessage request;
+    __block uint16_t familyID = 0;
+    OFMutableDictionary *multicastGroups = _multicastGroups;
+    
+    CDAWiFiNetlinkMessageInit(&request, GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY);
+    CDAWiFiNetlinkMessagePutString(&request, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME);
+    
+    BOOL success = [self performRequests:&request count:1 handler:^(size_t requestIndex, const struct nlmsghdr *message) {
+        
+        const struct nlattr *attributes[CTRL_ATTR_MAX + 1];
+        
+        CDAWiFiNetlinkParseMessage(attributes, CTRL_ATTR_MAX, message);
+        
+        if (attributes[CTRL_ATTR_FAMILY_ID] != NULL) {
+            familyID = CDAWiFiNetlinkAttributeU16(attributes[CTRL_ATTR_FAMILY_ID]);
+        }
+        
+        if (attributes[CTRL_ATTR_MCAST_GROUPS] != NULL) {
+            
+            const struct nlattr *groups = attributes[CTRL_ATTR_MCAST_GROUPS];
+            const uint8_t *cursor = CDAWiFiNetlinkAttributeData(groups);
+            const uint8_t *end = cursor + CDAWiFiNetlinkAttributeLength(groups);
+            
+            while (cursor + NLA_HDRLEN <= end) {
+                
+                const struct nlattr *group = (const struct nlattr *)cursor;
+                const struct nlattr *groupAttributes[CTRL_ATTR_MCAST_GRP_MAX + 1];
+                
+                if (group->nla_len < NLA_HDRLEN || cursor + group->nla_len > end) {
+                    break;
+                }
+                
+                CDAWiFiNetlinkParseNested(groupAttributes, CTRL_ATTR_MCAST_GRP_MAX, group);
+                
+                if (groupAttributes[CTRL_ATTR_MCAST_GRP_NAME] != NULL &&
+                    groupAttributes[CTRL_ATTR_MCAST_GRP_ID] != NULL) {
+                    
+                    OFString *name = [OFString stringWithUTF8String:CDAWiFiNetlinkAttributeData(groupAttributes[CTRL_ATTR_MCAST_GRP_NAME])];
+                    uint32_t groupID = CDAWiFiNetlinkAttributeU32(groupAttributes[CTRL_ATTR_MCAST_GRP_ID]);
+                    
+                    multicastGroups[name] = [OFNumber numberWithUInt32:groupID];
+                }
+                
+                cursor += NLA_ALIGN(group->nla_len);
+            }
+        }
+        
+    } results:NULL error:error];
+    
+    if (!success) {
+        return NO;
+    }
+    
+    if (familyID == 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiNotSupportedError);
+        }
+        
+        return NO;
+    }
+    
+    _nl80211FamilyID = familyID;
+    
+    return YES;
+}
+
+- (uint32_t)multicastGroupIDWithName:(OFString *)name
+{
+    return [_multicastGroups[name] uInt32Value];
+}
+
+- (BOOL)addMembershipToMulticastGroupWithName:(OFString *)name error:(out CDAError **)error
+{
+    uint32_t groupID = [self multicastGroupIDWithName:name];
+    
+    if (groupID == 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiNotSupportedError);
+        }
+        
+        return NO;
+    }
+    
+    if (setsockopt(_fileDescriptor, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &groupID, sizeof(groupID)) != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errno);
+        }
+        
+        return NO;
+    }
+    
+    return YES;
+}
+
+#pragma mark - Events
+
+- (BOOL)receiveEventsWithHandler:(CDAWiFiNetlinkEventHandler)handler error:(out CDAError **)error
+{
+    int receiveError = 0;
+    
+    [_mutex lock];
+    
+    for (;;) {
+        
+        ssize_t length = recv(_fileDescriptor, _receiveBuffer, CDAWiFiNetlinkReceiveBufferSize, MSG_DONTWAIT);
+        
+        if (length < 0) {
+            
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            /* Keep draining after an overflow, report it once the queue is empty. */
+            if (errno == ENOBUFS) {
+                receiveError = ENOBUFS;
+                continue;
+            }
+            
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                receiveError = errno;
+            }
+            
+            break;
+        }
+        
+        for (const struct nlmsghdr *message = (const struct nlmsghdr *)_receiveBuffer;
+             NLMSG_OK(message, length);
+             message = NLMSG_NEXT(message, length)) {
+            
+            if (message->nlmsg_type != NLMSG_NOOP && message->nlmsg_type != NLMSG_ERROR &&
+                message->nlmsg_type != NLMSG_DONE) {
+                
+                handler(message);
+            }
+        }
+    }
+    
+    [_mutex unlock];
+    
+    if (receiveError != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(receiveError);
+        }
+        
+        return NO;
+    }
+    
+    return YES;
+}
+
+#pragma mark - Requests
+
+/* Writes messages with a single system call. Returns 0 or an errno value. */
+- (int)sendVectors:(struct iovec *)vectors count:(size_t)count
+{
+    struct sockaddr_nl kernel = { .nl_family = AF_NETLINK };
+    struct msghdr header;
+    ssize_t sent;
+    
+    memset(&header, 0, sizeof(header));
+    header.msg_name = &kernel;
+    header.msg_namelen = sizeof(kernel);
+    header.msg_iov = vectors;
+    header.msg_iovlen = count;
+    
+    do {
+        sent = sendmsg(_fileDescriptor, &header, 0);
+    } while (sent < 0 && errno == EINTR);
+    
+    return (sent < 0) ? errno : 0;
+}
+
+- (BOOL)performRequests:(CDAWiFiNetlinkMessage *)requests
+                  count:(size_t)count
+                handler:(CDAWiFiNetlinkResponseHandler)handler
+                results:(int *)results
+                  error:(out CDAError **)error
+{
+    struct iovec vectors[CDAWiFiNetlinkMaximumBatchCount];
+    size_t vectorCount = 0;
+    BOOL finished[CDAWiFiNetlinkMaximumBatchCount];
+    size_t deferredDumps[CDAWiFiNetlinkMaximumBatchCount];
+    size_t deferredDumpCount = 0;
+    size_t nextDeferredDump = 0;
+    BOOL dumpInFlight = NO;
+    size_t pending = count;
+    uint32_t firstSequenceNumber;
+    int firstError = 0;
+    int transportError = 0;
+    
+    if (count == 0 || count > CDAWiFiNetlinkMaximumBatchCount) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        if (requests[index].overflow) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+            }
+            
+            return NO;
+        }
+    }
+    
+    [_mutex lock];
+    
+    firstSequenceNumber = _sequenceNumber + 1;
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        struct nlmsghdr *request = &requests[index].buffer.header;
+        
+        request->nlmsg_seq = ++_sequenceNumber;
+        request->nlmsg_pid = 0;
+        finished[index] = NO;
+        
+        if (results != NULL) {
+            results[index] = 0;
+        }
+        
+        /* Dumps are terminated by NLMSG_DONE, everything else by an acknowledgement. */
+        if (!(request->nlmsg_flags & NLM_F_DUMP)) {
+            request->nlmsg_flags |= NLM_F_ACK;
+        }
+        
+        /* The kernel runs a single dump per socket at a time (a second one fails with EBUSY),
+           so further dumps are sent as soon as the previous one is done. */
+        if ((request->nlmsg_flags & NLM_F_DUMP) && dumpInFlight) {
+            deferredDumps[deferredDumpCount++] = index;
+            continue;
+        }
+        
+        if (request->nlmsg_flags & NLM_F_DUMP) {
+            dumpInFlight = YES;
+        }
+        
+        vectors[vectorCount].iov_base = request;
+        vectors[vectorCount].iov_len = request->nlmsg_len;
+        vectorCount++;
+    }
+    
+    transportError = [self sendVectors:vectors count:vectorCount];
+    
+    while (pending > 0 && transportError == 0) {
+        
+        ssize_t length = recv(_fileDescriptor, _receiveBuffer, CDAWiFiNetlinkReceiveBufferSize, 0);
+        
+        if (length < 0) {
+            
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            /* Timed out or lost messages (ENOBUFS): the batch can not be completed. */
+            transportError = errno;
+            
+            break;
+        }
+        
+        for (const struct nlmsghdr *message = (const struct nlmsghdr *)_receiveBuffer;
+             NLMSG_OK(message, length);
+             message = NLMSG_NEXT(message, length)) {
+            
+            /* Modulo 2^32, so a batch whose sequence numbers wrap around is matched like any other. */
+            size_t index = (uint32_t)(message->nlmsg_seq - firstSequenceNumber);
+            
+            /* Stale replies to an earlier, aborted batch. */
+            if (index >= count || finished[index]) {
+                continue;
+            }
+            
+            if (message->nlmsg_type == NLMSG_DONE || message->nlmsg_type == NLMSG_ERROR) {
+                
+                if (message->nlmsg_type == NLMSG_ERROR) {
+                    
+                    const struct nlmsgerr *errorMessage = NLMSG_DATA(message);
+                    
+                    if (errorMessage->error != 0) {
+                        
+                        if (results != NULL) {
+                            results[index] = -errorMessage->error;
+                        }
+                        
+                        if (firstError == 0) {
+                            firstError = -errorMessage->error;
+                        }
+                    }
+                }
+                
+                finished[index] = YES;
+                pending--;
+                
+                if ((requests[index].buffer.header.nlmsg_flags & NLM_F_DUMP) && nextDeferredDump < deferredDumpCount) {
+                    
+                    struct nlmsghdr *request = &requests[deferredDumps[nextDeferredDump++]].buffer.header;
+                    struct iovec vector = { .iov_base = request, .iov_len = request->nlmsg_len };
+                    
+                    transportError = [self sendVectors:&vector count:1];
+                }
+                
+            } else if (message->nlmsg_type != NLMSG_NOOP && handler != nil) {
+                
+                handler(index, message);
+            }
+        }
+    }
+    
+    [_mutex unlock];
+    
+    if (transportError != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(transportError);
+        }
+        
+        return NO;
+    }
+    
+    if (firstError != 0 && results == NULL) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(firstError);
+        }
+        
+        return NO;
+    }
+    
+    return YES;
+}
+
+@end
@@ -0,0 +1,172 @@
+//
+//  CDAWiFiNetwork+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/3/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiNetwork.h>
+#import <CDAWiFi/CDAWiFiScanSnapshot.h>
+#import "CDAWiFiInformationElements.h"
+
+@class CDAWiFiScanArena, CDAWiFiSSID;
+
+struct nlattr;
+
+@interface CDAWiFiNetwork (Private)
+
+/*!
+ * @method
+ *
+ * @param attribute
+ * The NL80211_ATTR_BSS attribute of an NL80211_CMD_NEW_SCAN_RESULTS message.
+ *
+ * @param noiseMeasurement
+ * The noise floor (dBm) of the channel the BSS was seen on, or 0 if unknown.
+ *
+ * @param arena
+ * The arena of the scan dump, the information elements are copied to it. If nil, they get an arena of their own.
+ *
+ * @abstract
+ * Initializes a CDAWiFiNetwork object from an nl80211 scan result.
+ *
+ * @discussion
+ * Returns nil if the attribute does not describe a valid BSS.
+ * Information elements are copied once and indexed lazily, on first access.
+ */
+- (instancetype)initWithBSSAttribute:(const struct nlattr *)attribute
+                    noiseMeasurement:(int)noiseMeasurement
+                               arena:(CDAWiFiScanArena *)arena;
+
+/*!
+ * @method
+ *
+ * @param index
+ * The index of informationElementData, typically built in bulk with CDAWiFiInformationElementIndexBuildBatch().
+ *
+ * @abstract
+ * Sets the information element index, so it is not built lazily.
+ *
+ * @discussion
+ * Does nothing if the index was already built.
+ */
+- (void)setInformationElementIndex:(const CDAWiFiInformationElementIndex *)index;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the body of an information element, in place, or NULL if the network does not advertise it.
+ */
+- (const uint8_t *)informationElement:(CDAWiFiInformationElement)element length:(size_t *)length;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The information elements, in place. Their length is informationElementLength.
+ */
+@property (readonly) const uint8_t *informationElements;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The length of the information elements.
+ */
+@property (readonly) size_t informationElementLength;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The center frequency (MHz) the BSS was seen on.
+ */
+@property (readonly) uint32_t frequency;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * YES if the interface is associated to this BSS.
+ */
+@property (readonly) BOOL associated;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * When the BSS was last heard, in seconds on the CDAWiFiMonotonicTime() clock.
+ *
+ * @discussion
+ * Derived from the age the kernel reports with the scan result. Networks restored from a snapshot,
+ * and drivers that do not report the age, use the time the network was decoded.
+ */
+@property (readonly) double lastSeen;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interned SSID, or nil if the network does not advertise one. Compare SSIDs with it, not with ssidData.
+ */
+@property (readonly) CDAWiFiSSID *internedSSID;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the strongest security type advertised by the network.
+ */
+- (CDAWiFiSecurity)security;
+
+/*!
+ * @method
+ *
+ * @param network
+ * A scan result for the same BSS.
+ *
+ * @param rssiTolerance
+ * The RSSI difference (dB) under which the signal is considered unchanged.
+ *
+ * @abstract
+ * Returns YES if network carries the same scan result, NO if anything a client can observe changed.
+ */
+- (BOOL)isScanResultEqualToNetwork:(CDAWiFiNetwork *)network rssiTolerance:(int)rssiTolerance;
+
+/*!
+ * @method
+ *
+ * @param record
+ * A snapshot record.
+ *
+ * @param informationElements
+ * The record->informationElementLength bytes of information elements of the record.
+ *
+ * @param lastSeen
+ * When the BSS was last heard, in seconds on the CDAWiFiMonotonicTime() clock.
+ *
+ * @param arena
+ * The arena the information elements are copied to. If nil, they get an arena of their own.
+ *
+ * @abstract
+ * Initializes a CDAWiFiNetwork object from a scan snapshot record.
+ */
+- (instancetype)initWithSnapshotRecord:(const CDAWiFiScanSnapshotRecord *)record
+                   informationElements:(const uint8_t *)informationElements
+                              lastSeen:(double)lastSeen
+                                 arena:(CDAWiFiScanArena *)arena;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Fills the BSS fields of a snapshot record.
+ *
+ * @discussion
+ * ssidOffset is set relative to informationElements. The offsets, lengths and channel index are left to the writer.
+ */
+- (void)getSnapshotRecord:(CDAWiFiScanSnapshotRecord *)record;
+
+@end
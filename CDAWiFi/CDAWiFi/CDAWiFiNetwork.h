@@ -47,6 +47,17 @@
  */
 @property (readonly) NSString *bssid;
 
+/*!
+ * @property
+ *
+ * @abstract
+ * Returns the basic service set identifier (BSSID) for the Wi-Fi network device, as a packed integer.
+ *
+ * @discussion
+ * Prefer this property to bssid to compare or key networks, it does not allocate.
+ */
+@property (readonly) CDAWiFiMACAddress bssidValue;
+
 /*!
  * @property
  *
@@ -76,6 +87,16 @@
  *
  * @abstract
  * Returns information element data included in beacon or probe response frames.
+ *
+ * @discussion
+ * Networks returned by -[CDAWiFiInterface cachedScanResults] come with their elements already indexed,
+ * in one pass over the whole scan dump. Other networks are indexed once, on first access to
+ * wlanChannel, countryCode, -[CDAWiFiNetwork supportsSecurity:] or -[CDAWiFiNetwork supportsPHYMode:].
+ * Each accessor then decodes only the element it needs, in place. The SSID is interned when the network is decoded,
+ * networks of the same ESS share its octets and its string.
+ *
+ * The elements of every network decoded from a scan dump are stored together, and freed with the last of those networks.
+ * This property returns a copy of them.
  */
 @property (readonly) OFBigDataArray *informationElementData;
 
@@ -87,6 +108,14 @@
  */
 @property (readonly) OFString *countryCode;
 
+/*!
+ * @property
+ *
+ * @abstract
+ * Returns the advertised country code for the Wi-Fi device, as a packed integer. 0 if none is advertised.
+ */
+@property (readonly) CDAWiFiCountryCode countryCodeValue;
+
 /*!
  * @property
  *
@@ -7,7 +7,414 @@
 //
 
 #import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiChannel+Private.h"
+#import "CDAWiFiNetlink.h"
+#import "CDAWiFiScanArena.h"
+#import "CDAWiFiSSID.h"
+#import "CDAWiFiUtilities.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/* Capability information field (IEEE 802.11-2012, 8.4.1.4) */
+#define CDAWiFiCapabilityIBSS       (1 << 1)
+#define CDAWiFiCapabilityPrivacy    (1 << 4)
+
+/* Element ID of the SSID (IEEE 802.11-2012, 8.4.2.2) */
+#define CDAWiFiNetworkElementIDSSID 0
+
+/* States of the lazily built information element index. */
+enum {
+    CDAWiFiNetworkIndexUnbuilt  = 0,
+    CDAWiFiNetworkIndexBuilding = 1,
+    CDAWiFiNetworkIndexBuilt    = 2
+};
 
 @implementation CDAWiFiNetwork
+{
+    CDAWiFiMACAddress _bssid;
+    uint32_t _frequency;
+    uint16_t _capability;
+    uint16_t _beaconInterval;
+    BOOL _associated;
+    double _lastSeen;
+    
+    /* Information elements, in the arena of the scan the network was decoded from. */
+    CDAWiFiScanArena *_arena;
+    const uint8_t *_informationElements;
+    size_t _informationElementLength;
+    
+    /* Interned SSID, nil if the network does not advertise one. */
+    CDAWiFiSSID *_ssid;
+    
+    _Atomic(int) _informationElementIndexState;
+    CDAWiFiInformationElementIndex _informationElementIndex;
+}
+
+@synthesize rssiValue = _rssiValue, noiseMeasurement = _noiseMeasurement;
+@synthesize frequency = _frequency, associated = _associated, bssidValue = _bssid, lastSeen = _lastSeen;
+@synthesize informationElements = _informationElements, informationElementLength = _informationElementLength;
+@synthesize internedSSID = _ssid;
+
+#pragma mark - Initialization
+
+- (instancetype)initWithBSSAttribute:(const struct nlattr *)attribute
+                    noiseMeasurement:(int)noiseMeasurement
+                               arena:(CDAWiFiScanArena *)arena
+{
+    self = [super init];
+    
+    if (self) {
+        
+        const struct nlattr *bss[NL80211_BSS_MAX + 1];
+        const struct nlattr *informationElements;
+        
+        CDAWiFiNetlinkParseNested(bss, NL80211_BSS_MAX, attribute);
+        
+        if (bss[NL80211_BSS_BSSID] == NULL || CDAWiFiNetlinkAttributeLength(bss[NL80211_BSS_BSSID]) != 6 ||
+            bss[NL80211_BSS_FREQUENCY] == NULL) {
+            
+            return nil;
+        }
+        
+        _bssid = CDAWiFiMACAddressMake(CDAWiFiNetlinkAttributeData(bss[NL80211_BSS_BSSID]));
+        _frequency = CDAWiFiNetlinkAttributeU32(bss[NL80211_BSS_FREQUENCY]);
+        
+        if (bss[NL80211_BSS_CAPABILITY] != NULL) {
+            _capability = CDAWiFiNetlinkAttributeU16(bss[NL80211_BSS_CAPABILITY]);
+        }
+        
+        if (bss[NL80211_BSS_BEACON_INTERVAL] != NULL) {
+            _beaconInterval = CDAWiFiNetlinkAttributeU16(bss[NL80211_BSS_BEACON_INTERVAL]);
+        }
+        
+        if (bss[NL80211_BSS_SIGNAL_MBM] != NULL) {
+            _rssiValue = (int32_t)CDAWiFiNetlinkAttributeU32(bss[NL80211_BSS_SIGNAL_MBM]) / 100;
+        }
+        
+        if (bss[NL80211_BSS_STATUS] != NULL) {
+            _associated = (CDAWiFiNetlinkAttributeU32(bss[NL80211_BSS_STATUS]) == NL80211_BSS_STATUS_ASSOCIATED);
+        }
+        
+        _lastSeen = CDAWiFiMonotonicTime();
+        
+        if (bss[NL80211_BSS_SEEN_MS_AGO] != NULL) {
+            _lastSeen -= CDAWiFiNetlinkAttributeU32(bss[NL80211_BSS_SEEN_MS_AGO]) / 1000.0;
+        }
+        
+        _noiseMeasurement = noiseMeasurement;
+        
+        /* Probe response elements are more complete than beacon elements, prefer them. */
+        informationElements = bss[NL80211_BSS_INFORMATION_ELEMENTS];
+        
+        if (informationElements == NULL) {
+            informationElements = bss[NL80211_BSS_BEACON_IES];
+        }
+        
+        if (![self setInformationElements:(informationElements != NULL) ? CDAWiFiNetlinkAttributeData(informationElements) : NULL
+                                   length:(informationElements != NULL) ? CDAWiFiNetlinkAttributeLength(informationElements) : 0
+                                    arena:arena]) {
+            
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSnapshotRecord:(const CDAWiFiScanSnapshotRecord *)record
+                   informationElements:(const uint8_t *)informationElements
+                              lastSeen:(double)lastSeen
+                                 arena:(CDAWiFiScanArena *)arena
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _bssid = record->bssid;
+        _frequency = record->frequency;
+        _capability = record->capability;
+        _beaconInterval = record->beaconInterval;
+        _rssiValue = record->rssiValue;
+        _noiseMeasurement = record->noiseMeasurement;
+        _associated = (record->flags & CDAWiFiScanSnapshotRecordFlagAssociated) != 0;
+        _lastSeen = lastSeen;
+        
+        if (![self setInformationElements:informationElements length:record->informationElementLength arena:arena]) {
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+/* Copies the information elements to the arena, or to an arena of their own if there is none. */
+- (BOOL)setInformationElements:(const uint8_t *)informationElements length:(size_t)length arena:(CDAWiFiScanArena *)arena
+{
+    if (arena == nil) {
+        arena = [[CDAWiFiScanArena alloc] initWithChunkSize:length];
+    }
+    
+    _informationElements = [arena addBytes:informationElements length:length];
+    _informationElementLength = length;
+    _arena = arena;
+    
+    if (_informationElements == NULL) {
+        return NO;
+    }
+    
+    /* The SSID is the first element of beacons and probe responses, no need for the index to find it. */
+    for (size_t offset = 0; offset + 2 <= length && offset + 2 + _informationElements[offset + 1] <= length;
+         offset += 2 + _informationElements[offset + 1]) {
+        
+        if (_informationElements[offset] == CDAWiFiNetworkElementIDSSID) {
+            
+            _ssid = [CDAWiFiSSID SSIDWithBytes:_informationElements + offset + 2 length:_informationElements[offset + 1]];
+            
+            break;
+        }
+    }
+    
+    return YES;
+}
+
+- (id)copy
+{
+    /* Immutable */
+    return self;
+}
+
+#pragma mark - Information Elements
+
+- (void)setInformationElementIndex:(const CDAWiFiInformationElementIndex *)index
+{
+    int expected = CDAWiFiNetworkIndexUnbuilt;
+    
+    /* An index already built (or being built) from the same bytes is identical. */
+    if (atomic_compare_exchange_strong(&_informationElementIndexState, &expected, CDAWiFiNetworkIndexBuilding)) {
+        
+        _informationElementIndex = *index;
+        
+        atomic_store_explicit(&_informationElementIndexState, CDAWiFiNetworkIndexBuilt, memory_order_release);
+    }
+}
+
+/*
+ * Returns the information element index, building it on first access.
+ * If another thread is building it at the same time, the index is built into buffer instead of waiting.
+ */
+- (const CDAWiFiInformationElementIndex *)informationElementIndexWithBuffer:(CDAWiFiInformationElementIndex *)buffer
+{
+    int state = atomic_load_explicit(&_informationElementIndexState, memory_order_acquire);
+    
+    if (state == CDAWiFiNetworkIndexBuilt) {
+        return &_informationElementIndex;
+    }
+    
+    int expected = CDAWiFiNetworkIndexUnbuilt;
+    
+    if (atomic_compare_exchange_strong(&_informationElementIndexState, &expected, CDAWiFiNetworkIndexBuilding)) {
+        
+        CDAWiFiInformationElementIndexBuild(&_informationElementIndex, _informationElements, _informationElementLength);
+        
+        atomic_store_explicit(&_informationElementIndexState, CDAWiFiNetworkIndexBuilt, memory_order_release);
+        
+        return &_informationElementIndex;
+    }
+    
+    CDAWiFiInformationElementIndexBuild(buffer, _informationElements, _informationElementLength);
+    
+    return buffer;
+}
+
+/* Returns the body of an information element, in place. */
+- (const uint8_t *)informationElement:(CDAWiFiInformationElement)element length:(size_t *)length
+{
+    CDAWiFiInformationElementIndex buffer;
+    const CDAWiFiInformationElementIndex *index = [self informationElementIndexWithBuffer:&buffer];
+    
+    return CDAWiFiInformationElementIndexGet(index, _informationElements, element, length);
+}
+
+#pragma mark - Properties
+
+- (OFBigDataArray *)informationElementData
+{
+    OFBigDataArray *informationElementData = [OFBigDataArray dataArray];
+    
+    [informationElementData addItems:_informationElements count:_informationElementLength];
+    
+    return informationElementData;
+}
+
+- (OFString *)ssid
+{
+    return _ssid.string;
+}
+
+- (OFDataArray *)ssidData
+{
+    return _ssid.data;
+}
+
+- (OFString *)bssid
+{
+    return CDAWiFiMACAddressString(_bssid);
+}
+
+- (CDAWiFiChannel *)wlanChannel
+{
+    CDAWiFiInformationElementIndex buffer;
+    const CDAWiFiInformationElementIndex *index = [self informationElementIndexWithBuffer:&buffer];
+    int channelNumber = CDAWiFiChannelNumberForFrequency(_frequency);
+    
+    if (channelNumber == 0) {
+        return nil;
+    }
+    
+    return [CDAWiFiChannel channelWithChannelNumber:channelNumber
+                                       channelWidth:CDAWiFiInformationElementIndexChannelWidth(index, _informationElements)
+                                        channelBand:CDAWiFiChannelBandForFrequency(_frequency)];
+}
+
+- (OFString *)countryCode
+{
+    return CDAWiFiCountryCodeString(self.countryCodeValue);
+}
+
+- (CDAWiFiCountryCode)countryCodeValue
+{
+    size_t length;
+    const uint8_t *country = [self informationElement:CDAWiFiInformationElementCountry length:&length];
+    
+    if (country == NULL || length < 2) {
+        return 0;
+    }
+    
+    return CDAWiFiCountryCodeMake(country);
+}
+
+- (int)beaconInterval
+{
+    /* Time units (1024 µs) to milliseconds */
+    return (int)((_beaconInterval * 1024 + 500) / 1000);
+}
+
+- (BOOL)ibss
+{
+    return (_capability & CDAWiFiCapabilityIBSS) != 0;
+}
+
+- (CDAWiFiSecurity)security
+{
+    CDAWiFiInformationElementIndex buffer;
+    const CDAWiFiInformationElementIndex *index = [self informationElementIndexWithBuffer:&buffer];
+    
+    return CDAWiFiInformationElementIndexSecurity(index, _informationElements, (_capability & CDAWiFiCapabilityPrivacy) != 0);
+}
+
+#pragma mark - Security
+
+- (BOOL)supportsSecurity:(CDAWiFiSecurity)security
+{
+    CDAWiFiInformationElementIndex buffer;
+    const CDAWiFiInformationElementIndex *index = [self informationElementIndexWithBuffer:&buffer];
+    
+    return CDAWiFiInformationElementIndexSupportsSecurity(index, _informationElements,
+                                                          (_capability & CDAWiFiCapabilityPrivacy) != 0, security);
+}
+
+#pragma mark - PHY Modes
+
+- (BOOL)supportsPHYMode:(CDAWiFiPHYMode)phyMode
+{
+    CDAWiFiInformationElementIndex buffer;
+    const CDAWiFiInformationElementIndex *index = [self informationElementIndexWithBuffer:&buffer];
+    
+    return CDAWiFiInformationElementIndexSupportsPHYMode(index, _informationElements,
+                                                         CDAWiFiChannelBandForFrequency(_frequency), phyMode);
+}
+
+#pragma mark - Snapshots
+
+- (void)getSnapshotRecord:(CDAWiFiScanSnapshotRecord *)record
+{
+    size_t ssidLength;
+    const uint8_t *ssid = [self informationElement:CDAWiFiInformationElementSSID length:&ssidLength];
+    
+    memset(record, 0, sizeof(*record));
+    
+    record->bssid = _bssid;
+    record->frequency = _frequency;
+    record->rssiValue = (int16_t)_rssiValue;
+    record->noiseMeasurement = (int16_t)_noiseMeasurement;
+    record->capability = _capability;
+    record->beaconInterval = _beaconInterval;
+    record->flags = _associated ? CDAWiFiScanSnapshotRecordFlagAssociated : 0;
+    record->age = (uint32_t)OF_MIN(OF_MAX(CDAWiFiMonotonicTime() - _lastSeen, 0) * 1000, UINT32_MAX);
+    record->countryCode = self.countryCodeValue;
+    CDAWiFiSecurity security = self.security;
+    
+    record->security = (security <= CDAWiFiSecurityEnterprise) ? (uint8_t)security : UINT8_MAX;
+    
+    if (ssid != NULL) {
+        record->ssidOffset = (uint32_t)(ssid - _informationElements);
+        record->ssidLength = (uint8_t)ssidLength;
+    }
+}
+
+#pragma mark - Equality
+
+- (BOOL)isScanResultEqualToNetwork:(CDAWiFiNetwork *)network rssiTolerance:(int)rssiTolerance
+{
+    if (_bssid != network->_bssid ||
+        _frequency != network->_frequency ||
+        _capability != network->_capability ||
+        _beaconInterval != network->_beaconInterval ||
+        _associated != network->_associated ||
+        _noiseMeasurement != network->_noiseMeasurement ||
+        abs(_rssiValue - network->_rssiValue) >= rssiTolerance) {
+        
+        return NO;
+    }
+    
+    return _informationElementLength == network->_informationElementLength &&
+           memcmp(_informationElements, network->_informationElements, _informationElementLength) == 0;
+}
+
+- (BOOL)isEqualToNetwork:(CDAWiFiNetwork *)network
+{
+    if (!network) {
+        return NO;
+    }
+    
+    if (_bssid != network->_bssid) {
+        return NO;
+    }
+    
+    if (_ssid == nil || network->_ssid == nil) {
+        return _ssid == network->_ssid;
+    }
+    
+    return [_ssid isEqualToSSID:network->_ssid];
+}
+
+- (bool)isEqual:(id)other
+{
+    if (other == self) {
+        return YES;
+    } else if (![other isKindOfClass:[CDAWiFiNetwork class]]) {
+        return NO;
+    } else {
+        return [self isEqualToNetwork:other];
+    }
+}
+
+- (uint32_t)hash
+{
+    /* The low octets of a BSSID vary the most. */
+    return (uint32_t)_bssid ^ (uint32_t)(_bssid >> 32);
+}
 
 @end
@@ -0,0 +1,31 @@
+//
+//  CDAWiFiNetworkProfile+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiNetworkProfile.h>
+
+@class CDAWiFiSSID;
+
+@interface CDAWiFiNetworkProfile (Private)
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes a profile with an interned SSID, shared rather than copied.
+ */
+- (instancetype)initWithInternedSSID:(CDAWiFiSSID *)ssid security:(CDAWiFiSecurity)security;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interned SSID, or nil if none was set. Compare SSIDs with it, not with ssidData.
+ */
+@property (readonly) CDAWiFiSSID *internedSSID;
+
+@end
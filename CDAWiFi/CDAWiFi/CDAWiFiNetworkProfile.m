@@ -7,7 +7,135 @@
 //
 
 #import "CDAWiFiNetworkProfile.h"
+#import "CDAWiFiNetworkProfile+Private.h"
+#import "CDAWiFiSSID.h"
+
+@interface CDAWiFiNetworkProfile ()
+
+@property CDAWiFiSSID *internedSSID;
+
+@property CDAWiFiSecurity security;
+
+@end
 
 @implementation CDAWiFiNetworkProfile
 
+@synthesize internedSSID = _internedSSID, security = _security;
+
+#pragma mark - Initialization
+
++ (instancetype)networkProfile
+{
+    return [[self alloc] init];
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _security = CDAWiFiSecurityNone;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithNetworkProfile:(CDAWiFiNetworkProfile *)networkProfile
+{
+    self = [super init];
+    
+    if (self) {
+        
+        /* Interned SSIDs are immutable, the copy shares it. */
+        _internedSSID = networkProfile.internedSSID;
+        _security = networkProfile.security;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithInternedSSID:(CDAWiFiSSID *)ssid security:(CDAWiFiSecurity)security
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _internedSSID = ssid;
+        _security = security;
+    }
+    
+    return self;
+}
+
++ (instancetype)networkProfileWithNetworkProfile:(CDAWiFiNetworkProfile *)networkProfile
+{
+    return [[self alloc] initWithNetworkProfile:networkProfile];
+}
+
+#pragma mark - Properties
+
+- (OFString *)ssid
+{
+    return _internedSSID.string;
+}
+
+- (OFDataArray *)ssidData
+{
+    return _internedSSID.data;
+}
+
+#pragma mark - Comparing
+
+- (BOOL)isEqualToNetworkProfile:(CDAWiFiNetworkProfile *)networkProfile
+{
+    if (!networkProfile) {
+        return NO;
+    }
+    
+    if (_security != networkProfile.security) {
+        return NO;
+    }
+    
+    CDAWiFiSSID *ssid = networkProfile.internedSSID;
+    
+    if (_internedSSID == nil || ssid == nil) {
+        return _internedSSID == ssid;
+    }
+    
+    return [_internedSSID isEqualToSSID:ssid];
+}
+
+- (bool)isEqual:(id)other
+{
+    if (other == self) {
+        return YES;
+    } else if (![other isKindOfClass:[CDAWiFiNetworkProfile class]]) {
+        return NO;
+    } else {
+        return [self isEqualToNetworkProfile:other];
+    }
+}
+
+- (uint32_t)hash
+{
+    return _internedSSID.hash ^ (uint32_t)_security;
+}
+
+@end
+
+@implementation CDAWiFiMutableNetworkProfile
+
+@dynamic security;
+
+- (OFDataArray *)ssidData
+{
+    return [super ssidData];
+}
+
+- (void)setSsidData:(OFDataArray *)ssidData
+{
+    self.internedSSID = [CDAWiFiSSID SSIDWithData:ssidData];
+}
+
 @end
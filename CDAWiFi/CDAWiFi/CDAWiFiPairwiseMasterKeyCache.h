@@ -0,0 +1,118 @@
+//
+//  CDAWiFiPairwiseMasterKeyCache.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/10/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import "CDAWiFiCrypto.h"
+
+/*!
+ * @constant CDAWiFiPairwiseMasterKeyCacheDefaultCapacity
+ *
+ * @abstract The default number of keys a cache holds.
+ */
+#define CDAWiFiPairwiseMasterKeyCacheDefaultCapacity 64
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Caches the pairwise master keys derived from WPA passphrases, keyed by SSID and passphrase.
+ *
+ * @discussion
+ * Deriving a PMK takes 8192 SHA-1 compressions. Reconnecting to a network reuses the key derived on the first connection.
+ * Entries are found by the SHA-1 digest of the SSID and passphrase, the passphrase itself is not kept.
+ * When full, the least recently used key is evicted. Keys are zeroed when evicted and when the cache is deallocated.
+ *
+ * Thread safe. Keys are derived outside of the lock, so concurrent derivations do not wait for each other.
+ */
+@interface CDAWiFiPairwiseMasterKeyCache : OFObject
+
+/*!
+ * @method
+ *
+ * @param capacity
+ * The maximum number of keys held.
+ */
+- (instancetype)initWithCapacity:(size_t)capacity;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The maximum number of keys held.
+ */
+@property (readonly) size_t capacity;
+
+/*!
+ * @method
+ *
+ * @param key
+ * Upon return, the pairwise master key.
+ *
+ * @param ssid
+ * The SSID octets of the network.
+ *
+ * @param passphrase
+ * A passphrase of 8 to 63 printable ASCII characters, or the PSK as 64 hexadecimal digits.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Returns the cached key of a network, deriving and caching it on a miss.
+ *
+ * @discussion
+ * Fails with a CDAWiFiInvalidParameterError error if the SSID or the passphrase is invalid.
+ */
+- (BOOL)getPairwiseMasterKey:(uint8_t *)key
+                     forSSID:(OFDataArray *)ssid
+                  passphrase:(OFString *)passphrase
+                       error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @param ssids
+ * An OFArray of OFDataArray objects, the SSIDs of the networks.
+ *
+ * @param passphrases
+ * An OFArray of OFString objects, the passphrase of the network with the SSID at the same index.
+ *
+ * @result
+ * An OFArray of OFDataArray objects, the keys in the order of the SSIDs. Returns nil if an error occurs.
+ *
+ * @abstract
+ * Returns the keys of many networks, deriving every missing key in a single batch.
+ *
+ * @discussion
+ * The misses are derived with CDAWiFiPairwiseMasterKeyDeriveBatch(), in parallel, then cached.
+ * Fails with a CDAWiFiInvalidParameterError error if any SSID or passphrase is invalid, and caches nothing in that case.
+ */
+- (OFArray *)pairwiseMasterKeysForSSIDs:(OFArray *)ssids passphrases:(OFArray *)passphrases error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes the key of a network, for example after the network rejected it.
+ */
+- (void)removePairwiseMasterKeyForSSID:(OFDataArray *)ssid passphrase:(OFString *)passphrase;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes every key.
+ */
+- (void)removeAllPairwiseMasterKeys;
+
+@end
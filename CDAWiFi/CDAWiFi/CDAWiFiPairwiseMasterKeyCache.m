@@ -0,0 +1,327 @@
+//
+//  CDAWiFiPairwiseMasterKeyCache.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/10/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiPairwiseMasterKeyCache.h"
+#import "CDAWiFiUtilities.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    uint8_t tag[CDAWiFiSHA1DigestLength];
+    uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+    uint64_t lastUse;   /* 0 if the entry is free */
+    
+} CDAWiFiPairwiseMasterKeyCacheEntry;
+
+/* The tag of a network, SHA-1(length of SSID || SSID || passphrase). Returns NO if the SSID or passphrase is too long. */
+static BOOL CDAWiFiPairwiseMasterKeyCacheTag(uint8_t tag[CDAWiFiSHA1DigestLength],
+                                            OFDataArray *ssid,
+                                            const char *passphrase,
+                                            size_t passphraseLength)
+{
+    uint8_t message[1 + 32 + 2 * CDAWiFiPairwiseMasterKeyLength];
+    
+    if (ssid.count > 32 || passphraseLength > 2 * CDAWiFiPairwiseMasterKeyLength) {
+        return NO;
+    }
+    
+    message[0] = (uint8_t)ssid.count;
+    memcpy(message + 1, ssid.items, ssid.count);
+    memcpy(message + 1 + ssid.count, passphrase, passphraseLength);
+    
+    CDAWiFiSHA1(message, 1 + ssid.count + passphraseLength, tag);
+    
+    CDAWiFiSecureZero(message, sizeof(message));
+    
+    return YES;
+}
+
+@implementation CDAWiFiPairwiseMasterKeyCache
+{
+    OFMutex *_mutex;
+    CDAWiFiPairwiseMasterKeyCacheEntry *_entries;
+    uint64_t _useCount;
+}
+
+@synthesize capacity = _capacity;
+
+- (instancetype)init
+{
+    return [self initWithCapacity:CDAWiFiPairwiseMasterKeyCacheDefaultCapacity];
+}
+
+- (instancetype)initWithCapacity:(size_t)capacity
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _capacity = (capacity > 0) ? capacity : 1;
+        _entries = calloc(_capacity, sizeof(CDAWiFiPairwiseMasterKeyCacheEntry));
+        _mutex = [OFMutex mutex];
+        
+        if (_entries == NULL) {
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_entries != NULL) {
+        
+        CDAWiFiSecureZero(_entries, _capacity * sizeof(CDAWiFiPairwiseMasterKeyCacheEntry));
+        
+        free(_entries);
+    }
+}
+
+#pragma mark - Entries
+
+/* Returns the entry of a tag, or NULL. Must be called with the mutex locked. */
+- (CDAWiFiPairwiseMasterKeyCacheEntry *)entryWithTag:(const uint8_t *)tag
+{
+    for (size_t index = 0; index < _capacity; index++) {
+        
+        if (_entries[index].lastUse != 0 && memcmp(_entries[index].tag, tag, CDAWiFiSHA1DigestLength) == 0) {
+            return &_entries[index];
+        }
+    }
+    
+    return NULL;
+}
+
+/* Stores a key, evicting the least recently used one if needed. Must be called with the mutex locked. */
+- (void)storePairwiseMasterKey:(const uint8_t *)key withTag:(const uint8_t *)tag
+{
+    CDAWiFiPairwiseMasterKeyCacheEntry *entry = [self entryWithTag:tag];
+    
+    /* Another thread may have derived the same key meanwhile. */
+    if (entry == NULL) {
+        
+        entry = &_entries[0];
+        
+        for (size_t index = 1; index < _capacity && entry->lastUse != 0; index++) {
+            
+            if (_entries[index].lastUse < entry->lastUse) {
+                entry = &_entries[index];
+            }
+        }
+        
+        memcpy(entry->tag, tag, CDAWiFiSHA1DigestLength);
+        memcpy(entry->key, key, CDAWiFiPairwiseMasterKeyLength);
+    }
+    
+    entry->lastUse = ++_useCount;
+}
+
+- (BOOL)getPairwiseMasterKey:(uint8_t *)key
+                     forSSID:(OFDataArray *)ssid
+                  passphrase:(OFString *)passphrase
+                       error:(out CDAError **)error
+{
+    const char *passphraseBytes = [passphrase UTF8String];
+    size_t passphraseLength = [passphrase UTF8StringLength];
+    uint8_t tag[CDAWiFiSHA1DigestLength];
+    
+    if (ssid == nil || passphrase == nil || !CDAWiFiPairwiseMasterKeyCacheTag(tag, ssid, passphraseBytes, passphraseLength)) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    [_mutex lock];
+    
+    CDAWiFiPairwiseMasterKeyCacheEntry *entry = [self entryWithTag:tag];
+    
+    if (entry != NULL) {
+        
+        memcpy(key, entry->key, CDAWiFiPairwiseMasterKeyLength);
+        
+        entry->lastUse = ++_useCount;
+        
+        [_mutex unlock];
+        
+        return YES;
+    }
+    
+    [_mutex unlock];
+    
+    if (!CDAWiFiPairwiseMasterKeyDerive(passphraseBytes, passphraseLength, ssid.items, ssid.count, key)) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    [_mutex lock];
+    
+    [self storePairwiseMasterKey:key withTag:tag];
+    
+    [_mutex unlock];
+    
+    return YES;
+}
+
+- (OFArray *)pairwiseMasterKeysForSSIDs:(OFArray *)ssids passphrases:(OFArray *)passphrases error:(out CDAError **)error
+{
+    size_t count = ssids.count;
+    
+    if (passphrases.count != count) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return nil;
+    }
+    
+    if (count == 0) {
+        return [OFArray array];
+    }
+    
+    CDAWiFiPairwiseMasterKeyDerivation *derivations = calloc(count, sizeof(CDAWiFiPairwiseMasterKeyDerivation));
+    uint8_t (*tags)[CDAWiFiSHA1DigestLength] = calloc(count, CDAWiFiSHA1DigestLength);
+    BOOL *hits = calloc(count, sizeof(BOOL));
+    size_t missCount = 0, hitCount = 0;
+    BOOL valid = (derivations != NULL && tags != NULL && hits != NULL);
+    
+    /* Misses are gathered at the front of the derivations, the keys of hits are copied to the back. */
+    [_mutex lock];
+    
+    for (size_t index = 0; valid && index < count; index++) {
+        
+        OFDataArray *ssid = ssids[index];
+        OFString *passphrase = passphrases[index];
+        const char *passphraseBytes = [passphrase UTF8String];
+        size_t passphraseLength = [passphrase UTF8StringLength];
+        
+        if (!CDAWiFiPairwiseMasterKeyCacheTag(tags[index], ssid, passphraseBytes, passphraseLength)) {
+            
+            valid = NO;
+            
+            break;
+        }
+        
+        CDAWiFiPairwiseMasterKeyCacheEntry *entry = [self entryWithTag:tags[index]];
+        
+        if (entry != NULL) {
+            
+            memcpy(derivations[count - 1 - hitCount++].key, entry->key, CDAWiFiPairwiseMasterKeyLength);
+            
+            entry->lastUse = ++_useCount;
+            hits[index] = YES;
+            
+            continue;
+        }
+        
+        derivations[missCount].passphrase = passphraseBytes;
+        derivations[missCount].passphraseLength = passphraseLength;
+        derivations[missCount].ssid = ssid.items;
+        derivations[missCount].ssidLength = ssid.count;
+        missCount++;
+    }
+    
+    [_mutex unlock];
+    
+    if (valid) {
+        
+        CDAWiFiPairwiseMasterKeyDeriveBatch(derivations, missCount);
+        
+        for (size_t index = 0; index < missCount; index++) {
+            valid = valid && derivations[index].valid;
+        }
+    }
+    
+    OFMutableArray *keys = nil;
+    
+    if (valid) {
+        
+        keys = [OFMutableArray arrayWithCapacity:count];
+        
+        [_mutex lock];
+        
+        for (size_t index = 0, missIndex = 0, hitIndex = count - 1; index < count; index++) {
+            
+            OFDataArray *key = [OFDataArray dataArray];
+            
+            if (hits[index]) {
+                
+                [key addItems:derivations[hitIndex--].key count:CDAWiFiPairwiseMasterKeyLength];
+                
+            } else {
+                
+                [self storePairwiseMasterKey:derivations[missIndex].key withTag:tags[index]];
+                
+                [key addItems:derivations[missIndex++].key count:CDAWiFiPairwiseMasterKeyLength];
+            }
+            
+            [keys addObject:key];
+        }
+        
+        [_mutex unlock];
+        
+        [keys makeImmutable];
+        
+    } else if (error != NULL) {
+        
+        *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+    }
+    
+    if (derivations != NULL) {
+        
+        CDAWiFiSecureZero(derivations, count * sizeof(CDAWiFiPairwiseMasterKeyDerivation));
+        
+        free(derivations);
+    }
+    
+    free(tags);
+    free(hits);
+    
+    return keys;
+}
+
+- (void)removePairwiseMasterKeyForSSID:(OFDataArray *)ssid passphrase:(OFString *)passphrase
+{
+    uint8_t tag[CDAWiFiSHA1DigestLength];
+    
+    if (ssid == nil || passphrase == nil ||
+        !CDAWiFiPairwiseMasterKeyCacheTag(tag, ssid, [passphrase UTF8String], [passphrase UTF8StringLength])) {
+        
+        return;
+    }
+    
+    [_mutex lock];
+    
+    CDAWiFiPairwiseMasterKeyCacheEntry *entry = [self entryWithTag:tag];
+    
+    if (entry != NULL) {
+        CDAWiFiSecureZero(entry, sizeof(*entry));
+    }
+    
+    [_mutex unlock];
+}
+
+- (void)removeAllPairwiseMasterKeys
+{
+    [_mutex lock];
+    
+    CDAWiFiSecureZero(_entries, _capacity * sizeof(CDAWiFiPairwiseMasterKeyCacheEntry));
+    
+    [_mutex unlock];
+}
+
+@end
@@ -0,0 +1,32 @@
+//
+//  CDAWiFiProfileStore+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiProfileStore.h>
+
+@interface CDAWiFiProfileStore (Private)
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Changes on every update of the store.
+ */
+@property (readonly) uint64_t generation;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Calls a block with the SSID of every profile, straight from the mapped records, without creating any object.
+ *
+ * @result
+ * The generation of the profiles enumerated.
+ */
+- (uint64_t)enumerateSSIDsUsingBlock:(void (^)(const uint8_t *ssid, size_t length))block;
+
+@end
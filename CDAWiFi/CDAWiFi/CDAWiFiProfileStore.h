@@ -0,0 +1,149 @@
+//
+//  CDAWiFiProfileStore.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiNetwork, CDAWiFiNetworkProfile;
+
+/*!
+ * @constant CDAWiFiProfileStoreVersion
+ *
+ * @abstract The profile store format version written by this library.
+ */
+#define CDAWiFiProfileStoreVersion 1
+
+/*!
+ * @class
+ *
+ * @abstract
+ * A persistent database of known network profiles, keyed by SSID and security type.
+ *
+ * @discussion
+ * The store file holds fixed width profile records and an open addressed hash table of their SSID and security type.
+ * It is mapped, not parsed: opening it only checks that the table and the records stay inside the file,
+ * and lookups then probe the table in place. CDAWiFiNetworkProfile objects are only created for the profiles found,
+ * so thousands of profiles cost neither startup time nor memory when only a few of their SSIDs are on the air.
+ *
+ * Updates never modify the mapped file. Every update writes a new file next to it, flushes it and renames it over
+ * the store, then maps it: readers and power losses see either the profiles before the update or after it.
+ *
+ * Thread safe.
+ */
+@interface CDAWiFiProfileStore : OFObject
+
+/*!
+ * @method
+ *
+ * @param path
+ * The path of the store file. A missing file is an empty store, created by the first update.
+ *
+ * @abstract
+ * Opens a profile store.
+ *
+ * @discussion
+ * Returns nil with a CDAWiFiInvalidFormatError error if the file is not a valid profile store.
+ */
+- (instancetype)initWithContentsOfFile:(OFString *)path error:(out CDAError **)error;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The path of the store file.
+ */
+@property (readonly) OFString *path;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The number of profiles.
+ */
+@property (readonly) size_t count;
+
+/*! @functiongroup Looking Up Profiles */
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Indicates whether the store holds a profile, without creating it.
+ */
+- (BOOL)containsProfileWithSSIDData:(OFDataArray *)ssidData security:(CDAWiFiSecurity)security;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the profile with an SSID and a security type, or nil.
+ */
+- (CDAWiFiNetworkProfile *)profileWithSSIDData:(OFDataArray *)ssidData security:(CDAWiFiSecurity)security;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the profiles with the SSID of a network and a security type the network supports.
+ */
+- (OFArray *)profilesForNetwork:(CDAWiFiNetwork *)network;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Creates every profile of the store, in no particular order.
+ */
+- (OFArray *)profiles;
+
+/*! @functiongroup Updating Profiles */
+
+/*!
+ * @method
+ *
+ * @param addedProfiles
+ * A collection of CDAWiFiNetworkProfile objects to add, replacing the profiles with the same SSID and security type.
+ *
+ * @param removedProfiles
+ * A collection of CDAWiFiNetworkProfile objects to remove. Missing profiles are ignored.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Adds and removes profiles in one atomic update.
+ *
+ * @discussion
+ * Removals apply before additions. Fails with a CDAWiFiInvalidParameterError error, leaving the store untouched,
+ * if a profile has no SSID or no known security type. If the update fails after the new file replaced the store,
+ * because its directory could not be flushed, the store holds the update, which may not survive a power loss.
+ */
+- (BOOL)addProfiles:(id <OFCollection>)addedProfiles removeProfiles:(id <OFCollection>)removedProfiles error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Adds a profile, replacing the profile with the same SSID and security type.
+ */
+- (BOOL)addProfile:(CDAWiFiNetworkProfile *)profile error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes a profile.
+ */
+- (BOOL)removeProfile:(CDAWiFiNetworkProfile *)profile error:(out CDAError **)error;
+
+@end
@@ -0,0 +1,678 @@
+//
+//  CDAWiFiProfileStore.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiProfileStore.h"
+#import "CDAWiFiProfileStore+Private.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiNetworkProfile.h"
+#import "CDAWiFiNetworkProfile+Private.h"
+#import "CDAWiFiSSID.h"
+#import "CDAWiFiUtilities.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#pragma mark - File Layout
+
+#define CDAWiFiProfileStoreByteOrder 0x0102
+
+/* Fewest buckets of a table, a power of two. Tables are kept at most half full. */
+#define CDAWiFiProfileStoreMinimumBucketCount 16
+
+static const char CDAWiFiProfileStoreMagic[8] = { 'C', 'D', 'A', 'W', 'P', 'R', 'O', 'F' };
+
+/*
+ * A store is laid out as the header, the bucket table and the records, each starting on an 8 byte boundary
+ * at the offsets given by the header. Integers are stored in host byte order.
+ */
+typedef struct
+{
+    char magic[8];              /* "CDAWPROF" */
+    uint16_t version;
+    uint16_t byteOrder;         /* 0x0102 as written by the host */
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t recordCount;
+    uint32_t bucketCount;       /* A power of two, greater than recordCount */
+    uint32_t bucketOffset;
+    uint32_t recordOffset;
+    uint32_t reserved;
+    
+} CDAWiFiProfileStoreHeader;
+
+/* Buckets hold the index of a record plus one, 0 for an empty bucket. Collisions probe the following buckets. */
+typedef struct
+{
+    uint32_t hash;              /* CDAWiFiProfileStoreHash() of the SSID and the security type */
+    uint8_t security;           /* CDAWiFiSecurity */
+    uint8_t ssidLength;
+    uint16_t reserved;
+    uint8_t ssid[32];
+    
+} CDAWiFiProfileStoreRecord;
+
+_Static_assert(sizeof(CDAWiFiProfileStoreHeader) == 40, "Profile store header layout changed");
+_Static_assert(sizeof(CDAWiFiProfileStoreRecord) == 40, "Profile store record layout changed");
+
+static inline size_t CDAWiFiProfileStoreAlign(size_t offset)
+{
+    return (offset + 7) & ~(size_t)7;
+}
+
+/* Returns YES if [offset, offset + length) lies inside a buffer of size bytes. */
+static inline BOOL CDAWiFiProfileStoreRangeIsValid(uint64_t offset, uint64_t length, uint64_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+static uint32_t CDAWiFiProfileStoreHash(const uint8_t *ssid, size_t ssidLength, uint8_t security)
+{
+    /* FNV-1a, part of the file format. */
+    uint32_t hash = 2166136261u;
+    
+    for (size_t index = 0; index < ssidLength; index++) {
+        hash = (hash ^ ssid[index]) * 16777619u;
+    }
+    
+    return (hash ^ security) * 16777619u;
+}
+
+/* Fills a record with a key. Returns NO if the key can not be stored. */
+static BOOL CDAWiFiProfileStoreRecordMake(CDAWiFiProfileStoreRecord *record, const uint8_t *ssid, size_t ssidLength,
+                                          CDAWiFiSecurity security)
+{
+    if (ssidLength == 0 || ssidLength > sizeof(record->ssid) || (uint32_t)security > CDAWiFiSecurityEnterprise) {
+        return NO;
+    }
+    
+    memset(record, 0, sizeof(*record));
+    memcpy(record->ssid, ssid, ssidLength);
+    
+    record->ssidLength = (uint8_t)ssidLength;
+    record->security = (uint8_t)security;
+    record->hash = CDAWiFiProfileStoreHash(ssid, ssidLength, record->security);
+    
+    return YES;
+}
+
+static inline BOOL CDAWiFiProfileStoreRecordKeyIsEqual(const CDAWiFiProfileStoreRecord *record, const CDAWiFiProfileStoreRecord *other)
+{
+    return record->hash == other->hash && record->security == other->security && record->ssidLength == other->ssidLength &&
+           memcmp(record->ssid, other->ssid, record->ssidLength) == 0;
+}
+
+/* Returns the index plus one of the record with the key of another, 0 if there is none. */
+static uint32_t CDAWiFiProfileStoreFind(const uint32_t *buckets, uint32_t bucketCount, const CDAWiFiProfileStoreRecord *records,
+                                        const CDAWiFiProfileStoreRecord *key)
+{
+    uint32_t mask = bucketCount - 1;
+    
+    for (uint32_t index = key->hash & mask; buckets[index] != 0; index = (index + 1) & mask) {
+        
+        if (CDAWiFiProfileStoreRecordKeyIsEqual(&records[buckets[index] - 1], key)) {
+            return buckets[index];
+        }
+    }
+    
+    return 0;
+}
+
+/* Indexes a record, in place of a record with the same key. */
+static void CDAWiFiProfileStoreInsert(uint32_t *buckets, uint32_t bucketCount, const CDAWiFiProfileStoreRecord *records,
+                                      uint32_t recordIndex)
+{
+    uint32_t mask = bucketCount - 1;
+    uint32_t index = records[recordIndex].hash & mask;
+    
+    while (buckets[index] != 0 && !CDAWiFiProfileStoreRecordKeyIsEqual(&records[buckets[index] - 1], &records[recordIndex])) {
+        index = (index + 1) & mask;
+    }
+    
+    buckets[index] = recordIndex + 1;
+}
+
+static uint32_t CDAWiFiProfileStoreBucketCount(size_t recordCount)
+{
+    uint32_t bucketCount = CDAWiFiProfileStoreMinimumBucketCount;
+    
+    while (bucketCount < recordCount * 2) {
+        bucketCount *= 2;
+    }
+    
+    return bucketCount;
+}
+
+/* Returns a new bucket table of records, or NULL if out of memory. Free it with free(). */
+static uint32_t *CDAWiFiProfileStoreBuildBuckets(const CDAWiFiProfileStoreRecord *records, size_t recordCount, uint32_t bucketCount)
+{
+    uint32_t *buckets = calloc(bucketCount, sizeof(uint32_t));
+    
+    for (size_t index = 0; buckets != NULL && index < recordCount; index++) {
+        CDAWiFiProfileStoreInsert(buckets, bucketCount, records, (uint32_t)index);
+    }
+    
+    return buckets;
+}
+
+#pragma mark - Mapping
+
+/* An immutable mapped store file. Readers keep the mapping they started with alive while an update replaces it. */
+@interface CDAWiFiProfileStoreMapping : OFObject
+{
+@public
+    void *_mapping;
+    size_t _mappingLength;
+    
+    /* The bytes of a store file kept in memory instead, if the file could not be mapped. */
+    OFDataArray *_data;
+    
+    const CDAWiFiProfileStoreHeader *_header;
+    const uint32_t *_buckets;
+    const CDAWiFiProfileStoreRecord *_records;
+}
+
+@end
+
+@implementation CDAWiFiProfileStoreMapping
+
+- (instancetype)initWithContentsOfFile:(OFString *)path error:(out CDAError **)error
+{
+    self = [super init];
+    
+    if (self) {
+        
+        int fileDescriptor = open([path UTF8String], O_RDONLY | O_CLOEXEC);
+        struct stat status;
+        
+        if (fileDescriptor < 0 || fstat(fileDescriptor, &status) != 0) {
+            
+            int errnum = errno;
+            
+            if (fileDescriptor >= 0) {
+                close(fileDescriptor);
+            }
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errnum);
+            }
+            
+            return nil;
+        }
+        
+        if ((size_t)status.st_size < sizeof(CDAWiFiProfileStoreHeader)) {
+            
+            close(fileDescriptor);
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidFormatError);
+            }
+            
+            return nil;
+        }
+        
+        void *mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        
+        close(fileDescriptor);
+        
+        if (mapping == MAP_FAILED) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errno);
+            }
+            
+            return nil;
+        }
+        
+        _mapping = mapping;
+        _mappingLength = (size_t)status.st_size;
+        
+        if (![self loadBytes:mapping length:_mappingLength]) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidFormatError);
+            }
+            
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+/* Wraps the bytes of a store file just written, which are valid. */
+- (instancetype)initWithData:(OFDataArray *)data
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _data = data;
+        
+        if (![self loadBytes:data.items length:data.count * data.itemSize]) {
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_mapping != NULL) {
+        munmap(_mapping, _mappingLength);
+    }
+}
+
+/* Indicates whether the mapped file holds exactly some bytes. */
+- (BOOL)isEqualToData:(OFDataArray *)data
+{
+    return _mapping != NULL && _mappingLength == data.count * data.itemSize && memcmp(_mapping, data.items, _mappingLength) == 0;
+}
+
+/* Checks the layout and the bucket table once, so lookups can then probe without checks and always terminate. */
+- (BOOL)loadBytes:(const uint8_t *)bytes length:(size_t)length
+{
+    const CDAWiFiProfileStoreHeader *header = (const CDAWiFiProfileStoreHeader *)bytes;
+    
+    if (memcmp(header->magic, CDAWiFiProfileStoreMagic, sizeof(header->magic)) != 0 ||
+        header->byteOrder != CDAWiFiProfileStoreByteOrder ||
+        header->version != CDAWiFiProfileStoreVersion ||
+        header->headerSize < sizeof(CDAWiFiProfileStoreHeader) ||
+        header->recordSize != sizeof(CDAWiFiProfileStoreRecord) ||
+        header->bucketCount == 0 || (header->bucketCount & (header->bucketCount - 1)) != 0 ||
+        header->recordCount >= header->bucketCount ||
+        (header->bucketOffset & 7) != 0 || (header->recordOffset & 7) != 0 ||
+        !CDAWiFiProfileStoreRangeIsValid(header->bucketOffset, (uint64_t)header->bucketCount * sizeof(uint32_t), length) ||
+        !CDAWiFiProfileStoreRangeIsValid(header->recordOffset, (uint64_t)header->recordCount * sizeof(CDAWiFiProfileStoreRecord), length)) {
+        
+        return NO;
+    }
+    
+    const uint32_t *buckets = (const uint32_t *)(bytes + header->bucketOffset);
+    const CDAWiFiProfileStoreRecord *records = (const CDAWiFiProfileStoreRecord *)(bytes + header->recordOffset);
+    uint32_t usedBucketCount = 0;
+    
+    /* Every record in one bucket, so at least one bucket is empty. */
+    for (uint32_t index = 0; index < header->bucketCount; index++) {
+        
+        if (buckets[index] > header->recordCount) {
+            return NO;
+        }
+        
+        usedBucketCount += (buckets[index] != 0);
+    }
+    
+    if (usedBucketCount != header->recordCount) {
+        return NO;
+    }
+    
+    for (uint32_t index = 0; index < header->recordCount; index++) {
+        
+        if (records[index].ssidLength == 0 || records[index].ssidLength > sizeof(records[index].ssid) ||
+            records[index].security > CDAWiFiSecurityEnterprise) {
+            
+            return NO;
+        }
+    }
+    
+    _header = header;
+    _buckets = buckets;
+    _records = records;
+    
+    return YES;
+}
+
+- (const CDAWiFiProfileStoreRecord *)recordWithKey:(const CDAWiFiProfileStoreRecord *)key
+{
+    uint32_t index = CDAWiFiProfileStoreFind(_buckets, _header->bucketCount, _records, key);
+    
+    return (index != 0) ? &_records[index - 1] : NULL;
+}
+
+@end
+
+#pragma mark - Store
+
+@implementation CDAWiFiProfileStore
+{
+    /* Guards the current mapping, nil for an empty store. */
+    OFMutex *_mutex;
+    CDAWiFiProfileStoreMapping *_mapping;
+    uint64_t _generation;
+    
+    /* Serializes updates, readers do not wait for them. */
+    OFMutex *_updateMutex;
+}
+
+@synthesize path = _path;
+
+#pragma mark - Initialization
+
+- (instancetype)initWithContentsOfFile:(OFString *)path error:(out CDAError **)error
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _path = [path copy];
+        _mutex = [OFMutex mutex];
+        _updateMutex = [OFMutex mutex];
+        
+        /* Left by an update interrupted before its rename, never part of the store. */
+        unlink([[path stringByAppendingString:@".tmp"] UTF8String]);
+        
+        if (access([path UTF8String], F_OK) == 0) {
+            
+            _mapping = [[CDAWiFiProfileStoreMapping alloc] initWithContentsOfFile:path error:error];
+            
+            if (_mapping == nil) {
+                return nil;
+            }
+        }
+    }
+    
+    return self;
+}
+
+- (CDAWiFiProfileStoreMapping *)mapping
+{
+    [_mutex lock];
+    
+    CDAWiFiProfileStoreMapping *mapping = _mapping;
+    
+    [_mutex unlock];
+    
+    return mapping;
+}
+
+#pragma mark - Looking Up Profiles
+
+- (size_t)count
+{
+    CDAWiFiProfileStoreMapping *mapping = self.mapping;
+    
+    return (mapping != nil) ? mapping->_header->recordCount : 0;
+}
+
+- (BOOL)containsProfileWithSSIDData:(OFDataArray *)ssidData security:(CDAWiFiSecurity)security
+{
+    CDAWiFiProfileStoreMapping *mapping = self.mapping;
+    CDAWiFiProfileStoreRecord key;
+    
+    if (mapping == nil || !CDAWiFiProfileStoreRecordMake(&key, ssidData.items, ssidData.count * ssidData.itemSize, security)) {
+        return NO;
+    }
+    
+    return [mapping recordWithKey:&key] != NULL;
+}
+
+- (CDAWiFiNetworkProfile *)profileWithSSIDData:(OFDataArray *)ssidData security:(CDAWiFiSecurity)security
+{
+    if (![self containsProfileWithSSIDData:ssidData security:security]) {
+        return nil;
+    }
+    
+    return [[CDAWiFiNetworkProfile alloc] initWithInternedSSID:[CDAWiFiSSID SSIDWithData:ssidData] security:security];
+}
+
+- (OFArray *)profilesForNetwork:(CDAWiFiNetwork *)network
+{
+    CDAWiFiProfileStoreMapping *mapping = self.mapping;
+    CDAWiFiSSID *ssid = network.internedSSID;
+    OFMutableArray *profiles = [OFMutableArray array];
+    
+    if (mapping == nil || ssid == nil) {
+        return profiles;
+    }
+    
+    for (CDAWiFiSecurity security = CDAWiFiSecurityNone; security <= CDAWiFiSecurityEnterprise; security++) {
+        
+        CDAWiFiProfileStoreRecord key;
+        
+        if (!CDAWiFiProfileStoreRecordMake(&key, ssid.bytes, ssid.length, security) || [mapping recordWithKey:&key] == NULL) {
+            continue;
+        }
+        
+        if ([network supportsSecurity:security]) {
+            [profiles addObject:[[CDAWiFiNetworkProfile alloc] initWithInternedSSID:ssid security:security]];
+        }
+    }
+    
+    [profiles makeImmutable];
+    
+    return profiles;
+}
+
+- (OFArray *)profiles
+{
+    CDAWiFiProfileStoreMapping *mapping = self.mapping;
+    size_t count = (mapping != nil) ? mapping->_header->recordCount : 0;
+    OFMutableArray *profiles = [OFMutableArray arrayWithCapacity:count];
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        const CDAWiFiProfileStoreRecord *record = &mapping->_records[index];
+        
+        [profiles addObject:[[CDAWiFiNetworkProfile alloc] initWithInternedSSID:[CDAWiFiSSID SSIDWithBytes:record->ssid length:record->ssidLength]
+                                                                       security:record->security]];
+    }
+    
+    [profiles makeImmutable];
+    
+    return profiles;
+}
+
+- (uint64_t)generation
+{
+    [_mutex lock];
+    
+    uint64_t generation = _generation;
+    
+    [_mutex unlock];
+    
+    return generation;
+}
+
+- (uint64_t)enumerateSSIDsUsingBlock:(void (^)(const uint8_t *ssid, size_t length))block
+{
+    [_mutex lock];
+    
+    CDAWiFiProfileStoreMapping *mapping = _mapping;
+    uint64_t generation = _generation;
+    
+    [_mutex unlock];
+    
+    size_t count = (mapping != nil) ? mapping->_header->recordCount : 0;
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        const CDAWiFiProfileStoreRecord *record = &mapping->_records[index];
+        
+        block(record->ssid, record->ssidLength);
+    }
+    
+    return generation;
+}
+
+#pragma mark - Updating Profiles
+
+/* Appends the keys of profiles to records. Returns NO if one can not be stored. */
+static BOOL CDAWiFiProfileStoreAddKeys(OFDataArray *records, id <OFCollection> profiles)
+{
+    for (CDAWiFiNetworkProfile *profile in profiles) {
+        
+        CDAWiFiSSID *ssid = profile.internedSSID;
+        CDAWiFiProfileStoreRecord record;
+        
+        if (ssid == nil || !CDAWiFiProfileStoreRecordMake(&record, ssid.bytes, ssid.length, profile.security)) {
+            return NO;
+        }
+        
+        [records addItem:&record];
+    }
+    
+    return YES;
+}
+
+/* Encodes records, which must have distinct keys, as a store file. Returns nil if out of memory. */
+static OFDataArray *CDAWiFiProfileStoreData(OFDataArray *records)
+{
+    size_t recordCount = records.count;
+    uint32_t bucketCount = CDAWiFiProfileStoreBucketCount(recordCount);
+    uint32_t *buckets = CDAWiFiProfileStoreBuildBuckets(records.items, recordCount, bucketCount);
+    
+    if (buckets == NULL) {
+        return nil;
+    }
+    
+    CDAWiFiProfileStoreHeader header;
+    
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CDAWiFiProfileStoreMagic, sizeof(header.magic));
+    
+    header.version = CDAWiFiProfileStoreVersion;
+    header.byteOrder = CDAWiFiProfileStoreByteOrder;
+    header.headerSize = sizeof(header);
+    header.recordSize = sizeof(CDAWiFiProfileStoreRecord);
+    header.recordCount = (uint32_t)recordCount;
+    header.bucketCount = bucketCount;
+    header.bucketOffset = (uint32_t)CDAWiFiProfileStoreAlign(sizeof(header));
+    header.recordOffset = (uint32_t)CDAWiFiProfileStoreAlign(header.bucketOffset + bucketCount * sizeof(uint32_t));
+    
+    /* The bucket table is a multiple of 8 bytes, no padding is needed. */
+    OFDataArray *data = [OFDataArray dataArray];
+    
+    [data addItems:&header count:sizeof(header)];
+    [data addItems:buckets count:bucketCount * sizeof(uint32_t)];
+    [data addItems:records.items count:recordCount * sizeof(CDAWiFiProfileStoreRecord)];
+    
+    free(buckets);
+    
+    return data;
+}
+
+- (BOOL)addProfiles:(id <OFCollection>)addedProfiles removeProfiles:(id <OFCollection>)removedProfiles error:(out CDAError **)error
+{
+    OFDataArray *addedRecords = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiProfileStoreRecord)];
+    OFDataArray *changedRecords = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiProfileStoreRecord)];
+    
+    if (!CDAWiFiProfileStoreAddKeys(addedRecords, addedProfiles) || !CDAWiFiProfileStoreAddKeys(changedRecords, removedProfiles)) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+        }
+        
+        return NO;
+    }
+    
+    [changedRecords addItems:addedRecords.items count:addedRecords.count];
+    
+    [_updateMutex lock];
+    
+    CDAWiFiProfileStoreMapping *mapping = self.mapping;
+    size_t count = (mapping != nil) ? mapping->_header->recordCount : 0;
+    OFDataArray *records = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiProfileStoreRecord)];
+    
+    /* Later additions of the same key replace earlier ones, and every addition or removal replaces the stored record. */
+    uint32_t addedBucketCount = CDAWiFiProfileStoreBucketCount(addedRecords.count);
+    uint32_t changedBucketCount = CDAWiFiProfileStoreBucketCount(changedRecords.count);
+    uint32_t *addedBuckets = CDAWiFiProfileStoreBuildBuckets(addedRecords.items, addedRecords.count, addedBucketCount);
+    uint32_t *changedBuckets = CDAWiFiProfileStoreBuildBuckets(changedRecords.items, changedRecords.count, changedBucketCount);
+    
+    if (addedBuckets == NULL || changedBuckets == NULL) {
+        
+        free(addedBuckets);
+        free(changedBuckets);
+        
+        [_updateMutex unlock];
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiNoMemoryError);
+        }
+        
+        return NO;
+    }
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        if (CDAWiFiProfileStoreFind(changedBuckets, changedBucketCount, changedRecords.items, &mapping->_records[index]) == 0) {
+            [records addItem:&mapping->_records[index]];
+        }
+    }
+    
+    const CDAWiFiProfileStoreRecord *added = addedRecords.items;
+    
+    for (size_t index = 0; index < addedRecords.count; index++) {
+        
+        if (CDAWiFiProfileStoreFind(addedBuckets, addedBucketCount, added, &added[index]) == index + 1) {
+            [records addItem:&added[index]];
+        }
+    }
+    
+    free(addedBuckets);
+    free(changedBuckets);
+    
+    OFDataArray *data = CDAWiFiProfileStoreData(records);
+    CDAWiFiProfileStoreMapping *newMapping = nil;
+    BOOL success = NO;
+    
+    if (data == nil) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithCode(CDAWiFiNoMemoryError);
+        }
+        
+    } else {
+        
+        success = CDAWiFiWriteFileAtomically(data, _path, error);
+        
+        /* The store follows the file, whatever failed after the rename, so the next update does not drop this one. */
+        newMapping = [[CDAWiFiProfileStoreMapping alloc] initWithContentsOfFile:_path error:NULL];
+        
+        /* A write that failed before its rename left the previous file in place. */
+        if (!success && newMapping != nil && ![newMapping isEqualToData:data]) {
+            newMapping = nil;
+        }
+        
+        /* Mapping the new file can run out of memory or descriptors, its bytes are known anyway. */
+        if (success && newMapping == nil) {
+            newMapping = [[CDAWiFiProfileStoreMapping alloc] initWithData:data];
+        }
+    }
+    
+    if (newMapping != nil) {
+        
+        [_mutex lock];
+        
+        _mapping = newMapping;
+        _generation++;
+        
+        [_mutex unlock];
+    }
+    
+    [_updateMutex unlock];
+    
+    return success;
+}
+
+- (BOOL)addProfile:(CDAWiFiNetworkProfile *)profile error:(out CDAError **)error
+{
+    return [self addProfiles:[OFArray arrayWithObject:profile] removeProfiles:nil error:error];
+}
+
+- (BOOL)removeProfile:(CDAWiFiNetworkProfile *)profile error:(out CDAError **)error
+{
+    return [self addProfiles:nil removeProfiles:[OFArray arrayWithObject:profile] error:error];
+}
+
+@end
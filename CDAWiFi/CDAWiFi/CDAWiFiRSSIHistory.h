@@ -0,0 +1,224 @@
+//
+//  CDAWiFiRSSIHistory.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/9/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+/*!
+ * @constant CDAWiFiRSSIHistoryDefaultCapacity
+ *
+ * @abstract The default number of BSSIDs a history store keeps samples for.
+ */
+#define CDAWiFiRSSIHistoryDefaultCapacity 1024
+
+/*!
+ * @constant CDAWiFiRSSIHistoryDefaultSegmentCount
+ *
+ * @abstract The default number of 256 byte segments of a BSSID, each holding about 75 samples.
+ */
+#define CDAWiFiRSSIHistoryDefaultSegmentCount 4
+
+/*!
+ * @typedef CDAWiFiRSSISample
+ *
+ * @abstract A signal measurement of a BSS.
+ */
+typedef struct CDAWiFiRSSISample {
+    double timestamp;       /* Seconds since 1970, millisecond precision */
+    int rssiValue;          /* dBm */
+    int noiseMeasurement;   /* dBm, 0 if unknown */
+} CDAWiFiRSSISample;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * A bounded, memory mapped time series store of RSSI and noise samples, keyed by BSSID.
+ *
+ * @discussion
+ * Every BSSID owns a fixed size slot holding a ring of segments. Samples are appended to the newest segment,
+ * encoded as varint deltas from the previous sample (usually 3 bytes), and the oldest segment is recycled
+ * when the newest fills up. When every slot is taken, the least recently updated BSSID is evicted.
+ *
+ * A BSSID keeps about 75 samples per segment, so about 300 with CDAWiFiRSSIHistoryDefaultSegmentCount:
+ * under an hour of history for a BSS heard by a scan every 10 seconds. Longer horizons take more segments,
+ * the file is segmentCount * 256 bytes per BSSID.
+ *
+ * The file never grows, and opening it costs nothing but the mapping.
+ * Queries skip segments outside the requested time range and decode samples on the fly, nothing is deserialized.
+ *
+ * Thread safe. A store file must only be opened by one process at a time.
+ */
+@interface CDAWiFiRSSIHistory : OFObject
+
+/*!
+ * @method
+ *
+ * @param path
+ * The path of the store file. It is created if it does not exist.
+ *
+ * @param capacity
+ * The number of BSSIDs the store keeps samples for. Must match the capacity the file was created with.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @abstract
+ * Opens or creates a history store.
+ *
+ * @discussion
+ * Returns nil with a CDAWiFiInvalidFormatError error if the file is not a history store with the same capacity.
+ */
+- (instancetype)initWithContentsOfFile:(OFString *)path capacity:(size_t)capacity error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @param path
+ * The path of the store file. It is created if it does not exist.
+ *
+ * @param capacity
+ * The number of BSSIDs the store keeps samples for. Must match the capacity the file was created with.
+ *
+ * @param segmentCount
+ * The number of segments of every BSSID, at most 65535. Must match the segment count the file was created with.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @abstract
+ * Opens or creates a history store keeping a given number of segments per BSSID.
+ *
+ * @discussion
+ * Returns nil with a CDAWiFiInvalidFormatError error if the file is not a history store with the same layout.
+ */
+- (instancetype)initWithContentsOfFile:(OFString *)path
+                              capacity:(size_t)capacity
+                          segmentCount:(size_t)segmentCount
+                                 error:(out CDAError **)error;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The number of BSSIDs the store keeps samples for.
+ */
+@property (readonly) size_t capacity;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The number of segments of every BSSID.
+ */
+@property (readonly) size_t segmentCount;
+
+/*! @functiongroup Recording Samples */
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Appends a sample to the series of a BSSID.
+ *
+ * @discussion
+ * Samples older than the newest sample of the series are recorded with its timestamp.
+ */
+- (void)addSample:(CDAWiFiRSSISample)sample forBSSID:(CDAWiFiMACAddress)bssid;
+
+/*!
+ * @method
+ *
+ * @param networks
+ * A collection of CDAWiFiNetwork objects.
+ *
+ * @abstract
+ * Appends the RSSI and noise of every network heard since the newest sample of its BSSID.
+ *
+ * @discussion
+ * Samples are stamped with when the networks were last heard. The kernel reports a BSS in every scan dump
+ * until it expires; results that were not heard again are not recorded twice.
+ */
+- (void)addSamplesWithNetworks:(id <OFCollection>)networks;
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Flushes the store to disk.
+ *
+ * @discussion
+ * The kernel writes the mapping back on its own, this only matters to survive power losses.
+ */
+- (BOOL)synchronizeAndReturnError:(out CDAError **)error;
+
+/*! @functiongroup Querying Samples */
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the BSSIDs the store holds samples for, as OFNumber objects.
+ */
+- (OFArray *)bssids;
+
+/*!
+ * @method
+ *
+ * @param bssid
+ * The BSSID of the series.
+ *
+ * @param startTimestamp
+ * The start of the time range, in seconds since 1970, inclusive.
+ *
+ * @param endTimestamp
+ * The end of the time range, in seconds since 1970, inclusive.
+ *
+ * @param block
+ * Invoked for every sample in the range, oldest first. Set stop to YES to end the enumeration.
+ *
+ * @abstract
+ * Enumerates the samples of a BSSID in a time range.
+ *
+ * @discussion
+ * The store is locked during the enumeration, the block must not record samples.
+ */
+- (void)enumerateSamplesForBSSID:(CDAWiFiMACAddress)bssid
+                  startTimestamp:(double)startTimestamp
+                    endTimestamp:(double)endTimestamp
+                      usingBlock:(void (^)(const CDAWiFiRSSISample *sample, BOOL *stop))block;
+
+/*!
+ * @method
+ *
+ * @param samples
+ * A C array of maximumCount elements which upon return contains the samples, oldest first.
+ *
+ * @result
+ * The number of samples copied.
+ *
+ * @abstract
+ * Copies the samples of a BSSID in a time range.
+ */
+- (size_t)getSamples:(CDAWiFiRSSISample *)samples
+        maximumCount:(size_t)maximumCount
+            forBSSID:(CDAWiFiMACAddress)bssid
+      startTimestamp:(double)startTimestamp
+        endTimestamp:(double)endTimestamp;
+
+@end
@@ -0,0 +1,633 @@
+//
+//  CDAWiFiRSSIHistory.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/9/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiRSSIHistory.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiUtilities.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#pragma mark - File Layout
+
+#define CDAWiFiRSSIHistoryVersion 1
+#define CDAWiFiRSSIHistoryByteOrder 0x0102
+
+/* Size of a segment. About 75 samples fit in one. */
+#define CDAWiFiRSSIHistorySegmentSize 256
+
+/* Scan results heard less than this long (ms) after the newest sample of their BSSID are the same reception. */
+#define CDAWiFiRSSIHistoryScanResultInterval 500
+
+/* Slots probed for a BSSID before the least recently updated one is evicted. */
+#define CDAWiFiRSSIHistoryProbeCount 8
+
+/* Longest encoded sample: a 64 bit varint time delta and two 32 bit zigzag varints. */
+#define CDAWiFiRSSIHistoryMaximumSampleLength (10 + 5 + 5)
+
+static const char CDAWiFiRSSIHistoryMagic[8] = { 'C', 'D', 'A', 'W', 'R', 'S', 'S', 'I' };
+
+typedef struct
+{
+    char magic[8];
+    uint16_t version;
+    uint16_t byteOrder;
+    uint32_t headerSize;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    uint32_t segmentCount;
+    uint32_t segmentSize;
+    uint8_t reserved[32];
+    
+} CDAWiFiRSSIHistoryHeader;
+
+/* The first sample of a segment is stored in its header, the following ones as deltas in its payload. */
+typedef struct
+{
+    uint64_t firstTimestamp;    /* ms since 1970 */
+    uint64_t lastTimestamp;
+    uint16_t length;            /* Payload bytes used */
+    uint16_t sampleCount;
+    int8_t firstRSSI;
+    int8_t firstNoise;
+    int8_t lastRSSI;
+    int8_t lastNoise;
+    
+} CDAWiFiRSSIHistorySegmentHeader;
+
+#define CDAWiFiRSSIHistoryPayloadSize (CDAWiFiRSSIHistorySegmentSize - sizeof(CDAWiFiRSSIHistorySegmentHeader))
+
+typedef struct
+{
+    CDAWiFiRSSIHistorySegmentHeader header;
+    uint8_t payload[CDAWiFiRSSIHistoryPayloadSize];
+    
+} CDAWiFiRSSIHistorySegment;
+
+typedef struct
+{
+    CDAWiFiMACAddress bssid;    /* 0 if the slot is free */
+    uint64_t lastTimestamp;
+    uint32_t currentSegment;
+    uint32_t reserved[3];
+    CDAWiFiRSSIHistorySegment segments[];    /* segmentCount of them */
+    
+} CDAWiFiRSSIHistorySlot;
+
+_Static_assert(sizeof(CDAWiFiRSSIHistoryHeader) == 64, "History header layout changed");
+_Static_assert(sizeof(CDAWiFiRSSIHistorySegment) == CDAWiFiRSSIHistorySegmentSize, "History segment layout changed");
+_Static_assert(sizeof(CDAWiFiRSSIHistorySlot) == 32, "History slot layout changed");
+
+#pragma mark - Encoding
+
+static inline size_t CDAWiFiRSSIHistoryPutVarint(uint8_t *bytes, uint64_t value)
+{
+    size_t length = 0;
+    
+    while (value >= 0x80) {
+        bytes[length++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    
+    bytes[length++] = (uint8_t)value;
+    
+    return length;
+}
+
+/* Returns the number of bytes read, or 0 if the varint is truncated or too long. */
+static inline size_t CDAWiFiRSSIHistoryGetVarint(const uint8_t *bytes, size_t length, uint64_t *value)
+{
+    uint64_t result = 0;
+    
+    for (size_t index = 0; index < length && index < 10; index++) {
+        
+        result |= (uint64_t)(bytes[index] & 0x7F) << (7 * index);
+        
+        if ((bytes[index] & 0x80) == 0) {
+            
+            *value = result;
+            
+            return index + 1;
+        }
+    }
+    
+    return 0;
+}
+
+static inline uint32_t CDAWiFiRSSIHistoryZigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t CDAWiFiRSSIHistoryUnzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static inline int8_t CDAWiFiRSSIHistoryClamp(int value)
+{
+    return (int8_t)(value < INT8_MIN ? INT8_MIN : (value > INT8_MAX ? INT8_MAX : value));
+}
+
+static void CDAWiFiRSSIHistorySegmentStart(CDAWiFiRSSIHistorySegment *segment, uint64_t timestamp, int8_t rssi, int8_t noise)
+{
+    segment->header.firstTimestamp = timestamp;
+    segment->header.lastTimestamp = timestamp;
+    segment->header.length = 0;
+    segment->header.sampleCount = 1;
+    segment->header.firstRSSI = rssi;
+    segment->header.firstNoise = noise;
+    segment->header.lastRSSI = rssi;
+    segment->header.lastNoise = noise;
+}
+
+static void CDAWiFiRSSIHistorySlotAppend(CDAWiFiRSSIHistorySlot *slot, uint32_t segmentCount, uint64_t timestamp, int8_t rssi, int8_t noise)
+{
+    CDAWiFiRSSIHistorySegment *segment = &slot->segments[slot->currentSegment % segmentCount];
+    
+    if (segment->header.sampleCount == 0) {
+        
+        CDAWiFiRSSIHistorySegmentStart(segment, timestamp, rssi, noise);
+        
+        slot->lastTimestamp = timestamp;
+        
+        return;
+    }
+    
+    if (timestamp < segment->header.lastTimestamp) {
+        timestamp = segment->header.lastTimestamp;
+    }
+    
+    uint8_t sample[CDAWiFiRSSIHistoryMaximumSampleLength];
+    size_t length = 0;
+    
+    length += CDAWiFiRSSIHistoryPutVarint(sample + length, timestamp - segment->header.lastTimestamp);
+    length += CDAWiFiRSSIHistoryPutVarint(sample + length, CDAWiFiRSSIHistoryZigzag(rssi - segment->header.lastRSSI));
+    length += CDAWiFiRSSIHistoryPutVarint(sample + length, CDAWiFiRSSIHistoryZigzag(noise - segment->header.lastNoise));
+    
+    if (segment->header.length + length > CDAWiFiRSSIHistoryPayloadSize || segment->header.sampleCount == UINT16_MAX) {
+        
+        /* Recycle the oldest segment. */
+        slot->currentSegment = (slot->currentSegment + 1) % segmentCount;
+        
+        CDAWiFiRSSIHistorySegmentStart(&slot->segments[slot->currentSegment], timestamp, rssi, noise);
+        
+    } else {
+        
+        /* The payload is written before the length that makes it visible. */
+        memcpy(segment->payload + segment->header.length, sample, length);
+        
+        segment->header.length += length;
+        segment->header.sampleCount++;
+        segment->header.lastTimestamp = timestamp;
+        segment->header.lastRSSI = rssi;
+        segment->header.lastNoise = noise;
+    }
+    
+    slot->lastTimestamp = timestamp;
+}
+
+/* Decodes the samples of a segment in [startTimestamp, endTimestamp]. Returns NO if block stopped the enumeration. */
+static BOOL CDAWiFiRSSIHistorySegmentEnumerate(const CDAWiFiRSSIHistorySegment *segment,
+                                               uint64_t startTimestamp,
+                                               uint64_t endTimestamp,
+                                               void (^block)(const CDAWiFiRSSISample *sample, BOOL *stop))
+{
+    uint64_t timestamp = segment->header.firstTimestamp;
+    int rssi = segment->header.firstRSSI;
+    int noise = segment->header.firstNoise;
+    size_t length = segment->header.length <= CDAWiFiRSSIHistoryPayloadSize ? segment->header.length : CDAWiFiRSSIHistoryPayloadSize;
+    size_t offset = 0;
+    BOOL stop = NO;
+    
+    for (uint32_t index = 0; index < segment->header.sampleCount; index++) {
+        
+        if (index > 0) {
+            
+            uint64_t timeDelta, rssiDelta, noiseDelta;
+            size_t read;
+            
+            if ((read = CDAWiFiRSSIHistoryGetVarint(segment->payload + offset, length - offset, &timeDelta)) == 0) {
+                break;
+            }
+            
+            offset += read;
+            
+            if ((read = CDAWiFiRSSIHistoryGetVarint(segment->payload + offset, length - offset, &rssiDelta)) == 0) {
+                break;
+            }
+            
+            offset += read;
+            
+            if ((read = CDAWiFiRSSIHistoryGetVarint(segment->payload + offset, length - offset, &noiseDelta)) == 0) {
+                break;
+            }
+            
+            offset += read;
+            
+            timestamp += timeDelta;
+            rssi += CDAWiFiRSSIHistoryUnzigzag((uint32_t)rssiDelta);
+            noise += CDAWiFiRSSIHistoryUnzigzag((uint32_t)noiseDelta);
+        }
+        
+        if (timestamp > endTimestamp) {
+            break;
+        }
+        
+        if (timestamp < startTimestamp) {
+            continue;
+        }
+        
+        CDAWiFiRSSISample sample = {
+            .timestamp = timestamp / 1000.0,
+            .rssiValue = rssi,
+            .noiseMeasurement = noise
+        };
+        
+        block(&sample, &stop);
+        
+        if (stop) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+static inline uint64_t CDAWiFiRSSIHistoryMilliseconds(double timestamp)
+{
+    if (timestamp <= 0) {
+        return 0;
+    }
+    
+    if (timestamp >= (double)(UINT64_MAX / 1000)) {
+        return UINT64_MAX;
+    }
+    
+    return (uint64_t)llround(timestamp * 1000);
+}
+
+#pragma mark -
+
+@implementation CDAWiFiRSSIHistory
+{
+    OFMutex *_mutex;
+    
+    void *_mapping;
+    size_t _mappingLength;
+    
+    /* Slots are slotSize bytes apart, the size of their segments depends on the segment count. */
+    uint8_t *_slots;
+    size_t _slotSize;
+    size_t _capacity;
+    size_t _segmentCount;
+}
+
+@synthesize capacity = _capacity, segmentCount = _segmentCount;
+
+#pragma mark - Initialization
+
+- (instancetype)initWithContentsOfFile:(OFString *)path capacity:(size_t)capacity error:(out CDAError **)error
+{
+    return [self initWithContentsOfFile:path capacity:capacity segmentCount:CDAWiFiRSSIHistoryDefaultSegmentCount error:error];
+}
+
+- (instancetype)initWithContentsOfFile:(OFString *)path
+                              capacity:(size_t)capacity
+                          segmentCount:(size_t)segmentCount
+                                 error:(out CDAError **)error
+{
+    self = [super init];
+    
+    if (self) {
+        
+        size_t slotSize = sizeof(CDAWiFiRSSIHistorySlot) + segmentCount * sizeof(CDAWiFiRSSIHistorySegment);
+        
+        if (capacity == 0 || capacity > UINT32_MAX || segmentCount == 0 || segmentCount > UINT16_MAX ||
+            capacity > (SIZE_MAX - sizeof(CDAWiFiRSSIHistoryHeader)) / slotSize) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+            }
+            
+            return nil;
+        }
+        
+        size_t length = sizeof(CDAWiFiRSSIHistoryHeader) + capacity * slotSize;
+        int fileDescriptor = open([path UTF8String], O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        struct stat status;
+        
+        if (fileDescriptor < 0 || fstat(fileDescriptor, &status) != 0) {
+            
+            int errnum = errno;
+            
+            if (fileDescriptor >= 0) {
+                close(fileDescriptor);
+            }
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errnum);
+            }
+            
+            return nil;
+        }
+        
+        BOOL created = (status.st_size == 0);
+        
+        if (!created && (size_t)status.st_size != length) {
+            
+            close(fileDescriptor);
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidFormatError);
+            }
+            
+            return nil;
+        }
+        
+        /* A new file is sparse, slots only take disk space once used. */
+        if (created && ftruncate(fileDescriptor, (off_t)length) != 0) {
+            
+            int errnum = errno;
+            
+            close(fileDescriptor);
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errnum);
+            }
+            
+            return nil;
+        }
+        
+        void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+        
+        close(fileDescriptor);
+        
+        if (mapping == MAP_FAILED) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errno);
+            }
+            
+            return nil;
+        }
+        
+        _mapping = mapping;
+        _mappingLength = length;
+        _capacity = capacity;
+        _segmentCount = segmentCount;
+        _slotSize = slotSize;
+        _slots = (uint8_t *)mapping + sizeof(CDAWiFiRSSIHistoryHeader);
+        _mutex = [OFMutex mutex];
+        
+        CDAWiFiRSSIHistoryHeader *header = mapping;
+        
+        if (created) {
+            
+            memcpy(header->magic, CDAWiFiRSSIHistoryMagic, sizeof(header->magic));
+            header->version = CDAWiFiRSSIHistoryVersion;
+            header->byteOrder = CDAWiFiRSSIHistoryByteOrder;
+            header->headerSize = sizeof(CDAWiFiRSSIHistoryHeader);
+            header->slotCount = (uint32_t)capacity;
+            header->slotSize = (uint32_t)slotSize;
+            header->segmentCount = (uint32_t)segmentCount;
+            header->segmentSize = CDAWiFiRSSIHistorySegmentSize;
+            
+        } else if (memcmp(header->magic, CDAWiFiRSSIHistoryMagic, sizeof(header->magic)) != 0 ||
+                   header->version != CDAWiFiRSSIHistoryVersion ||
+                   header->byteOrder != CDAWiFiRSSIHistoryByteOrder ||
+                   header->headerSize != sizeof(CDAWiFiRSSIHistoryHeader) ||
+                   header->slotCount != capacity ||
+                   header->slotSize != slotSize ||
+                   header->segmentCount != segmentCount ||
+                   header->segmentSize != CDAWiFiRSSIHistorySegmentSize) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidFormatError);
+            }
+            
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_mapping != NULL) {
+        munmap(_mapping, _mappingLength);
+    }
+}
+
+#pragma mark - Slots
+
+static inline size_t CDAWiFiRSSIHistorySlotIndex(CDAWiFiMACAddress bssid, size_t capacity)
+{
+    /* Fibonacci hashing spreads the sequential BSSIDs of multi-BSS access points. */
+    return (size_t)((bssid * UINT64_C(0x9E3779B97F4A7C15)) >> 32) % capacity;
+}
+
+- (CDAWiFiRSSIHistorySlot *)slotAtIndex:(size_t)index
+{
+    return (CDAWiFiRSSIHistorySlot *)(_slots + index * _slotSize);
+}
+
+/* Returns the slot of a BSSID. If create is YES, claims a free slot or evicts the least recently updated one. */
+- (CDAWiFiRSSIHistorySlot *)slotForBSSID:(CDAWiFiMACAddress)bssid create:(BOOL)create
+{
+    size_t start = CDAWiFiRSSIHistorySlotIndex(bssid, _capacity);
+    size_t probeCount = _capacity < CDAWiFiRSSIHistoryProbeCount ? _capacity : CDAWiFiRSSIHistoryProbeCount;
+    CDAWiFiRSSIHistorySlot *victim = NULL;
+    
+    for (size_t probe = 0; probe < probeCount; probe++) {
+        
+        CDAWiFiRSSIHistorySlot *slot = [self slotAtIndex:(start + probe) % _capacity];
+        
+        if (slot->bssid == bssid) {
+            return slot;
+        }
+        
+        /* Slots are never freed, so a free slot ends the probe sequence. */
+        if (slot->bssid == 0) {
+            victim = slot;
+            break;
+        }
+        
+        if (victim == NULL || slot->lastTimestamp < victim->lastTimestamp) {
+            victim = slot;
+        }
+    }
+    
+    if (!create) {
+        return NULL;
+    }
+    
+    memset(victim, 0, _slotSize);
+    victim->bssid = bssid;
+    
+    return victim;
+}
+
+#pragma mark - Recording Samples
+
+- (void)addSample:(CDAWiFiRSSISample)sample forBSSID:(CDAWiFiMACAddress)bssid
+{
+    if (bssid == 0) {
+        return;
+    }
+    
+    [_mutex lock];
+    
+    CDAWiFiRSSIHistorySlotAppend([self slotForBSSID:bssid create:YES],
+                                 (uint32_t)_segmentCount,
+                                 CDAWiFiRSSIHistoryMilliseconds(sample.timestamp),
+                                 CDAWiFiRSSIHistoryClamp(sample.rssiValue),
+                                 CDAWiFiRSSIHistoryClamp(sample.noiseMeasurement));
+    
+    [_mutex unlock];
+}
+
+- (void)addSamplesWithNetworks:(id <OFCollection>)networks
+{
+    /* Converts lastSeen from the monotonic clock to the wall clock. */
+    double offset = [[OFDate date] timeIntervalSince1970] - CDAWiFiMonotonicTime();
+    
+    [_mutex lock];
+    
+    for (CDAWiFiNetwork *network in networks) {
+        
+        CDAWiFiMACAddress bssid = network.bssidValue;
+        
+        if (bssid == 0) {
+            continue;
+        }
+        
+        uint64_t milliseconds = CDAWiFiRSSIHistoryMilliseconds(network.lastSeen + offset);
+        CDAWiFiRSSIHistorySlot *slot = [self slotForBSSID:bssid create:YES];
+        
+        /* The kernel reports a BSS in every dump until it expires, record it once per reception. */
+        if (slot->lastTimestamp != 0 && milliseconds < slot->lastTimestamp + CDAWiFiRSSIHistoryScanResultInterval) {
+            continue;
+        }
+        
+        CDAWiFiRSSIHistorySlotAppend(slot,
+                                     (uint32_t)_segmentCount,
+                                     milliseconds,
+                                     CDAWiFiRSSIHistoryClamp(network.rssiValue),
+                                     CDAWiFiRSSIHistoryClamp(network.noiseMeasurement));
+    }
+    
+    [_mutex unlock];
+}
+
+- (BOOL)synchronizeAndReturnError:(out CDAError **)error
+{
+    if (msync(_mapping, _mappingLength, MS_SYNC) != 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errno);
+        }
+        
+        return NO;
+    }
+    
+    return YES;
+}
+
+#pragma mark - Querying Samples
+
+- (OFArray *)bssids
+{
+    OFMutableArray *bssids = [OFMutableArray array];
+    
+    [_mutex lock];
+    
+    for (size_t index = 0; index < _capacity; index++) {
+        
+        CDAWiFiRSSIHistorySlot *slot = [self slotAtIndex:index];
+        
+        if (slot->bssid != 0) {
+            [bssids addObject:[OFNumber numberWithUInt64:slot->bssid]];
+        }
+    }
+    
+    [_mutex unlock];
+    
+    [bssids makeImmutable];
+    
+    return bssids;
+}
+
+- (void)enumerateSamplesForBSSID:(CDAWiFiMACAddress)bssid
+                  startTimestamp:(double)startTimestamp
+                    endTimestamp:(double)endTimestamp
+                      usingBlock:(void (^)(const CDAWiFiRSSISample *sample, BOOL *stop))block
+{
+    uint64_t start = CDAWiFiRSSIHistoryMilliseconds(startTimestamp);
+    uint64_t end = CDAWiFiRSSIHistoryMilliseconds(endTimestamp);
+    
+    [_mutex lock];
+    
+    @try {
+        
+        CDAWiFiRSSIHistorySlot *slot = (bssid != 0) ? [self slotForBSSID:bssid create:NO] : NULL;
+        
+        if (slot == NULL) {
+            return;
+        }
+        
+        /* Oldest segment first: the one after the current segment in the ring. */
+        for (size_t offset = 1; offset <= _segmentCount; offset++) {
+            
+            const CDAWiFiRSSIHistorySegment *segment = &slot->segments[(slot->currentSegment + offset) % _segmentCount];
+            
+            if (segment->header.sampleCount == 0 ||
+                segment->header.lastTimestamp < start ||
+                segment->header.firstTimestamp > end) {
+                
+                continue;
+            }
+            
+            if (!CDAWiFiRSSIHistorySegmentEnumerate(segment, start, end, block)) {
+                return;
+            }
+        }
+    }
+    @finally {
+        [_mutex unlock];
+    }
+}
+
+- (size_t)getSamples:(CDAWiFiRSSISample *)samples
+        maximumCount:(size_t)maximumCount
+            forBSSID:(CDAWiFiMACAddress)bssid
+      startTimestamp:(double)startTimestamp
+        endTimestamp:(double)endTimestamp
+{
+    __block size_t count = 0;
+    
+    if (maximumCount == 0) {
+        return 0;
+    }
+    
+    [self enumerateSamplesForBSSID:bssid startTimestamp:startTimestamp endTimestamp:endTimestamp usingBlock:^(const CDAWiFiRSSISample *sample, BOOL *stop) {
+        
+        samples[count++] = *sample;
+        
+        *stop = (count == maximumCount);
+    }];
+    
+    return count;
+}
+
+@end
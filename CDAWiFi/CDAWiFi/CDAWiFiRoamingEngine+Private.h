@@ -0,0 +1,23 @@
+//
+//  CDAWiFiRoamingEngine+Private.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/11/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <CDAWiFi/CDAWiFiRoamingEngine.h>
+
+@class CDAWiFiScanCacheChanges;
+
+@interface CDAWiFiRoamingEngine (Private)
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Updates the candidates with the changes of the scan cache of the interface. Returns immediately.
+ */
+- (void)scanCacheDidChange:(CDAWiFiScanCacheChanges *)changes;
+
+@end
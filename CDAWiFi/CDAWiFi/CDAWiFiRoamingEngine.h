@@ -0,0 +1,174 @@
+//
+//  CDAWiFiRoamingEngine.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/11/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiInterface, CDAWiFiNetwork;
+
+/*!
+ * @constant CDAWiFiRoamingEngineDefaultRoamThreshold
+ *
+ * @abstract The default RSSI (dBm) below which a roaming engine looks for a better BSS.
+ */
+#define CDAWiFiRoamingEngineDefaultRoamThreshold -72
+
+/*!
+ * @constant CDAWiFiRoamingEngineDefaultMinimumImprovement
+ *
+ * @abstract The default signal improvement (dB) a candidate must offer over the current BSS.
+ */
+#define CDAWiFiRoamingEngineDefaultMinimumImprovement 8
+
+/*!
+ * @constant CDAWiFiRoamingEngineDefaultScanInterval
+ *
+ * @abstract The default interval (seconds) between the background scans of a roaming engine.
+ */
+#define CDAWiFiRoamingEngineDefaultScanInterval 30
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Keeps a station mode interface connected to the best BSS of its ESS.
+ *
+ * @discussion
+ * The engine keeps a ranked list of the other BSSes advertising the SSID of the interface, updated on every
+ * scan cache change and refreshed by periodic directed scans. When the connection quality monitor of the driver
+ * reports the RSSI fell below the roam threshold, the engine reassociates to the best candidate right away,
+ * on its known channel, without scanning.
+ *
+ * For WPA Personal networks, the PMK of the ESS is reused for every BSS: no key is derived when roaming,
+ * and PMK security associations are installed ahead of time for the best candidates, so drivers that cache
+ * PMKSAs can skip the authentication exchange of the reassociation.
+ *
+ * The interface must be associated with associateToNetwork:password:error: before roaming,
+ * WEP and enterprise networks are not supported. Thread safe.
+ */
+@interface CDAWiFiRoamingEngine : OFObject
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Initializes a roaming engine for an interface. The engine does nothing until it is started.
+ */
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interface the engine roams.
+ */
+@property (readonly) CDAWiFiInterface *interface;
+
+/*! @functiongroup Configuring Roaming */
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The RSSI (dBm) below which the engine roams. Takes effect when the engine is started.
+ */
+@property int roamThreshold;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The signal improvement (dB) a candidate must offer over the current BSS. 5 GHz BSSes get a bonus of 5 dB.
+ */
+@property int minimumImprovement;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The interval (seconds) between directed scans for the SSID, refreshing the candidates. 0 disables background scans.
+ * Takes effect when the engine is started.
+ */
+@property of_time_interval_t scanInterval;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * Invoked on a global queue after every automatic roam attempt, with the BSS roamed to or the error of the last attempt.
+ */
+@property (copy) void (^roamHandler)(CDAWiFiNetwork *network, CDAError *error);
+
+/*! @functiongroup Running the Engine */
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Starts watching the link of the interface. Does nothing if the engine is running.
+ */
+- (BOOL)startAndReturnError:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Stops the engine and removes the PMK security associations it installed.
+ */
+- (void)stop;
+
+/*! @functiongroup Roaming */
+
+/*!
+ * @method
+ *
+ * @result
+ * An OFArray of CDAWiFiNetwork objects, the BSSes of the current SSID other than the current one, best first.
+ *
+ * @abstract
+ * Returns the ranked roaming candidates.
+ */
+- (OFArray *)candidates;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The duration (seconds) of the last successful roam, from the reassociation request to the completed handshake.
+ */
+@property (readonly) of_time_interval_t lastRoamDuration;
+
+/*!
+ * @method
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * The BSS the interface roamed to, or nil if an error occurs.
+ *
+ * @abstract
+ * Roams to the best candidate now, whatever the current RSSI.
+ *
+ * @discussion
+ * Blocks for the duration of the roam. Fails with a CDAWiFiInvalidParameterError error if the engine is not running
+ * or the interface is not associated, and with a CDAWiFiUnspecifiedFailureError error if there is no candidate.
+ * Must not be called from the roam handler.
+ */
+- (CDAWiFiNetwork *)roamAndReturnError:(out CDAError **)error;
+
+@end
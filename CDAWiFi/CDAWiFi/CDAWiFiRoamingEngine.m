@@ -0,0 +1,675 @@
+//
+//  CDAWiFiRoamingEngine.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/11/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiRoamingEngine.h"
+#import "CDAWiFiRoamingEngine+Private.h"
+#import "CDAWiFiInterface.h"
+#import "CDAWiFiInterface+Private.h"
+#import "CDAWiFiClient.h"
+#import "CDAWiFiClient+Private.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiInterfaceState.h"
+#import "CDAWiFiInterfaceState+Private.h"
+#import "CDAWiFiSSID.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiScanCacheChanges.h"
+#import "CDAWiFiEventEngine.h"
+#import "CDAWiFiCrypto.h"
+#import "CDAWiFiUtilities.h"
+#include <stdlib.h>
+
+/* Score bonus (dB) of 5 GHz BSSes, which are usually less congested. */
+#define CDAWiFiRoamingEngine5GHzBonus 5
+
+/* Hysteresis (dB) of the connection quality monitor. */
+#define CDAWiFiRoamingEngineHysteresis 4
+
+/* Background scans are skipped while the RSSI is this far (dB) above the roam threshold. */
+#define CDAWiFiRoamingEngineScanMargin 10
+
+/* Seconds a BSS that refused a reassociation is skipped. */
+#define CDAWiFiRoamingEngineFailurePenalty 60
+
+/* Candidates tried per roam. */
+#define CDAWiFiRoamingEngineMaximumAttempts 2
+
+/* Best candidates with a PMK security association installed. */
+#define CDAWiFiRoamingEngineIdentifierCount 3
+
+static inline int CDAWiFiRoamingEngineScore(int rssi, CDAWiFiChannel *channel)
+{
+    return rssi + ((channel.channelBand == CDAWiFiChannelBand5GHz) ? CDAWiFiRoamingEngine5GHzBonus : 0);
+}
+
+static inline BOOL CDAWiFiRoamingEngineIsPersonal(CDAWiFiSecurity security)
+{
+    return (security == CDAWiFiSecurityWPAPersonal ||
+            security == CDAWiFiSecurityWPAPersonalMixed ||
+            security == CDAWiFiSecurityWPA2Personal ||
+            security == CDAWiFiSecurityPersonal);
+}
+
+@implementation CDAWiFiRoamingEngine
+{
+    /* Every ivar below but the candidates is only used on the queue. */
+    dispatch_queue_t _queue;
+    dispatch_source_t _scanTimer;
+    id _linkObserver;
+    BOOL _running;
+    BOOL _scanning;
+    BOOL _roamPending;
+    
+    CDAWiFiSSID *_ssid;
+    CDAWiFiSecurity _security;
+    CDAWiFiMACAddress _bssid;
+    OFMutableDictionary *_networks;     /* CDAWiFiNetwork of the SSID by BSSID */
+    OFMutableDictionary *_failures;     /* OFNumber monotonic time of the last refused reassociation by BSSID */
+    OFMutableDictionary *_identifiers;  /* OFDataArray PMKID installed in the driver by BSSID */
+    
+    OFMutex *_mutex;
+    OFArray *_candidates;
+    of_time_interval_t _lastRoamDuration;
+}
+
+@synthesize interface = _interface, roamThreshold = _roamThreshold, minimumImprovement = _minimumImprovement;
+@synthesize scanInterval = _scanInterval, roamHandler = _roamHandler;
+
+#pragma mark - Initialization
+
+- (instancetype)initWithInterface:(CDAWiFiInterface *)interface
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _interface = interface;
+        _roamThreshold = CDAWiFiRoamingEngineDefaultRoamThreshold;
+        _minimumImprovement = CDAWiFiRoamingEngineDefaultMinimumImprovement;
+        _scanInterval = CDAWiFiRoamingEngineDefaultScanInterval;
+        _queue = dispatch_queue_create("CDAWiFiRoamingEngine", DISPATCH_QUEUE_SERIAL);
+        _networks = [OFMutableDictionary dictionary];
+        _failures = [OFMutableDictionary dictionary];
+        _identifiers = [OFMutableDictionary dictionary];
+        _mutex = [OFMutex mutex];
+        _candidates = [OFArray array];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    /* Pending blocks retain the engine, so the queue is idle here. */
+    if (_linkObserver != nil) {
+        [_interface.client.eventEngine removeLinkObserver:_linkObserver];
+    }
+    
+    if (_scanTimer != NULL) {
+        
+        dispatch_source_cancel(_scanTimer);
+        
+        CDAWiFiDispatchRelease(_scanTimer);
+    }
+    
+    if (_queue != NULL) {
+        CDAWiFiDispatchRelease(_queue);
+    }
+}
+
+#pragma mark - Running the Engine
+
+- (BOOL)startAndReturnError:(out CDAError **)error
+{
+    __block BOOL success = YES;
+    __block CDAError *startError = nil;
+    
+    dispatch_sync(_queue, ^{
+        
+        if (_running) {
+            return;
+        }
+        
+        CDAWiFiEventEngine *eventEngine = _interface.client.eventEngine;
+        
+        if (eventEngine == nil) {
+            
+            startError = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+            success = NO;
+            
+            return;
+        }
+        
+        if (![eventEngine startAndReturnError:&startError]) {
+            
+            success = NO;
+            
+            return;
+        }
+        
+        __weak CDAWiFiRoamingEngine *weakSelf = self;
+        dispatch_queue_t queue = _queue;
+        
+        _linkObserver = [eventEngine addLinkObserverForInterfaceIndex:_interface.interfaceIndex handler:^(CDAWiFiEventType type, int rssi) {
+            
+            dispatch_async(queue, ^{
+                
+                [weakSelf handleLinkEventWithType:type rssi:rssi];
+            });
+        }];
+        
+        _running = YES;
+        _interface.roamingEngine = self;
+        
+        /* Without a connection quality monitor, the background scan timer polls the RSSI. */
+        [_interface setConnectionQualityThreshold:_roamThreshold hysteresis:CDAWiFiRoamingEngineHysteresis error:NULL];
+        
+        [self updateConnection];
+        
+        if (_scanInterval > 0) {
+            
+            uint64_t interval = (uint64_t)(_scanInterval * NSEC_PER_SEC);
+            
+            _scanTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+            
+            dispatch_source_set_timer(_scanTimer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+            
+            dispatch_source_set_event_handler(_scanTimer, ^{
+                
+                [weakSelf scanTimerDidFire];
+            });
+            
+            dispatch_resume(_scanTimer);
+        }
+    });
+    
+    if (!success && error != NULL) {
+        *error = startError;
+    }
+    
+    return success;
+}
+
+- (void)stop
+{
+    dispatch_sync(_queue, ^{
+        
+        if (!_running) {
+            return;
+        }
+        
+        _running = NO;
+        _roamPending = NO;
+        
+        [_interface.client.eventEngine removeLinkObserver:_linkObserver];
+        
+        _linkObserver = nil;
+        
+        if (_scanTimer != NULL) {
+            
+            dispatch_source_cancel(_scanTimer);
+            
+            CDAWiFiDispatchRelease(_scanTimer);
+            
+            _scanTimer = NULL;
+        }
+        
+        if (_interface.roamingEngine == self) {
+            _interface.roamingEngine = nil;
+        }
+        
+        [self forgetConnection];
+    });
+}
+
+#pragma mark - Candidates
+
+- (OFArray *)candidates
+{
+    [_mutex lock];
+    
+    OFArray *candidates = _candidates;
+    
+    [_mutex unlock];
+    
+    return candidates;
+}
+
+- (of_time_interval_t)lastRoamDuration
+{
+    [_mutex lock];
+    
+    of_time_interval_t duration = _lastRoamDuration;
+    
+    [_mutex unlock];
+    
+    return duration;
+}
+
+- (void)scanCacheDidChange:(CDAWiFiScanCacheChanges *)changes
+{
+    dispatch_async(_queue, ^{
+        
+        if (!_running || _ssid == nil) {
+            return;
+        }
+        
+        if (changes.reset) {
+            [_networks removeAllObjects];
+        }
+        
+        for (CDAWiFiNetwork *network in changes.removedNetworks) {
+            
+            [_networks removeObjectForKey:[OFNumber numberWithUInt64:network.bssidValue]];
+        }
+        
+        for (CDAWiFiNetwork *network in changes.addedNetworks) {
+            
+            [self addNetwork:network];
+        }
+        
+        for (CDAWiFiNetwork *network in changes.changedNetworks) {
+            
+            [self addNetwork:network];
+        }
+        
+        [self rankCandidates];
+        
+        if (_roamPending) {
+            
+            [_interface updateStateAndReturnError:NULL];
+            
+            [self roamIfNeededWithRSSI:_interface.rssiValue];
+        }
+    });
+}
+
+/* Keeps a network if it belongs to the current ESS. */
+- (void)addNetwork:(CDAWiFiNetwork *)network
+{
+    if (network.bssidValue == 0 || network.security != _security || ![network.internedSSID isEqualToSSID:_ssid]) {
+        return;
+    }
+    
+    _networks[[OFNumber numberWithUInt64:network.bssidValue]] = network;
+}
+
+/* Reads the current BSS, and reloads the networks of the ESS from the scan cache if the SSID changed. */
+- (void)updateConnection
+{
+    [_interface updateStateAndReturnError:NULL];
+    
+    CDAWiFiSSID *ssid = _interface.state.internedSSID;
+    CDAWiFiSecurity security = _interface.security;
+    
+    /* A BSS just joined may not be in the scan cache yet, the state reads its security from there. */
+    if (ssid != nil && security == CDAWiFiSecurityUnknown && _interface.cachedScanResults != nil &&
+        [_interface updateStateAndReturnError:NULL]) {
+        
+        ssid = _interface.state.internedSSID;
+        security = _interface.security;
+    }
+    
+    if (ssid == nil || (security != CDAWiFiSecurityNone && !CDAWiFiRoamingEngineIsPersonal(security))) {
+        
+        [self forgetConnection];
+        
+        return;
+    }
+    
+    if (![ssid isEqualToSSID:_ssid] || security != _security) {
+        
+        [self forgetConnection];
+        
+        _ssid = ssid;
+        _security = security;
+        
+        for (CDAWiFiNetwork *network in _interface.cachedScanResults) {
+            
+            [self addNetwork:network];
+        }
+    }
+    
+    _bssid = _interface.bssidValue;
+    
+    [self rankCandidates];
+}
+
+/* Forgets the current ESS and removes the installed PMK security associations. */
+- (void)forgetConnection
+{
+    for (OFNumber *key in _identifiers) {
+        
+        OFDataArray *identifier = _identifiers[key];
+        
+        [_interface removePairwiseMasterKeyIdentifier:identifier.items forBSSID:key.uInt64Value];
+    }
+    
+    [_identifiers removeAllObjects];
+    [_networks removeAllObjects];
+    [_failures removeAllObjects];
+    
+    _ssid = nil;
+    _security = CDAWiFiSecurityNone;
+    _bssid = 0;
+    
+    [_mutex lock];
+    
+    _candidates = [OFArray array];
+    
+    [_mutex unlock];
+}
+
+/* Sorts the networks of the ESS by score, best first, then installs the PMK security associations of the best ones. */
+- (void)rankCandidates
+{
+    size_t count = 0;
+    int *scores = malloc((_networks.count + 1) * sizeof(int));
+    OFMutableArray *candidates = [OFMutableArray arrayWithCapacity:_networks.count];
+    
+    if (scores == NULL) {
+        return;
+    }
+    
+    for (OFNumber *key in _networks) {
+        
+        CDAWiFiNetwork *network = _networks[key];
+        
+        if (network.bssidValue == _bssid) {
+            continue;
+        }
+        
+        int score = CDAWiFiRoamingEngineScore(network.rssiValue, network.wlanChannel);
+        size_t index = count;
+        
+        while (index > 0 && scores[index - 1] < score) {
+            
+            scores[index] = scores[index - 1];
+            index--;
+        }
+        
+        scores[index] = score;
+        
+        [candidates insertObject:network atIndex:index];
+        
+        count++;
+    }
+    
+    free(scores);
+    
+    [candidates makeImmutable];
+    
+    [_mutex lock];
+    
+    _candidates = candidates;
+    
+    [_mutex unlock];
+    
+    [self installIdentifiersForCandidates:candidates];
+}
+
+/* PMKID = HMAC-SHA1-128(PMK, "PMK Name" || AA || SPA), installed ahead of time so reassociating skips authentication. */
+- (void)installIdentifiersForCandidates:(OFArray *)candidates
+{
+    uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+    uint8_t supplicantAddress[6], authenticatorAddress[6];
+    uint8_t identifier[CDAWiFiPairwiseMasterKeyIdentifierLength];
+    OFMutableDictionary *identifiers = [OFMutableDictionary dictionary];
+    
+    if (CDAWiFiRoamingEngineIsPersonal(_security) && [_interface getPairwiseMasterKey:key]) {
+        
+        CDAWiFiMACAddressGetOctets(_interface.hardwareAddressValue, supplicantAddress);
+        
+        for (size_t index = 0; index < OF_MIN(candidates.count, CDAWiFiRoamingEngineIdentifierCount); index++) {
+            
+            CDAWiFiNetwork *network = candidates[index];
+            OFNumber *bssid = [OFNumber numberWithUInt64:network.bssidValue];
+            OFDataArray *installedIdentifier = _identifiers[bssid];
+            
+            if (installedIdentifier == nil) {
+                
+                CDAWiFiMACAddressGetOctets(network.bssidValue, authenticatorAddress);
+                
+                CDAWiFiPairwiseMasterKeyIdentifierDerive(key, authenticatorAddress, supplicantAddress, identifier);
+                
+                if (![_interface setPairwiseMasterKeyIdentifier:identifier key:key forBSSID:network.bssidValue error:NULL]) {
+                    continue;
+                }
+                
+                installedIdentifier = [OFDataArray dataArray];
+                
+                [installedIdentifier addItems:identifier count:sizeof(identifier)];
+            }
+            
+            identifiers[bssid] = installedIdentifier;
+            
+            [_identifiers removeObjectForKey:bssid];
+        }
+        
+        CDAWiFiSecureZero(key, sizeof(key));
+    }
+    
+    /* Candidates that fell out of the best ones. */
+    for (OFNumber *bssid in _identifiers) {
+        
+        OFDataArray *installedIdentifier = _identifiers[bssid];
+        
+        [_interface removePairwiseMasterKeyIdentifier:installedIdentifier.items forBSSID:bssid.uInt64Value];
+    }
+    
+    _identifiers = identifiers;
+}
+
+#pragma mark - Link Events
+
+- (void)handleLinkEventWithType:(CDAWiFiEventType)type rssi:(int)rssi
+{
+    if (!_running) {
+        return;
+    }
+    
+    switch (type) {
+        
+        case CDAWiFiEventTypeBSSIDDidChange:
+            
+            [self updateConnection];
+            
+            break;
+        
+        case CDAWiFiEventTypeLinkDidChange:
+            
+            /* Disconnected, the candidates become current again on the next connection. */
+            _bssid = 0;
+            _roamPending = NO;
+            
+            break;
+        
+        case CDAWiFiEventTypeLinkQualityDidChange:
+            
+            /* Some drivers do not report the RSSI level. */
+            if (rssi == 0 && [_interface updateStateAndReturnError:NULL]) {
+                rssi = _interface.rssiValue;
+            }
+            
+            [self roamIfNeededWithRSSI:rssi];
+            
+            break;
+        
+        default:
+            
+            break;
+    }
+}
+
+- (void)scanTimerDidFire
+{
+    if (!_running || _bssid == 0 || ![_interface updateStateAndReturnError:NULL]) {
+        return;
+    }
+    
+    int rssi = _interface.rssiValue;
+    
+    if (rssi < _roamThreshold) {
+        
+        [self roamIfNeededWithRSSI:rssi];
+        
+    } else if (rssi < _roamThreshold + CDAWiFiRoamingEngineScanMargin) {
+        
+        [self scan];
+    }
+}
+
+/* Directed scan for the SSID. The scan cache hook updates the candidates before the completion handler runs. */
+- (void)scan
+{
+    if (_scanning || _ssid == nil) {
+        return;
+    }
+    
+    _scanning = YES;
+    
+    [_interface scanForNetworksWithSSID:_ssid.data queue:_queue resultHandler:nil completionHandler:^(OFSet *networks, CDAError *error) {
+        
+        _scanning = NO;
+        
+        /* Nothing better was found. */
+        _roamPending = NO;
+    }];
+}
+
+#pragma mark - Roaming
+
+- (void)roamIfNeededWithRSSI:(int)rssi
+{
+    if (_bssid == 0 || rssi == 0 || rssi >= _roamThreshold) {
+        
+        _roamPending = NO;
+        
+        return;
+    }
+    
+    CDAError *error = nil;
+    CDAWiFiNetwork *network = [self roamWithRSSI:rssi force:NO error:&error];
+    
+    if (network == nil && error == nil) {
+        
+        /* No candidate is good enough yet, look for one and roam as soon as it is found. */
+        _roamPending = YES;
+        
+        [self scan];
+        
+        return;
+    }
+    
+    void (^roamHandler)(CDAWiFiNetwork *, CDAError *) = self.roamHandler;
+    
+    if (roamHandler != nil) {
+        
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            
+            roamHandler(network, error);
+        });
+    }
+}
+
+/* Reassociates to the best candidates in turn. Returns nil without an error if no candidate qualifies. */
+- (CDAWiFiNetwork *)roamWithRSSI:(int)rssi force:(BOOL)force error:(out CDAError **)error
+{
+    int minimumScore = CDAWiFiRoamingEngineScore(rssi, _interface.wlanChannel) + self.minimumImprovement;
+    of_time_interval_t now = CDAWiFiMonotonicTime();
+    CDAWiFiMACAddress previousBSSID = _bssid;
+    CDAError *roamError = nil;
+    int attempts = 0;
+    
+    for (CDAWiFiNetwork *network in [self candidates]) {
+        
+        if (attempts == CDAWiFiRoamingEngineMaximumAttempts) {
+            break;
+        }
+        
+        /* Candidates are ranked, no later one qualifies either. */
+        if (!force && CDAWiFiRoamingEngineScore(network.rssiValue, network.wlanChannel) < minimumScore) {
+            break;
+        }
+        
+        OFNumber *bssid = [OFNumber numberWithUInt64:network.bssidValue];
+        OFNumber *failure = _failures[bssid];
+        
+        if (failure != nil && now - failure.doubleValue < CDAWiFiRoamingEngineFailurePenalty) {
+            continue;
+        }
+        
+        attempts++;
+        
+        of_time_interval_t start = CDAWiFiMonotonicTime();
+        
+        if ([_interface associateToNetwork:network password:nil previousBSSID:previousBSSID error:&roamError]) {
+            
+            of_time_interval_t duration = CDAWiFiMonotonicTime() - start;
+            
+            [_mutex lock];
+            
+            _lastRoamDuration = duration;
+            
+            [_mutex unlock];
+            
+            _roamPending = NO;
+            
+            [_failures removeObjectForKey:bssid];
+            
+            [self updateConnection];
+            
+            return network;
+        }
+        
+        _failures[bssid] = [OFNumber numberWithDouble:now];
+        
+        /* A failed reassociation may have dropped the link. */
+        [_interface updateStateAndReturnError:NULL];
+        
+        previousBSSID = _interface.bssidValue;
+    }
+    
+    if (error != NULL) {
+        *error = roamError;
+    }
+    
+    return nil;
+}
+
+- (CDAWiFiNetwork *)roamAndReturnError:(out CDAError **)error
+{
+    __block CDAWiFiNetwork *network = nil;
+    __block CDAError *roamError = nil;
+    
+    dispatch_sync(_queue, ^{
+        
+        if (!_running || _bssid == 0) {
+            
+            roamError = CDAWiFiErrorWithCode(CDAWiFiInvalidParameterError);
+            
+            return;
+        }
+        
+        [_interface updateStateAndReturnError:NULL];
+        
+        network = [self roamWithRSSI:_interface.rssiValue force:YES error:&roamError];
+        
+        if (network == nil && roamError == nil) {
+            roamError = CDAWiFiErrorWithCode(CDAWiFiUnspecifiedFailureError);
+        }
+    });
+    
+    if (network == nil && error != NULL) {
+        *error = roamError;
+    }
+    
+    return network;
+}
+
+@end
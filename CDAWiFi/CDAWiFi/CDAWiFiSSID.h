@@ -0,0 +1,85 @@
+//
+//  CDAWiFiSSID.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+
+/*!
+ * @class
+ *
+ * @abstract
+ * The octets of an SSID, interned.
+ *
+ * @discussion
+ * Networks, network profiles and interface states with the same SSID share the same immutable entry,
+ * so dozens of BSSes of an ESS keep a single copy of its octets and its string, which is decoded once, on first access.
+ * Interned entries are equal only if they are the same object, so comparing SSIDs is a pointer comparison.
+ *
+ * The table does not own the entries: an entry leaves it when its last owner releases it, so the table only holds
+ * the SSIDs in use, however many distinct SSIDs were seen.
+ *
+ * Thread safe.
+ */
+@interface CDAWiFiSSID : OFObject
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the entry of an SSID, or nil if it is longer than 32 octets.
+ */
++ (CDAWiFiSSID *)SSIDWithBytes:(const uint8_t *)bytes length:(size_t)length;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the entry of the octets of a data array, or nil if it is nil or longer than 32 octets.
+ */
++ (CDAWiFiSSID *)SSIDWithData:(OFDataArray *)data;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The octets of the SSID.
+ */
+@property (readonly) const uint8_t *bytes;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The number of octets of the SSID, 0 to 32.
+ */
+@property (readonly) size_t length;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the SSID encoded as a string, or nil if it is empty or not valid UTF-8 or WinLatin1.
+ */
+- (OFString *)string;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns a new data array of the octets of the SSID.
+ */
+- (OFDataArray *)data;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Compares two SSIDs, by pointer when both are interned.
+ */
+- (BOOL)isEqualToSSID:(CDAWiFiSSID *)ssid;
+
+@end
@@ -0,0 +1,338 @@
+//
+//  CDAWiFiSSID.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiSSID.h"
+#import "CDAWiFiUtilities.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Initial number of slots of the intern table, a power of two. */
+#define CDAWiFiSSIDTableInitialCapacity 256
+
+/* States of the lazily decoded string. */
+enum {
+    CDAWiFiSSIDStringUndecoded  = 0,
+    CDAWiFiSSIDStringDecoding   = 1,
+    CDAWiFiSSIDStringDecoded    = 2
+};
+
+@interface CDAWiFiSSID ()
+
+- (instancetype)initWithBytes:(const uint8_t *)bytes length:(size_t)length hash:(uint32_t)hash tableEntry:(void *)tableEntry;
+
+@end
+
+/*
+ * The slot of an interned SSID. The octets are copied, so lookups compare them without loading the SSID,
+ * and the reference is weak: it reads nil as soon as the SSID starts deallocating.
+ */
+@interface CDAWiFiSSIDTableEntry : OFObject
+{
+@public
+    uint8_t _bytes[32];
+    size_t _length;
+    __weak CDAWiFiSSID *_ssid;
+}
+
+@end
+
+@implementation CDAWiFiSSIDTableEntry
+
+@end
+
+/*
+ * Open addressed table of the interned entries, with linear probing. The slots retain the table entries, not the SSIDs:
+ * a deallocating SSID removes its slot. Guarded by CDAWiFiSSIDTableMutex.
+ */
+static struct {
+    uint32_t hash;
+    void *entry;
+} *CDAWiFiSSIDTableSlots;
+
+static size_t CDAWiFiSSIDTableMask;
+static size_t CDAWiFiSSIDTableCount;
+static OFMutex *CDAWiFiSSIDTableMutex;
+
+static uint32_t CDAWiFiSSIDHash(const uint8_t *bytes, size_t length)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    
+    for (size_t index = 0; index < length; index++) {
+        hash = (hash ^ bytes[index]) * 16777619u;
+    }
+    
+    return hash;
+}
+
+static BOOL CDAWiFiSSIDTableGrow(void)
+{
+    size_t capacity = (CDAWiFiSSIDTableSlots == NULL) ? CDAWiFiSSIDTableInitialCapacity : (CDAWiFiSSIDTableMask + 1) * 2;
+    __typeof__(CDAWiFiSSIDTableSlots) slots = calloc(capacity, sizeof(*slots));
+    
+    if (slots == NULL) {
+        return NO;
+    }
+    
+    for (size_t index = 0; CDAWiFiSSIDTableSlots != NULL && index <= CDAWiFiSSIDTableMask; index++) {
+        
+        if (CDAWiFiSSIDTableSlots[index].entry == NULL) {
+            continue;
+        }
+        
+        size_t slot = CDAWiFiSSIDTableSlots[index].hash & (capacity - 1);
+        
+        while (slots[slot].entry != NULL) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        
+        slots[slot] = CDAWiFiSSIDTableSlots[index];
+    }
+    
+    free(CDAWiFiSSIDTableSlots);
+    
+    CDAWiFiSSIDTableSlots = slots;
+    CDAWiFiSSIDTableMask = capacity - 1;
+    
+    return YES;
+}
+
+/* Empties a slot, moving back the entries after it that probed past it, so no probe sequence is broken. */
+static void CDAWiFiSSIDTableRemove(size_t index)
+{
+    (void)(__bridge_transfer CDAWiFiSSIDTableEntry *)CDAWiFiSSIDTableSlots[index].entry;
+    
+    CDAWiFiSSIDTableSlots[index].entry = NULL;
+    CDAWiFiSSIDTableCount--;
+    
+    for (size_t next = (index + 1) & CDAWiFiSSIDTableMask; CDAWiFiSSIDTableSlots[next].entry != NULL;
+         next = (next + 1) & CDAWiFiSSIDTableMask) {
+        
+        size_t home = CDAWiFiSSIDTableSlots[next].hash & CDAWiFiSSIDTableMask;
+        
+        /* The hole is between the home slot of the entry and the entry. */
+        if (((next - home) & CDAWiFiSSIDTableMask) >= ((next - index) & CDAWiFiSSIDTableMask)) {
+            
+            CDAWiFiSSIDTableSlots[index] = CDAWiFiSSIDTableSlots[next];
+            CDAWiFiSSIDTableSlots[next].entry = NULL;
+            
+            index = next;
+        }
+    }
+}
+
+@implementation CDAWiFiSSID
+{
+    uint8_t _bytes[32];
+    size_t _length;
+    uint32_t _hash;
+    BOOL _interned;
+    
+    /* The CDAWiFiSSIDTableEntry of the SSID, owned by the table, or NULL if it is not interned. */
+    void *_tableEntry;
+    
+    _Atomic(int) _stringState;
+    OFString *_string;
+}
+
+@synthesize length = _length;
+
+#pragma mark - Initialization
+
++ (void)initialize
+{
+    if (self == [CDAWiFiSSID class]) {
+        CDAWiFiSSIDTableMutex = [[OFMutex alloc] init];
+    }
+}
+
++ (CDAWiFiSSID *)SSIDWithBytes:(const uint8_t *)bytes length:(size_t)length
+{
+    if (length > 32) {
+        return nil;
+    }
+    
+    uint32_t hash = CDAWiFiSSIDHash(bytes, length);
+    CDAWiFiSSID *ssid = nil;
+    
+    [CDAWiFiSSIDTableMutex lock];
+    
+    /*
+     * Only a match is loaded, and kept, so no SSID is released under the mutex, where its dealloc would deadlock.
+     * The slot of an SSID being deallocated reads nil until it is removed, a new entry takes its place.
+     */
+    for (size_t index = hash & CDAWiFiSSIDTableMask; CDAWiFiSSIDTableSlots != NULL && CDAWiFiSSIDTableSlots[index].entry != NULL;
+         index = (index + 1) & CDAWiFiSSIDTableMask) {
+        
+        __unsafe_unretained CDAWiFiSSIDTableEntry *entry = (__bridge CDAWiFiSSIDTableEntry *)CDAWiFiSSIDTableSlots[index].entry;
+        
+        if (CDAWiFiSSIDTableSlots[index].hash == hash && entry->_length == length && memcmp(entry->_bytes, bytes, length) == 0) {
+            
+            ssid = entry->_ssid;
+            
+            if (ssid != nil) {
+                break;
+            }
+        }
+    }
+    
+    /* Kept at most half full, probe sequences stay short. */
+    if (ssid == nil && ((CDAWiFiSSIDTableCount + 1) * 2 <= CDAWiFiSSIDTableMask + 1 || CDAWiFiSSIDTableGrow())) {
+        
+        CDAWiFiSSIDTableEntry *entry = [[CDAWiFiSSIDTableEntry alloc] init];
+        size_t index = hash & CDAWiFiSSIDTableMask;
+        
+        memcpy(entry->_bytes, bytes, length);
+        entry->_length = length;
+        
+        ssid = [[CDAWiFiSSID alloc] initWithBytes:bytes length:length hash:hash tableEntry:(__bridge void *)entry];
+        entry->_ssid = ssid;
+        
+        while (CDAWiFiSSIDTableSlots[index].entry != NULL) {
+            index = (index + 1) & CDAWiFiSSIDTableMask;
+        }
+        
+        CDAWiFiSSIDTableSlots[index].hash = hash;
+        CDAWiFiSSIDTableSlots[index].entry = (__bridge_retained void *)entry;
+        CDAWiFiSSIDTableCount++;
+    }
+    
+    [CDAWiFiSSIDTableMutex unlock];
+    
+    /* The table could not grow. */
+    if (ssid == nil) {
+        ssid = [[CDAWiFiSSID alloc] initWithBytes:bytes length:length hash:hash tableEntry:NULL];
+    }
+    
+    return ssid;
+}
+
++ (CDAWiFiSSID *)SSIDWithData:(OFDataArray *)data
+{
+    if (data == nil) {
+        return nil;
+    }
+    
+    return [self SSIDWithBytes:data.items length:data.count * data.itemSize];
+}
+
+- (instancetype)initWithBytes:(const uint8_t *)bytes length:(size_t)length hash:(uint32_t)hash tableEntry:(void *)tableEntry
+{
+    self = [super init];
+    
+    if (self) {
+        
+        memcpy(_bytes, bytes, length);
+        
+        _length = length;
+        _hash = hash;
+        _interned = (tableEntry != NULL);
+        _tableEntry = tableEntry;
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_tableEntry == NULL) {
+        return;
+    }
+    
+    [CDAWiFiSSIDTableMutex lock];
+    
+    for (size_t index = _hash & CDAWiFiSSIDTableMask; CDAWiFiSSIDTableSlots[index].entry != NULL;
+         index = (index + 1) & CDAWiFiSSIDTableMask) {
+        
+        if (CDAWiFiSSIDTableSlots[index].entry == _tableEntry) {
+            
+            CDAWiFiSSIDTableRemove(index);
+            
+            break;
+        }
+    }
+    
+    [CDAWiFiSSIDTableMutex unlock];
+}
+
+- (id)copy
+{
+    /* Immutable */
+    return self;
+}
+
+#pragma mark - Properties
+
+- (const uint8_t *)bytes
+{
+    return _bytes;
+}
+
+/* Decodes the string on first access. If another thread is decoding it at the same time, decodes a copy instead of waiting. */
+- (OFString *)string
+{
+    if (atomic_load_explicit(&_stringState, memory_order_acquire) == CDAWiFiSSIDStringDecoded) {
+        return _string;
+    }
+    
+    OFString *string = CDAWiFiSSIDString(_bytes, _length);
+    int expected = CDAWiFiSSIDStringUndecoded;
+    
+    if (atomic_compare_exchange_strong(&_stringState, &expected, CDAWiFiSSIDStringDecoding)) {
+        
+        _string = string;
+        
+        atomic_store_explicit(&_stringState, CDAWiFiSSIDStringDecoded, memory_order_release);
+    }
+    
+    return string;
+}
+
+- (OFDataArray *)data
+{
+    /* OFDataArray is mutable, so every caller gets its own octets. */
+    OFDataArray *data = [OFDataArray dataArray];
+    
+    [data addItems:_bytes count:_length];
+    
+    return data;
+}
+
+#pragma mark - Equality
+
+- (BOOL)isEqualToSSID:(CDAWiFiSSID *)ssid
+{
+    if (ssid == self) {
+        return YES;
+    }
+    
+    if (ssid == nil || (_interned && ssid->_interned)) {
+        return NO;
+    }
+    
+    return _length == ssid->_length && memcmp(_bytes, ssid->_bytes, _length) == 0;
+}
+
+- (bool)isEqual:(id)other
+{
+    if (other == self) {
+        return YES;
+    } else if (![other isKindOfClass:[CDAWiFiSSID class]]) {
+        return NO;
+    } else {
+        return [self isEqualToSSID:other];
+    }
+}
+
+- (uint32_t)hash
+{
+    return _hash;
+}
+
+@end
@@ -0,0 +1,67 @@
+//
+//  CDAWiFiScanArena.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/9/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+
+/*!
+ * @constant CDAWiFiScanArenaDefaultChunkSize
+ *
+ * @abstract The chunk size of an arena, enough for the information elements of about a hundred BSSs.
+ */
+#define CDAWiFiScanArenaDefaultChunkSize (64 * 1024)
+
+/*!
+ * @constant CDAWiFiScanArenaPadding
+ *
+ * @abstract The number of readable bytes after every payload, so parsers loading a few bytes at a time may read past its end.
+ */
+#define CDAWiFiScanArenaPadding 8
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Storage for the variable length payloads of the networks decoded from one scan dump.
+ *
+ * @discussion
+ * Bytes are appended to large chunks and never moved or freed individually.
+ * Every network of the scan keeps the arena alive, and all chunks are freed at once when the last network goes.
+ *
+ * Appending is not thread safe and is done by the thread decoding the scan. The bytes are immutable once appended.
+ */
+@interface CDAWiFiScanArena : OFObject
+
+/*!
+ * @method
+ *
+ * @param chunkSize
+ * The size of the chunks bytes are appended to. Payloads larger than a quarter of it get a chunk of their own.
+ */
+- (instancetype)initWithChunkSize:(size_t)chunkSize;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The number of bytes allocated for the chunks.
+ */
+@property (readonly) size_t size;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Copies bytes to the arena.
+ *
+ * @result
+ * The copy, valid as long as the arena and followed by at least CDAWiFiScanArenaPadding readable bytes,
+ * or NULL if memory is exhausted. A zero length returns a valid, empty pointer.
+ */
+- (const uint8_t *)addBytes:(const void *)bytes length:(size_t)length;
+
+@end
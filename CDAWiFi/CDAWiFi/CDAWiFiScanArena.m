@@ -0,0 +1,147 @@
+//
+//  CDAWiFiScanArena.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/9/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiScanArena.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct CDAWiFiScanArenaChunk
+{
+    struct CDAWiFiScanArenaChunk *next;
+    size_t size;
+    size_t used;
+    uint8_t bytes[];
+    
+} CDAWiFiScanArenaChunk;
+
+@implementation CDAWiFiScanArena
+{
+    size_t _chunkSize;
+    
+    /* The chunk bytes are appended to. Dedicated chunks of large payloads are linked after it. */
+    CDAWiFiScanArenaChunk *_chunks;
+}
+
+@synthesize size = _size;
+
+- (instancetype)init
+{
+    return [self initWithChunkSize:CDAWiFiScanArenaDefaultChunkSize];
+}
+
+- (instancetype)initWithChunkSize:(size_t)chunkSize
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _chunkSize = (chunkSize > 0) ? chunkSize : CDAWiFiScanArenaDefaultChunkSize;
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    CDAWiFiScanArenaChunk *chunk = _chunks;
+    
+    while (chunk != NULL) {
+        
+        CDAWiFiScanArenaChunk *next = chunk->next;
+        
+        free(chunk);
+        
+        chunk = next;
+    }
+}
+
+- (CDAWiFiScanArenaChunk *)newChunkWithSize:(size_t)size
+{
+    if (size > SIZE_MAX - sizeof(CDAWiFiScanArenaChunk) - CDAWiFiScanArenaPadding) {
+        return NULL;
+    }
+    
+    /* The padding follows the last payload of the chunk, the others are followed by the next payload. */
+    CDAWiFiScanArenaChunk *chunk = malloc(sizeof(CDAWiFiScanArenaChunk) + size + CDAWiFiScanArenaPadding);
+    
+    if (chunk == NULL) {
+        return NULL;
+    }
+    
+    memset(chunk->bytes + size, 0, CDAWiFiScanArenaPadding);
+    
+    chunk->size = size;
+    chunk->used = 0;
+    
+    _size += sizeof(CDAWiFiScanArenaChunk) + size + CDAWiFiScanArenaPadding;
+    
+    return chunk;
+}
+
+- (const uint8_t *)addBytes:(const void *)bytes length:(size_t)length
+{
+    static const uint8_t empty[CDAWiFiScanArenaPadding] = { 0 };
+    
+    CDAWiFiScanArenaChunk *chunk = _chunks;
+    
+    if (length == 0) {
+        return empty;
+    }
+    
+    if (length > _chunkSize / 4) {
+        
+        /* Large payloads get a chunk of their own, so the current chunk keeps filling up. */
+        CDAWiFiScanArenaChunk *dedicated = [self newChunkWithSize:length];
+        
+        if (dedicated == NULL) {
+            return NULL;
+        }
+        
+        if (chunk != NULL) {
+            
+            dedicated->next = chunk->next;
+            chunk->next = dedicated;
+            
+        } else {
+            
+            /* Full once copied, so the next payload starts a new chunk. */
+            dedicated->next = NULL;
+            
+            _chunks = dedicated;
+        }
+        
+        memcpy(dedicated->bytes, bytes, length);
+        
+        dedicated->used = length;
+        
+        return dedicated->bytes;
+    }
+    
+    if (chunk == NULL || chunk->size - chunk->used < length) {
+        
+        chunk = [self newChunkWithSize:_chunkSize];
+        
+        if (chunk == NULL) {
+            return NULL;
+        }
+        
+        chunk->next = _chunks;
+        
+        _chunks = chunk;
+    }
+    
+    uint8_t *copy = chunk->bytes + chunk->used;
+    
+    memcpy(copy, bytes, length);
+    
+    chunk->used += length;
+    
+    return copy;
+}
+
+@end
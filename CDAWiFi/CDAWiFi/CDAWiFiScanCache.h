@@ -0,0 +1,131 @@
+//
+//  CDAWiFiScanCache.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/6/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiScanCacheChanges.h"
+#import "CDAWiFiTypes.h"
+
+@class CDAWiFiNetwork, CDAWiFiScanQuery;
+
+/*!
+ * @constant CDAWiFiScanCacheDefaultMaximumAge
+ *
+ * @abstract The default age (seconds) after which a BSS that was not heard again expires, the kernel scan result lifetime.
+ */
+#define CDAWiFiScanCacheDefaultMaximumAge 30
+
+/*!
+ * @class
+ *
+ * @abstract
+ * The scan cache of a Wi-Fi interface, keyed by BSSID.
+ *
+ * @discussion
+ * Entries are found by BSSID in an open addressed hash table, so merging a scan result costs the same
+ * whatever the size of the cache. Every entry is stamped with the time its BSS was last heard, and expires
+ * maximumAge later. Expirations are scheduled on a timer wheel of one second slots: expiring the stale
+ * entries only visits the slots elapsed since the previous expiration, never the whole cache.
+ *
+ * Entries are kept in a list ordered by the generation they last changed in,
+ * so the changes since any generation are found by walking back from the most recent entry,
+ * in time proportional to the number of changes rather than to the size of the cache.
+ * Expired networks are kept as tombstones, up to CDAWiFiScanCacheMaximumTombstoneCount,
+ * so they can be reported as removed.
+ *
+ * The live networks are also kept in a CDAWiFiScanIndex, updated with every merge and expiration,
+ * so queries by SSID, band, channel, security, PHY mode and RSSI never scan the whole cache.
+ *
+ * Thread safe.
+ */
+@interface CDAWiFiScanCache : OFObject
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The current generation. Starts at 0, for an empty cache.
+ */
+@property (readonly) uint64_t generation;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The age (seconds) after which a BSS that was not heard again expires. Applies to the BSSes heard from then on.
+ */
+@property of_time_interval_t maximumAge;
+
+/*!
+ * @method
+ *
+ * @param networks
+ * Networks from a kernel scan dump.
+ *
+ * @abstract
+ * Merges scan results into the cache, and expires the BSSes not heard for maximumAge.
+ *
+ * @discussion
+ * BSSes missing from the networks are kept until they expire. Results the kernel heard more than maximumAge ago
+ * are ignored.
+ *
+ * @result
+ * The changes made by the update. Empty if nothing changed, in which case the generation is not incremented.
+ */
+- (CDAWiFiScanCacheChanges *)updateWithNetworks:(OFArray *)networks;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the changes made since a generation, after expiring the stale BSSes.
+ */
+- (CDAWiFiScanCacheChanges *)changesSinceGeneration:(uint64_t)generation;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns an immutable set of the networks in the cache, after expiring the stale BSSes.
+ *
+ * @discussion
+ * The same set is returned until the cache changes. Until then it holds the scan results current when it was built,
+ * while the cache moves on to the newest result of every BSS heard again.
+ */
+- (OFSet *)networks;
+
+/*!
+ * @method
+ *
+ * @param lastSeen
+ * Upon return, when the BSS was last heard, in seconds on the CDAWiFiMonotonicTime() clock. This parameter is optional.
+ *
+ * @abstract
+ * Returns the cached network with a BSSID, or nil.
+ */
+- (CDAWiFiNetwork *)networkWithBSSID:(CDAWiFiMACAddress)bssid lastSeen:(double *)lastSeen;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the networks in the cache matching a query, in its sort order, after expiring the stale BSSes.
+ */
+- (OFArray *)networksMatchingQuery:(CDAWiFiScanQuery *)query;
+
+@end
+
+@interface CDAWiFiScanCacheChanges (Private)
+
+- (instancetype)initWithGeneration:(uint64_t)generation
+                previousGeneration:(uint64_t)previousGeneration
+                     addedNetworks:(OFSet *)addedNetworks
+                   changedNetworks:(OFSet *)changedNetworks
+                   removedNetworks:(OFSet *)removedNetworks
+                             reset:(BOOL)reset;
+
+@end
@@ -0,0 +1,651 @@
+//
+//  CDAWiFiScanCache.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/6/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiScanCache.h"
+#import "CDAWiFiScanIndex.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiUtilities.h"
+#include <stdlib.h>
+#include <math.h>
+
+/* Maximum number of expired networks remembered, to report them as removed. */
+#define CDAWiFiScanCacheMaximumTombstoneCount 256
+
+/* RSSI variations (dB) under which a network is not reported as changed. */
+#define CDAWiFiScanCacheRSSITolerance 3
+
+/* Initial number of slots of the BSSID table, a power of two. */
+#define CDAWiFiScanCacheInitialTableCapacity 64
+
+/* Number of one second slots of the expiration wheel, a power of two. Longer ages wrap around the wheel. */
+#define CDAWiFiScanCacheWheelSlotCount 64
+
+/*
+ * A network in the scan cache list. A network that reappears after expiring gets a new entry,
+ * its tombstone stays in the list so callers that knew it see it removed, then added.
+ */
+@interface CDAWiFiScanCacheEntry : OFObject
+{
+@public
+    CDAWiFiMACAddress _bssid;
+    CDAWiFiNetwork *_network;
+    
+    /* Generation the entry last changed in. */
+    uint64_t _generation;
+    
+    /* Generation the network entered the cache in. */
+    uint64_t _addedGeneration;
+    
+    /* Last update that listed the network. */
+    uint64_t _seenUpdate;
+    
+    BOOL _removed;
+    
+    /* Newer and older entries. */
+    CDAWiFiScanCacheEntry *_next;
+    __unsafe_unretained CDAWiFiScanCacheEntry *_previous;
+    
+    /* When the BSS was last heard (CDAWiFiMonotonicTime() clock), and the wheel tick it expires at. */
+    double _lastSeen;
+    uint64_t _expirationTick;
+    
+    /* Neighbors in the wheel slot of a live entry. */
+    __unsafe_unretained CDAWiFiScanCacheEntry *_wheelNext;
+    __unsafe_unretained CDAWiFiScanCacheEntry *_wheelPrevious;
+    
+    /* Row of a live entry in the index. */
+    uint32_t _row;
+}
+
+@end
+
+@implementation CDAWiFiScanCacheEntry
+
+@end
+
+/*
+ * Open addressed table of the newest entry of every BSSID, live or tombstone, with linear probing.
+ * The generation list owns the entries, the table does not retain them.
+ */
+typedef struct CDAWiFiScanCacheTable {
+    struct {
+        CDAWiFiMACAddress bssid;
+        void *entry;
+    } *slots;
+    size_t mask;
+    size_t count;
+} CDAWiFiScanCacheTable;
+
+static inline size_t CDAWiFiScanCacheTableIndex(const CDAWiFiScanCacheTable *table, CDAWiFiMACAddress bssid)
+{
+    /* Fibonacci hashing, vendors share the upper octets. */
+    return (size_t)((bssid * 0x9E3779B97F4A7C15ULL) >> 32) & table->mask;
+}
+
+static BOOL CDAWiFiScanCacheTableInitialize(CDAWiFiScanCacheTable *table, size_t capacity)
+{
+    table->slots = calloc(capacity, sizeof(*table->slots));
+    table->mask = capacity - 1;
+    table->count = 0;
+    
+    return table->slots != NULL;
+}
+
+static void *CDAWiFiScanCacheTableGet(const CDAWiFiScanCacheTable *table, CDAWiFiMACAddress bssid)
+{
+    for (size_t index = CDAWiFiScanCacheTableIndex(table, bssid); table->slots[index].entry != NULL; index = (index + 1) & table->mask) {
+        
+        if (table->slots[index].bssid == bssid) {
+            return table->slots[index].entry;
+        }
+    }
+    
+    return NULL;
+}
+
+static void CDAWiFiScanCacheTableSet(CDAWiFiScanCacheTable *table, CDAWiFiMACAddress bssid, void *entry)
+{
+    /* Kept at most half full, probe sequences stay short. */
+    if ((table->count + 1) * 2 > table->mask + 1) {
+        
+        CDAWiFiScanCacheTable grownTable;
+        
+        if (CDAWiFiScanCacheTableInitialize(&grownTable, (table->mask + 1) * 2)) {
+            
+            for (size_t index = 0; index <= table->mask; index++) {
+                
+                if (table->slots[index].entry != NULL) {
+                    CDAWiFiScanCacheTableSet(&grownTable, table->slots[index].bssid, table->slots[index].entry);
+                }
+            }
+            
+            free(table->slots);
+            
+            *table = grownTable;
+        }
+    }
+    
+    size_t index = CDAWiFiScanCacheTableIndex(table, bssid);
+    
+    while (table->slots[index].entry != NULL && table->slots[index].bssid != bssid) {
+        index = (index + 1) & table->mask;
+    }
+    
+    if (table->slots[index].entry == NULL) {
+        table->count++;
+    }
+    
+    table->slots[index].bssid = bssid;
+    table->slots[index].entry = entry;
+}
+
+static void CDAWiFiScanCacheTableRemove(CDAWiFiScanCacheTable *table, CDAWiFiMACAddress bssid)
+{
+    size_t index = CDAWiFiScanCacheTableIndex(table, bssid);
+    
+    while (table->slots[index].entry != NULL && table->slots[index].bssid != bssid) {
+        index = (index + 1) & table->mask;
+    }
+    
+    if (table->slots[index].entry == NULL) {
+        return;
+    }
+    
+    /* Backward shift deletion: move up the following entries that probed past the hole, no tombstones. */
+    size_t hole = index;
+    
+    for (index = (hole + 1) & table->mask; table->slots[index].entry != NULL; index = (index + 1) & table->mask) {
+        
+        size_t home = CDAWiFiScanCacheTableIndex(table, table->slots[index].bssid);
+        
+        if (((index - home) & table->mask) >= ((index - hole) & table->mask)) {
+            
+            table->slots[hole] = table->slots[index];
+            hole = index;
+        }
+    }
+    
+    table->slots[hole].entry = NULL;
+    table->count--;
+}
+
+@implementation CDAWiFiScanCache
+{
+    OFMutex *_mutex;
+    
+    /* Newest entry of every BSSID. */
+    CDAWiFiScanCacheTable _table;
+    
+    /* Live entries by expiration tick (seconds, CDAWiFiMonotonicTime() clock), and the next tick to expire. */
+    __unsafe_unretained CDAWiFiScanCacheEntry *_wheel[CDAWiFiScanCacheWheelSlotCount];
+    uint64_t _wheelTick;
+    
+    /* Entries ordered by generation, oldest first. */
+    CDAWiFiScanCacheEntry *_oldestEntry;
+    __unsafe_unretained CDAWiFiScanCacheEntry *_newestEntry;
+    
+    /* Tombstones, oldest first. */
+    OFMutableArray *_tombstones;
+    
+    /* Generation of the newest tombstone dropped. Changes since older generations can not be computed. */
+    uint64_t _forgottenGeneration;
+    
+    /* Number of updates, changing the cache or not. Updates that change nothing leave the generation as is. */
+    uint64_t _updateCount;
+    
+    /* Set returned by -networks, nil when the cache changed since. */
+    OFSet *_networks;
+    
+    /* Secondary indexes of the live entries. */
+    CDAWiFiScanIndex *_index;
+}
+
+@synthesize maximumAge = _maximumAge;
+
+#pragma mark - Initialization
+
+- (instancetype)init
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _mutex = [OFMutex mutex];
+        _tombstones = [OFMutableArray array];
+        _index = [[CDAWiFiScanIndex alloc] init];
+        _maximumAge = CDAWiFiScanCacheDefaultMaximumAge;
+        _wheelTick = (uint64_t)CDAWiFiMonotonicTime();
+        
+        if (_index == nil || !CDAWiFiScanCacheTableInitialize(&_table, CDAWiFiScanCacheInitialTableCapacity)) {
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_table.slots);
+}
+
+#pragma mark - List
+
+- (void)unlinkEntry:(CDAWiFiScanCacheEntry *)entry
+{
+    CDAWiFiScanCacheEntry *next = entry->_next;
+    
+    if (entry->_previous != nil) {
+        entry->_previous->_next = next;
+    } else {
+        _oldestEntry = next;
+    }
+    
+    if (next != nil) {
+        next->_previous = entry->_previous;
+    } else {
+        _newestEntry = entry->_previous;
+    }
+    
+    entry->_next = nil;
+    entry->_previous = nil;
+}
+
+- (void)appendEntry:(CDAWiFiScanCacheEntry *)entry
+{
+    entry->_previous = _newestEntry;
+    
+    if (_newestEntry != nil) {
+        _newestEntry->_next = entry;
+    } else {
+        _oldestEntry = entry;
+    }
+    
+    _newestEntry = entry;
+}
+
+- (void)pruneTombstones
+{
+    while (_tombstones.count > CDAWiFiScanCacheMaximumTombstoneCount) {
+        
+        CDAWiFiScanCacheEntry *tombstone = [_tombstones firstObject];
+        
+        [_tombstones removeObjectAtIndex:0];
+        
+        if (CDAWiFiScanCacheTableGet(&_table, tombstone->_bssid) == (__bridge void *)tombstone) {
+            CDAWiFiScanCacheTableRemove(&_table, tombstone->_bssid);
+        }
+        
+        [self unlinkEntry:tombstone];
+        
+        if (tombstone->_generation > _forgottenGeneration) {
+            _forgottenGeneration = tombstone->_generation;
+        }
+    }
+}
+
+#pragma mark - Expiration
+
+- (void)scheduleEntry:(CDAWiFiScanCacheEntry *)entry
+{
+    uint64_t tick = (uint64_t)ceil(entry->_lastSeen + _maximumAge);
+    
+    /* Entries already due expire on the next tick. */
+    entry->_expirationTick = OF_MAX(tick, _wheelTick);
+    
+    __unsafe_unretained CDAWiFiScanCacheEntry **slot = &_wheel[entry->_expirationTick & (CDAWiFiScanCacheWheelSlotCount - 1)];
+    
+    entry->_wheelPrevious = nil;
+    entry->_wheelNext = *slot;
+    
+    if (*slot != nil) {
+        (*slot)->_wheelPrevious = entry;
+    }
+    
+    *slot = entry;
+}
+
+- (void)unscheduleEntry:(CDAWiFiScanCacheEntry *)entry
+{
+    if (entry->_wheelPrevious != nil) {
+        entry->_wheelPrevious->_wheelNext = entry->_wheelNext;
+    } else {
+        _wheel[entry->_expirationTick & (CDAWiFiScanCacheWheelSlotCount - 1)] = entry->_wheelNext;
+    }
+    
+    if (entry->_wheelNext != nil) {
+        entry->_wheelNext->_wheelPrevious = entry->_wheelPrevious;
+    }
+    
+    entry->_wheelNext = nil;
+    entry->_wheelPrevious = nil;
+}
+
+/*
+ * Turns the entries due by now into tombstones of generation. Visits each slot elapsed since the previous call
+ * once, the entries of a slot that are due on a later turn of the wheel stay.
+ */
+- (void)expireEntriesAtTime:(double)now generation:(uint64_t)generation removedNetworks:(OFMutableSet *)removedNetworks
+{
+    uint64_t tick = (uint64_t)now;
+    
+    if (tick < _wheelTick) {
+        return;
+    }
+    
+    uint64_t slotCount = OF_MIN(tick - _wheelTick + 1, CDAWiFiScanCacheWheelSlotCount);
+    
+    for (uint64_t index = 0; index < slotCount; index++) {
+        
+        CDAWiFiScanCacheEntry *entry = _wheel[(_wheelTick + index) & (CDAWiFiScanCacheWheelSlotCount - 1)];
+        
+        while (entry != nil) {
+            
+            CDAWiFiScanCacheEntry *next = entry->_wheelNext;
+            
+            if (entry->_expirationTick <= tick) {
+                
+                [self unscheduleEntry:entry];
+                [self unlinkEntry:entry];
+                
+                [_index removeNetworkAtRow:entry->_row];
+                
+                entry->_removed = YES;
+                entry->_generation = generation;
+                
+                [self appendEntry:entry];
+                
+                [_tombstones addObject:entry];
+                
+                [removedNetworks addObject:entry->_network];
+            }
+            
+            entry = next;
+        }
+    }
+    
+    _wheelTick = tick + 1;
+}
+
+/* Expires the entries due outside of an update, in a generation of their own. */
+- (void)expireEntries
+{
+    OFMutableSet *removedNetworks = [OFMutableSet set];
+    
+    [self expireEntriesAtTime:CDAWiFiMonotonicTime() generation:_generation + 1 removedNetworks:removedNetworks];
+    
+    if (removedNetworks.count == 0) {
+        return;
+    }
+    
+    _generation++;
+    _networks = nil;
+    
+    [self pruneTombstones];
+}
+
+#pragma mark - Updating
+
+- (CDAWiFiScanCacheChanges *)updateWithNetworks:(OFArray *)networks
+{
+    OFMutableSet *addedNetworks = [OFMutableSet set];
+    OFMutableSet *changedNetworks = [OFMutableSet set];
+    OFMutableSet *removedNetworks = [OFMutableSet set];
+    double now = CDAWiFiMonotonicTime();
+    
+    [_mutex lock];
+    
+    uint64_t previousGeneration = _generation;
+    uint64_t generation = _generation + 1;
+    uint64_t update = ++_updateCount;
+    
+    /* Merged before expiring, so a BSS due now but heard again is refreshed rather than removed and added back. */
+    for (CDAWiFiNetwork *network in networks) {
+        
+        CDAWiFiMACAddress bssid = network.bssidValue;
+        CDAWiFiScanCacheEntry *entry = (__bridge CDAWiFiScanCacheEntry *)CDAWiFiScanCacheTableGet(&_table, bssid);
+        double lastSeen = network.lastSeen;
+        
+        if (entry != nil && !entry->_removed) {
+            
+            /* Drivers may report a BSS once per channel it was heard on, keep the first. */
+            if (entry->_seenUpdate == update) {
+                continue;
+            }
+            
+            entry->_seenUpdate = update;
+            
+            if (lastSeen > entry->_lastSeen) {
+                
+                entry->_lastSeen = lastSeen;
+                
+                [self unscheduleEntry:entry];
+                [self scheduleEntry:entry];
+            }
+            
+            /* Not reported as changed, but the newer result is kept: the previous one pins the arena of its whole dump. */
+            if ([entry->_network isScanResultEqualToNetwork:network rssiTolerance:CDAWiFiScanCacheRSSITolerance]) {
+                
+                entry->_network = network;
+                
+                [_index replaceNetworkAtRow:entry->_row withNetwork:network];
+                
+                continue;
+            }
+            
+            [self unlinkEntry:entry];
+            
+            [_index replaceNetworkAtRow:entry->_row withNetwork:network];
+            
+            [changedNetworks addObject:network];
+            
+        } else {
+            
+            /* The kernel keeps reporting BSSes for a while after it last heard them. */
+            if (now - lastSeen >= _maximumAge) {
+                continue;
+            }
+            
+            entry = [[CDAWiFiScanCacheEntry alloc] init];
+            entry->_bssid = bssid;
+            entry->_addedGeneration = generation;
+            entry->_seenUpdate = update;
+            entry->_lastSeen = lastSeen;
+            entry->_row = [_index addNetwork:network];
+            
+            CDAWiFiScanCacheTableSet(&_table, bssid, (__bridge void *)entry);
+            
+            [self scheduleEntry:entry];
+            
+            [addedNetworks addObject:network];
+        }
+        
+        entry->_network = network;
+        entry->_generation = generation;
+        
+        [self appendEntry:entry];
+    }
+    
+    [self expireEntriesAtTime:now generation:generation removedNetworks:removedNetworks];
+    
+    /* A network that changed, but was not heard again, may still expire in the same update. */
+    [changedNetworks minusSet:removedNetworks];
+    
+    if (addedNetworks.count == 0 && changedNetworks.count == 0 && removedNetworks.count == 0) {
+        
+        [_mutex unlock];
+        
+        return [[CDAWiFiScanCacheChanges alloc] initWithGeneration:previousGeneration
+                                                previousGeneration:previousGeneration
+                                                     addedNetworks:addedNetworks
+                                                   changedNetworks:changedNetworks
+                                                   removedNetworks:removedNetworks
+                                                             reset:NO];
+    }
+    
+    _generation = generation;
+    _networks = nil;
+    
+    [self pruneTombstones];
+    
+    [_mutex unlock];
+    
+    [addedNetworks makeImmutable];
+    [changedNetworks makeImmutable];
+    [removedNetworks makeImmutable];
+    
+    return [[CDAWiFiScanCacheChanges alloc] initWithGeneration:generation
+                                            previousGeneration:previousGeneration
+                                                 addedNetworks:addedNetworks
+                                               changedNetworks:changedNetworks
+                                               removedNetworks:removedNetworks
+                                                         reset:NO];
+}
+
+#pragma mark - Querying
+
+- (uint64_t)generation
+{
+    [_mutex lock];
+    
+    uint64_t generation = _generation;
+    
+    [_mutex unlock];
+    
+    return generation;
+}
+
+- (CDAWiFiScanCacheChanges *)changesSinceGeneration:(uint64_t)previousGeneration
+{
+    OFMutableSet *addedNetworks = [OFMutableSet set];
+    OFMutableSet *changedNetworks = [OFMutableSet set];
+    OFMutableSet *removedNetworks = [OFMutableSet set];
+    BOOL reset;
+    
+    [_mutex lock];
+    
+    [self expireEntries];
+    
+    uint64_t generation = _generation;
+    
+    reset = (previousGeneration > generation || previousGeneration < _forgottenGeneration);
+    
+    for (CDAWiFiScanCacheEntry *entry = _newestEntry; entry != nil; entry = entry->_previous) {
+        
+        if (reset) {
+            
+            if (!entry->_removed) {
+                [addedNetworks addObject:entry->_network];
+            }
+            
+            continue;
+        }
+        
+        if (entry->_generation <= previousGeneration) {
+            break;
+        }
+        
+        if (entry->_removed) {
+            
+            /* Networks that came and went since the previous generation were never seen by the caller. */
+            if (entry->_addedGeneration <= previousGeneration) {
+                [removedNetworks addObject:entry->_network];
+            }
+            
+        } else if (entry->_addedGeneration > previousGeneration) {
+            
+            [addedNetworks addObject:entry->_network];
+            
+        } else {
+            
+            [changedNetworks addObject:entry->_network];
+        }
+    }
+    
+    [_mutex unlock];
+    
+    [addedNetworks makeImmutable];
+    [changedNetworks makeImmutable];
+    [removedNetworks makeImmutable];
+    
+    return [[CDAWiFiScanCacheChanges alloc] initWithGeneration:generation
+                                            previousGeneration:(reset ? 0 : previousGeneration)
+                                                 addedNetworks:addedNetworks
+                                               changedNetworks:changedNetworks
+                                               removedNetworks:removedNetworks
+                                                         reset:reset];
+}
+
+- (OFSet *)networks
+{
+    [_mutex lock];
+    
+    [self expireEntries];
+    
+    OFSet *networks = _networks;
+    
+    if (networks == nil) {
+        
+        OFMutableSet *mutableNetworks = [OFMutableSet setWithCapacity:_table.count];
+        
+        for (CDAWiFiScanCacheEntry *entry = _oldestEntry; entry != nil; entry = entry->_next) {
+            
+            if (!entry->_removed) {
+                [mutableNetworks addObject:entry->_network];
+            }
+        }
+        
+        [mutableNetworks makeImmutable];
+        
+        networks = mutableNetworks;
+        _networks = networks;
+    }
+    
+    [_mutex unlock];
+    
+    return networks;
+}
+
+- (CDAWiFiNetwork *)networkWithBSSID:(CDAWiFiMACAddress)bssid lastSeen:(double *)lastSeen
+{
+    [_mutex lock];
+    
+    [self expireEntries];
+    
+    CDAWiFiScanCacheEntry *entry = (__bridge CDAWiFiScanCacheEntry *)CDAWiFiScanCacheTableGet(&_table, bssid);
+    CDAWiFiNetwork *network = nil;
+    
+    if (entry != nil && !entry->_removed) {
+        
+        network = entry->_network;
+        
+        if (lastSeen != NULL) {
+            *lastSeen = entry->_lastSeen;
+        }
+    }
+    
+    [_mutex unlock];
+    
+    return network;
+}
+
+- (OFArray *)networksMatchingQuery:(CDAWiFiScanQuery *)query
+{
+    [_mutex lock];
+    
+    [self expireEntries];
+    
+    OFArray *networks = [_index networksMatchingQuery:query];
+    
+    [_mutex unlock];
+    
+    return networks;
+}
+
+@end
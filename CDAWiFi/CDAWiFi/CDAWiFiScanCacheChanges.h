@@ -0,0 +1,93 @@
+//
+//  CDAWiFiScanCacheChanges.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/6/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+/*!
+ * @class
+ *
+ * @abstract
+ * The changes made to the scan cache of a Wi-Fi interface between two generations.
+ *
+ * @discussion
+ * Every update of the scan cache that adds, changes or removes networks increments the scan cache generation.
+ * Keep the generation of the last changes applied and pass it to
+ * -[CDAWiFiInterface scanCacheChangesSinceGeneration:error:] to get only what changed since.
+ */
+@interface CDAWiFiScanCacheChanges : OFObject
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The generation of the scan cache the changes lead to.
+ */
+@property (readonly) uint64_t generation;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The generation of the scan cache the changes start from.
+ */
+@property (readonly) uint64_t previousGeneration;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The CDAWiFiNetwork objects that entered the scan cache.
+ */
+@property (readonly) OFSet *addedNetworks;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The CDAWiFiNetwork objects whose scan result changed, in their latest state.
+ *
+ * @discussion
+ * RSSI variations smaller than 3 dB are not reported as changes.
+ */
+@property (readonly) OFSet *changedNetworks;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The CDAWiFiNetwork objects that expired from the scan cache, in their last known state.
+ *
+ * @discussion
+ * A network that expired and then reappeared is listed both here and in addedNetworks.
+ * Apply removals before additions.
+ */
+@property (readonly) OFSet *removedNetworks;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * YES if the changes could not be computed from the previous generation.
+ *
+ * @discussion
+ * Happens when the previous generation is too old for the expired networks to still be remembered,
+ * or was not produced by this interface.
+ * addedNetworks then holds the whole scan cache, and any state built from earlier changes should be discarded.
+ */
+@property (readonly, getter=isReset) BOOL reset;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * YES if nothing changed.
+ */
+@property (readonly, getter=isEmpty) BOOL empty;
+
+@end
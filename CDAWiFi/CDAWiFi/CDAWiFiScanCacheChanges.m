@@ -0,0 +1,41 @@
+//
+//  CDAWiFiScanCacheChanges.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/6/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiScanCacheChanges.h"
+#import "CDAWiFiScanCache.h"
+
+@implementation CDAWiFiScanCacheChanges
+
+- (instancetype)initWithGeneration:(uint64_t)generation
+                previousGeneration:(uint64_t)previousGeneration
+                     addedNetworks:(OFSet *)addedNetworks
+                   changedNetworks:(OFSet *)changedNetworks
+                   removedNetworks:(OFSet *)removedNetworks
+                             reset:(BOOL)reset
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _generation = generation;
+        _previousGeneration = previousGeneration;
+        _addedNetworks = addedNetworks;
+        _changedNetworks = changedNetworks;
+        _removedNetworks = removedNetworks;
+        _reset = reset;
+    }
+    
+    return self;
+}
+
+- (BOOL)isEmpty
+{
+    return !_reset && _addedNetworks.count == 0 && _changedNetworks.count == 0 && _removedNetworks.count == 0;
+}
+
+@end
@@ -0,0 +1,64 @@
+//
+//  CDAWiFiScanIndex.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+
+@class CDAWiFiNetwork, CDAWiFiScanQuery;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Secondary indexes over the live networks of a scan cache.
+ *
+ * @discussion
+ * Every network occupies a row. Rows have one bit in a bitmap per band, per channel, per security type and per PHY mode
+ * they support, and are listed by SSID. The RSSI, band, channel and SSID of every row are also kept in flat columns,
+ * so queries intersect bitmaps 64 rows at a time and filter and sort without touching the network objects.
+ * Rows of removed networks are reused.
+ *
+ * Not thread safe, the scan cache updates and queries it under its lock.
+ */
+@interface CDAWiFiScanIndex : OFObject
+
+/*!
+ * @method
+ *
+ * @result
+ * The row of the network.
+ *
+ * @abstract
+ * Indexes a network.
+ */
+- (uint32_t)addNetwork:(CDAWiFiNetwork *)network;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Replaces the network of a row with a newer scan result of the same BSS. Changes of RSSI alone leave the bitmaps untouched.
+ */
+- (void)replaceNetworkAtRow:(uint32_t)row withNetwork:(CDAWiFiNetwork *)network;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Removes the network of a row.
+ */
+- (void)removeNetworkAtRow:(uint32_t)row;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the networks matching a query, in its sort order.
+ */
+- (OFArray *)networksMatchingQuery:(CDAWiFiScanQuery *)query;
+
+@end
@@ -0,0 +1,560 @@
+//
+//  CDAWiFiScanIndex.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiScanIndex.h"
+#import "CDAWiFiScanQuery.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiSSID.h"
+#import "CDAWiFiUtilities.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Initial number of rows, a multiple of 64. */
+#define CDAWiFiScanIndexInitialRowCapacity 256
+
+#define CDAWiFiScanIndexBandCount (CDAWiFiChannelBand5GHz + 1)
+#define CDAWiFiScanIndexSecurityCount (CDAWiFiSecurityEnterprise + 1)
+#define CDAWiFiScanIndexPHYModeCount (CDAWiFiPHYMode11ac + 1)
+#define CDAWiFiScanIndexChannelNumberCount 256
+
+/* Bitmaps allocated up front. Channel bitmaps are allocated on first use. */
+enum {
+    CDAWiFiScanIndexBitmapLive      = 0,
+    CDAWiFiScanIndexBitmapBand      = 1,
+    CDAWiFiScanIndexBitmapSecurity  = CDAWiFiScanIndexBitmapBand + CDAWiFiScanIndexBandCount,
+    CDAWiFiScanIndexBitmapPHYMode   = CDAWiFiScanIndexBitmapSecurity + CDAWiFiScanIndexSecurityCount,
+    CDAWiFiScanIndexBitmapCount     = CDAWiFiScanIndexBitmapPHYMode + CDAWiFiScanIndexPHYModeCount
+};
+
+/* The indexed attributes of a network. */
+typedef struct CDAWiFiScanIndexRow {
+    int rssi;
+    CDAWiFiMACAddress bssid;
+    uint16_t securityMask;
+    uint8_t phyModeMask;
+    uint8_t band;
+    uint8_t channelNumber;
+    uint8_t ssidLength;
+    uint8_t ssid[32];
+} CDAWiFiScanIndexRow;
+
+static void CDAWiFiScanIndexRowMake(CDAWiFiScanIndexRow *row, CDAWiFiNetwork *network)
+{
+    CDAWiFiSSID *ssid = network.internedSSID;
+    
+    memset(row, 0, sizeof(*row));
+    
+    row->rssi = network.rssiValue;
+    row->bssid = network.bssidValue;
+    row->band = CDAWiFiChannelBandForFrequency(network.frequency);
+    row->channelNumber = (uint8_t)CDAWiFiChannelNumberForFrequency(network.frequency);
+    
+    if (ssid != nil) {
+        
+        row->ssidLength = (uint8_t)ssid.length;
+        
+        memcpy(row->ssid, ssid.bytes, row->ssidLength);
+    }
+    
+    for (CDAWiFiSecurity security = CDAWiFiSecurityNone; security < CDAWiFiScanIndexSecurityCount; security++) {
+        
+        if ([network supportsSecurity:security]) {
+            row->securityMask |= 1 << security;
+        }
+    }
+    
+    for (CDAWiFiPHYMode phyMode = CDAWiFiPHYMode11a; phyMode < CDAWiFiScanIndexPHYModeCount; phyMode++) {
+        
+        if ([network supportsPHYMode:phyMode]) {
+            row->phyModeMask |= 1 << phyMode;
+        }
+    }
+}
+
+static inline void CDAWiFiScanIndexBitmapSet(uint64_t *bitmap, uint32_t row)
+{
+    bitmap[row / 64] |= (uint64_t)1 << (row % 64);
+}
+
+static inline void CDAWiFiScanIndexBitmapClear(uint64_t *bitmap, uint32_t row)
+{
+    bitmap[row / 64] &= ~((uint64_t)1 << (row % 64));
+}
+
+static inline BOOL CDAWiFiScanIndexBitmapTest(const uint64_t *bitmap, uint32_t row)
+{
+    return (bitmap[row / 64] >> (row % 64)) & 1;
+}
+
+#pragma mark - Sorting
+
+typedef struct CDAWiFiScanIndexMatch {
+    const CDAWiFiScanIndexRow *row;
+    uint32_t index;
+} CDAWiFiScanIndexMatch;
+
+static int CDAWiFiScanIndexCompareRSSI(const void *first, const void *second)
+{
+    const CDAWiFiScanIndexRow *a = ((const CDAWiFiScanIndexMatch *)first)->row, *b = ((const CDAWiFiScanIndexMatch *)second)->row;
+    
+    /* Strongest first, ties by BSSID for a stable order. */
+    if (a->rssi != b->rssi) {
+        return (a->rssi < b->rssi) - (a->rssi > b->rssi);
+    }
+    
+    return (a->bssid > b->bssid) - (a->bssid < b->bssid);
+}
+
+static int CDAWiFiScanIndexCompareSSID(const void *first, const void *second)
+{
+    const CDAWiFiScanIndexRow *a = ((const CDAWiFiScanIndexMatch *)first)->row, *b = ((const CDAWiFiScanIndexMatch *)second)->row;
+    int result = memcmp(a->ssid, b->ssid, OF_MIN(a->ssidLength, b->ssidLength));
+    
+    if (result != 0) {
+        return result;
+    }
+    
+    if (a->ssidLength != b->ssidLength) {
+        return (a->ssidLength > b->ssidLength) - (a->ssidLength < b->ssidLength);
+    }
+    
+    return CDAWiFiScanIndexCompareRSSI(first, second);
+}
+
+static int CDAWiFiScanIndexCompareChannel(const void *first, const void *second)
+{
+    const CDAWiFiScanIndexRow *a = ((const CDAWiFiScanIndexMatch *)first)->row, *b = ((const CDAWiFiScanIndexMatch *)second)->row;
+    
+    if (a->band != b->band) {
+        return (a->band > b->band) - (a->band < b->band);
+    }
+    
+    if (a->channelNumber != b->channelNumber) {
+        return (a->channelNumber > b->channelNumber) - (a->channelNumber < b->channelNumber);
+    }
+    
+    return CDAWiFiScanIndexCompareRSSI(first, second);
+}
+
+@implementation CDAWiFiScanIndex
+{
+    /* Rows, and their networks (OFNull for free rows). */
+    CDAWiFiScanIndexRow *_rows;
+    OFMutableArray *_networks;
+    OFDataArray *_freeRows;
+    uint32_t _rowCapacity;
+    
+    /* CDAWiFiScanIndexBitmapCount bitmaps of _rowCapacity bits, one after the other. */
+    uint64_t *_bitmaps;
+    
+    /* Bitmap of every channel number of every band, NULL until a network uses it. */
+    uint64_t *_channelBitmaps[CDAWiFiScanIndexBandCount][CDAWiFiScanIndexChannelNumberCount];
+    
+    /* OFDataArray of uint32_t rows, by interned SSID. */
+    OFMutableDictionary *_ssidRows;
+}
+
+#pragma mark - Initialization
+
+- (instancetype)init
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _rowCapacity = CDAWiFiScanIndexInitialRowCapacity;
+        _rows = calloc(_rowCapacity, sizeof(CDAWiFiScanIndexRow));
+        _bitmaps = calloc(CDAWiFiScanIndexBitmapCount * (_rowCapacity / 64), sizeof(uint64_t));
+        _networks = [OFMutableArray arrayWithCapacity:_rowCapacity];
+        _freeRows = [[OFDataArray alloc] initWithItemSize:sizeof(uint32_t)];
+        _ssidRows = [OFMutableDictionary dictionary];
+        
+        if (_rows == NULL || _bitmaps == NULL) {
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    for (size_t band = 0; band < CDAWiFiScanIndexBandCount; band++) {
+        
+        for (size_t channelNumber = 0; channelNumber < CDAWiFiScanIndexChannelNumberCount; channelNumber++) {
+            free(_channelBitmaps[band][channelNumber]);
+        }
+    }
+    
+    free(_rows);
+    free(_bitmaps);
+}
+
+#pragma mark - Bitmaps
+
+- (uint64_t *)bitmap:(size_t)bitmap
+{
+    return _bitmaps + bitmap * (_rowCapacity / 64);
+}
+
+/* Doubles the number of rows. Exceptions on exhausted memory, like the collections of the rows. */
+- (void)grow
+{
+    uint32_t capacity = _rowCapacity * 2;
+    size_t wordCount = _rowCapacity / 64;
+    CDAWiFiScanIndexRow *rows = realloc(_rows, capacity * sizeof(CDAWiFiScanIndexRow));
+    uint64_t *bitmaps = calloc(CDAWiFiScanIndexBitmapCount * (capacity / 64), sizeof(uint64_t));
+    
+    if (rows != NULL) {
+        _rows = rows;
+    }
+    
+    if (rows == NULL || bitmaps == NULL) {
+        
+        free(bitmaps);
+        
+        @throw [OFOutOfMemoryException exceptionWithRequestedSize:capacity * sizeof(CDAWiFiScanIndexRow)];
+    }
+    
+    for (size_t bitmap = 0; bitmap < CDAWiFiScanIndexBitmapCount; bitmap++) {
+        memcpy(bitmaps + bitmap * (capacity / 64), _bitmaps + bitmap * wordCount, wordCount * sizeof(uint64_t));
+    }
+    
+    for (size_t band = 0; band < CDAWiFiScanIndexBandCount; band++) {
+        
+        for (size_t channelNumber = 0; channelNumber < CDAWiFiScanIndexChannelNumberCount; channelNumber++) {
+            
+            uint64_t *channelBitmap = _channelBitmaps[band][channelNumber];
+            
+            if (channelBitmap == NULL) {
+                continue;
+            }
+            
+            uint64_t *grownBitmap = calloc(capacity / 64, sizeof(uint64_t));
+            
+            if (grownBitmap == NULL) {
+                
+                free(bitmaps);
+                
+                @throw [OFOutOfMemoryException exceptionWithRequestedSize:capacity / 8];
+            }
+            
+            memcpy(grownBitmap, channelBitmap, wordCount * sizeof(uint64_t));
+            free(channelBitmap);
+            
+            _channelBitmaps[band][channelNumber] = grownBitmap;
+        }
+    }
+    
+    free(_bitmaps);
+    
+    _bitmaps = bitmaps;
+    _rowCapacity = capacity;
+}
+
+- (uint64_t *)channelBitmapForBand:(uint8_t)band channelNumber:(uint8_t)channelNumber
+{
+    uint64_t *bitmap = _channelBitmaps[band][channelNumber];
+    
+    if (bitmap == NULL) {
+        
+        bitmap = calloc(_rowCapacity / 64, sizeof(uint64_t));
+        
+        if (bitmap == NULL) {
+            @throw [OFOutOfMemoryException exceptionWithRequestedSize:_rowCapacity / 8];
+        }
+        
+        _channelBitmaps[band][channelNumber] = bitmap;
+    }
+    
+    return bitmap;
+}
+
+/* Sets or clears the bits of a row in every bitmap and list of its attributes. */
+- (void)indexRow:(uint32_t)row set:(BOOL)set
+{
+    const CDAWiFiScanIndexRow *attributes = &_rows[row];
+    void (*update)(uint64_t *, uint32_t) = set ? CDAWiFiScanIndexBitmapSet : CDAWiFiScanIndexBitmapClear;
+    
+    update([self bitmap:CDAWiFiScanIndexBitmapLive], row);
+    update([self bitmap:CDAWiFiScanIndexBitmapBand + attributes->band], row);
+    update([self channelBitmapForBand:attributes->band channelNumber:attributes->channelNumber], row);
+    
+    for (size_t security = 0; security < CDAWiFiScanIndexSecurityCount; security++) {
+        
+        if (attributes->securityMask & (1 << security)) {
+            update([self bitmap:CDAWiFiScanIndexBitmapSecurity + security], row);
+        }
+    }
+    
+    for (size_t phyMode = 0; phyMode < CDAWiFiScanIndexPHYModeCount; phyMode++) {
+        
+        if (attributes->phyModeMask & (1 << phyMode)) {
+            update([self bitmap:CDAWiFiScanIndexBitmapPHYMode + phyMode], row);
+        }
+    }
+    
+    CDAWiFiSSID *ssid = [CDAWiFiSSID SSIDWithBytes:attributes->ssid length:attributes->ssidLength];
+    OFDataArray *rows = _ssidRows[ssid];
+    
+    if (set) {
+        
+        if (rows == nil) {
+            
+            rows = [[OFDataArray alloc] initWithItemSize:sizeof(uint32_t)];
+            
+            _ssidRows[ssid] = rows;
+        }
+        
+        [rows addItem:&row];
+        
+        return;
+    }
+    
+    uint32_t *items = rows.items;
+    size_t count = rows.count;
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        if (items[index] != row) {
+            continue;
+        }
+        
+        items[index] = items[count - 1];
+        
+        [rows removeLastItem];
+        
+        break;
+    }
+    
+    if (rows.count == 0) {
+        [_ssidRows removeObjectForKey:ssid];
+    }
+}
+
+#pragma mark - Updating
+
+- (uint32_t)addNetwork:(CDAWiFiNetwork *)network
+{
+    uint32_t row;
+    
+    if (_freeRows.count > 0) {
+        
+        row = *(uint32_t *)_freeRows.lastItem;
+        
+        [_freeRows removeLastItem];
+        
+        [_networks replaceObjectAtIndex:row withObject:network];
+        
+    } else {
+        
+        row = (uint32_t)_networks.count;
+        
+        if (row == _rowCapacity) {
+            [self grow];
+        }
+        
+        [_networks addObject:network];
+    }
+    
+    CDAWiFiScanIndexRowMake(&_rows[row], network);
+    
+    [self indexRow:row set:YES];
+    
+    return row;
+}
+
+- (void)replaceNetworkAtRow:(uint32_t)row withNetwork:(CDAWiFiNetwork *)network
+{
+    CDAWiFiScanIndexRow attributes;
+    
+    CDAWiFiScanIndexRowMake(&attributes, network);
+    
+    [_networks replaceObjectAtIndex:row withObject:network];
+    
+    /* RSSI changes are the common case, and only live in the column. */
+    if (attributes.band == _rows[row].band && attributes.channelNumber == _rows[row].channelNumber &&
+        attributes.securityMask == _rows[row].securityMask && attributes.phyModeMask == _rows[row].phyModeMask &&
+        attributes.ssidLength == _rows[row].ssidLength && memcmp(attributes.ssid, _rows[row].ssid, attributes.ssidLength) == 0) {
+        
+        _rows[row].rssi = attributes.rssi;
+        
+        return;
+    }
+    
+    [self indexRow:row set:NO];
+    
+    _rows[row] = attributes;
+    
+    [self indexRow:row set:YES];
+}
+
+- (void)removeNetworkAtRow:(uint32_t)row
+{
+    [self indexRow:row set:NO];
+    
+    [_networks replaceObjectAtIndex:row withObject:[OFNull null]];
+    
+    [_freeRows addItem:&row];
+}
+
+#pragma mark - Querying
+
+- (OFArray *)networksMatchingQuery:(CDAWiFiScanQuery *)query
+{
+    const uint64_t *bitmaps[5];
+    size_t bitmapCount = 0;
+    size_t wordCount = _rowCapacity / 64;
+    CDAWiFiChannelBand band = query.channelBand;
+    int channelNumber = query.channelNumber;
+    CDAWiFiSecurity security = query.security;
+    CDAWiFiPHYMode phyMode = query.phyMode;
+    int minimumRSSI = query.minimumRSSI, maximumRSSI = query.maximumRSSI;
+    OFDataArray *ssidData = query.ssidData;
+    uint64_t *channelBitmap = NULL;
+    
+    /* Criteria out of range match nothing. */
+    if ((uint32_t)band >= CDAWiFiScanIndexBandCount || channelNumber < 0 || channelNumber >= CDAWiFiScanIndexChannelNumberCount ||
+        ((uint32_t)security >= CDAWiFiScanIndexSecurityCount && security != CDAWiFiSecurityUnknown) ||
+        (uint32_t)phyMode >= CDAWiFiScanIndexPHYModeCount || minimumRSSI > maximumRSSI) {
+        
+        return [OFArray array];
+    }
+    
+    bitmaps[bitmapCount++] = [self bitmap:CDAWiFiScanIndexBitmapLive];
+    
+    if (band != CDAWiFiChannelBandUnknown) {
+        bitmaps[bitmapCount++] = [self bitmap:CDAWiFiScanIndexBitmapBand + band];
+    }
+    
+    if (security != CDAWiFiSecurityUnknown) {
+        bitmaps[bitmapCount++] = [self bitmap:CDAWiFiScanIndexBitmapSecurity + security];
+    }
+    
+    if (phyMode != CDAWiFiPHYModeNone) {
+        bitmaps[bitmapCount++] = [self bitmap:CDAWiFiScanIndexBitmapPHYMode + phyMode];
+    }
+    
+    if (channelNumber != 0) {
+        
+        /* Without a band, the channel number of every band. */
+        channelBitmap = calloc(wordCount, sizeof(uint64_t));
+        
+        if (channelBitmap == NULL) {
+            @throw [OFOutOfMemoryException exceptionWithRequestedSize:wordCount * sizeof(uint64_t)];
+        }
+        
+        for (size_t channelBand = 0; channelBand < CDAWiFiScanIndexBandCount; channelBand++) {
+            
+            const uint64_t *bandBitmap = _channelBitmaps[channelBand][channelNumber];
+            
+            if (bandBitmap == NULL || (band != CDAWiFiChannelBandUnknown && channelBand != band)) {
+                continue;
+            }
+            
+            for (size_t word = 0; word < wordCount; word++) {
+                channelBitmap[word] |= bandBitmap[word];
+            }
+        }
+        
+        bitmaps[bitmapCount++] = channelBitmap;
+    }
+    
+    OFDataArray *matches = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiScanIndexMatch)];
+    
+    if (ssidData != nil) {
+        
+        /* The rows of the SSID are few, test their bits one by one. */
+        CDAWiFiSSID *ssid = [CDAWiFiSSID SSIDWithData:ssidData];
+        OFDataArray *rows = (ssid != nil) ? _ssidRows[ssid] : nil;
+        const uint32_t *items = rows.items;
+        
+        for (size_t index = 0; index < rows.count; index++) {
+            
+            uint32_t row = items[index];
+            BOOL match = (_rows[row].rssi >= minimumRSSI && _rows[row].rssi <= maximumRSSI);
+            
+            for (size_t bitmap = 0; match && bitmap < bitmapCount; bitmap++) {
+                match = CDAWiFiScanIndexBitmapTest(bitmaps[bitmap], row);
+            }
+            
+            if (match) {
+                
+                CDAWiFiScanIndexMatch item = { &_rows[row], row };
+                
+                [matches addItem:&item];
+            }
+        }
+        
+    } else {
+        
+        for (size_t word = 0; word < wordCount; word++) {
+            
+            uint64_t bits = bitmaps[0][word];
+            
+            for (size_t bitmap = 1; bits != 0 && bitmap < bitmapCount; bitmap++) {
+                bits &= bitmaps[bitmap][word];
+            }
+            
+            while (bits != 0) {
+                
+                uint32_t row = (uint32_t)(word * 64 + __builtin_ctzll(bits));
+                
+                bits &= bits - 1;
+                
+                if (_rows[row].rssi < minimumRSSI || _rows[row].rssi > maximumRSSI) {
+                    continue;
+                }
+                
+                CDAWiFiScanIndexMatch item = { &_rows[row], row };
+                
+                [matches addItem:&item];
+            }
+        }
+    }
+    
+    free(channelBitmap);
+    
+    int (*compare)(const void *, const void *);
+    
+    switch (query.sortOrder) {
+        case CDAWiFiScanQuerySortOrderSSID:
+            compare = CDAWiFiScanIndexCompareSSID;
+            break;
+        
+        case CDAWiFiScanQuerySortOrderChannel:
+            compare = CDAWiFiScanIndexCompareChannel;
+            break;
+        
+        default:
+            compare = CDAWiFiScanIndexCompareRSSI;
+            break;
+    }
+    
+    qsort(matches.items, matches.count, sizeof(CDAWiFiScanIndexMatch), compare);
+    
+    size_t count = matches.count;
+    
+    if (query.maximumCount != 0) {
+        count = OF_MIN(count, query.maximumCount);
+    }
+    
+    OFMutableArray *networks = [OFMutableArray arrayWithCapacity:count];
+    const CDAWiFiScanIndexMatch *items = matches.items;
+    
+    for (size_t index = 0; index < count; index++) {
+        [networks addObject:[_networks objectAtIndex:items[index].index]];
+    }
+    
+    [networks makeImmutable];
+    
+    return networks;
+}
+
+@end
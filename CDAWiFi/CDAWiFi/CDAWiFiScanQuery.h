@@ -0,0 +1,126 @@
+//
+//  CDAWiFiScanQuery.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+/*!
+ * @typedef CDAWiFiScanQuerySortOrder
+ *
+ * @abstract The order of the results of a scan query.
+ *
+ * @constant CDAWiFiScanQuerySortOrderRSSI
+ * Strongest first.
+ *
+ * @constant CDAWiFiScanQuerySortOrderSSID
+ * By SSID octets, then strongest first.
+ *
+ * @constant CDAWiFiScanQuerySortOrderChannel
+ * By band and channel number, then strongest first.
+ */
+typedef enum
+{
+    CDAWiFiScanQuerySortOrderRSSI       = 0,
+    CDAWiFiScanQuerySortOrderSSID       = 1,
+    CDAWiFiScanQuerySortOrderChannel    = 2,
+} CDAWiFiScanQuerySortOrder;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * Criteria selecting and ordering cached scan results.
+ *
+ * @discussion
+ * A new query matches every network. Each property set narrows it, networks must match all of them.
+ * Queries are evaluated against the indexes of the scan cache, see -[CDAWiFiInterface cachedScanResultsMatchingQuery:].
+ */
+@interface CDAWiFiScanQuery : OFObject <OFCopying>
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns a new query matching every network.
+ */
++ (instancetype)query;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The SSID octets of the networks, or nil for any SSID.
+ */
+@property (copy) OFDataArray *ssidData;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The band of the networks, or CDAWiFiChannelBandUnknown for any band.
+ */
+@property CDAWiFiChannelBand channelBand;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The primary channel number of the networks, or 0 for any channel. Channel numbers repeat across bands.
+ */
+@property int channelNumber;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * A security type the networks must support, or CDAWiFiSecurityUnknown for any security.
+ */
+@property CDAWiFiSecurity security;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * A PHY mode the networks must support, or CDAWiFiPHYModeNone for any PHY mode.
+ */
+@property CDAWiFiPHYMode phyMode;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The lowest RSSI (dBm) of the networks, inclusive. INT_MIN by default.
+ */
+@property int minimumRSSI;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The highest RSSI (dBm) of the networks, inclusive. INT_MAX by default.
+ */
+@property int maximumRSSI;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The order of the results, strongest first by default.
+ */
+@property CDAWiFiScanQuerySortOrder sortOrder;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The maximum number of results, the first ones in the sort order, or 0 for every match.
+ */
+@property size_t maximumCount;
+
+@end
@@ -0,0 +1,58 @@
+//
+//  CDAWiFiScanQuery.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiScanQuery.h"
+#include <limits.h>
+
+@implementation CDAWiFiScanQuery
+
+@synthesize ssidData = _ssidData, channelBand = _channelBand, channelNumber = _channelNumber;
+@synthesize security = _security, phyMode = _phyMode, minimumRSSI = _minimumRSSI, maximumRSSI = _maximumRSSI;
+@synthesize sortOrder = _sortOrder, maximumCount = _maximumCount;
+
+#pragma mark - Initialization
+
++ (instancetype)query
+{
+    return [[self alloc] init];
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _security = CDAWiFiSecurityUnknown;
+        _minimumRSSI = INT_MIN;
+        _maximumRSSI = INT_MAX;
+    }
+    
+    return self;
+}
+
+#pragma mark - Copying
+
+- (id)copy
+{
+    CDAWiFiScanQuery *query = [[CDAWiFiScanQuery alloc] init];
+    
+    query.ssidData = self.ssidData;
+    query.channelBand = self.channelBand;
+    query.channelNumber = self.channelNumber;
+    query.security = self.security;
+    query.phyMode = self.phyMode;
+    query.minimumRSSI = self.minimumRSSI;
+    query.maximumRSSI = self.maximumRSSI;
+    query.sortOrder = self.sortOrder;
+    query.maximumCount = self.maximumCount;
+    
+    return query;
+}
+
+@end
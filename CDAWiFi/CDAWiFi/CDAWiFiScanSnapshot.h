@@ -0,0 +1,252 @@
+//
+//  CDAWiFiScanSnapshot.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/9/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+
+@class CDAWiFiNetwork, CDAWiFiChannel;
+
+/*!
+ * @constant CDAWiFiScanSnapshotVersion
+ *
+ * @abstract The snapshot format version written by this library.
+ */
+#define CDAWiFiScanSnapshotVersion 2
+
+/*!
+ * @constant CDAWiFiScanSnapshotNoChannel
+ *
+ * @abstract Channel index of a record whose channel is not known.
+ */
+#define CDAWiFiScanSnapshotNoChannel 0xFFFF
+
+/*!
+ * @typedef CDAWiFiScanSnapshotHeader
+ *
+ * @abstract The header at the start of a snapshot.
+ *
+ * @discussion
+ * A snapshot is laid out as the header, the channel table, the records and the blob section,
+ * each starting on an 8 byte boundary at the offsets given by the header. Integers are stored in host byte order,
+ * byteOrder tells readers on other hosts to reject the snapshot.
+ */
+typedef struct CDAWiFiScanSnapshotHeader {
+    char magic[8];              /* "CDAWSNAP" */
+    uint16_t version;
+    uint16_t byteOrder;         /* 0x0102 as written by the host */
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t recordCount;
+    uint32_t channelCount;
+    uint32_t channelTableOffset;
+    uint32_t recordOffset;
+    uint32_t blobOffset;
+    uint32_t blobLength;
+    uint32_t reserved;
+    int64_t timestamp;          /* milliseconds since 1970 when written */
+} CDAWiFiScanSnapshotHeader;
+
+/*!
+ * @typedef CDAWiFiScanSnapshotChannel
+ *
+ * @abstract An entry of the channel table. Records refer to channels by index.
+ */
+typedef struct CDAWiFiScanSnapshotChannel {
+    uint8_t channelNumber;
+    uint8_t channelWidth;       /* CDAWiFiChannelWidth */
+    uint8_t channelBand;        /* CDAWiFiChannelBand */
+    uint8_t reserved;
+} CDAWiFiScanSnapshotChannel;
+
+/*!
+ * @typedef CDAWiFiScanSnapshotRecord
+ *
+ * @abstract The fixed width record of a BSS.
+ *
+ * @discussion
+ * Offsets are relative to the start of the blob section. The SSID lies inside the information elements.
+ */
+typedef struct CDAWiFiScanSnapshotRecord {
+    CDAWiFiMACAddress bssid;
+    uint32_t frequency;                 /* MHz */
+    uint32_t informationElementOffset;
+    uint32_t informationElementLength;
+    uint32_t ssidOffset;
+    uint32_t age;                       /* milliseconds between the BSS last heard and the snapshot */
+    int16_t rssiValue;                  /* dBm */
+    int16_t noiseMeasurement;           /* dBm */
+    uint16_t capability;                /* IEEE 802.11 capability information */
+    uint16_t beaconInterval;            /* TU */
+    uint16_t channelIndex;              /* CDAWiFiScanSnapshotNoChannel if unknown */
+    uint8_t ssidLength;
+    uint8_t flags;                      /* CDAWiFiScanSnapshotRecordFlag values */
+    CDAWiFiCountryCode countryCode;
+    uint8_t security;                   /* CDAWiFiSecurity, UINT8_MAX if unknown */
+    uint8_t reserved[5];
+} CDAWiFiScanSnapshotRecord;
+
+/*!
+ * @typedef CDAWiFiScanSnapshotRecordFlag
+ *
+ * @abstract Flags of a CDAWiFiScanSnapshotRecord.
+ *
+ * @constant CDAWiFiScanSnapshotRecordFlagAssociated
+ * The interface was associated to the BSS.
+ */
+typedef enum
+{
+    CDAWiFiScanSnapshotRecordFlagAssociated = (1 << 0),
+} CDAWiFiScanSnapshotRecordFlag;
+
+/*!
+ * @class
+ *
+ * @abstract
+ * A versioned binary snapshot of a set of scan results.
+ *
+ * @discussion
+ * Snapshots are made of fixed width records, a channel table and a blob section holding the information elements.
+ * A snapshot file is mapped, not parsed: opening it only checks that every offset stays inside the file,
+ * and records are then read in place. CDAWiFiNetwork objects are only created when asked for.
+ *
+ * Thread safe.
+ */
+@interface CDAWiFiScanSnapshot : OFObject
+
+/*! @functiongroup Writing Snapshots */
+
+/*!
+ * @method
+ *
+ * @param networks
+ * A collection of CDAWiFiNetwork objects.
+ *
+ * @abstract
+ * Encodes scan results as a snapshot.
+ */
++ (OFDataArray *)dataWithNetworks:(id <OFCollection>)networks;
+
+/*!
+ * @method
+ *
+ * @param networks
+ * A collection of CDAWiFiNetwork objects.
+ *
+ * @param path
+ * The path of the snapshot file.
+ *
+ * @param error
+ * An CDAError object passed by reference, which upon return will contain the error if an error occurs.
+ * This parameter is optional.
+ *
+ * @result
+ * A BOOL value indicating whether or not an error occurred. YES indicates no error occurred.
+ *
+ * @abstract
+ * Writes scan results to a snapshot file.
+ *
+ * @discussion
+ * The snapshot is written to a temporary file, flushed and renamed over path,
+ * so readers and power losses see either the previous snapshot or the new one.
+ */
++ (BOOL)writeNetworks:(id <OFCollection>)networks toFile:(OFString *)path error:(out CDAError **)error;
+
+/*! @functiongroup Reading Snapshots */
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Maps a snapshot file.
+ *
+ * @discussion
+ * Returns nil with a CDAWiFiInvalidFormatError error if the file is not a valid snapshot.
+ */
+- (instancetype)initWithContentsOfFile:(OFString *)path error:(out CDAError **)error;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Reads a snapshot in memory. The data is retained, not copied.
+ *
+ * @discussion
+ * Returns nil with a CDAWiFiInvalidFormatError error if the data is not a valid snapshot.
+ */
+- (instancetype)initWithData:(OFDataArray *)data error:(out CDAError **)error;
+
+/*!
+ * @property
+ *
+ * @abstract
+ * The number of records.
+ */
+@property (readonly) size_t count;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns a record, in place.
+ */
+- (const CDAWiFiScanSnapshotRecord *)recordAtIndex:(size_t)index;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the information elements of a record, in place. Their length is record->informationElementLength.
+ */
+- (const uint8_t *)informationElementsForRecord:(const CDAWiFiScanSnapshotRecord *)record;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the SSID octets of a record, in place, or NULL if it has none. Their length is record->ssidLength.
+ */
+- (const uint8_t *)ssidForRecord:(const CDAWiFiScanSnapshotRecord *)record;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns the channel of a record, or nil if it is not known.
+ */
+- (CDAWiFiChannel *)channelForRecord:(const CDAWiFiScanSnapshotRecord *)record;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Returns when the BSS of a record was last heard, in seconds on the CDAWiFiMonotonicTime() clock.
+ *
+ * @discussion
+ * The age of the record is added to the time elapsed since the snapshot was written, by the wall clock,
+ * so results restored after a restart are as old as they were.
+ */
+- (double)lastSeenForRecord:(const CDAWiFiScanSnapshotRecord *)record;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Creates the CDAWiFiNetwork object of a record.
+ */
+- (CDAWiFiNetwork *)networkAtIndex:(size_t)index;
+
+/*!
+ * @method
+ *
+ * @abstract
+ * Creates the CDAWiFiNetwork objects of every record.
+ */
+- (OFSet *)networks;
+
+@end
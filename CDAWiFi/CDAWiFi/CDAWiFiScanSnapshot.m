@@ -0,0 +1,398 @@
+//
+//  CDAWiFiScanSnapshot.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/9/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiScanSnapshot.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiChannel+Private.h"
+#import "CDAWiFiScanArena.h"
+#import "CDAWiFiUtilities.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char CDAWiFiScanSnapshotMagic[8] = { 'C', 'D', 'A', 'W', 'S', 'N', 'A', 'P' };
+
+#define CDAWiFiScanSnapshotByteOrder 0x0102
+
+_Static_assert(sizeof(CDAWiFiScanSnapshotHeader) == 56, "Snapshot header layout changed");
+_Static_assert(sizeof(CDAWiFiScanSnapshotChannel) == 4, "Snapshot channel layout changed");
+_Static_assert(sizeof(CDAWiFiScanSnapshotRecord) == 48, "Snapshot record layout changed");
+
+static inline size_t CDAWiFiScanSnapshotAlign(size_t offset)
+{
+    return (offset + 7) & ~(size_t)7;
+}
+
+/* Pads data with zeros up to offset. */
+static void CDAWiFiScanSnapshotPad(OFDataArray *data, size_t offset)
+{
+    static const uint8_t zeros[8] = { 0 };
+    
+    [data addItems:zeros count:offset - data.count];
+}
+
+/* Returns YES if [offset, offset + length) lies inside a buffer of size bytes. */
+static inline BOOL CDAWiFiScanSnapshotRangeIsValid(uint64_t offset, uint64_t length, uint64_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+@implementation CDAWiFiScanSnapshot
+{
+    /* Keeps in memory snapshots alive. */
+    OFDataArray *_data;
+    
+    void *_mapping;
+    size_t _mappingLength;
+    
+    const uint8_t *_bytes;
+    const CDAWiFiScanSnapshotHeader *_header;
+    const CDAWiFiScanSnapshotRecord *_records;
+    const uint8_t *_blob;
+    
+    /* Interned channels of the channel table. */
+    OFArray *_channels;
+}
+
+#pragma mark - Writing
+
++ (OFDataArray *)dataWithNetworks:(id <OFCollection>)networks
+{
+    OFMutableArray *channels = [OFMutableArray array];
+    OFMutableDictionary *channelIndexes = [OFMutableDictionary dictionary];
+    OFDataArray *records = [[OFDataArray alloc] initWithItemSize:sizeof(CDAWiFiScanSnapshotRecord)];
+    OFDataArray *blob = [OFDataArray dataArray];
+    
+    for (CDAWiFiNetwork *network in networks) {
+        
+        CDAWiFiScanSnapshotRecord record;
+        CDAWiFiChannel *channel = network.wlanChannel;
+        
+        [network getSnapshotRecord:&record];
+        
+        record.informationElementOffset = (uint32_t)blob.count;
+        record.informationElementLength = (uint32_t)network.informationElementLength;
+        record.ssidOffset += record.informationElementOffset;
+        record.channelIndex = CDAWiFiScanSnapshotNoChannel;
+        
+        if (channel != nil) {
+            
+            OFNumber *channelIndex = channelIndexes[channel];
+            
+            if (channelIndex == nil) {
+                
+                channelIndex = [OFNumber numberWithUInt16:(uint16_t)channels.count];
+                channelIndexes[channel] = channelIndex;
+                
+                [channels addObject:channel];
+            }
+            
+            record.channelIndex = [channelIndex uInt16Value];
+        }
+        
+        [blob addItems:network.informationElements count:network.informationElementLength];
+        [records addItem:&record];
+    }
+    
+    CDAWiFiScanSnapshotHeader header;
+    
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CDAWiFiScanSnapshotMagic, sizeof(header.magic));
+    
+    header.version = CDAWiFiScanSnapshotVersion;
+    header.byteOrder = CDAWiFiScanSnapshotByteOrder;
+    header.headerSize = sizeof(header);
+    header.recordSize = sizeof(CDAWiFiScanSnapshotRecord);
+    header.recordCount = (uint32_t)records.count;
+    header.channelCount = (uint32_t)channels.count;
+    header.channelTableOffset = (uint32_t)CDAWiFiScanSnapshotAlign(sizeof(header));
+    header.recordOffset = (uint32_t)CDAWiFiScanSnapshotAlign(header.channelTableOffset + channels.count * sizeof(CDAWiFiScanSnapshotChannel));
+    header.blobOffset = (uint32_t)CDAWiFiScanSnapshotAlign(header.recordOffset + records.count * sizeof(CDAWiFiScanSnapshotRecord));
+    header.blobLength = (uint32_t)blob.count;
+    header.timestamp = (int64_t)([[OFDate date] timeIntervalSince1970] * 1000);
+    
+    OFDataArray *data = [OFDataArray dataArray];
+    
+    [data addItems:&header count:sizeof(header)];
+    CDAWiFiScanSnapshotPad(data, header.channelTableOffset);
+    
+    for (CDAWiFiChannel *channel in channels) {
+        
+        CDAWiFiScanSnapshotChannel entry = {
+            .channelNumber = (uint8_t)channel.channelNumber,
+            .channelWidth = (uint8_t)channel.channelWidth,
+            .channelBand = (uint8_t)channel.channelBand,
+            .reserved = 0
+        };
+        
+        [data addItems:&entry count:sizeof(entry)];
+    }
+    
+    CDAWiFiScanSnapshotPad(data, header.recordOffset);
+    [data addItems:records.items count:records.count * sizeof(CDAWiFiScanSnapshotRecord)];
+    CDAWiFiScanSnapshotPad(data, header.blobOffset);
+    [data addItems:blob.items count:blob.count];
+    
+    return data;
+}
+
++ (BOOL)writeNetworks:(id <OFCollection>)networks toFile:(OFString *)path error:(out CDAError **)error
+{
+    return CDAWiFiWriteFileAtomically([self dataWithNetworks:networks], path, error);
+}
+
+#pragma mark - Reading
+
+- (instancetype)initWithContentsOfFile:(OFString *)path error:(out CDAError **)error
+{
+    self = [super init];
+    
+    if (self) {
+        
+        int fileDescriptor = open([path UTF8String], O_RDONLY | O_CLOEXEC);
+        struct stat status;
+        
+        if (fileDescriptor < 0) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errno);
+            }
+            
+            return nil;
+        }
+        
+        if (fstat(fileDescriptor, &status) != 0) {
+            
+            int errnum = errno;
+            
+            close(fileDescriptor);
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errnum);
+            }
+            
+            return nil;
+        }
+        
+        if ((size_t)status.st_size < sizeof(CDAWiFiScanSnapshotHeader)) {
+            
+            close(fileDescriptor);
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidFormatError);
+            }
+            
+            return nil;
+        }
+        
+        void *mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        
+        close(fileDescriptor);
+        
+        if (mapping == MAP_FAILED) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithErrno(errno);
+            }
+            
+            return nil;
+        }
+        
+        _mapping = mapping;
+        _mappingLength = (size_t)status.st_size;
+        
+        if (![self loadBytes:mapping length:_mappingLength]) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidFormatError);
+            }
+            
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithData:(OFDataArray *)data error:(out CDAError **)error
+{
+    self = [super init];
+    
+    if (self) {
+        
+        _data = data;
+        
+        if (![self loadBytes:data.items length:data.count * data.itemSize]) {
+            
+            if (error != NULL) {
+                *error = CDAWiFiErrorWithCode(CDAWiFiInvalidFormatError);
+            }
+            
+            return nil;
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_mapping != NULL) {
+        munmap(_mapping, _mappingLength);
+    }
+}
+
+/* Checks that every offset of the snapshot stays inside it, so records can then be read without checks. */
+- (BOOL)loadBytes:(const uint8_t *)bytes length:(size_t)length
+{
+    const CDAWiFiScanSnapshotHeader *header = (const CDAWiFiScanSnapshotHeader *)bytes;
+    
+    /* Sections are 8 byte aligned relative to the start, which mmap and malloc align further. */
+    if (length < sizeof(CDAWiFiScanSnapshotHeader) || ((uintptr_t)bytes & 7) != 0 ||
+        memcmp(header->magic, CDAWiFiScanSnapshotMagic, sizeof(header->magic)) != 0 ||
+        header->byteOrder != CDAWiFiScanSnapshotByteOrder ||
+        header->version != CDAWiFiScanSnapshotVersion ||
+        header->headerSize < sizeof(CDAWiFiScanSnapshotHeader) ||
+        header->recordSize != sizeof(CDAWiFiScanSnapshotRecord) ||
+        (header->channelTableOffset & 7) != 0 || (header->recordOffset & 7) != 0 ||
+        !CDAWiFiScanSnapshotRangeIsValid(header->channelTableOffset, (uint64_t)header->channelCount * sizeof(CDAWiFiScanSnapshotChannel), length) ||
+        !CDAWiFiScanSnapshotRangeIsValid(header->recordOffset, (uint64_t)header->recordCount * sizeof(CDAWiFiScanSnapshotRecord), length) ||
+        !CDAWiFiScanSnapshotRangeIsValid(header->blobOffset, header->blobLength, length)) {
+        
+        return NO;
+    }
+    
+    const CDAWiFiScanSnapshotChannel *entries = (const CDAWiFiScanSnapshotChannel *)(bytes + header->channelTableOffset);
+    OFMutableArray *channels = [OFMutableArray arrayWithCapacity:header->channelCount];
+    
+    for (uint32_t index = 0; index < header->channelCount; index++) {
+        
+        CDAWiFiChannel *channel = [CDAWiFiChannel channelWithChannelNumber:entries[index].channelNumber
+                                                              channelWidth:entries[index].channelWidth
+                                                               channelBand:entries[index].channelBand];
+        
+        if (channel == nil) {
+            return NO;
+        }
+        
+        [channels addObject:channel];
+    }
+    
+    const CDAWiFiScanSnapshotRecord *records = (const CDAWiFiScanSnapshotRecord *)(bytes + header->recordOffset);
+    
+    for (uint32_t index = 0; index < header->recordCount; index++) {
+        
+        const CDAWiFiScanSnapshotRecord *record = &records[index];
+        
+        if (!CDAWiFiScanSnapshotRangeIsValid(record->informationElementOffset, record->informationElementLength, header->blobLength) ||
+            !CDAWiFiScanSnapshotRangeIsValid(record->ssidOffset, record->ssidLength, header->blobLength) ||
+            (record->channelIndex != CDAWiFiScanSnapshotNoChannel && record->channelIndex >= header->channelCount)) {
+            
+            return NO;
+        }
+    }
+    
+    [channels makeImmutable];
+    
+    _bytes = bytes;
+    _header = header;
+    _records = records;
+    _blob = bytes + header->blobOffset;
+    _channels = channels;
+    
+    return YES;
+}
+
+#pragma mark - Records
+
+- (size_t)count
+{
+    return _header->recordCount;
+}
+
+- (const CDAWiFiScanSnapshotRecord *)recordAtIndex:(size_t)index
+{
+    if (index >= _header->recordCount) {
+        @throw [OFOutOfRangeException exception];
+    }
+    
+    return &_records[index];
+}
+
+- (const uint8_t *)informationElementsForRecord:(const CDAWiFiScanSnapshotRecord *)record
+{
+    return _blob + record->informationElementOffset;
+}
+
+- (const uint8_t *)ssidForRecord:(const CDAWiFiScanSnapshotRecord *)record
+{
+    if (record->ssidLength == 0) {
+        return NULL;
+    }
+    
+    return _blob + record->ssidOffset;
+}
+
+- (CDAWiFiChannel *)channelForRecord:(const CDAWiFiScanSnapshotRecord *)record
+{
+    if (record->channelIndex == CDAWiFiScanSnapshotNoChannel) {
+        return nil;
+    }
+    
+    return _channels[record->channelIndex];
+}
+
+- (double)lastSeenForRecord:(const CDAWiFiScanSnapshotRecord *)record
+{
+    double elapsed = [[OFDate date] timeIntervalSince1970] - _header->timestamp / 1000.0;
+    
+    /* The wall clock may have been set back since. */
+    return CDAWiFiMonotonicTime() - record->age / 1000.0 - OF_MAX(elapsed, 0);
+}
+
+#pragma mark - Networks
+
+- (CDAWiFiNetwork *)networkAtIndex:(size_t)index
+{
+    const CDAWiFiScanSnapshotRecord *record = [self recordAtIndex:index];
+    
+    return [[CDAWiFiNetwork alloc] initWithSnapshotRecord:record
+                                      informationElements:[self informationElementsForRecord:record]
+                                                 lastSeen:[self lastSeenForRecord:record]
+                                                    arena:nil];
+}
+
+- (OFSet *)networks
+{
+    OFMutableSet *networks = [OFMutableSet set];
+    CDAWiFiScanArena *arena = [[CDAWiFiScanArena alloc] init];
+    
+    for (size_t index = 0; index < _header->recordCount; index++) {
+        
+        const CDAWiFiScanSnapshotRecord *record = [self recordAtIndex:index];
+        CDAWiFiNetwork *network = [[CDAWiFiNetwork alloc] initWithSnapshotRecord:record
+                                                             informationElements:[self informationElementsForRecord:record]
+                                                                        lastSeen:[self lastSeenForRecord:record]
+                                                                           arena:arena];
+        
+        if (network != nil) {
+            [networks addObject:network];
+        }
+    }
+    
+    [networks makeImmutable];
+    
+    return networks;
+}
+
+@end
@@ -154,6 +154,13 @@ typedef enum
     CDAWiFiGenericError									= -3931,
 } CDAWiFiError;
 
+/*!
+ * @const CDAWiFiErrorDomain
+ *
+ * @abstract Error domain for errors returned by the CDAWiFi framework. Error codes are CDAWiFiError values.
+ */
+extern OFString *const CDAWiFiErrorDomain;
+
 /*!
  * @typedef CWPHYMode
  *
@@ -432,3 +439,22 @@ typedef enum
     CDAWiFiEventTypeUnknown                  = INTMAX_MAX
 } CDAWiFiEventType;
 
+/*!
+ * @typedef CDAWiFiMACAddress
+ *
+ * @abstract A MAC-48 address packed in the low 48 bits of an integer, first octet most significant.
+ *
+ * @discussion
+ * 0 indicates no address. Packed addresses compare, hash and sort like their XX:XX:XX:XX:XX:XX form.
+ */
+typedef uint64_t CDAWiFiMACAddress;
+
+/*!
+ * @typedef CDAWiFiCountryCode
+ *
+ * @abstract An ISO/IEC 3166-1 alpha-2 country code packed in an integer, first letter in the high byte.
+ *
+ * @discussion
+ * 0 indicates no country code.
+ */
+typedef uint16_t CDAWiFiCountryCode;
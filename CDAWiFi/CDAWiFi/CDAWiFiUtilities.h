@@ -0,0 +1,246 @@
+//
+//  CDAWiFiUtilities.h
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/2/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import <CDAFoundation/CDAFoundation.h>
+#import <CDAWiFi/CDAWiFiTypes.h>
+#include <dispatch/dispatch.h>
+#include <stdatomic.h>
+
+/* Private helpers shared by the CDAWiFi classes. Not part of the public API. */
+
+/*! @functiongroup Errors */
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns a CDAError in the CDAWiFiErrorDomain domain with the specified code.
+ */
+extern CDAError *CDAWiFiErrorWithCode(CDAWiFiError code);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns a CDAError in the CDAWiFiErrorDomain domain for a (positive) errno value reported by the kernel.
+ */
+extern CDAError *CDAWiFiErrorWithErrno(int errnum);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns a CDAError in the CDAWiFiErrorDomain domain for a failed IEEE 802.11 authentication or association
+ * status code (IEEE 802.11-2012, 8.4.1.9).
+ */
+extern CDAError *CDAWiFiErrorWithStatusCode(uint16_t statusCode);
+
+/*! @functiongroup Dispatch */
+
+/*
+ * Dispatch objects are only managed by ARC when libdispatch is built with Objective-C support,
+ * which the Linux port is not. Blocks then do not retain the queues and sources they capture.
+ * Both are statements, like the libdispatch calls they stand for.
+ */
+#if OS_OBJECT_USE_OBJC
+#define CDAWiFiDispatchRetain(object)   do { } while (0)
+#define CDAWiFiDispatchRelease(object)  do { } while (0)
+#else
+#define CDAWiFiDispatchRetain(object)   do { dispatch_retain(object); } while (0)
+#define CDAWiFiDispatchRelease(object)  do { dispatch_release(object); } while (0)
+#endif
+
+/*! @functiongroup Time */
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the value of the monotonic clock in seconds.
+ */
+extern double CDAWiFiMonotonicTime(void);
+
+/*! @functiongroup Channels */
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the IEEE 802.11 channel number for a center frequency in MHz, or 0 if the frequency is not a Wi-Fi channel.
+ */
+extern int CDAWiFiChannelNumberForFrequency(uint32_t frequency);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the channel band for a center frequency in MHz.
+ */
+extern CDAWiFiChannelBand CDAWiFiChannelBandForFrequency(uint32_t frequency);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Converts an nl80211 channel width (enum nl80211_chan_width) to a CDAWiFiChannelWidth.
+ */
+extern CDAWiFiChannelWidth CDAWiFiChannelWidthForNL80211ChannelWidth(uint32_t width);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Converts a CDAWiFiChannelWidth to an nl80211 channel width (enum nl80211_chan_width).
+ */
+extern uint32_t CDAWiFiNL80211ChannelWidthForChannelWidth(CDAWiFiChannelWidth width);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the center frequency in MHz of a 20 MHz channel, or 0 if the channel does not exist in the band.
+ */
+extern uint32_t CDAWiFiFrequencyForChannelNumber(int channelNumber, CDAWiFiChannelBand band);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns the center frequency in MHz of the whole width of a channel, or 0 if the channel cannot be that wide.
+ *
+ * @discussion
+ * 5 GHz channels are bonded in the fixed blocks starting at channels 36 and 149. A 40 MHz 2.4 GHz channel extends
+ * above its primary channel up to channel 7, below it from channel 8 on.
+ */
+extern uint32_t CDAWiFiCenterFrequencyForChannel(int channelNumber, CDAWiFiChannelWidth width, CDAWiFiChannelBand band);
+
+/*! @functiongroup Addresses */
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Packs the 6 octets of a MAC-48 address.
+ */
+static inline CDAWiFiMACAddress CDAWiFiMACAddressMake(const uint8_t octets[6])
+{
+    return ((CDAWiFiMACAddress)octets[0] << 40 | (CDAWiFiMACAddress)octets[1] << 32 |
+            (CDAWiFiMACAddress)octets[2] << 24 | (CDAWiFiMACAddress)octets[3] << 16 |
+            (CDAWiFiMACAddress)octets[4] << 8 | (CDAWiFiMACAddress)octets[5]);
+}
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Unpacks a MAC-48 address into its 6 octets.
+ */
+static inline void CDAWiFiMACAddressGetOctets(CDAWiFiMACAddress address, uint8_t octets[6])
+{
+    for (int index = 5; index >= 0; index--) {
+        octets[index] = (uint8_t)address;
+        address >>= 8;
+    }
+}
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Packs the 2 letters of a country code.
+ */
+static inline CDAWiFiCountryCode CDAWiFiCountryCodeMake(const uint8_t letters[2])
+{
+    return (CDAWiFiCountryCode)(letters[0] << 8 | letters[1]);
+}
+
+/*! @functiongroup Strings */
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Formats a MAC-48 address as XX:XX:XX:XX:XX:XX.
+ */
+extern OFString *CDAWiFiMACAddressString(CDAWiFiMACAddress address);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Formats a country code, or returns nil if it is 0.
+ */
+extern OFString *CDAWiFiCountryCodeString(CDAWiFiCountryCode countryCode);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Decodes raw SSID octets as UTF-8, falling back to WinLatin1.
+ *
+ * @discussion
+ * Returns nil if the SSID is empty or can not be decoded.
+ */
+extern OFString *CDAWiFiSSIDString(const uint8_t *bytes, size_t length);
+
+/*! @functiongroup Files */
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Writes data to a temporary file, flushes it and renames it over path.
+ *
+ * @discussion
+ * Readers and power losses see either the previous file or the new one, never a partial write.
+ * The directory is flushed after the rename. If that fails, the function returns NO with the new file already in place,
+ * but the new file may not survive a power loss.
+ */
+extern BOOL CDAWiFiWriteFileAtomically(OFDataArray *data, OFString *path, CDAError **error);
+
+/*! @functiongroup Hazard Pointers */
+
+/*
+ * Lock free reclamation of objects replaced behind an atomic pointer. A reader protects the object it loads with
+ * a hazard pointer of its thread until it holds its own reference, a writer that replaced the object keeps its reference
+ * while any thread protects it. Readers pay a store to their own hazard pointer and a second load, no lock, no syscall.
+ * Each thread protects a single object at a time.
+ */
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Loads an atomic pointer and protects the value from reclamation until CDAWiFiHazardPointerRelease() is called
+ * on the same thread.
+ *
+ * @discussion
+ * Both functions are out of line on purpose: the compiler can not move the retain of the object between them
+ * past the release of the hazard pointer.
+ */
+extern void *CDAWiFiHazardPointerAcquire(_Atomic(void *) *pointer);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Stops protecting the value of the last CDAWiFiHazardPointerAcquire() call of the thread.
+ */
+extern void CDAWiFiHazardPointerRelease(void);
+
+/*!
+ * @function
+ *
+ * @abstract
+ * Returns YES if a thread protects the pointer.
+ *
+ * @discussion
+ * Called by writers once the pointer was replaced. If NO is returned, no reader can protect it anymore.
+ */
+extern BOOL CDAWiFiHazardPointerIsProtected(const void *pointer);
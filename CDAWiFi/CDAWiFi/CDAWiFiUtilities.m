@@ -0,0 +1,534 @@
+//
+//  CDAWiFiUtilities.m
+//  CDAWiFi
+//
+//  Created by Alsey Coleman Miller on 3/2/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiUtilities.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <linux/nl80211.h>
+
+OFString *const CDAWiFiErrorDomain = @"CDAWiFiErrorDomain";
+
+#pragma mark - Errors
+
+CDAError *CDAWiFiErrorWithCode(CDAWiFiError code)
+{
+    return [CDAError errorWithDomain:CDAWiFiErrorDomain code:code userInfo:nil];
+}
+
+CDAError *CDAWiFiErrorWithErrno(int errnum)
+{
+    CDAWiFiError code;
+    
+    switch (errnum) {
+        case EPERM:
+        case EACCES:
+            code = CDAWiFiOperationNotPermittedError;
+            break;
+            
+        case ENOMEM:
+        case ENOBUFS:
+            code = CDAWiFiNoMemoryError;
+            break;
+            
+        case EINVAL:
+        case ERANGE:
+            code = CDAWiFiInvalidParameterError;
+            break;
+            
+        case EOPNOTSUPP:
+        case ENOSYS:
+            code = CDAWiFiNotSupportedError;
+            break;
+            
+        case ETIMEDOUT:
+        case EAGAIN:
+            code = CDAWiFiTimeoutError;
+            break;
+            
+        case ENODEV:
+        case ENXIO:
+        case ENOENT:
+            code = CDAWiFiReferenceNotBoundError;
+            break;
+            
+        case ENOTCONN:
+        case ECONNREFUSED:
+        case ECONNRESET:
+            code = CDAWiFiIPCFailureError;
+            break;
+            
+        default:
+            code = CDAWiFiUnknownError;
+            break;
+    }
+    
+    return CDAWiFiErrorWithCode(code);
+}
+
+CDAError *CDAWiFiErrorWithStatusCode(uint16_t statusCode)
+{
+    CDAWiFiError code;
+    
+    switch (statusCode) {
+        case 10: code = CDAWiFiUnsupportedCapabilitiesError; break;
+        case 11: code = CDAWiFiReassociationDeniedError; break;
+        case 12: code = CDAWiFiAssociationDeniedError; break;
+        case 13: code = CDAWiFiAuthenticationAlgorithmUnsupportedError; break;
+        case 14: code = CDAWiFiInvalidAuthenticationSequenceNumberError; break;
+        case 15: code = CDAWiFiChallengeFailureError; break;
+        case 16: code = CDAWiFiTimeoutError; break;
+        case 17: code = CDAWiFiAPFullError; break;
+        case 18: code = CDAWiFiUnsupportedRateSetError; break;
+        case 25: code = CDAWiFiShortSlotUnsupportedError; break;
+        case 26: code = CDAWiFiDSSSOFDMUnsupportedError; break;
+        case 27: code = CDAWiFiHTFeaturesNotSupportedError; break;
+        case 28: code = CDAWiFiPCOTransitionTimeNotSupportedError; break;
+        case 40: code = CDAWiFiInvalidInformationElementError; break;
+        case 41: code = CDAWiFiInvalidGroupCipherError; break;
+        case 42: code = CDAWiFiInvalidPairwiseCipherError; break;
+        case 43: code = CDAWiFiInvalidAKMPError; break;
+        case 44: code = CDAWiFiUnsupportedRSNVersionError; break;
+        case 45: code = CDAWiFiInvalidRSNCapabilitiesError; break;
+        case 46: code = CDAWiFiCipherSuiteRejectedError; break;
+        case 53: code = CDAWiFiInvalidPMKError; break;
+        default: code = CDAWiFiUnspecifiedFailureError; break;
+    }
+    
+    return CDAWiFiErrorWithCode(code);
+}
+
+#pragma mark - Time
+
+double CDAWiFiMonotonicTime(void)
+{
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (double)now.tv_sec + (double)now.tv_nsec / 1000000000.0;
+}
+
+#pragma mark - Channels
+
+int CDAWiFiChannelNumberForFrequency(uint32_t frequency)
+{
+    if (frequency == 2484) {
+        return 14;
+    }
+    
+    if (frequency >= 2412 && frequency <= 2472) {
+        return (frequency - 2407) / 5;
+    }
+    
+    if (frequency >= 4910 && frequency <= 4980) {
+        return (frequency - 4000) / 5;
+    }
+    
+    if (frequency >= 5000 && frequency <= 5900) {
+        return (frequency - 5000) / 5;
+    }
+    
+    return 0;
+}
+
+CDAWiFiChannelBand CDAWiFiChannelBandForFrequency(uint32_t frequency)
+{
+    /* The frequencies with a channel number, and only them, have a band. */
+    if (CDAWiFiChannelNumberForFrequency(frequency) == 0) {
+        return CDAWiFiChannelBandUnknown;
+    }
+    
+    return (frequency < 3000) ? CDAWiFiChannelBand2GHz : CDAWiFiChannelBand5GHz;
+}
+
+CDAWiFiChannelWidth CDAWiFiChannelWidthForNL80211ChannelWidth(uint32_t width)
+{
+    switch (width) {
+        case NL80211_CHAN_WIDTH_20_NOHT:
+        case NL80211_CHAN_WIDTH_20:
+            return CDAWiFiChannelWidth20MHz;
+            
+        case NL80211_CHAN_WIDTH_40:
+            return CDAWiFiChannelWidth40MHz;
+            
+        case NL80211_CHAN_WIDTH_80:
+            return CDAWiFiChannelWidth80MHz;
+            
+        case NL80211_CHAN_WIDTH_80P80:
+        case NL80211_CHAN_WIDTH_160:
+            return CDAWiFiChannelWidth160MHz;
+            
+        default:
+            return CDAWiFiChannelWidthUnknown;
+    }
+}
+
+uint32_t CDAWiFiNL80211ChannelWidthForChannelWidth(CDAWiFiChannelWidth width)
+{
+    switch (width) {
+        case CDAWiFiChannelWidth40MHz:
+            return NL80211_CHAN_WIDTH_40;
+        
+        case CDAWiFiChannelWidth80MHz:
+            return NL80211_CHAN_WIDTH_80;
+        
+        case CDAWiFiChannelWidth160MHz:
+            return NL80211_CHAN_WIDTH_160;
+        
+        default:
+            return NL80211_CHAN_WIDTH_20;
+    }
+}
+
+uint32_t CDAWiFiFrequencyForChannelNumber(int channelNumber, CDAWiFiChannelBand band)
+{
+    switch (band) {
+        case CDAWiFiChannelBand2GHz:
+            
+            if (channelNumber == 14) {
+                return 2484;
+            }
+            
+            return (channelNumber >= 1 && channelNumber <= 13) ? 2407 + channelNumber * 5 : 0;
+        
+        case CDAWiFiChannelBand5GHz:
+            
+            if (channelNumber >= 182 && channelNumber <= 196) {
+                return 4000 + channelNumber * 5;
+            }
+            
+            return (channelNumber >= 1 && channelNumber <= 180) ? 5000 + channelNumber * 5 : 0;
+        
+        default:
+            return 0;
+    }
+}
+
+uint32_t CDAWiFiCenterFrequencyForChannel(int channelNumber, CDAWiFiChannelWidth width, CDAWiFiChannelBand band)
+{
+    uint32_t frequency = CDAWiFiFrequencyForChannelNumber(channelNumber, band);
+    
+    if (frequency == 0 || width == CDAWiFiChannelWidth20MHz) {
+        return frequency;
+    }
+    
+    if (band == CDAWiFiChannelBand2GHz) {
+        
+        if (width != CDAWiFiChannelWidth40MHz || channelNumber > 13) {
+            return 0;
+        }
+        
+        return (channelNumber <= 7) ? frequency + 10 : frequency - 10;
+    }
+    
+    if (channelNumber < 36 || channelNumber > 177) {
+        return 0;
+    }
+    
+    /* Channel numbers are 5 MHz apart, a block of n 20 MHz channels spans 4n numbers. */
+    int base = (channelNumber < 149) ? 36 : 149;
+    int span;
+    
+    switch (width) {
+        case CDAWiFiChannelWidth40MHz:
+            span = 8;
+            break;
+        
+        case CDAWiFiChannelWidth80MHz:
+            span = 16;
+            break;
+        
+        case CDAWiFiChannelWidth160MHz:
+            span = 32;
+            break;
+        
+        default:
+            return 0;
+    }
+    
+    int centerChannelNumber = base + (channelNumber - base) / span * span + (span - 4) / 2;
+    
+    return 5000 + centerChannelNumber * 5;
+}
+
+#pragma mark - Strings
+
+OFString *CDAWiFiMACAddressString(CDAWiFiMACAddress address)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char string[17];
+    
+    /* Formatted by hand, a format string costs more than the string itself. */
+    for (int index = 0; index < 6; index++) {
+        
+        uint8_t octet = (uint8_t)(address >> (40 - index * 8));
+        
+        string[index * 3] = digits[octet >> 4];
+        string[index * 3 + 1] = digits[octet & 0x0F];
+        
+        if (index < 5) {
+            string[index * 3 + 2] = ':';
+        }
+    }
+    
+    return [OFString stringWithCString:string encoding:OF_STRING_ENCODING_ASCII length:sizeof(string)];
+}
+
+OFString *CDAWiFiCountryCodeString(CDAWiFiCountryCode countryCode)
+{
+    if (countryCode == 0) {
+        return nil;
+    }
+    
+    char string[2] = { (char)(countryCode >> 8), (char)countryCode };
+    
+    return [OFString stringWithCString:string encoding:OF_STRING_ENCODING_ASCII length:sizeof(string)];
+}
+
+OFString *CDAWiFiSSIDString(const uint8_t *bytes, size_t length)
+{
+    if (length == 0) {
+        return nil;
+    }
+    
+    @try {
+        return [OFString stringWithUTF8String:(const char *)bytes length:length];
+    }
+    @catch (OFInvalidEncodingException *exception) {
+        
+    }
+    
+    @try {
+        return [OFString stringWithCString:(const char *)bytes
+                                  encoding:OF_STRING_ENCODING_WINDOWS_1252
+                                    length:length];
+    }
+    @catch (OFInvalidEncodingException *exception) {
+        
+        return nil;
+    }
+}
+
+#pragma mark - Files
+
+BOOL CDAWiFiWriteFileAtomically(OFDataArray *data, OFString *path, CDAError **error)
+{
+    OFString *temporaryPath = [path stringByAppendingString:@".tmp"];
+    const char *fileSystemPath = [path UTF8String];
+    const char *temporaryFileSystemPath = [temporaryPath UTF8String];
+    
+    int fileDescriptor = open(temporaryFileSystemPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    
+    if (fileDescriptor < 0) {
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errno);
+        }
+        
+        return NO;
+    }
+    
+    const uint8_t *bytes = data.items;
+    size_t remaining = data.count * data.itemSize;
+    
+    while (remaining > 0) {
+        
+        ssize_t written = write(fileDescriptor, bytes, remaining);
+        
+        if (written < 0) {
+            
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            break;
+        }
+        
+        bytes += written;
+        remaining -= written;
+    }
+    
+    /* The data must be on disk before the rename makes it visible. */
+    if (remaining > 0 || fsync(fileDescriptor) != 0) {
+        
+        int errnum = errno;
+        
+        close(fileDescriptor);
+        unlink(temporaryFileSystemPath);
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errnum);
+        }
+        
+        return NO;
+    }
+    
+    close(fileDescriptor);
+    
+    if (rename(temporaryFileSystemPath, fileSystemPath) != 0) {
+        
+        int errnum = errno;
+        
+        unlink(temporaryFileSystemPath);
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errnum);
+        }
+        
+        return NO;
+    }
+    
+    /* The rename is only durable once the directory entry is on disk too. */
+    OFString *directoryPath = [path stringByDeletingLastPathComponent];
+    
+    if (directoryPath.length == 0) {
+        directoryPath = @".";
+    }
+    
+    int directoryFileDescriptor = open([directoryPath UTF8String], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    
+    if (directoryFileDescriptor < 0 || fsync(directoryFileDescriptor) != 0) {
+        
+        int errnum = errno;
+        
+        if (directoryFileDescriptor >= 0) {
+            close(directoryFileDescriptor);
+        }
+        
+        if (error != NULL) {
+            *error = CDAWiFiErrorWithErrno(errnum);
+        }
+        
+        return NO;
+    }
+    
+    close(directoryFileDescriptor);
+    
+    return YES;
+}
+
+#pragma mark - Hazard Pointers
+
+/* A hazard pointer of a thread. Records are never freed, those of exited threads are reused. */
+typedef struct CDAWiFiHazardRecord {
+    _Atomic(const void *) pointer;
+    atomic_bool active;
+    struct CDAWiFiHazardRecord *next;
+} CDAWiFiHazardRecord;
+
+static _Atomic(CDAWiFiHazardRecord *) CDAWiFiHazardRecords;
+
+static pthread_key_t CDAWiFiHazardRecordKey;
+
+static pthread_once_t CDAWiFiHazardRecordKeyOnce = PTHREAD_ONCE_INIT;
+
+static void CDAWiFiHazardRecordThreadDidExit(void *value)
+{
+    CDAWiFiHazardRecord *record = value;
+    
+    atomic_store_explicit(&record->pointer, NULL, memory_order_relaxed);
+    atomic_store_explicit(&record->active, false, memory_order_release);
+}
+
+static void CDAWiFiHazardRecordKeyCreate(void)
+{
+    pthread_key_create(&CDAWiFiHazardRecordKey, CDAWiFiHazardRecordThreadDidExit);
+}
+
+static CDAWiFiHazardRecord *CDAWiFiHazardRecordForCurrentThread(void)
+{
+    pthread_once(&CDAWiFiHazardRecordKeyOnce, CDAWiFiHazardRecordKeyCreate);
+    
+    CDAWiFiHazardRecord *record = pthread_getspecific(CDAWiFiHazardRecordKey);
+    
+    if (record != NULL) {
+        return record;
+    }
+    
+    for (record = atomic_load_explicit(&CDAWiFiHazardRecords, memory_order_acquire); record != NULL; record = record->next) {
+        
+        bool expected = false;
+        
+        if (!atomic_load_explicit(&record->active, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&record->active, &expected, true, memory_order_acquire, memory_order_relaxed)) {
+            
+            break;
+        }
+    }
+    
+    if (record == NULL) {
+        
+        record = calloc(1, sizeof(CDAWiFiHazardRecord));
+        
+        if (record == NULL) {
+            @throw [OFOutOfMemoryException exceptionWithRequestedSize:sizeof(CDAWiFiHazardRecord)];
+        }
+        
+        atomic_init(&record->pointer, NULL);
+        atomic_init(&record->active, true);
+        
+        CDAWiFiHazardRecord *head = atomic_load_explicit(&CDAWiFiHazardRecords, memory_order_relaxed);
+        
+        do {
+            record->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&CDAWiFiHazardRecords, &head, record, memory_order_release, memory_order_relaxed));
+    }
+    
+    pthread_setspecific(CDAWiFiHazardRecordKey, record);
+    
+    return record;
+}
+
+void *CDAWiFiHazardPointerAcquire(_Atomic(void *) *pointer)
+{
+    CDAWiFiHazardRecord *record = CDAWiFiHazardRecordForCurrentThread();
+    void *value = atomic_load_explicit(pointer, memory_order_acquire);
+    
+    /* Published before the pointer is read again, so a writer that replaced it since either sees the mark or is seen. */
+    while (1) {
+        
+        atomic_store_explicit(&record->pointer, value, memory_order_seq_cst);
+        
+        void *currentValue = atomic_load_explicit(pointer, memory_order_seq_cst);
+        
+        if (currentValue == value) {
+            return value;
+        }
+        
+        value = currentValue;
+    }
+}
+
+void CDAWiFiHazardPointerRelease(void)
+{
+    CDAWiFiHazardRecord *record = pthread_getspecific(CDAWiFiHazardRecordKey);
+    
+    if (record != NULL) {
+        atomic_store_explicit(&record->pointer, NULL, memory_order_release);
+    }
+}
+
+BOOL CDAWiFiHazardPointerIsProtected(const void *pointer)
+{
+    for (CDAWiFiHazardRecord *record = atomic_load_explicit(&CDAWiFiHazardRecords, memory_order_acquire);
+         record != NULL;
+         record = record->next) {
+        
+        if (atomic_load_explicit(&record->pointer, memory_order_seq_cst) == pointer) {
+            return YES;
+        }
+    }
+    
+    return NO;
+}
@@ -0,0 +1,887 @@
+//
+//  main.m
+//  CDAWiFiBenchmarks
+//
+//  Created by Alsey Coleman Miller on 3/5/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiClient.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiChannel+Private.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiScanCache.h"
+#import "CDAWiFiScanArena.h"
+#import "CDAWiFiEventEngine.h"
+#import "CDAWiFiNetlink.h"
+#import "CDAWiFiInformationElements.h"
+#import "CDAWiFiCrypto.h"
+#import "CDAWiFiPairwiseMasterKeyCache.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Measures the hot paths of CDAWiFi without a radio, on synthetic or recorded nl80211 traffic,
+ * and prints the results as JSON on the standard output.
+ *
+ * Usage: CDAWiFiBenchmarks [--scan-dump path] [--events path] [--bss-count count] [--iterations count]
+ *
+ * Recorded files hold raw netlink messages back to back, as read from an nl80211 socket.
+ * Scan dumps are NL80211_CMD_NEW_SCAN_RESULTS messages, event streams any nl80211 multicast messages.
+ */
+
+/* Default number of BSSes in the synthetic scan dump. */
+#define CDAWiFiBenchmarkBSSCount 10000
+
+/* Default number of passes over the inputs per measurement. */
+#define CDAWiFiBenchmarkIterations 200
+
+/* Number of messages in the synthetic event stream. */
+#define CDAWiFiBenchmarkEventCount 4096
+
+/* Share of the BSSes whose RSSI changes between two scans of the set building benchmark. */
+#define CDAWiFiBenchmarkChurnRatio 10
+
+/* Number of profiles provisioned at once by the batch key derivation benchmark. */
+#define CDAWiFiBenchmarkProfileCount 32
+
+/* nl80211 family ID written in synthetic messages. Any value works, the family is not checked when replaying. */
+#define CDAWiFiBenchmarkFamilyID 0x1C
+
+/* Interface index written in synthetic messages. */
+#define CDAWiFiBenchmarkInterfaceIndex 3
+
+#pragma mark - Allocation Counting
+
+static _Atomic(size_t) CDAWiFiBenchmarkAllocationCount;
+
+#if defined(__GLIBC__)
+
+/* Interposes the C allocator, which ObjFW uses for objects and buffers. */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+#define CDAWiFiBenchmarkCountsAllocations 1
+
+void *malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&CDAWiFiBenchmarkAllocationCount, 1, memory_order_relaxed);
+    
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&CDAWiFiBenchmarkAllocationCount, 1, memory_order_relaxed);
+    
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    atomic_fetch_add_explicit(&CDAWiFiBenchmarkAllocationCount, 1, memory_order_relaxed);
+    
+    return __libc_realloc(pointer, size);
+}
+
+#else
+
+#define CDAWiFiBenchmarkCountsAllocations 0
+
+#endif
+
+#pragma mark - Message Streams
+
+typedef struct
+{
+    uint8_t *bytes;
+    size_t length;
+    size_t capacity;
+    size_t count;
+    
+} CDAWiFiBenchmarkStream;
+
+static void CDAWiFiBenchmarkStreamAppend(CDAWiFiBenchmarkStream *stream, const struct nlmsghdr *message)
+{
+    size_t length = NLMSG_ALIGN(message->nlmsg_len);
+    
+    if (stream->length + length > stream->capacity) {
+        
+        stream->capacity = (stream->capacity + length) * 2;
+        stream->bytes = realloc(stream->bytes, stream->capacity);
+    }
+    
+    memset(stream->bytes + stream->length, 0, length);
+    memcpy(stream->bytes + stream->length, message, message->nlmsg_len);
+    
+    stream->length += length;
+    stream->count++;
+}
+
+static BOOL CDAWiFiBenchmarkStreamLoad(CDAWiFiBenchmarkStream *stream, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    
+    if (file == NULL) {
+        return NO;
+    }
+    
+    uint8_t *bytes = NULL;
+    size_t length = 0, capacity = 0, read;
+    
+    do {
+        
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : 64 * 1024;
+            bytes = realloc(bytes, capacity);
+        }
+        
+        read = fread(bytes + length, 1, capacity - length, file);
+        length += read;
+        
+    } while (read > 0);
+    
+    fclose(file);
+    
+    /* Re-append message by message, so truncated or foreign records are dropped. */
+    size_t remaining = length;
+    
+    for (const struct nlmsghdr *message = (const struct nlmsghdr *)bytes;
+         NLMSG_OK(message, remaining);
+         message = NLMSG_NEXT(message, remaining)) {
+        
+        if (message->nlmsg_len >= NLMSG_LENGTH(GENL_HDRLEN) && message->nlmsg_type >= NLMSG_MIN_TYPE) {
+            CDAWiFiBenchmarkStreamAppend(stream, message);
+        }
+    }
+    
+    free(bytes);
+    
+    return YES;
+}
+
+/* Invokes block for every message of the stream. */
+static void CDAWiFiBenchmarkStreamEnumerate(const CDAWiFiBenchmarkStream *stream, void (^block)(const struct nlmsghdr *message))
+{
+    size_t remaining = stream->length;
+    
+    for (const struct nlmsghdr *message = (const struct nlmsghdr *)stream->bytes;
+         NLMSG_OK(message, remaining);
+         message = NLMSG_NEXT(message, remaining)) {
+        
+        block(message);
+    }
+}
+
+static void CDAWiFiBenchmarkStreamDestroy(CDAWiFiBenchmarkStream *stream)
+{
+    free(stream->bytes);
+}
+
+#pragma mark - Synthetic Traffic
+
+static uint32_t CDAWiFiBenchmarkRandom(uint32_t *state)
+{
+    /* xorshift32, so every run measures the same traffic. */
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    
+    return *state;
+}
+
+static uint8_t *CDAWiFiBenchmarkPutElement(uint8_t *cursor, uint8_t identifier, uint8_t length, uint32_t *state)
+{
+    cursor[0] = identifier;
+    cursor[1] = length;
+    
+    for (uint8_t index = 0; index < length; index++) {
+        cursor[2 + index] = (uint8_t)CDAWiFiBenchmarkRandom(state);
+    }
+    
+    return cursor + 2 + length;
+}
+
+/*
+ * Writes the information elements of a BSS, and returns their length.
+ * The element mix follows a typical 2.4/5 GHz survey: every BSS has SSID, rates, DS and HT elements,
+ * about half advertise VHT, RSN, Country and WPA, and some end with a truncated element.
+ */
+static size_t CDAWiFiBenchmarkPutElements(uint8_t *elements, uint32_t *state)
+{
+    uint8_t *cursor = elements;
+    
+    cursor = CDAWiFiBenchmarkPutElement(cursor, 0, CDAWiFiBenchmarkRandom(state) % 33, state);
+    cursor = CDAWiFiBenchmarkPutElement(cursor, 1, 8, state);
+    cursor = CDAWiFiBenchmarkPutElement(cursor, 3, 1, state);
+    
+    if (CDAWiFiBenchmarkRandom(state) % 2) {
+        cursor = CDAWiFiBenchmarkPutElement(cursor, 7, 6, state);
+    }
+    
+    cursor = CDAWiFiBenchmarkPutElement(cursor, 45, 26, state);
+    
+    if (CDAWiFiBenchmarkRandom(state) % 3) {
+        cursor = CDAWiFiBenchmarkPutElement(cursor, 48, 20, state);
+    }
+    
+    cursor = CDAWiFiBenchmarkPutElement(cursor, 61, 22, state);
+    
+    if (CDAWiFiBenchmarkRandom(state) % 2) {
+        cursor = CDAWiFiBenchmarkPutElement(cursor, 191, 12, state);
+        cursor = CDAWiFiBenchmarkPutElement(cursor, 192, 5, state);
+    }
+    
+    cursor = CDAWiFiBenchmarkPutElement(cursor, 127, 8, state);
+    
+    uint8_t *vendorSpecific = cursor;
+    
+    cursor = CDAWiFiBenchmarkPutElement(cursor, 221, 24, state);
+    
+    if (CDAWiFiBenchmarkRandom(state) % 2) {
+        memcpy(vendorSpecific + 2, (const uint8_t[]){ 0x00, 0x50, 0xF2, 0x01 }, 4);
+    }
+    
+    if (CDAWiFiBenchmarkRandom(state) % 5 == 0) {
+        *cursor++ = 48;
+    }
+    
+    return cursor - elements;
+}
+
+/* Appends a scan dump of count BSSes. rssiSeed selects the RSSI of every churned BSS, so two dumps can differ. */
+static void CDAWiFiBenchmarkStreamAddScanDump(CDAWiFiBenchmarkStream *stream, size_t count, uint32_t rssiSeed)
+{
+    static const uint32_t frequencies[] = { 2412, 2437, 2462, 5180, 5200, 5220, 5240, 5500, 5745, 5785 };
+    uint32_t state = 0x2545F491;
+    CDAWiFiNetlinkMessage message;
+    uint8_t elements[512];
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        uint8_t bssid[6] = { 0x02, 0x00, (uint8_t)(index >> 24), (uint8_t)(index >> 16), (uint8_t)(index >> 8), (uint8_t)index };
+        size_t length = CDAWiFiBenchmarkPutElements(elements, &state);
+        int rssi = -30 - (int)(CDAWiFiBenchmarkRandom(&state) % 60);
+        
+        if (index % CDAWiFiBenchmarkChurnRatio == 0) {
+            rssi = -30 - (int)((index + rssiSeed) % 60);
+        }
+        
+        CDAWiFiNetlinkMessageInit(&message, CDAWiFiBenchmarkFamilyID, NLM_F_MULTI, NL80211_CMD_NEW_SCAN_RESULTS);
+        CDAWiFiNetlinkMessagePutU32(&message, NL80211_ATTR_IFINDEX, CDAWiFiBenchmarkInterfaceIndex);
+        
+        size_t nested = CDAWiFiNetlinkMessageBeginNested(&message, NL80211_ATTR_BSS);
+        
+        CDAWiFiNetlinkMessagePut(&message, NL80211_BSS_BSSID, bssid, sizeof(bssid));
+        CDAWiFiNetlinkMessagePutU32(&message, NL80211_BSS_FREQUENCY, frequencies[index % (sizeof(frequencies) / sizeof(frequencies[0]))]);
+        CDAWiFiNetlinkMessagePutU16(&message, NL80211_BSS_BEACON_INTERVAL, 100);
+        CDAWiFiNetlinkMessagePutU16(&message, NL80211_BSS_CAPABILITY, (index % 3) ? 0x0411 : 0x0401);
+        CDAWiFiNetlinkMessagePutU32(&message, NL80211_BSS_SIGNAL_MBM, (uint32_t)(rssi * 100));
+        CDAWiFiNetlinkMessagePut(&message, NL80211_BSS_INFORMATION_ELEMENTS, elements, length);
+        
+        CDAWiFiNetlinkMessageEndNested(&message, nested);
+        
+        CDAWiFiBenchmarkStreamAppend(stream, &message.buffer.header);
+    }
+}
+
+/* Appends count events in the proportions a busy station sees them: mostly link quality and scan notifications. */
+static void CDAWiFiBenchmarkStreamAddEvents(CDAWiFiBenchmarkStream *stream, size_t count)
+{
+    static const uint8_t commands[] = {
+        NL80211_CMD_NOTIFY_CQM, NL80211_CMD_NOTIFY_CQM, NL80211_CMD_NOTIFY_CQM, NL80211_CMD_NEW_SCAN_RESULTS,
+        NL80211_CMD_NOTIFY_CQM, NL80211_CMD_ROAM, NL80211_CMD_NEW_SCAN_RESULTS, NL80211_CMD_DISCONNECT,
+        NL80211_CMD_CONNECT, NL80211_CMD_NOTIFY_CQM, NL80211_CMD_SCAN_ABORTED, NL80211_CMD_REG_CHANGE,
+        NL80211_CMD_TRIGGER_SCAN, NL80211_CMD_NOTIFY_CQM, NL80211_CMD_NEW_SCAN_RESULTS, NL80211_CMD_SET_INTERFACE
+    };
+    CDAWiFiNetlinkMessage message;
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        CDAWiFiNetlinkMessageInit(&message, CDAWiFiBenchmarkFamilyID, 0, commands[index % sizeof(commands)]);
+        CDAWiFiNetlinkMessagePutU32(&message, NL80211_ATTR_WIPHY, 0);
+        CDAWiFiNetlinkMessagePutU32(&message, NL80211_ATTR_IFINDEX, CDAWiFiBenchmarkInterfaceIndex);
+        
+        CDAWiFiBenchmarkStreamAppend(stream, &message.buffer.header);
+    }
+}
+
+#pragma mark - Measurements
+
+typedef struct
+{
+    const char *name;
+    const char *unit;
+    size_t operations;
+    double nanosecondsPerOperation;
+    double allocationsPerOperation;
+    
+} CDAWiFiBenchmarkResult;
+
+static double CDAWiFiBenchmarkNow(void)
+{
+    struct timespec time;
+    
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/* Runs body once to warm up the caches and the branch predictors, then iterations times. Each run performs operations operations. */
+static CDAWiFiBenchmarkResult CDAWiFiBenchmarkMeasure(const char *name,
+                                                      const char *unit,
+                                                      size_t operations,
+                                                      int iterations,
+                                                      void (^body)(void))
+{
+    CDAWiFiBenchmarkResult result;
+    
+    @autoreleasepool {
+        body();
+    }
+    
+    size_t allocationCount = atomic_load(&CDAWiFiBenchmarkAllocationCount);
+    double start = CDAWiFiBenchmarkNow();
+    
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        
+        @autoreleasepool {
+            body();
+        }
+    }
+    
+    double duration = CDAWiFiBenchmarkNow() - start;
+    
+    allocationCount = atomic_load(&CDAWiFiBenchmarkAllocationCount) - allocationCount;
+    
+    result.name = name;
+    result.unit = unit;
+    result.operations = operations * iterations;
+    result.nanosecondsPerOperation = duration * 1e9 / result.operations;
+    result.allocationsPerOperation = CDAWiFiBenchmarkCountsAllocations ? (double)allocationCount / result.operations : -1;
+    
+    return result;
+}
+
+static void CDAWiFiBenchmarkPrintResults(const CDAWiFiBenchmarkResult *results, size_t count,
+                                         const char *scannerName, size_t bssCount, size_t eventCount)
+{
+    printf("{\n");
+    printf("  \"scanner\": \"%s\",\n", scannerName);
+    printf("  \"bss_count\": %zu,\n", bssCount);
+    printf("  \"event_count\": %zu,\n", eventCount);
+    printf("  \"benchmarks\": [\n");
+    
+    for (size_t index = 0; index < count; index++) {
+        
+        printf("    { \"name\": \"%s\", \"unit\": \"%s\", \"operations\": %zu, \"ns_per_op\": %.2f, ",
+               results[index].name, results[index].unit, results[index].operations, results[index].nanosecondsPerOperation);
+        
+        if (results[index].allocationsPerOperation < 0) {
+            printf("\"allocations_per_op\": null }");
+        } else {
+            printf("\"allocations_per_op\": %.3f }", results[index].allocationsPerOperation);
+        }
+        
+        printf("%s\n", (index + 1 < count) ? "," : "");
+    }
+    
+    printf("  ]\n");
+    printf("}\n");
+}
+
+#pragma mark - Fixtures
+
+/* Returns the BSS attribute of a scan dump message, or NULL. */
+static const struct nlattr *CDAWiFiBenchmarkBSSAttribute(const struct nlmsghdr *message)
+{
+    const struct genlmsghdr *header = NLMSG_DATA(message);
+    const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+
+    if (header->cmd != NL80211_CMD_NEW_SCAN_RESULTS) {
+        return NULL;
+    }
+
+    CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, message);
+
+    return attributes[NL80211_ATTR_BSS];
+}
+
+/* Decodes the networks of a dump into one arena, the way CDAWiFiInterface does, or into an arena per network. */
+static OFArray *CDAWiFiBenchmarkNetworks(const CDAWiFiBenchmarkStream *stream, BOOL sharedArena)
+{
+    OFMutableArray *networks = [OFMutableArray arrayWithCapacity:stream->count];
+    CDAWiFiScanArena *arena = sharedArena ? [[CDAWiFiScanArena alloc] init] : nil;
+
+    CDAWiFiBenchmarkStreamEnumerate(stream, ^(const struct nlmsghdr *message) {
+        
+        const struct nlattr *attribute = CDAWiFiBenchmarkBSSAttribute(message);
+        CDAWiFiNetwork *network = attribute ? [[CDAWiFiNetwork alloc] initWithBSSAttribute:attribute noiseMeasurement:-95 arena:arena] : nil;
+        
+        if (network != nil) {
+            [networks addObject:network];
+        }
+    });
+
+    [networks makeImmutable];
+
+    return networks;
+}
+
+typedef struct
+{
+    const uint8_t **elements;
+    uint32_t *lengths;
+    size_t count;
+
+} CDAWiFiBenchmarkElements;
+
+/* Points at the information elements of the networks in their arenas, the way CDAWiFiInterface indexes a scan dump. */
+static CDAWiFiBenchmarkElements CDAWiFiBenchmarkElementsCreate(OFArray *networks)
+{
+    CDAWiFiBenchmarkElements elements;
+
+    elements.elements = malloc(networks.count * sizeof(const uint8_t *));
+    elements.lengths = malloc(networks.count * sizeof(uint32_t));
+    elements.count = 0;
+
+    for (CDAWiFiNetwork *network in networks) {
+        
+        elements.elements[elements.count] = network.informationElements;
+        elements.lengths[elements.count] = (uint32_t)network.informationElementLength;
+        elements.count++;
+    }
+
+    return elements;
+}
+
+static void CDAWiFiBenchmarkElementsDestroy(CDAWiFiBenchmarkElements *elements)
+{
+    free(elements->elements);
+    free(elements->lengths);
+}
+
+static BOOL CDAWiFiBenchmarkIndexesEqual(const CDAWiFiInformationElementIndex *indexes,
+                                         const CDAWiFiInformationElementIndex *otherIndexes,
+                                         size_t count)
+{
+    for (size_t index = 0; index < count; index++) {
+        
+        if (indexes[index].present != otherIndexes[index].present) {
+            return NO;
+        }
+        
+        for (int element = 0; element < CDAWiFiInformationElementCount; element++) {
+            
+            if ((indexes[index].present & (1u << element)) &&
+                indexes[index].offsets[element] != otherIndexes[index].offsets[element]) {
+                
+                return NO;
+            }
+        }
+    }
+
+    return YES;
+}
+
+/* Receives every event, the way a client delegate does. */
+@interface CDAWiFiBenchmarkDelegate : OFObject <CDAWiFiEventDelegate>
+{
+@public
+    size_t _eventCount;
+}
+
+@end
+
+@implementation CDAWiFiBenchmarkDelegate
+
+- (void)clientConnectionInterrupted { _eventCount++; }
+- (void)ssidDidChangeForWiFiInterfaceWithName:(OFString *)interfaceName { _eventCount++; }
+- (void)bssidDidChangeForWiFiInterfaceWithName:(OFString *)interfaceName { _eventCount++; }
+- (void)countryCodeDidChangeForWiFiInterfaceWithName:(OFString *)interfaceName { _eventCount++; }
+- (void)linkDidChangeForWiFiInterfaceWithName:(OFString *)interfaceName { _eventCount++; }
+- (void)modeDidChangeForWiFiInterfaceWithName:(OFString *)interfaceName { _eventCount++; }
+- (void)scanCacheUpdatedForWiFiInterfaceWithName:(OFString *)interfaceName { _eventCount++; }
+
+- (void)linkQualityDidChangeForWiFiInterfaceWithName:(OFString *)interfaceName rssi:(int)rssi transmitRate:(double)transmitRate
+{
+    _eventCount++;
+}
+
+@end
+
+#pragma mark - Benchmarks
+
+static void CDAWiFiBenchmarkUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--scan-dump path] [--events path] [--bss-count count] [--iterations count]\n", program);
+}
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool {
+        
+        const char *scanDumpPath = NULL, *eventsPath = NULL;
+        size_t bssCount = CDAWiFiBenchmarkBSSCount;
+        int iterations = CDAWiFiBenchmarkIterations;
+        
+        for (int index = 1; index < argc; index++) {
+            
+            if (index + 1 >= argc) {
+                
+                CDAWiFiBenchmarkUsage(argv[0]);
+                
+                return EXIT_FAILURE;
+            }
+            
+            if (strcmp(argv[index], "--scan-dump") == 0) {
+                scanDumpPath = argv[++index];
+            } else if (strcmp(argv[index], "--events") == 0) {
+                eventsPath = argv[++index];
+            } else if (strcmp(argv[index], "--bss-count") == 0) {
+                bssCount = strtoul(argv[++index], NULL, 10);
+            } else if (strcmp(argv[index], "--iterations") == 0) {
+                iterations = atoi(argv[++index]);
+            } else {
+                
+                CDAWiFiBenchmarkUsage(argv[0]);
+                
+                return EXIT_FAILURE;
+            }
+        }
+        
+        if (bssCount == 0 || iterations <= 0) {
+            
+            CDAWiFiBenchmarkUsage(argv[0]);
+            
+            return EXIT_FAILURE;
+        }
+        
+        /* Two dumps of the same BSSes, with the RSSI of some of them changed in between. */
+        CDAWiFiBenchmarkStream scanDump = { 0 }, nextScanDump = { 0 }, events = { 0 };
+        
+        if (scanDumpPath != NULL) {
+            
+            if (!CDAWiFiBenchmarkStreamLoad(&scanDump, scanDumpPath)) {
+                
+                fprintf(stderr, "Could not read scan dump %s\n", scanDumpPath);
+                
+                return EXIT_FAILURE;
+            }
+            
+        } else {
+            
+            CDAWiFiBenchmarkStreamAddScanDump(&scanDump, bssCount, 0);
+            CDAWiFiBenchmarkStreamAddScanDump(&nextScanDump, bssCount, 7);
+        }
+        
+        if (eventsPath != NULL) {
+            
+            if (!CDAWiFiBenchmarkStreamLoad(&events, eventsPath)) {
+                
+                fprintf(stderr, "Could not read event stream %s\n", eventsPath);
+                
+                return EXIT_FAILURE;
+            }
+            
+        } else {
+            CDAWiFiBenchmarkStreamAddEvents(&events, CDAWiFiBenchmarkEventCount);
+        }
+        
+        OFArray *networks = CDAWiFiBenchmarkNetworks(&scanDump, YES);
+        OFArray *nextNetworks = (nextScanDump.count > 0) ? CDAWiFiBenchmarkNetworks(&nextScanDump, YES) : networks;
+        
+        if (networks.count == 0) {
+            
+            fprintf(stderr, "The scan dump holds no BSS\n");
+            
+            return EXIT_FAILURE;
+        }
+        
+        CDAWiFiBenchmarkResult results[15];
+        size_t resultCount = 0;
+        
+        /* Information element indexing */
+        
+        CDAWiFiBenchmarkElements elements = CDAWiFiBenchmarkElementsCreate(networks);
+        CDAWiFiInformationElementIndex *scalarIndexes = calloc(elements.count, sizeof(CDAWiFiInformationElementIndex));
+        CDAWiFiInformationElementIndex *indexes = calloc(elements.count, sizeof(CDAWiFiInformationElementIndex));
+        CDAWiFiInformationElementScanner scanner = CDAWiFiInformationElementScannerBest();
+        const char *scannerNames[] = { "scalar", "avx2", "sse2" };
+        const char *scannerName = scannerNames[scanner];
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("information_element_index_scalar", "bss", elements.count, iterations, ^{
+            
+            CDAWiFiInformationElementIndexBuildBatchWithScanner(scalarIndexes, elements.elements, elements.lengths,
+                                                                elements.count, CDAWiFiInformationElementScannerScalar);
+        });
+        
+        /* The AVX2 scanner implies SSE2, which is measured as well. */
+        CDAWiFiInformationElementScanner vectorScanners[] = { CDAWiFiInformationElementScannerSSE2, CDAWiFiInformationElementScannerAVX2 };
+        const char *vectorResultNames[] = { "information_element_index_sse2", "information_element_index_avx2" };
+        
+        for (size_t vectorIndex = 0; vectorIndex < 2 && scanner != CDAWiFiInformationElementScannerScalar; vectorIndex++) {
+            
+            CDAWiFiInformationElementScanner vectorScanner = vectorScanners[vectorIndex];
+            
+            if (vectorScanner == CDAWiFiInformationElementScannerAVX2 && scanner != CDAWiFiInformationElementScannerAVX2) {
+                break;
+            }
+            
+            memset(indexes, 0, elements.count * sizeof(CDAWiFiInformationElementIndex));
+            
+            results[resultCount++] = CDAWiFiBenchmarkMeasure(vectorResultNames[vectorIndex], "bss", elements.count, iterations, ^{
+                
+                CDAWiFiInformationElementIndexBuildBatchWithScanner(indexes, elements.elements, elements.lengths,
+                                                                    elements.count, vectorScanner);
+            });
+            
+            if (!CDAWiFiBenchmarkIndexesEqual(scalarIndexes, indexes, elements.count)) {
+                
+                fprintf(stderr, "Information element indexes built by the %s scanner differ from the scalar ones\n",
+                        scannerNames[vectorScanner]);
+                
+                return EXIT_FAILURE;
+            }
+        }
+        
+        free(scalarIndexes);
+        free(indexes);
+        CDAWiFiBenchmarkElementsDestroy(&elements);
+        
+        /* CDAWiFiNetwork objects, from the BSS attributes of the dump */
+        
+        const CDAWiFiBenchmarkStream *scanDumpStream = &scanDump;
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("network_build", "bss", networks.count, iterations, ^{
+            
+            CDAWiFiBenchmarkNetworks(scanDumpStream, YES);
+        });
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("network_build_unshared", "bss", networks.count, iterations, ^{
+            
+            CDAWiFiBenchmarkNetworks(scanDumpStream, NO);
+        });
+        
+        /* cachedScanResults sets. Synthetic scans alternate between two dumps so every update changes the cache, a recorded dump is diffed against itself. */
+        
+        CDAWiFiScanCache *scanCache = [[CDAWiFiScanCache alloc] init];
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("scan_results_set_build", "scan", 2, iterations, ^{
+            
+            [scanCache updateWithNetworks:networks];
+            [scanCache networks];
+            
+            [scanCache updateWithNetworks:nextNetworks];
+            [scanCache networks];
+        });
+        
+        /* CDAWiFiChannel hashing and equality, through set lookups */
+        
+        OFMutableSet *channelSet = [OFMutableSet set];
+        OFMutableArray *channels = [OFMutableArray array];
+        
+        for (CDAWiFiNetwork *network in networks) {
+            
+            CDAWiFiChannel *channel = network.wlanChannel;
+            
+            if (channel != nil) {
+                
+                [channels addObject:channel];
+                [channelSet addObject:channel];
+            }
+        }
+        
+        for (int channelNumber = 1; channelNumber <= 196; channelNumber++) {
+            
+            for (CDAWiFiChannelWidth width = CDAWiFiChannelWidth20MHz; width <= CDAWiFiChannelWidth160MHz; width++) {
+                
+                [channelSet addObject:[CDAWiFiChannel channelWithChannelNumber:channelNumber
+                                                                  channelWidth:width
+                                                                   channelBand:(channelNumber <= 14) ? CDAWiFiChannelBand2GHz : CDAWiFiChannelBand5GHz]];
+            }
+        }
+        
+        __block size_t channelMatches = 0;
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("channel_set_lookup", "lookup", channels.count, iterations, ^{
+            
+            for (CDAWiFiChannel *channel in channels) {
+                
+                if ([channelSet containsObject:channel]) {
+                    channelMatches++;
+                }
+            }
+        });
+        
+        /* Delegate event dispatch, from nl80211 messages to delegate methods */
+        
+        CDAWiFiBenchmarkDelegate *delegate = [[CDAWiFiBenchmarkDelegate alloc] init];
+        OFString *interfaceName = @"wlan0";
+        
+        CDAWiFiEventEngine *eventEngine = [[CDAWiFiEventEngine alloc] initWithHandler:^(CDAWiFiEventType type, uint32_t interfaceIndex) {
+            
+            switch (type) {
+                
+                case CDAWiFiEventTypeSSIDDidChange:
+                    if ([delegate respondsToSelector:@selector(ssidDidChangeForWiFiInterfaceWithName:)]) {
+                        [delegate ssidDidChangeForWiFiInterfaceWithName:interfaceName];
+                    }
+                    break;
+                
+                case CDAWiFiEventTypeBSSIDDidChange:
+                    if ([delegate respondsToSelector:@selector(bssidDidChangeForWiFiInterfaceWithName:)]) {
+                        [delegate bssidDidChangeForWiFiInterfaceWithName:interfaceName];
+                    }
+                    break;
+                
+                case CDAWiFiEventTypeCountryCodeDidChange:
+                    if ([delegate respondsToSelector:@selector(countryCodeDidChangeForWiFiInterfaceWithName:)]) {
+                        [delegate countryCodeDidChangeForWiFiInterfaceWithName:interfaceName];
+                    }
+                    break;
+                
+                case CDAWiFiEventTypeLinkDidChange:
+                    if ([delegate respondsToSelector:@selector(linkDidChangeForWiFiInterfaceWithName:)]) {
+                        [delegate linkDidChangeForWiFiInterfaceWithName:interfaceName];
+                    }
+                    break;
+                
+                case CDAWiFiEventTypeLinkQualityDidChange:
+                    if ([delegate respondsToSelector:@selector(linkQualityDidChangeForWiFiInterfaceWithName:rssi:transmitRate:)]) {
+                        [delegate linkQualityDidChangeForWiFiInterfaceWithName:interfaceName rssi:-60 transmitRate:144.4];
+                    }
+                    break;
+                
+                case CDAWiFiEventTypeModeDidChange:
+                    if ([delegate respondsToSelector:@selector(modeDidChangeForWiFiInterfaceWithName:)]) {
+                        [delegate modeDidChangeForWiFiInterfaceWithName:interfaceName];
+                    }
+                    break;
+                
+                case CDAWiFiEventTypeScanCacheUpdated:
+                    if ([delegate respondsToSelector:@selector(scanCacheUpdatedForWiFiInterfaceWithName:)]) {
+                        [delegate scanCacheUpdatedForWiFiInterfaceWithName:interfaceName];
+                    }
+                    break;
+                
+                default:
+                    if ([delegate respondsToSelector:@selector(clientConnectionInterrupted)]) {
+                        [delegate clientConnectionInterrupted];
+                    }
+                    break;
+            }
+        }];
+        
+        for (CDAWiFiEventType type = CDAWiFiEventTypePowerDidChange; type <= CDAWiFiEventTypeScanCacheUpdated; type++) {
+            [eventEngine enableEventType:type];
+        }
+        
+        const CDAWiFiBenchmarkStream *eventStream = &events;
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("event_dispatch", "message", events.count, iterations, ^{
+            
+            CDAWiFiBenchmarkStreamEnumerate(eventStream, ^(const struct nlmsghdr *message) {
+                
+                [eventEngine dispatchGenericMessage:message];
+            });
+        });
+        
+        /* WPA Personal key derivation, the IEEE 802.11-2012 M.4 test vector */
+        
+        static const char passphrase[] = "password";
+        static const char ssid[] = "IEEE";
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("pbkdf2_sha1_scalar", "pmk", 1, iterations, ^{
+            
+            uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+            
+            CDAWiFiPBKDF2SHA1WithImplementation(passphrase, strlen(passphrase), ssid, strlen(ssid),
+                                                CDAWiFiPairwiseMasterKeyIterations, key, sizeof(key),
+                                                CDAWiFiSHA1ImplementationScalar);
+        });
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("pbkdf2_sha1_best", "pmk", 1, iterations, ^{
+            
+            uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+            
+            CDAWiFiPBKDF2SHA1(passphrase, strlen(passphrase), ssid, strlen(ssid),
+                              CDAWiFiPairwiseMasterKeyIterations, key, sizeof(key));
+        });
+        
+        /* Reconnections, every key already derived */
+        
+        CDAWiFiPairwiseMasterKeyCache *keyCache = [[CDAWiFiPairwiseMasterKeyCache alloc] init];
+        OFMutableArray *keySSIDs = [OFMutableArray array];
+        OFString *keyPassphrase = @"correct horse battery staple";
+        
+        for (size_t index = 0; index < CDAWiFiPairwiseMasterKeyCacheDefaultCapacity; index++) {
+            
+            OFDataArray *keySSID = [OFDataArray dataArray];
+            OFString *name = [OFString stringWithFormat:@"Network %zu", index];
+            uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+            
+            [keySSID addItems:[name UTF8String] count:[name UTF8StringLength]];
+            [keySSIDs addObject:keySSID];
+            
+            [keyCache getPairwiseMasterKey:key forSSID:keySSID passphrase:keyPassphrase error:NULL];
+        }
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("pmk_cache_hit", "lookup", keySSIDs.count, iterations, ^{
+            
+            uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+            
+            for (OFDataArray *keySSID in keySSIDs) {
+                [keyCache getPairwiseMasterKey:key forSSID:keySSID passphrase:keyPassphrase error:NULL];
+            }
+        });
+        
+        /* Provisioning, one key after another versus a parallel batch. A pass derives every profile key, so there are fewer passes. */
+        
+        CDAWiFiPairwiseMasterKeyDerivation derivations[CDAWiFiBenchmarkProfileCount];
+        int provisioningIterations = iterations / CDAWiFiBenchmarkProfileCount + 1;
+        
+        for (size_t index = 0; index < CDAWiFiBenchmarkProfileCount; index++) {
+            
+            OFDataArray *keySSID = keySSIDs[index];
+            
+            derivations[index].passphrase = [keyPassphrase UTF8String];
+            derivations[index].passphraseLength = [keyPassphrase UTF8StringLength];
+            derivations[index].ssid = keySSID.items;
+            derivations[index].ssidLength = keySSID.count;
+        }
+        
+        CDAWiFiPairwiseMasterKeyDerivation *derivationsPointer = derivations;
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("pmk_provision_sequential", "pmk", CDAWiFiBenchmarkProfileCount, provisioningIterations, ^{
+            
+            for (size_t index = 0; index < CDAWiFiBenchmarkProfileCount; index++) {
+                
+                CDAWiFiPairwiseMasterKeyDerivation *derivation = &derivationsPointer[index];
+                
+                derivation->valid = CDAWiFiPairwiseMasterKeyDerive(derivation->passphrase, derivation->passphraseLength,
+                                                                   derivation->ssid, derivation->ssidLength, derivation->key);
+            }
+        });
+        
+        results[resultCount++] = CDAWiFiBenchmarkMeasure("pmk_provision_batch", "pmk", CDAWiFiBenchmarkProfileCount, provisioningIterations, ^{
+            
+            CDAWiFiPairwiseMasterKeyDeriveBatch(derivationsPointer, CDAWiFiBenchmarkProfileCount);
+        });
+        
+        CDAWiFiBenchmarkPrintResults(results, resultCount, scannerName, networks.count, events.count);
+        
+        CDAWiFiBenchmarkStreamDestroy(&scanDump);
+        CDAWiFiBenchmarkStreamDestroy(&nextScanDump);
+        CDAWiFiBenchmarkStreamDestroy(&events);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+//
+//  CDAWiFiAutoJoinEngineTests.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiNetworkProfile.h"
+#import "CDAWiFiProfileStore.h"
+#import "CDAWiFiAutoJoinEngine.h"
+#import "CDAWiFiAutoJoinEngine+Private.h"
+#import "CDAWiFiSSID.h"
+#import "CDAWiFiTestFixtures.h"
+
+/* Known networks, enough for a filter of 10 bits per profile after rounding up to a power of two. */
+#define CDAWiFiAutoJoinEngineTestsProfileCount 1600
+
+/* Unknown networks tested against the filter. */
+#define CDAWiFiAutoJoinEngineTestsUnknownCount 100000
+
+/* Matching of scan results against known network profiles. */
+@interface CDAWiFiAutoJoinEngineTests : XCTestCase
+
+@end
+
+@implementation CDAWiFiAutoJoinEngineTests
+
+- (void)testFilterFalsePositiveRate
+{
+    CDAWiFiProfileStore *store = [[CDAWiFiProfileStore alloc] initWithContentsOfFile:CDAWiFiTestTemporaryPath(@"profiles-filter")
+                                                                                error:NULL];
+    OFMutableArray *profiles = [OFMutableArray array];
+    char name[32];
+    
+    XCTAssertNotNil(store);
+    
+    for (int index = 0; index < CDAWiFiAutoJoinEngineTestsProfileCount; index++) {
+        
+        CDAWiFiMutableNetworkProfile *profile = [[CDAWiFiMutableNetworkProfile alloc] init];
+        OFDataArray *ssidData = [OFDataArray dataArray];
+        int length = snprintf(name, sizeof(name), "Known%d", index);
+        
+        [ssidData addItems:name count:length];
+        
+        profile.ssidData = ssidData;
+        profile.security = CDAWiFiSecurityWPA2Personal;
+        
+        [profiles addObject:profile];
+    }
+    
+    XCTAssertTrue([store addProfiles:profiles removeProfiles:nil error:NULL]);
+    
+    CDAWiFiAutoJoinEngine *engine = [[CDAWiFiAutoJoinEngine alloc] initWithInterface:nil profileStore:store];
+    
+    XCTAssertTrue([engine updateFilter]);
+    
+    /* Every known SSID passes. */
+    for (int index = 0; index < CDAWiFiAutoJoinEngineTestsProfileCount; index++) {
+        
+        int length = snprintf(name, sizeof(name), "Known%d", index);
+        
+        XCTAssertTrue([engine filterMayContainSSID:[CDAWiFiSSID SSIDWithBytes:(const uint8_t *)name length:length]], @"Profile %d", index);
+    }
+    
+    size_t falsePositives = 0;
+    
+    for (int index = 0; index < CDAWiFiAutoJoinEngineTestsUnknownCount; index++) {
+        
+        @autoreleasepool {
+            
+            int length = snprintf(name, sizeof(name), "Unknown%d", index);
+            
+            if ([engine filterMayContainSSID:[CDAWiFiSSID SSIDWithBytes:(const uint8_t *)name length:length]]) {
+                falsePositives++;
+            }
+        }
+    }
+    
+    /* About 0.7% with 10 bits per profile and 7 probes. */
+    XCTAssertLessThan((double)falsePositives / CDAWiFiAutoJoinEngineTestsUnknownCount, 0.015);
+}
+
+@end
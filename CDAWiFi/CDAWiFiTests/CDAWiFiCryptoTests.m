@@ -0,0 +1,196 @@
+//
+//  CDAWiFiCryptoTests.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiCrypto.h"
+
+/* Decodes a hexadecimal test vector. */
+static void CDAWiFiCryptoTestsDecodeHex(const char *string, uint8_t *bytes, size_t length)
+{
+    for (size_t index = 0; index < length; index++) {
+        
+        unsigned int octet;
+        
+        sscanf(string + index * 2, "%2x", &octet);
+        
+        bytes[index] = (uint8_t)octet;
+    }
+}
+
+/* SHA-1 and the WPA Personal key derivations, against published test vectors. */
+@interface CDAWiFiCryptoTests : XCTestCase
+
+@end
+
+@implementation CDAWiFiCryptoTests
+
+- (void)testSHA1
+{
+    uint8_t digest[CDAWiFiSHA1DigestLength];
+    uint8_t expected[CDAWiFiSHA1DigestLength];
+    
+    /* FIPS 180-2, appendix A.1. */
+    CDAWiFiSHA1("abc", 3, digest);
+    CDAWiFiCryptoTestsDecodeHex("a9993e364706816aba3e25717850c26c9cd0d89d", expected, sizeof(expected));
+    
+    XCTAssertEqual(memcmp(digest, expected, sizeof(digest)), 0);
+    
+    /* RFC 2202, test case 1. */
+    uint8_t key[20];
+    
+    memset(key, 0x0B, sizeof(key));
+    
+    CDAWiFiHMACSHA1(key, sizeof(key), "Hi There", 8, digest);
+    CDAWiFiCryptoTestsDecodeHex("b617318655057264e28bc0b6fb378c8ef146be00", expected, sizeof(expected));
+    
+    XCTAssertEqual(memcmp(digest, expected, sizeof(digest)), 0);
+}
+
+- (void)testPBKDF2SHA1Implementations
+{
+    const CDAWiFiSHA1Implementation implementations[] = {
+        CDAWiFiSHA1ImplementationScalar,
+        CDAWiFiSHA1ImplementationSHANI,
+        CDAWiFiSHA1ImplementationARMv8
+    };
+    uint8_t expected[CDAWiFiSHA1DigestLength];
+    
+    /* RFC 6070, test case 3. Implementations the CPU does not support fall back to the scalar one. */
+    CDAWiFiCryptoTestsDecodeHex("4b007901b765489abead49d926f721d065a429c1", expected, sizeof(expected));
+    
+    for (size_t index = 0; index < sizeof(implementations) / sizeof(implementations[0]); index++) {
+        
+        uint8_t key[CDAWiFiSHA1DigestLength];
+        
+        CDAWiFiPBKDF2SHA1WithImplementation("password", 8, "salt", 4, 4096, key, sizeof(key), implementations[index]);
+        
+        XCTAssertEqual(memcmp(key, expected, sizeof(key)), 0, @"Implementation %d", implementations[index]);
+    }
+    
+    /* RFC 6070, test case 1. */
+    uint8_t key[CDAWiFiSHA1DigestLength];
+    
+    CDAWiFiPBKDF2SHA1("password", 8, "salt", 4, 1, key, sizeof(key));
+    CDAWiFiCryptoTestsDecodeHex("0c60c80f961f0e71f3a9b524af6012062fe037a6", expected, sizeof(expected));
+    
+    XCTAssertEqual(memcmp(key, expected, sizeof(key)), 0);
+}
+
+- (void)testPairwiseMasterKey
+{
+    uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+    uint8_t expected[CDAWiFiPairwiseMasterKeyLength];
+    
+    /* IEEE 802.11-2012, M.4.2. */
+    XCTAssertTrue(CDAWiFiPairwiseMasterKeyDerive("password", 8, (const uint8_t *)"IEEE", 4, key));
+    CDAWiFiCryptoTestsDecodeHex("f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e", expected, sizeof(expected));
+    
+    XCTAssertEqual(memcmp(key, expected, sizeof(key)), 0);
+    
+    XCTAssertTrue(CDAWiFiPairwiseMasterKeyDerive("ThisIsAPassword", 15, (const uint8_t *)"ThisIsASSID", 11, key));
+    CDAWiFiCryptoTestsDecodeHex("0dc0d6eb90555ed6419756b9a15ec3e3209b63df707dd508d14581f8982721af", expected, sizeof(expected));
+    
+    XCTAssertEqual(memcmp(key, expected, sizeof(key)), 0);
+    
+    /* Passphrases are 8 to 63 characters, SSIDs 1 to 32 octets. */
+    XCTAssertFalse(CDAWiFiPairwiseMasterKeyDerive("short", 5, (const uint8_t *)"IEEE", 4, key));
+    XCTAssertFalse(CDAWiFiPairwiseMasterKeyDerive("password", 8, (const uint8_t *)"IEEE", 0, key));
+}
+
+- (void)testPairwiseMasterKeyIdentifier
+{
+    const uint8_t authenticatorAddress[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    const uint8_t supplicantAddress[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+    uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+    uint8_t identifier[CDAWiFiPairwiseMasterKeyIdentifierLength];
+    uint8_t expected[CDAWiFiPairwiseMasterKeyIdentifierLength];
+    
+    CDAWiFiCryptoTestsDecodeHex("f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e", key, sizeof(key));
+    
+    /* HMAC-SHA1-128(PMK, "PMK Name" || AA || SPA). */
+    CDAWiFiPairwiseMasterKeyIdentifierDerive(key, authenticatorAddress, supplicantAddress, identifier);
+    CDAWiFiCryptoTestsDecodeHex("3e07270d0746b999db1bec32482841f1", expected, sizeof(expected));
+    
+    XCTAssertEqual(memcmp(identifier, expected, sizeof(identifier)), 0);
+}
+
+- (void)testPairwiseMasterKeyBatch
+{
+    /* More keys than lanes in a group, so several groups run, the last one partly filled. */
+    enum { CDAWiFiCryptoTestsBatchCount = 19 };
+    CDAWiFiPairwiseMasterKeyDerivation derivations[CDAWiFiCryptoTestsBatchCount];
+    char passphrases[CDAWiFiCryptoTestsBatchCount][32];
+    char ssids[CDAWiFiCryptoTestsBatchCount][16];
+    uint8_t expected[CDAWiFiPairwiseMasterKeyLength];
+    
+    memset(derivations, 0, sizeof(derivations));
+    
+    for (size_t index = 0; index < CDAWiFiCryptoTestsBatchCount; index++) {
+        
+        snprintf(passphrases[index], sizeof(passphrases[index]), "passphrase%03zu", index);
+        snprintf(ssids[index], sizeof(ssids[index]), "Network%zu", index);
+        
+        derivations[index].passphrase = passphrases[index];
+        derivations[index].passphraseLength = strlen(passphrases[index]);
+        derivations[index].ssid = (const uint8_t *)ssids[index];
+        derivations[index].ssidLength = strlen(ssids[index]);
+    }
+    
+    /* IEEE 802.11-2012, M.4.2, a raw PSK and an invalid passphrase among the others. */
+    derivations[0].passphrase = "password";
+    derivations[0].passphraseLength = 8;
+    derivations[0].ssid = (const uint8_t *)"IEEE";
+    derivations[0].ssidLength = 4;
+    
+    derivations[9].passphrase = "ThisIsAPassword";
+    derivations[9].passphraseLength = 15;
+    derivations[9].ssid = (const uint8_t *)"ThisIsASSID";
+    derivations[9].ssidLength = 11;
+    
+    derivations[5].passphrase = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+    derivations[5].passphraseLength = 64;
+    
+    derivations[3].passphraseLength = 3;
+    
+    CDAWiFiPairwiseMasterKeyDeriveBatch(derivations, CDAWiFiCryptoTestsBatchCount);
+    
+    CDAWiFiCryptoTestsDecodeHex("f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e", expected, sizeof(expected));
+    
+    XCTAssertTrue(derivations[0].valid);
+    XCTAssertEqual(memcmp(derivations[0].key, expected, sizeof(expected)), 0);
+    
+    CDAWiFiCryptoTestsDecodeHex("0dc0d6eb90555ed6419756b9a15ec3e3209b63df707dd508d14581f8982721af", expected, sizeof(expected));
+    
+    XCTAssertTrue(derivations[9].valid);
+    XCTAssertEqual(memcmp(derivations[9].key, expected, sizeof(expected)), 0);
+    
+    CDAWiFiCryptoTestsDecodeHex(derivations[5].passphrase, expected, sizeof(expected));
+    
+    XCTAssertTrue(derivations[5].valid);
+    XCTAssertEqual(memcmp(derivations[5].key, expected, sizeof(expected)), 0);
+    
+    XCTAssertFalse(derivations[3].valid);
+    
+    /* Every lane agrees with the single key derivation. */
+    for (size_t index = 0; index < CDAWiFiCryptoTestsBatchCount; index++) {
+        
+        uint8_t key[CDAWiFiPairwiseMasterKeyLength];
+        BOOL valid = CDAWiFiPairwiseMasterKeyDerive(derivations[index].passphrase, derivations[index].passphraseLength,
+                                                    derivations[index].ssid, derivations[index].ssidLength, key);
+        
+        XCTAssertEqual(derivations[index].valid, valid, @"Derivation %zu", index);
+        
+        if (valid) {
+            XCTAssertEqual(memcmp(derivations[index].key, key, sizeof(key)), 0, @"Derivation %zu", index);
+        }
+    }
+}
+
+@end
@@ -0,0 +1,95 @@
+//
+//  CDAWiFiProfileStoreTests.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiNetworkProfile.h"
+#import "CDAWiFiProfileStore.h"
+#import "CDAWiFiTestFixtures.h"
+#include <string.h>
+#include <unistd.h>
+
+static OFDataArray *CDAWiFiProfileStoreTestsSSID(const char *ssid)
+{
+    OFDataArray *data = [OFDataArray dataArray];
+    
+    [data addItems:ssid count:strlen(ssid)];
+    
+    return data;
+}
+
+static CDAWiFiNetworkProfile *CDAWiFiProfileStoreTestsProfile(const char *ssid, CDAWiFiSecurity security)
+{
+    CDAWiFiMutableNetworkProfile *profile = [[CDAWiFiMutableNetworkProfile alloc] init];
+    
+    profile.ssidData = CDAWiFiProfileStoreTestsSSID(ssid);
+    profile.security = security;
+    
+    return profile;
+}
+
+/* Persistence of known network profiles. */
+@interface CDAWiFiProfileStoreTests : XCTestCase
+
+@end
+
+@implementation CDAWiFiProfileStoreTests
+
+- (void)testRoundTrip
+{
+    OFString *path = CDAWiFiTestTemporaryPath(@"profiles");
+    CDAWiFiProfileStore *store = [[CDAWiFiProfileStore alloc] initWithContentsOfFile:path error:NULL];
+    
+    XCTAssertNotNil(store);
+    XCTAssertEqual(store.count, (size_t)0);
+    
+    OFArray *profiles = [OFArray arrayWithObjects:
+                         CDAWiFiProfileStoreTestsProfile("Home", CDAWiFiSecurityWPA2Personal),
+                         CDAWiFiProfileStoreTestsProfile("Home", CDAWiFiSecurityNone),
+                         CDAWiFiProfileStoreTestsProfile("Office", CDAWiFiSecurityWPA2Personal),
+                         CDAWiFiProfileStoreTestsProfile("Cafe", CDAWiFiSecurityNone), nil];
+    
+    XCTAssertTrue([store addProfiles:profiles removeProfiles:nil error:NULL]);
+    XCTAssertTrue([store removeProfile:CDAWiFiProfileStoreTestsProfile("Cafe", CDAWiFiSecurityNone) error:NULL]);
+    
+    /* The key is the SSID and the security type, the open Home network is another profile. */
+    XCTAssertTrue([store removeProfile:CDAWiFiProfileStoreTestsProfile("Home", CDAWiFiSecurityNone) error:NULL]);
+    XCTAssertEqual(store.count, (size_t)2);
+    
+    /* Nothing but the store file is left. */
+    XCTAssertNotEqual(access([[path stringByAppendingString:@".tmp"] UTF8String], F_OK), 0);
+    
+    store = [[CDAWiFiProfileStore alloc] initWithContentsOfFile:path error:NULL];
+    
+    XCTAssertNotNil(store);
+    XCTAssertEqual(store.count, (size_t)2);
+    XCTAssertTrue([store containsProfileWithSSIDData:CDAWiFiProfileStoreTestsSSID("Home") security:CDAWiFiSecurityWPA2Personal]);
+    XCTAssertTrue([store containsProfileWithSSIDData:CDAWiFiProfileStoreTestsSSID("Office") security:CDAWiFiSecurityWPA2Personal]);
+    XCTAssertFalse([store containsProfileWithSSIDData:CDAWiFiProfileStoreTestsSSID("Home") security:CDAWiFiSecurityNone]);
+    XCTAssertFalse([store containsProfileWithSSIDData:CDAWiFiProfileStoreTestsSSID("Cafe") security:CDAWiFiSecurityNone]);
+    
+    CDAWiFiNetworkProfile *profile = [store profileWithSSIDData:CDAWiFiProfileStoreTestsSSID("Office") security:CDAWiFiSecurityWPA2Personal];
+    
+    XCTAssertTrue([profile isEqualToNetworkProfile:profiles[2]]);
+    XCTAssertEqual(store.profiles.count, (size_t)2);
+}
+
+- (void)testRejectsInvalidFile
+{
+    OFString *path = CDAWiFiTestTemporaryPath(@"profiles-invalid");
+    OFDataArray *data = CDAWiFiProfileStoreTestsSSID("not a profile store, but long enough to hold a header");
+    CDAError *error = nil;
+    
+    [data writeToFile:path];
+    
+    XCTAssertNil([[CDAWiFiProfileStore alloc] initWithContentsOfFile:path error:&error]);
+    XCTAssertEqual((long)error.code, (long)CDAWiFiInvalidFormatError);
+}
+
+@end
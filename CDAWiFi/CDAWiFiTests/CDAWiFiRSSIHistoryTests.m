@@ -0,0 +1,79 @@
+//
+//  CDAWiFiRSSIHistoryTests.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiRSSIHistory.h"
+#import "CDAWiFiTestFixtures.h"
+
+/* Recording of signal samples from scan dumps. */
+@interface CDAWiFiRSSIHistoryTests : XCTestCase
+
+@end
+
+@implementation CDAWiFiRSSIHistoryTests
+
+- (void)testRecordsScanResultOncePerReception
+{
+    CDAWiFiRSSIHistory *history = [[CDAWiFiRSSIHistory alloc] initWithContentsOfFile:CDAWiFiTestTemporaryPath(@"history")
+                                                                             capacity:16
+                                                                                error:NULL];
+    CDAWiFiNetwork *network = CDAWiFiTestNetwork(0x020000000301ULL, "Home", 2412, -60, 5000, CDAWiFiTestSecurityNone, nil);
+    CDAWiFiRSSISample samples[4];
+    double now = [[OFDate date] timeIntervalSince1970];
+    
+    XCTAssertNotNil(history);
+    
+    /* The kernel reports the BSS in every dump until it expires. */
+    [history addSamplesWithNetworks:[OFArray arrayWithObject:network]];
+    [history addSamplesWithNetworks:[OFArray arrayWithObject:network]];
+    
+    network = CDAWiFiTestNetwork(0x020000000301ULL, "Home", 2412, -70, 0, CDAWiFiTestSecurityNone, nil);
+    
+    [history addSamplesWithNetworks:[OFArray arrayWithObject:network]];
+    
+    size_t count = [history getSamples:samples maximumCount:4 forBSSID:0x020000000301ULL startTimestamp:0 endTimestamp:now + 60];
+    
+    /* Stamped with when the BSS was heard, not when the dump was read. */
+    XCTAssertEqual(count, (size_t)2);
+    XCTAssertEqualWithAccuracy(samples[0].timestamp, now - 5, 0.5);
+    XCTAssertEqual(samples[0].rssiValue, -60);
+    XCTAssertEqualWithAccuracy(samples[1].timestamp, now, 0.5);
+    XCTAssertEqual(samples[1].rssiValue, -70);
+}
+
+- (void)testKeepsSegmentCount
+{
+    OFString *path = CDAWiFiTestTemporaryPath(@"history-segments");
+    CDAWiFiRSSIHistory *history = [[CDAWiFiRSSIHistory alloc] initWithContentsOfFile:path capacity:4 segmentCount:16 error:NULL];
+    CDAWiFiRSSISample sample = { .timestamp = 1000, .rssiValue = -50, .noiseMeasurement = -95 };
+    CDAWiFiRSSISample samples[1024];
+    
+    XCTAssertEqual(history.segmentCount, (size_t)16);
+    
+    /* Far more samples than the default segment count holds. */
+    for (int index = 0; index < 1000; index++) {
+        
+        sample.timestamp += 0.1;
+        sample.rssiValue = (index % 2) ? -50 : -60;
+        
+        [history addSample:sample forBSSID:0x020000000302ULL];
+    }
+    
+    XCTAssertEqual([history getSamples:samples maximumCount:1024 forBSSID:0x020000000302ULL startTimestamp:0 endTimestamp:sample.timestamp], (size_t)1000);
+    
+    history = nil;
+    
+    /* A store is reopened with the layout it was created with. */
+    XCTAssertNil([[CDAWiFiRSSIHistory alloc] initWithContentsOfFile:path capacity:4 error:NULL]);
+    XCTAssertNotNil([[CDAWiFiRSSIHistory alloc] initWithContentsOfFile:path capacity:4 segmentCount:16 error:NULL]);
+}
+
+@end
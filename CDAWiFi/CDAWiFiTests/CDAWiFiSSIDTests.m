@@ -0,0 +1,66 @@
+//
+//  CDAWiFiSSIDTests.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiSSID.h"
+
+/* Interning of SSID octets. */
+@interface CDAWiFiSSIDTests : XCTestCase
+
+@end
+
+@implementation CDAWiFiSSIDTests
+
+- (void)testInternsEverySSIDInUse
+{
+    OFMutableArray *ssids = [OFMutableArray array];
+    char name[16];
+    
+    /* More distinct SSIDs than any fixed cap, all alive at once. */
+    for (int index = 0; index < 10000; index++) {
+        
+        int length = snprintf(name, sizeof(name), "Network%d", index);
+        
+        [ssids addObject:[CDAWiFiSSID SSIDWithBytes:(const uint8_t *)name length:length]];
+    }
+    
+    for (int index = 0; index < 10000; index += 999) {
+        
+        int length = snprintf(name, sizeof(name), "Network%d", index);
+        
+        XCTAssertEqual([CDAWiFiSSID SSIDWithBytes:(const uint8_t *)name length:length], ssids[index]);
+    }
+}
+
+- (void)testReleasesSSIDNoLongerInUse
+{
+    __weak CDAWiFiSSID *weakSSID = nil;
+    
+    @autoreleasepool {
+        
+        CDAWiFiSSID *ssid = [CDAWiFiSSID SSIDWithBytes:(const uint8_t *)"Transient" length:9];
+        
+        weakSSID = ssid;
+        
+        XCTAssertEqual([CDAWiFiSSID SSIDWithBytes:(const uint8_t *)"Transient" length:9], ssid);
+    }
+    
+    /* The table does not keep it alive. */
+    XCTAssertNil(weakSSID);
+    
+    /* Interned again from scratch, and shared again. */
+    CDAWiFiSSID *ssid = [CDAWiFiSSID SSIDWithBytes:(const uint8_t *)"Transient" length:9];
+    
+    XCTAssertNotNil(ssid);
+    XCTAssertEqual([CDAWiFiSSID SSIDWithBytes:(const uint8_t *)"Transient" length:9], ssid);
+    XCTAssertEqualObjects(ssid.string, @"Transient");
+}
+
+@end
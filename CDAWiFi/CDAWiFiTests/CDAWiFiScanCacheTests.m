@@ -0,0 +1,137 @@
+//
+//  CDAWiFiScanCacheTests.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiScanCache.h"
+#import "CDAWiFiScanCacheChanges.h"
+#import "CDAWiFiScanArena.h"
+#import "CDAWiFiUtilities.h"
+#import "CDAWiFiTestFixtures.h"
+
+/* Merging of scan dumps into the scan cache. */
+@interface CDAWiFiScanCacheTests : XCTestCase
+
+@end
+
+@implementation CDAWiFiScanCacheTests
+
+- (void)testReportsAddedAndChangedNetworks
+{
+    CDAWiFiScanCache *cache = [[CDAWiFiScanCache alloc] init];
+    CDAWiFiNetwork *network = CDAWiFiTestNetwork(0x020000000201ULL, "Home", 2412, -60, 0, CDAWiFiTestSecurityNone, nil);
+    
+    CDAWiFiScanCacheChanges *changes = [cache updateWithNetworks:[OFArray arrayWithObject:network]];
+    
+    XCTAssertEqual(changes.generation, (uint64_t)1);
+    XCTAssertEqual(changes.addedNetworks.count, (size_t)1);
+    
+    /* Within the RSSI tolerance, nothing changed. */
+    network = CDAWiFiTestNetwork(0x020000000201ULL, "Home", 2412, -61, 0, CDAWiFiTestSecurityNone, nil);
+    changes = [cache updateWithNetworks:[OFArray arrayWithObject:network]];
+    
+    XCTAssertEqual(changes.generation, (uint64_t)1);
+    XCTAssertEqual(changes.changedNetworks.count, (size_t)0);
+    
+    network = CDAWiFiTestNetwork(0x020000000201ULL, "Home", 2412, -75, 0, CDAWiFiTestSecurityNone, nil);
+    changes = [cache updateWithNetworks:[OFArray arrayWithObject:network]];
+    
+    XCTAssertEqual(changes.generation, (uint64_t)2);
+    XCTAssertEqual(changes.changedNetworks.count, (size_t)1);
+    XCTAssertEqual([cache networkWithBSSID:0x020000000201ULL lastSeen:NULL].rssiValue, -75);
+}
+
+- (void)testRefreshesAfterUpdateWithoutChanges
+{
+    CDAWiFiScanCache *cache = [[CDAWiFiScanCache alloc] init];
+    CDAWiFiNetwork *network = CDAWiFiTestNetwork(0x020000000202ULL, "Home", 2412, -60, 10000, CDAWiFiTestSecurityNone, nil);
+    double lastSeen = 0;
+    
+    [cache updateWithNetworks:[OFArray arrayWithObject:network]];
+    [cache updateWithNetworks:[OFArray arrayWithObject:network]];
+    
+    /* The update that changed nothing left the generation as is, the BSS heard again must still be refreshed. */
+    network = CDAWiFiTestNetwork(0x020000000202ULL, "Home", 2412, -60, 0, CDAWiFiTestSecurityNone, nil);
+    
+    [cache updateWithNetworks:[OFArray arrayWithObject:network]];
+    
+    XCTAssertNotNil([cache networkWithBSSID:0x020000000202ULL lastSeen:&lastSeen]);
+    XCTAssertEqualWithAccuracy(lastSeen, CDAWiFiMonotonicTime(), 0.5);
+}
+
+- (void)testKeepsFirstReportOfBSS
+{
+    CDAWiFiScanCache *cache = [[CDAWiFiScanCache alloc] init];
+    CDAWiFiNetwork *first = CDAWiFiTestNetwork(0x020000000203ULL, "Home", 2412, -60, 0, CDAWiFiTestSecurityNone, nil);
+    CDAWiFiNetwork *second = CDAWiFiTestNetwork(0x020000000203ULL, "Home", 2417, -80, 0, CDAWiFiTestSecurityNone, nil);
+    
+    CDAWiFiScanCacheChanges *changes = [cache updateWithNetworks:[OFArray arrayWithObjects:first, second, nil]];
+    
+    XCTAssertEqual(changes.addedNetworks.count, (size_t)1);
+    XCTAssertEqual([cache networkWithBSSID:0x020000000203ULL lastSeen:NULL], first);
+}
+
+- (void)testExpiresNetworksNotHeardAgain
+{
+    CDAWiFiScanCache *cache = [[CDAWiFiScanCache alloc] init];
+    
+    cache.maximumAge = 2;
+    
+    [cache updateWithNetworks:[OFArray arrayWithObject:CDAWiFiTestNetwork(0x020000000204ULL, "Home", 2412, -60, 1500, CDAWiFiTestSecurityNone, nil)]];
+    
+    XCTAssertEqual(cache.networks.count, (size_t)1);
+    
+    /* Too old to be merged. */
+    CDAWiFiScanCacheChanges *changes = [cache updateWithNetworks:[OFArray arrayWithObject:CDAWiFiTestNetwork(0x020000000205ULL, "Old", 2412, -60, 5000, CDAWiFiTestSecurityNone, nil)]];
+    
+    XCTAssertEqual(changes.addedNetworks.count, (size_t)0);
+    
+    [OFThread sleepForTimeInterval:2];
+    
+    changes = [cache changesSinceGeneration:1];
+    
+    XCTAssertEqual(changes.removedNetworks.count, (size_t)1);
+    XCTAssertEqual(cache.networks.count, (size_t)0);
+}
+
+- (void)testRefreshesNetworkDueInSameUpdate
+{
+    CDAWiFiScanCache *cache = [[CDAWiFiScanCache alloc] init];
+    
+    cache.maximumAge = 2;
+    
+    [cache updateWithNetworks:[OFArray arrayWithObject:CDAWiFiTestNetwork(0x020000000206ULL, "Home", 2412, -60, 1500, CDAWiFiTestSecurityNone, nil)]];
+    
+    [OFThread sleepForTimeInterval:2];
+    
+    /* Due by now, but heard again: neither removed nor added back. */
+    CDAWiFiScanCacheChanges *changes = [cache updateWithNetworks:[OFArray arrayWithObject:CDAWiFiTestNetwork(0x020000000206ULL, "Home", 2412, -60, 0, CDAWiFiTestSecurityNone, nil)]];
+    
+    XCTAssertEqual(changes.removedNetworks.count, (size_t)0);
+    XCTAssertEqual(changes.addedNetworks.count, (size_t)0);
+    XCTAssertEqual(cache.networks.count, (size_t)1);
+}
+
+- (void)testKeepsNewestResultOfUnchangedNetwork
+{
+    CDAWiFiScanCache *cache = [[CDAWiFiScanCache alloc] init];
+    CDAWiFiNetwork *first = CDAWiFiTestNetwork(0x020000000207ULL, "Home", 2412, -60, 0, CDAWiFiTestSecurityNone, [[CDAWiFiScanArena alloc] init]);
+    CDAWiFiNetwork *second = CDAWiFiTestNetwork(0x020000000207ULL, "Home", 2412, -60, 0, CDAWiFiTestSecurityNone, [[CDAWiFiScanArena alloc] init]);
+    
+    [cache updateWithNetworks:[OFArray arrayWithObject:first]];
+    
+    CDAWiFiScanCacheChanges *changes = [cache updateWithNetworks:[OFArray arrayWithObject:second]];
+    
+    /* Not a change, but the first result, and the arena of its dump, are released. */
+    XCTAssertEqual(changes.changedNetworks.count, (size_t)0);
+    XCTAssertEqual([cache networkWithBSSID:0x020000000207ULL lastSeen:NULL], second);
+}
+
+@end
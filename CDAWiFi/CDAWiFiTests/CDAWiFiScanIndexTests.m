@@ -0,0 +1,217 @@
+//
+//  CDAWiFiScanIndexTests.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiScanIndex.h"
+#import "CDAWiFiScanQuery.h"
+#import "CDAWiFiTestFixtures.h"
+#include <string.h>
+#include <limits.h>
+
+/* The BSSIDs of the results, in their order, for comparisons. */
+static OFArray *CDAWiFiScanIndexTestsBSSIDs(OFArray *networks)
+{
+    OFMutableArray *bssids = [OFMutableArray array];
+    
+    for (CDAWiFiNetwork *network in networks) {
+        [bssids addObject:[OFNumber numberWithUInt64:network.bssidValue]];
+    }
+    
+    return bssids;
+}
+
+static OFArray *CDAWiFiScanIndexTestsExpectedBSSIDs(size_t count, const CDAWiFiMACAddress *bssids)
+{
+    OFMutableArray *expected = [OFMutableArray array];
+    
+    for (size_t index = 0; index < count; index++) {
+        [expected addObject:[OFNumber numberWithUInt64:bssids[index]]];
+    }
+    
+    return expected;
+}
+
+#define CDAWiFiScanIndexTestsAssertResults(networks, ...) \
+    do { \
+        const CDAWiFiMACAddress expected[] = { __VA_ARGS__ }; \
+        XCTAssertEqualObjects(CDAWiFiScanIndexTestsBSSIDs(networks), \
+                              CDAWiFiScanIndexTestsExpectedBSSIDs(sizeof(expected) / sizeof(expected[0]), expected)); \
+    } while (0)
+
+static OFDataArray *CDAWiFiScanIndexTestsSSID(const char *ssid)
+{
+    OFDataArray *data = [OFDataArray dataArray];
+    
+    [data addItems:ssid count:strlen(ssid)];
+    
+    return data;
+}
+
+/* Queries over the secondary indexes of the scan cache. */
+@interface CDAWiFiScanIndexTests : XCTestCase
+
+@end
+
+@implementation CDAWiFiScanIndexTests
+{
+    CDAWiFiScanIndex *_index;
+    uint32_t _rows[6];
+}
+
+- (void)setUp
+{
+    [super setUp];
+    
+    _index = [[CDAWiFiScanIndex alloc] init];
+    
+    _rows[0] = [_index addNetwork:CDAWiFiTestNetwork(0x020000000401ULL, "Home", 2412, -50, 0, CDAWiFiTestSecurityWPA2Personal, nil)];
+    _rows[1] = [_index addNetwork:CDAWiFiTestNetwork(0x020000000402ULL, "Home", 5180, -60, 0, CDAWiFiTestSecurityWPA2Personal, nil)];
+    _rows[2] = [_index addNetwork:CDAWiFiTestNetwork(0x020000000403ULL, "Cafe", 5180, -70, 0, CDAWiFiTestSecurityNone, nil)];
+    _rows[3] = [_index addNetwork:CDAWiFiTestNetwork(0x020000000404ULL, "Office", 5200, -55, 0, CDAWiFiTestSecurityWPA2Personal, nil)];
+    _rows[4] = [_index addNetwork:CDAWiFiTestNetwork(0x020000000405ULL, "Office", 5180, -85, 0, CDAWiFiTestSecurityWPA2Personal, nil)];
+    _rows[5] = [_index addNetwork:CDAWiFiTestNetwork(0x020000000406ULL, "Lab", 2412, -40, 0, CDAWiFiTestSecurityNone, nil)];
+}
+
+- (void)testFiltersByBandSecurityAndRSSI
+{
+    CDAWiFiScanQuery *query = [CDAWiFiScanQuery query];
+    
+    query.channelBand = CDAWiFiChannelBand5GHz;
+    query.security = CDAWiFiSecurityWPA2Personal;
+    query.minimumRSSI = -80;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000404ULL, 0x020000000402ULL);
+    
+    /* Both bounds are inclusive. */
+    query.minimumRSSI = -60;
+    query.maximumRSSI = -56;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000402ULL);
+    
+    query.channelBand = CDAWiFiChannelBand2GHz;
+    query.security = CDAWiFiSecurityNone;
+    query.minimumRSSI = INT_MIN;
+    query.maximumRSSI = INT_MAX;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000406ULL);
+    
+    /* Bounds in the wrong order match nothing. */
+    query.minimumRSSI = -40;
+    query.maximumRSSI = -50;
+    
+    XCTAssertEqual([_index networksMatchingQuery:query].count, (size_t)0);
+}
+
+- (void)testFiltersByChannelWithoutBand
+{
+    CDAWiFiScanQuery *query = [CDAWiFiScanQuery query];
+    
+    /* Every band is searched for the channel number. */
+    query.channelNumber = 36;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000402ULL, 0x020000000403ULL, 0x020000000405ULL);
+    
+    query.channelNumber = 1;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000406ULL, 0x020000000401ULL);
+    
+    /* A channel no network uses yet. */
+    query.channelNumber = 11;
+    
+    XCTAssertEqual([_index networksMatchingQuery:query].count, (size_t)0);
+    
+    query.channelNumber = 36;
+    query.channelBand = CDAWiFiChannelBand2GHz;
+    
+    XCTAssertEqual([_index networksMatchingQuery:query].count, (size_t)0);
+    
+    query.channelBand = CDAWiFiChannelBand5GHz;
+    query.security = CDAWiFiSecurityNone;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000403ULL);
+}
+
+- (void)testFindsSSIDAfterRowReuse
+{
+    CDAWiFiScanQuery *query = [CDAWiFiScanQuery query];
+    
+    [_index removeNetworkAtRow:_rows[0]];
+    
+    /* The freed row is reused by the next network. */
+    uint32_t row = [_index addNetwork:CDAWiFiTestNetwork(0x020000000407ULL, "Guest", 2437, -65, 0, CDAWiFiTestSecurityNone, nil)];
+    
+    XCTAssertEqual(row, _rows[0]);
+    
+    query.ssidData = CDAWiFiScanIndexTestsSSID("Home");
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000402ULL);
+    
+    query.ssidData = CDAWiFiScanIndexTestsSSID("Guest");
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000407ULL);
+    
+    /* The row of a BSS that changed its SSID moves to the new list. */
+    [_index replaceNetworkAtRow:_rows[1] withNetwork:CDAWiFiTestNetwork(0x020000000402ULL, "Guest", 5180, -60, 0, CDAWiFiTestSecurityNone, nil)];
+    
+    query.ssidData = CDAWiFiScanIndexTestsSSID("Home");
+    
+    XCTAssertEqual([_index networksMatchingQuery:query].count, (size_t)0);
+    
+    query.ssidData = CDAWiFiScanIndexTestsSSID("Guest");
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000402ULL, 0x020000000407ULL);
+    
+    /* And out of the security bitmap it left. */
+    query.security = CDAWiFiSecurityWPA2Personal;
+    
+    XCTAssertEqual([_index networksMatchingQuery:query].count, (size_t)0);
+    
+    /* A change of RSSI alone reorders the results. */
+    query.security = CDAWiFiSecurityUnknown;
+    
+    [_index replaceNetworkAtRow:row withNetwork:CDAWiFiTestNetwork(0x020000000407ULL, "Guest", 2437, -45, 0, CDAWiFiTestSecurityNone, nil)];
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000407ULL, 0x020000000402ULL);
+}
+
+- (void)testSortOrdersWithMaximumCount
+{
+    CDAWiFiScanQuery *query = [CDAWiFiScanQuery query];
+    
+    query.maximumCount = 3;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000406ULL, 0x020000000401ULL, 0x020000000404ULL);
+    
+    /* By SSID octets, then strongest first. */
+    query.sortOrder = CDAWiFiScanQuerySortOrderSSID;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query], 0x020000000403ULL, 0x020000000401ULL, 0x020000000402ULL);
+    
+    /* By band and channel number, then strongest first. */
+    query.sortOrder = CDAWiFiScanQuerySortOrderChannel;
+    query.maximumCount = 4;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query],
+                                       0x020000000406ULL, 0x020000000401ULL, 0x020000000402ULL, 0x020000000403ULL);
+    
+    /* Every match when the maximum is larger than the results, or 0. */
+    query.maximumCount = 100;
+    
+    XCTAssertEqual([_index networksMatchingQuery:query].count, (size_t)6);
+    
+    query.maximumCount = 0;
+    
+    CDAWiFiScanIndexTestsAssertResults([_index networksMatchingQuery:query],
+                                       0x020000000406ULL, 0x020000000401ULL, 0x020000000402ULL, 0x020000000403ULL,
+                                       0x020000000405ULL, 0x020000000404ULL);
+}
+
+@end
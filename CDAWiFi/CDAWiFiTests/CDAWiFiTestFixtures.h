@@ -0,0 +1,28 @@
+//
+//  CDAWiFiTestFixtures.h
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiTypes.h"
+
+@class CDAWiFiNetwork, CDAWiFiScanArena;
+
+/* Security advertised by a synthetic BSS. */
+typedef enum {
+    CDAWiFiTestSecurityNone,
+    CDAWiFiTestSecurityWPA2Personal
+} CDAWiFiTestSecurity;
+
+/*
+ * Decodes a network from a synthetic NL80211_CMD_NEW_SCAN_RESULTS message, the way a scan dump is decoded.
+ * A NULL ssid advertises no SSID element.
+ */
+extern CDAWiFiNetwork *CDAWiFiTestNetwork(CDAWiFiMACAddress bssid, const char *ssid, uint32_t frequency, int rssi,
+                                          uint32_t seenMillisecondsAgo, CDAWiFiTestSecurity security, CDAWiFiScanArena *arena);
+
+/* Returns a path for a file of the test, removing what a previous run left there. */
+extern OFString *CDAWiFiTestTemporaryPath(OFString *name);
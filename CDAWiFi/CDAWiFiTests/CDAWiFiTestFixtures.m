@@ -0,0 +1,79 @@
+//
+//  CDAWiFiTestFixtures.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import "CDAWiFiTestFixtures.h"
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiNetlink.h"
+#import "CDAWiFiUtilities.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* RSN element of a CCMP, PSK network. */
+static const uint8_t CDAWiFiTestRSNElement[] = {
+    48, 20, 0x01, 0x00, 0x00, 0x0F, 0xAC, 0x04, 0x01, 0x00, 0x00, 0x0F, 0xAC, 0x04, 0x01, 0x00, 0x00, 0x0F, 0xAC, 0x02, 0x00, 0x00
+};
+
+CDAWiFiNetwork *CDAWiFiTestNetwork(CDAWiFiMACAddress bssid, const char *ssid, uint32_t frequency, int rssi,
+                                   uint32_t seenMillisecondsAgo, CDAWiFiTestSecurity security, CDAWiFiScanArena *arena)
+{
+    CDAWiFiNetlinkMessage message;
+    uint8_t elements[64 + sizeof(CDAWiFiTestRSNElement)];
+    uint8_t bssidOctets[6];
+    size_t length = 0;
+    
+    CDAWiFiMACAddressGetOctets(bssid, bssidOctets);
+    
+    if (ssid != NULL) {
+        
+        elements[length++] = 0;
+        elements[length++] = (uint8_t)strlen(ssid);
+        
+        memcpy(&elements[length], ssid, strlen(ssid));
+        
+        length += strlen(ssid);
+    }
+    
+    if (security == CDAWiFiTestSecurityWPA2Personal) {
+        
+        memcpy(&elements[length], CDAWiFiTestRSNElement, sizeof(CDAWiFiTestRSNElement));
+        
+        length += sizeof(CDAWiFiTestRSNElement);
+    }
+    
+    CDAWiFiNetlinkMessageInit(&message, 0x1C, NLM_F_MULTI, NL80211_CMD_NEW_SCAN_RESULTS);
+    
+    size_t nested = CDAWiFiNetlinkMessageBeginNested(&message, NL80211_ATTR_BSS);
+    
+    CDAWiFiNetlinkMessagePut(&message, NL80211_BSS_BSSID, bssidOctets, sizeof(bssidOctets));
+    CDAWiFiNetlinkMessagePutU32(&message, NL80211_BSS_FREQUENCY, frequency);
+    CDAWiFiNetlinkMessagePutU16(&message, NL80211_BSS_BEACON_INTERVAL, 100);
+    CDAWiFiNetlinkMessagePutU16(&message, NL80211_BSS_CAPABILITY, (security == CDAWiFiTestSecurityNone) ? 0x0401 : 0x0411);
+    CDAWiFiNetlinkMessagePutU32(&message, NL80211_BSS_SIGNAL_MBM, (uint32_t)(rssi * 100));
+    CDAWiFiNetlinkMessagePutU32(&message, NL80211_BSS_SEEN_MS_AGO, seenMillisecondsAgo);
+    CDAWiFiNetlinkMessagePut(&message, NL80211_BSS_INFORMATION_ELEMENTS, elements, length);
+    
+    CDAWiFiNetlinkMessageEndNested(&message, nested);
+    
+    const struct nlattr *attributes[NL80211_ATTR_MAX + 1];
+    
+    CDAWiFiNetlinkParseMessage(attributes, NL80211_ATTR_MAX, &message.buffer.header);
+    
+    return [[CDAWiFiNetwork alloc] initWithBSSAttribute:attributes[NL80211_ATTR_BSS] noiseMeasurement:-95 arena:arena];
+}
+
+OFString *CDAWiFiTestTemporaryPath(OFString *name)
+{
+    OFString *path = [OFString stringWithFormat:@"/tmp/CDAWiFiTests-%d-%@", (int)getpid(), name];
+    
+    unlink([path UTF8String]);
+    unlink([[path stringByAppendingString:@".tmp"] UTF8String]);
+    
+    return path;
+}
@@ -8,33 +8,137 @@
 
 #import <Cocoa/Cocoa.h>
 #import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiNetwork.h"
+#import "CDAWiFiNetwork+Private.h"
+#import "CDAWiFiChannel.h"
+#import "CDAWiFiScanArena.h"
+#import "CDAWiFiInformationElements.h"
+#import "CDAWiFiScanSnapshot.h"
+#import "CDAWiFiUtilities.h"
+#import "CDAWiFiTestFixtures.h"
 
+/* Decoding of nl80211 scan results, the input of every benchmark. */
 @interface CDAWiFiTests : XCTestCase
 
 @end
 
 @implementation CDAWiFiTests
 
-- (void)setUp {
-    [super setUp];
-    // Put setup code here. This method is called before the invocation of each test method in the class.
+- (void)testDecodesScanResult
+{
+    double now = CDAWiFiMonotonicTime();
+    CDAWiFiNetwork *network = CDAWiFiTestNetwork(0x020000000001ULL, "Home", 5180, -54, 2000, CDAWiFiTestSecurityWPA2Personal, nil);
+    
+    XCTAssertNotNil(network);
+    XCTAssertEqual(network.bssidValue, 0x020000000001ULL);
+    XCTAssertEqual(network.rssiValue, -54);
+    XCTAssertEqual(network.wlanChannel.channelNumber, 36);
+    XCTAssertEqual(network.wlanChannel.channelBand, CDAWiFiChannelBand5GHz);
+    XCTAssertTrue([network.ssid isEqual:@"Home"]);
+    XCTAssertTrue([network supportsSecurity:CDAWiFiSecurityWPA2Personal]);
+    XCTAssertFalse([network supportsSecurity:CDAWiFiSecurityNone]);
+    
+    /* The age reported by the kernel dates the network back. */
+    XCTAssertEqualWithAccuracy(network.lastSeen, now - 2, 0.5);
 }
 
-- (void)tearDown {
-    // Put teardown code here. This method is called after the invocation of each test method in the class.
-    [super tearDown];
+- (void)testDecodesOpenScanResult
+{
+    CDAWiFiNetwork *network = CDAWiFiTestNetwork(0x020000000002ULL, "Cafe", 2437, -70, 0, CDAWiFiTestSecurityNone, nil);
+    
+    XCTAssertEqual(network.wlanChannel.channelNumber, 6);
+    XCTAssertEqual(network.wlanChannel.channelBand, CDAWiFiChannelBand2GHz);
+    XCTAssertTrue([network supportsSecurity:CDAWiFiSecurityNone]);
 }
 
-- (void)testExample {
-    // This is an example of a functional test case.
-    XCTAssert(YES, @"Pass");
+- (void)testDecodesHiddenNetwork
+{
+    CDAWiFiNetwork *network = CDAWiFiTestNetwork(0x020000000003ULL, NULL, 2412, -60, 0, CDAWiFiTestSecurityNone, nil);
+    
+    XCTAssertNotNil(network);
+    XCTAssertNil(network.ssidData);
 }
 
-- (void)testPerformanceExample {
-    // This is an example of a performance test case.
-    [self measureBlock:^{
-        // Put the code you want to measure the time of here.
-    }];
+- (void)testSharesDumpArena
+{
+    CDAWiFiScanArena *arena = [[CDAWiFiScanArena alloc] init];
+    CDAWiFiNetwork *first = CDAWiFiTestNetwork(0x020000000004ULL, "One", 2412, -60, 0, CDAWiFiTestSecurityNone, arena);
+    CDAWiFiNetwork *second = CDAWiFiTestNetwork(0x020000000005ULL, "Two", 2412, -60, 0, CDAWiFiTestSecurityNone, arena);
+    
+    /* Elements of one dump are laid out back to back. */
+    XCTAssertEqual(second.informationElements, first.informationElements + first.informationElementLength);
+    XCTAssertTrue([second.ssid isEqual:@"Two"]);
+}
+
+- (void)testBatchScannersAgree
+{
+    CDAWiFiScanArena *arena = [[CDAWiFiScanArena alloc] init];
+    const uint8_t *elements[19];
+    uint32_t lengths[19];
+    CDAWiFiInformationElementIndex scalarIndexes[19];
+    CDAWiFiInformationElementIndex indexes[19];
+    
+    /* Enough networks for two AVX2 groups and a scalar tail, every other one secured. */
+    for (int network = 0; network < 19; network++) {
+        
+        CDAWiFiTestSecurity security = (network % 2) ? CDAWiFiTestSecurityWPA2Personal : CDAWiFiTestSecurityNone;
+        CDAWiFiNetwork *result = CDAWiFiTestNetwork(0x020000000100ULL + network, (network % 5) ? "Batch" : NULL, 2412, -60, 0, security, arena);
+        
+        elements[network] = result.informationElements;
+        lengths[network] = (uint32_t)result.informationElementLength;
+    }
+    
+    CDAWiFiInformationElementIndexBuildBatchWithScanner(scalarIndexes, elements, lengths, 19, CDAWiFiInformationElementScannerScalar);
+    
+    for (CDAWiFiInformationElementScanner scanner = CDAWiFiInformationElementScannerScalar; scanner <= CDAWiFiInformationElementScannerSSE2; scanner++) {
+        
+        CDAWiFiInformationElementIndexBuildBatchWithScanner(indexes, elements, lengths, 19, scanner);
+        
+        for (int network = 0; network < 19; network++) {
+            
+            XCTAssertEqual(indexes[network].present, scalarIndexes[network].present, @"scanner %d", scanner);
+            
+            for (int element = 0; element < CDAWiFiInformationElementCount; element++) {
+                
+                if (scalarIndexes[network].present & (1u << element)) {
+                    XCTAssertEqual(indexes[network].offsets[element], scalarIndexes[network].offsets[element], @"scanner %d", scanner);
+                }
+            }
+        }
+    }
+}
+
+- (void)testSnapshotKeepsAge
+{
+    CDAWiFiNetwork *network = CDAWiFiTestNetwork(0x020000000006ULL, "Home", 5180, -54, 12000, CDAWiFiTestSecurityWPA2Personal, nil);
+    OFDataArray *data = [CDAWiFiScanSnapshot dataWithNetworks:[OFArray arrayWithObject:network]];
+    CDAWiFiScanSnapshot *snapshot = [[CDAWiFiScanSnapshot alloc] initWithData:data error:NULL];
+    
+    XCTAssertNotNil(snapshot);
+    XCTAssertEqual(snapshot.count, (size_t)1);
+    
+    CDAWiFiNetwork *restored = [snapshot networkAtIndex:0];
+    
+    /* Restored results are as old as they were, not heard just now. */
+    XCTAssertEqual(restored.bssidValue, network.bssidValue);
+    XCTAssertTrue([restored.ssid isEqual:@"Home"]);
+    XCTAssertEqualWithAccuracy(restored.lastSeen, network.lastSeen, 0.5);
+}
+
+- (void)testChannelNumbersAndBandsAgree
+{
+    for (uint32_t frequency = 2300; frequency <= 6000; frequency++) {
+        
+        BOOL hasNumber = CDAWiFiChannelNumberForFrequency(frequency) != 0;
+        BOOL hasBand = CDAWiFiChannelBandForFrequency(frequency) != CDAWiFiChannelBandUnknown;
+        
+        XCTAssertEqual(hasNumber, hasBand, @"%u MHz", frequency);
+    }
+    
+    XCTAssertEqual(CDAWiFiChannelNumberForFrequency(5900), 180);
+    XCTAssertEqual(CDAWiFiChannelBandForFrequency(5900), CDAWiFiChannelBand5GHz);
+    XCTAssertEqual(CDAWiFiFrequencyForChannelNumber(180, CDAWiFiChannelBand5GHz), 5900u);
 }
 
 @end
@@ -0,0 +1,83 @@
+//
+//  CDAWiFiUtilitiesTests.m
+//  CDAWiFiTests
+//
+//  Created by Alsey Coleman Miller on 3/13/15.
+//  Copyright (c) 2015 ColemanCDA. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import <XCTest/XCTest.h>
+#import <ObjFW/ObjFW.h>
+#import "CDAWiFiUtilities.h"
+
+/* Private helpers shared by the CDAWiFi classes. */
+@interface CDAWiFiUtilitiesTests : XCTestCase
+
+@end
+
+@implementation CDAWiFiUtilitiesTests
+
+- (void)testHazardPointerProtectsUntilReleased
+{
+    static int first, second;
+    _Atomic(void *) pointer;
+    
+    atomic_init(&pointer, &first);
+    
+    XCTAssertEqual(CDAWiFiHazardPointerAcquire(&pointer), (void *)&first);
+    XCTAssertTrue(CDAWiFiHazardPointerIsProtected(&first));
+    
+    /* Replaced, but still protected by the reader. */
+    atomic_store(&pointer, &second);
+    
+    XCTAssertTrue(CDAWiFiHazardPointerIsProtected(&first));
+    XCTAssertFalse(CDAWiFiHazardPointerIsProtected(&second));
+    
+    CDAWiFiHazardPointerRelease();
+    
+    XCTAssertFalse(CDAWiFiHazardPointerIsProtected(&first));
+    XCTAssertEqual(CDAWiFiHazardPointerAcquire(&pointer), (void *)&second);
+    
+    CDAWiFiHazardPointerRelease();
+}
+
+- (void)testHazardPointerOfOtherThread
+{
+    static int value;
+    _Atomic(void *) pointer;
+    _Atomic(void *) *pointerAddress = &pointer;
+    dispatch_semaphore_t acquired = dispatch_semaphore_create(0);
+    dispatch_semaphore_t checked = dispatch_semaphore_create(0);
+    dispatch_semaphore_t released = dispatch_semaphore_create(0);
+    
+    atomic_init(&pointer, &value);
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        CDAWiFiHazardPointerAcquire(pointerAddress);
+        
+        dispatch_semaphore_signal(acquired);
+        dispatch_semaphore_wait(checked, DISPATCH_TIME_FOREVER);
+        
+        CDAWiFiHazardPointerRelease();
+        
+        dispatch_semaphore_signal(released);
+    });
+    
+    dispatch_semaphore_wait(acquired, DISPATCH_TIME_FOREVER);
+    
+    /* Writers see the protection of every thread. */
+    XCTAssertTrue(CDAWiFiHazardPointerIsProtected(&value));
+    
+    dispatch_semaphore_signal(checked);
+    dispatch_semaphore_wait(released, DISPATCH_TIME_FOREVER);
+    
+    XCTAssertFalse(CDAWiFiHazardPointerIsProtected(&value));
+    
+    CDAWiFiDispatchRelease(acquired);
+    CDAWiFiDispatchRelease(checked);
+    CDAWiFiDispatchRelease(released);
+}
+
+@end